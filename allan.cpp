@@ -0,0 +1,141 @@
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <array>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iostream>
+#include "AllanVariance.h"
+#include "ClockSync.h"
+#include "Recording.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+namespace fs = boost::filesystem;
+
+// get the section string
+string section(const string& text) {
+    return fmt::format(fmt::fg(fmt::color::cyan), "{:═^{}}", " " + text + " ",
+                       max(100, static_cast<int>(text.size() + 12)));
+}
+
+int main(int argc, char* argv[]) {
+    // argument parser
+    cxxopts::Options options(argv[0], "Compute the Allan deviation of IMU in static recording, and estimate the noise");
+    // clang-format off
+    options.add_options()("i,input", "device folder of recording, which contains the segments with imu.csv",
+                          cxxopts::value<string>())
+        ("o,output", "output Allan deviation curves, \"sensor,tau,x,y,z,error\" per line",
+         cxxopts::value<string>()->default_value("allan.csv"))
+        ("n,noise", "output noise parameters in the imu.yaml format of Kalibr",
+         cxxopts::value<string>()->default_value("imu_noise.yaml"))
+        ("pointsPerDecade", "cluster time number per decade", cxxopts::value<int>()->default_value("20"))
+        ("minClusters", "min non-overlapping cluster number of the longest cluster time",
+         cxxopts::value<int>()->default_value("9"))
+        ("threads", "thread number, 0 for CPU number", cxxopts::value<int>()->default_value("0"))
+        ("h,help", "help message");
+    // clang-format on
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("input")) {
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    // init glog
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_alsologtostderr = true;
+    FLAGS_colorlogtostderr = true;
+
+    cout << section("Allan Variance") << endl;
+    fs::path folder{result["input"].as<string>()};
+    AllanOptions allanOptions;
+    allanOptions.pointsPerDecade = result["pointsPerDecade"].as<int>();
+    allanOptions.minClusters = result["minClusters"].as<int>();
+    allanOptions.threads = result["threads"].as<int>();
+    // the accelerator and gyroscope have their own records and timestamps, the unused one is zero. The accelerator is
+    // never zero as there is gravity
+    AllanVariance acc(allanOptions), gyro(allanOptions);
+    RecordingReader reader(folder, false);
+    CHECK_GT(reader.segmentNum(), 0) << fmt::format("cannot find any closed segment in \"{}\"", folder.string());
+    RecordingItem item;
+    int64_t startTime = hostNow();
+    while (reader.next(&item)) {
+        const ImuRecord& record = item.imu;
+        bool hasAcc = record.acc[0] != 0 || record.acc[1] != 0 || record.acc[2] != 0;
+        if (hasAcc) {
+            acc.add(record.timestamp, Vec3d(record.acc));
+        }
+        if (!hasAcc || record.gyro[0] != 0 || record.gyro[1] != 0 || record.gyro[2] != 0) {
+            gyro.add(record.timestamp, Vec3d(record.gyro));
+        }
+    }
+    int64_t readTime = hostNow() - startTime;
+    startTime = hostNow();
+    auto accCurves = acc.compute();
+    auto gyroCurves = gyro.compute();
+    int64_t computeTime = hostNow() - startTime;
+    LOG(INFO) << fmt::format("read {} accelerator and {} gyroscope samples in {:.3f} s, compute in {:.3f} s",
+                             acc.sampleNum(), gyro.sampleNum(), readTime * 1.0E-9, computeTime * 1.0E-9);
+
+    const array<const char*, 3> axes{"x", "y", "z"};
+    ofstream curveFile(result["output"].as<string>());
+    CHECK(curveFile.is_open()) << fmt::format("cannot create \"{}\"", result["output"].as<string>());
+    curveFile << "# sensor,tau(s),x,y,z,relative error" << endl;
+    // noise parameters of all axes, the largest one is used for VIO
+    auto analyze = [&](const string& name, const AllanVariance& allan, const array<AllanCurve, 3>& curves,
+                       const string& unit, NoiseParameters* worst) {
+        double period = allan.samplePeriod();
+        if (curves[0].taus.empty()) {
+            LOG(WARNING) << fmt::format("{}, too few samples to compute Allan deviation", name);
+            return;
+        }
+        LOG(INFO) << fmt::format("{}, {} samples, {:.3f} h, rate = {:.3f} Hz, max interval = {:.3f} ms, tau = [{:.4f}, "
+                                 "{:.1f}] s",
+                                 name, allan.sampleNum(), allan.sampleNum() * period / 3600, 1 / period,
+                                 allan.maxInterval() * 1.0E3, curves[0].taus.front(), curves[0].taus.back());
+        if (allan.maxInterval() > 2 * period) {
+            LOG(WARNING) << fmt::format("{}, there are lost samples, the max interval is {:.1f} times of the period",
+                                        name, allan.maxInterval() / period);
+        }
+        for (size_t i = 0; i < curves[0].taus.size(); ++i) {
+            curveFile << fmt::format("{},{:.6f},{:.9e},{:.9e},{:.9e},{:.4f}\n", name, curves[0].taus[i],
+                                     curves[0].deviations[i], curves[1].deviations[i], curves[2].deviations[i],
+                                     curves[0].errors[i]);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            NoiseParameters noise = estimateNoise(curves[axis]);
+            LOG(INFO) << fmt::format("{} {}, noise density = {:.6e} {}/sqrt(Hz)(tau = {:.3f} s), random walk = {:.6e} "
+                                     "{}*sqrt(Hz)(tau = {:.1f} s), bias instability = {:.6e} {}",
+                                     name, axes[axis], noise.noiseDensity, unit, noise.noiseTau, noise.randomWalk,
+                                     unit, noise.randomWalkTau, noise.biasInstability, unit);
+            if (noise.randomWalk == 0) {
+                LOG(WARNING) << fmt::format("{} {}, the random walk isn't found, record longer", name, axes[axis]);
+            }
+            worst->noiseDensity = max(worst->noiseDensity, noise.noiseDensity);
+            worst->randomWalk = max(worst->randomWalk, noise.randomWalk);
+            worst->biasInstability = max(worst->biasInstability, noise.biasInstability);
+        }
+    };
+    NoiseParameters accNoise, gyroNoise;
+    analyze("acc", acc, accCurves, "m/s^2", &accNoise);
+    analyze("gyro", gyro, gyroCurves, "rad/s", &gyroNoise);
+
+    // the continuous time noise parameters, the largest of 3 axes
+    ofstream noiseFile(result["noise"].as<string>());
+    CHECK(noiseFile.is_open()) << fmt::format("cannot create \"{}\"", result["noise"].as<string>());
+    double period = gyro.sampleNum() > 1 ? gyro.samplePeriod() : acc.samplePeriod();
+    noiseFile << fmt::format("# IMU noise from Allan deviation of \"{}\", the largest of 3 axes\n", folder.string());
+    noiseFile << fmt::format("accelerometer_noise_density: {:.6e}  # m/s^2/sqrt(Hz)\n", accNoise.noiseDensity);
+    noiseFile << fmt::format("accelerometer_random_walk: {:.6e}  # m/s^3/sqrt(Hz)\n", accNoise.randomWalk);
+    noiseFile << fmt::format("gyroscope_noise_density: {:.6e}  # rad/s/sqrt(Hz)\n", gyroNoise.noiseDensity);
+    noiseFile << fmt::format("gyroscope_random_walk: {:.6e}  # rad/s^2/sqrt(Hz)\n", gyroNoise.randomWalk);
+    noiseFile << fmt::format("update_rate: {:.1f}  # Hz\n", period > 0 ? 1 / period : 0.0);
+    LOG(INFO) << fmt::format("save Allan deviation to \"{}\" and noise parameters to \"{}\"",
+                             result["output"].as<string>(), result["noise"].as<string>());
+
+    google::ShutdownGoogleLogging();
+    return 0;
+}
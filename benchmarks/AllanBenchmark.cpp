@@ -0,0 +1,41 @@
+#include "AllanVariance.h"
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// compute the Allan deviation of 200 Hz gyroscope with white noise and bias random walk, arguments are (hours, threads)
+static void BM_AllanVariance(benchmark::State& state) {
+    const int rate = 200;
+    const auto samples = static_cast<int64_t>(state.range(0) * 3600 * rate);
+    AllanOptions options;
+    options.threads = static_cast<int>(state.range(1));
+    AllanVariance allan(options);
+    RNG rng(0);
+    Vec3d bias(0.01, -0.02, 0.005);
+    for (int64_t i = 0; i < samples; ++i) {
+        Vec3d values;
+        for (int j = 0; j < 3; ++j) {
+            bias[j] += rng.gaussian(2.0E-5 / sqrt(rate));
+            values[j] = bias[j] + rng.gaussian(1.7E-4 * sqrt(rate));
+        }
+        allan.add(i * 1000000000 / rate, values);
+    }
+    size_t points{0};
+    for (auto _ : state) {
+        auto curves = allan.compute();
+        points = curves[0].taus.size();
+        benchmark::DoNotOptimize(curves);
+    }
+    state.SetItemsProcessed(state.iterations() * samples * 3);
+    state.counters["taus"] = static_cast<double>(points);
+}
+BENCHMARK(BM_AllanVariance)
+    ->ArgNames({"hours", "threads"})
+    ->Args({1, 1})
+    ->Args({6, 1})
+    ->Args({6, 4})
+    ->Args({6, 8})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
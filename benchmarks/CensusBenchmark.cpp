@@ -0,0 +1,126 @@
+#include "Census.h"
+#include <algorithm>
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// disparity number of cost volume
+constexpr int kDisparities = 64;
+
+// disparity of synthetic stereo pair, pixel
+constexpr int kDisparity = 32;
+
+// all stream resolutions with each SIMD level as benchmark arguments, (width, height, simd)
+static void stereoKernelArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"width", "height", "simd"});
+    for (auto& s : kStreamResolutions) {
+        for (auto level : {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2}) {
+            b->Args({s.width, s.height, static_cast<int>(level)});
+        }
+    }
+}
+
+// get the SIMD level from benchmark arguments, skip the benchmark if it's not supported
+static bool simdLevel(benchmark::State& state, SimdLevel* level) {
+    *level = static_cast<SimdLevel>(state.range(2));
+    state.SetLabel(simdLevelName(*level));
+    if (*level > bestSimdLevel()) {
+        state.SkipWithError("SIMD level is not supported");
+        return false;
+    }
+    return true;
+}
+
+// check the output of SIMD level is bitwise equal to the scalar reference, skip the benchmark if not
+static bool checkOutput(benchmark::State& state, const Mat& output, const Mat& reference) {
+    if (output.size() != reference.size() || output.type() != reference.type() || !output.isContinuous() ||
+        !reference.isContinuous() ||
+        !equal(output.data, output.data + output.total() * output.elemSize(), reference.data)) {
+        state.SkipWithError("output is different from scalar");
+        return false;
+    }
+    return true;
+}
+
+// census transform of rectified gray image
+static void censusKernel(benchmark::State& state, CensusWindow window) {
+    SimdLevel level;
+    if (!simdLevel(state, &level)) {
+        return;
+    }
+    Mat gray = syntheticTexture(resolution(state));
+    Mat census, reference;
+    censusTransform(gray, window, census, level);
+    censusTransform(gray, window, reference, SimdLevel::Scalar);
+    if (!checkOutput(state, census, reference)) {
+        return;
+    }
+    for (auto _ : state) {
+        censusTransform(gray, window, census, level);
+        benchmark::DoNotOptimize(census.data);
+    }
+    state.SetBytesProcessed(state.iterations() * gray.total());
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_Census5x5(benchmark::State& state) { censusKernel(state, CensusWindow::W5x5); }
+BENCHMARK(BM_Census5x5)->Apply(stereoKernelArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_Census7x9(benchmark::State& state) { censusKernel(state, CensusWindow::W7x9); }
+BENCHMARK(BM_Census7x9)->Apply(stereoKernelArgs)->Unit(benchmark::kMillisecond);
+
+// Hamming cost volume of 64 disparities, the right image is the left image shifted by disparity
+static void hammingKernel(benchmark::State& state, CensusWindow window) {
+    SimdLevel level;
+    if (!simdLevel(state, &level)) {
+        return;
+    }
+    Size size = resolution(state);
+    Mat texture = syntheticTexture(Size(size.width + kDisparity, size.height));
+    Mat left, right, cost, reference;
+    censusTransform(texture(Rect(kDisparity, 0, size.width, size.height)).clone(), window, left);
+    censusTransform(texture(Rect(0, 0, size.width, size.height)).clone(), window, right);
+    hammingCost(left, right, kDisparities, cost, level);
+    hammingCost(left, right, kDisparities, reference, SimdLevel::Scalar);
+    if (!checkOutput(state, cost, reference)) {
+        return;
+    }
+    for (auto _ : state) {
+        hammingCost(left, right, kDisparities, cost, level);
+        benchmark::DoNotOptimize(cost.data);
+    }
+    state.SetItemsProcessed(state.iterations() * size.area() * kDisparities);
+}
+
+static void BM_HammingCost5x5(benchmark::State& state) { hammingKernel(state, CensusWindow::W5x5); }
+BENCHMARK(BM_HammingCost5x5)->Apply(stereoKernelArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_HammingCost7x9(benchmark::State& state) { hammingKernel(state, CensusWindow::W7x9); }
+BENCHMARK(BM_HammingCost7x9)->Apply(stereoKernelArgs)->Unit(benchmark::kMillisecond);
+
+// 5x5 box aggregation of the Hamming cost volume of 64 disparities
+static void BM_AggregateCost(benchmark::State& state) {
+    SimdLevel level;
+    if (!simdLevel(state, &level)) {
+        return;
+    }
+    Size size = resolution(state);
+    Mat texture = syntheticTexture(Size(size.width + kDisparity, size.height));
+    Mat left, right, cost, aggregated, reference;
+    censusTransform(texture(Rect(kDisparity, 0, size.width, size.height)).clone(), CensusWindow::W5x5, left);
+    censusTransform(texture(Rect(0, 0, size.width, size.height)).clone(), CensusWindow::W5x5, right);
+    hammingCost(left, right, kDisparities, cost);
+    aggregateCost(cost, kDisparities, 5, aggregated, level);
+    aggregateCost(cost, kDisparities, 5, reference, SimdLevel::Scalar);
+    if (!checkOutput(state, aggregated, reference)) {
+        return;
+    }
+    for (auto _ : state) {
+        aggregateCost(cost, kDisparities, 5, aggregated, level);
+        benchmark::DoNotOptimize(aggregated.data);
+    }
+    state.SetItemsProcessed(state.iterations() * size.area() * kDisparities);
+}
+BENCHMARK(BM_AggregateCost)->Apply(stereoKernelArgs)->Unit(benchmark::kMillisecond);
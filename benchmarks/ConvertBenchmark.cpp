@@ -0,0 +1,49 @@
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// YUYV to BGR conversion
+static void BM_YuyvToBgr(benchmark::State& state) {
+    Mat yuyv = syntheticYuyv(resolution(state));
+    Mat bgr;
+    for (auto _ : state) {
+        cvtColor(yuyv, bgr, COLOR_YUV2BGR_YUYV);
+        benchmark::DoNotOptimize(bgr.data);
+    }
+    state.SetBytesProcessed(state.iterations() * yuyv.total() * yuyv.elemSize());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_YuyvToBgr)->Apply(streamResolutions)->Unit(benchmark::kMillisecond);
+
+// YUYV to gray conversion
+static void BM_YuyvToGray(benchmark::State& state) {
+    Mat yuyv = syntheticYuyv(resolution(state));
+    Mat gray;
+    for (auto _ : state) {
+        cvtColor(yuyv, gray, COLOR_YUV2GRAY_YUYV);
+        benchmark::DoNotOptimize(gray.data);
+    }
+    state.SetBytesProcessed(state.iterations() * yuyv.total() * yuyv.elemSize());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_YuyvToGray)->Apply(streamResolutions)->Unit(benchmark::kMillisecond);
+
+// JPEG encoding of BGR image with default recorder quality
+static void BM_JpegEncode(benchmark::State& state) {
+    Mat bgr;
+    cvtColor(syntheticYuyv(resolution(state)), bgr, COLOR_YUV2BGR_YUYV);
+    const vector<int> params = {IMWRITE_JPEG_QUALITY, 95};
+    vector<uchar> buffer;
+    for (auto _ : state) {
+        imencode(".jpg", bgr, buffer, params);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bgr.total() * bgr.elemSize());
+    state.SetItemsProcessed(state.iterations());
+    state.counters["jpegBytes"] = static_cast<double>(buffer.size());
+}
+BENCHMARK(BM_JpegEncode)->Apply(streamResolutions)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,76 @@
+#include "DepthFilter.h"
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// frame number of synthetic depth sequence
+constexpr int kDepthFrames = 8;
+
+// synthetic depth sequence of a slanted floor and a box, with noise, 5% holes and flicker
+static vector<Mat> syntheticDepth(const Size& size) {
+    RNG rng(0);
+    vector<Mat> frames;
+    for (int i = 0; i < kDepthFrames; ++i) {
+        Mat depth(size, CV_16UC1);
+        for (int y = 0; y < size.height; ++y) {
+            auto row = depth.ptr<uint16_t>(y);
+            for (int x = 0; x < size.width; ++x) {
+                bool box = x > size.width / 3 && x < size.width / 2 && y > size.height / 3;
+                double d = box ? 1500 : 5000 - 3000.0 * y / size.height;
+                row[x] = rng.uniform(0, 20) == 0 ? 0 : static_cast<uint16_t>(d + rng.gaussian(d * 0.01));
+            }
+        }
+        frames.emplace_back(depth);
+    }
+    return frames;
+}
+
+// filter depth sequence in place, the frame is copied to the reused buffer first as the filter is in place
+static void depthFilter(benchmark::State& state, const DepthFilterOptions& options) {
+    vector<Mat> frames = syntheticDepth(resolution(state));
+    DepthFilter filter(options);
+    Mat depth;
+    size_t i{0};
+    for (auto _ : state) {
+        frames[i++ % frames.size()].copyTo(depth);
+        filter.filter(depth);
+        benchmark::DoNotOptimize(depth.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// all stages with default options
+static void BM_DepthFilter(benchmark::State& state) { depthFilter(state, DepthFilterOptions()); }
+BENCHMARK(BM_DepthFilter)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
+
+// spatial filter only
+static void BM_DepthSpatial(benchmark::State& state) {
+    DepthFilterOptions options;
+    options.temporal = false;
+    options.holeFill = HoleFill::None;
+    depthFilter(state, options);
+}
+BENCHMARK(BM_DepthSpatial)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
+
+// temporal filter only
+static void BM_DepthTemporal(benchmark::State& state) {
+    DepthFilterOptions options;
+    options.spatial = false;
+    options.holeFill = HoleFill::None;
+    depthFilter(state, options);
+}
+BENCHMARK(BM_DepthTemporal)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,102 @@
+#include <fmt/format.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <thread>
+#include "BlockingQueue.h"
+#include "RecordPipeline.h"
+#include "SegmentWriter.h"
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+namespace fs = boost::filesystem;
+
+// temp folder for writing benchmark, removed when the benchmark is finished
+class TempFolder {
+  public:
+    TempFolder() : path_(fs::temp_directory_path() / fs::unique_path("mev_benchmark_%%%%%%%%")) {
+        fs::create_directories(path_);
+    }
+    ~TempFolder() { fs::remove_all(path_); }
+    inline const fs::path& path() const { return path_; }
+
+  private:
+    fs::path path_;
+};
+
+// write raw image to file
+static void BM_RawWrite(benchmark::State& state) {
+    TempFolder folder;
+    Mat yuyv = syntheticYuyv(resolution(state));
+    const size_t bytes = yuyv.total() * yuyv.elemSize();
+    size_t index{0};
+    for (auto _ : state) {
+        ofstream outFs((folder.path() / fmt::format("{}.bin", index++ % 64)).string(), ios::binary);
+        outFs.write(reinterpret_cast<const char*>(yuyv.data), bytes);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RawWrite)->Apply(streamResolutions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// write encoded image by segment writer, including index
+static void BM_SegmentWrite(benchmark::State& state) {
+    TempFolder folder;
+    SegmentOptions options;
+    options.minFreeSpace = 0;
+    SegmentWriter writer(folder.path(), options, {"left"});
+    ImageRecord record;
+    record.stream = "left";
+    record.ext = "jpg";
+    record.data.resize(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        record.timestamp += 33333333;
+        writer.write(record);
+    }
+    writer.close();
+    state.SetBytesProcessed(state.iterations() * record.data.size());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SegmentWrite)->Arg(100 << 10)->Arg(400 << 10)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// format IMU record to line
+static void BM_ImuFormat(benchmark::State& state) {
+    ImuRecord record;
+    record.timestamp = 1600000000000000000;
+    record.hostTimestamp = 1600000000001000000;
+    record.acc[2] = 9.80665;
+    record.gyro[0] = 0.0123456789;
+    size_t bytes{0};
+    for (auto _ : state) {
+        ++record.timestamp;
+        string line = formatImuRecord(record);
+        bytes += line.size();
+        benchmark::DoNotOptimize(line.data());
+    }
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ImuFormat);
+
+// hand off raw frame from capture thread to encode thread by blocking queue, the time is the latency per frame
+static void BM_QueueHandoff(benchmark::State& state) {
+    BlockingQueue<RawFrame> queue(static_cast<size_t>(state.range(0)));
+    thread consumer([&] {
+        RawFrame frame;
+        while (queue.pop(frame)) {
+            benchmark::DoNotOptimize(frame.image.data);
+        }
+    });
+    Mat image = syntheticYuyv(Size(640, 480));
+    for (auto _ : state) {
+        RawFrame frame;
+        frame.stream = "left";
+        frame.image = image;
+        queue.push(std::move(frame));
+    }
+    queue.close();
+    consumer.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueHandoff)->Arg(1)->Arg(60)->UseRealTime();
@@ -0,0 +1,57 @@
+#include "ObstacleDetector.h"
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// synthetic depth of a camera 0.3 m above the floor looking down 15 degrees, with a 0.5x0.5x0.3 m box 2 m ahead
+static Mat syntheticScene(const DepthCamera& camera, const MountingPose& pose, const Size& size) {
+    Matx33d rotation;
+    Vec3d translation;
+    mountingTransform(pose, &rotation, &translation);
+    RNG rng(0);
+    Mat depth(size, CV_16UC1, Scalar(0));
+    for (int v = 0; v < size.height; ++v) {
+        auto row = depth.ptr<uint16_t>(v);
+        for (int u = 0; u < size.width; ++u) {
+            // ray cast to the floor and the front face of box
+            Vec3d ray = rotation * Vec3d((u - camera.cx) / camera.fx, (v - camera.cy) / camera.fy, 1);
+            double z = ray[2] < 0 ? -translation[2] / ray[2] : 1E9;
+            if (ray[0] > 0) {
+                double s = (2.0 - translation[0]) / ray[0];
+                Vec3d p = translation + ray * s;
+                if (p[1] > -0.25 && p[1] < 0.25 && p[2] < 0.3 && s < z) {
+                    z = s;
+                }
+            }
+            if (z < 10) {
+                row[u] = static_cast<uint16_t>(z * 1000 + rng.gaussian(z * 5));
+            }
+        }
+    }
+    return depth;
+}
+
+static void BM_ObstacleDetect(benchmark::State& state) {
+    Size size = resolution(state);
+    DepthCamera camera;
+    camera.fx = camera.fy = size.width / 2.0;
+    camera.cx = size.width / 2.0;
+    camera.cy = size.height / 2.0;
+    MountingPose pose;
+    pose.height = 0.3;
+    pose.pitch = 15;
+    Mat depth = syntheticScene(camera, pose, size);
+    ObstacleDetector detector(camera, pose);
+    for (auto _ : state) {
+        detector.detect(depth);
+        benchmark::DoNotOptimize(detector.nearest());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ObstacleDetect)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
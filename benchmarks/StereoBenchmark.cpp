@@ -0,0 +1,54 @@
+#include "SparseStereo.h"
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// disparity of synthetic stereo pair, pixel
+constexpr int kDisparity = 32;
+
+// sparse stereo matching of 150 features with SAD or ZNCC, the right image is the left image shifted by disparity
+static void sparseStereo(benchmark::State& state, MatchCost cost) {
+    Size size = resolution(state);
+    Mat texture = syntheticTexture(Size(size.width + kDisparity, size.height));
+    Mat left = texture(Rect(kDisparity, 0, size.width, size.height)).clone();
+    Mat right = texture(Rect(0, 0, size.width, size.height)).clone();
+    vector<Feature> features;
+    for (int r = 0; r < 10; ++r) {
+        for (int c = 0; c < 15; ++c) {
+            Feature f;
+            f.id = features.size();
+            f.point = Point2f((c + 0.5f) * size.width / 15, (r + 0.5f) * size.height / 10);
+            features.emplace_back(f);
+        }
+    }
+    StereoCamera camera;
+    camera.fx = camera.fy = size.width / 2.0;
+    camera.cx = size.width / 2.0;
+    camera.cy = size.height / 2.0;
+    camera.baseline = 0.12;
+    SparseStereoOptions options;
+    options.cost = cost;
+    SparseStereoMatcher matcher(camera, options);
+    for (auto _ : state) {
+        auto& points = matcher.match(left, right, features);
+        benchmark::DoNotOptimize(points.data());
+    }
+    state.SetItemsProcessed(state.iterations() * features.size());
+    state.counters["matched"] = static_cast<double>(matcher.points().size());
+}
+
+static void BM_SparseStereoSad(benchmark::State& state) { sparseStereo(state, MatchCost::SAD); }
+BENCHMARK(BM_SparseStereoSad)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SparseStereoZncc(benchmark::State& state) { sparseStereo(state, MatchCost::ZNCC); }
+BENCHMARK(BM_SparseStereoZncc)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
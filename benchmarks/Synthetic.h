@@ -0,0 +1,36 @@
+#pragma once
+#include <benchmark/benchmark.h>
+#include <array>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include "PipelineBenchmark.h"
+
+namespace mev {
+
+// resolutions of stream mode, 2560x720, 1280x720, 1280x480 and 640x480
+const std::array<cv::Size, 4> kStreamResolutions = {cv::Size(2560, 720), cv::Size(1280, 720), cv::Size(1280, 480),
+                                                    cv::Size(640, 480)};
+
+// add all stream resolutions as benchmark arguments, (width, height)
+inline void streamResolutions(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"width", "height"});
+    for (auto& s : kStreamResolutions) {
+        b->Args({s.width, s.height});
+    }
+}
+
+// get the resolution from benchmark arguments
+inline cv::Size resolution(const benchmark::State& state) {
+    return cv::Size(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+}
+
+// synthetic gray image of smooth random texture with corners, which is upsampled from random pixels by 8 times
+inline cv::Mat syntheticTexture(const cv::Size& size) {
+    cv::Mat small((size.height + 7) / 8, (size.width + 7) / 8, CV_8UC1);
+    cv::randu(small, cv::Scalar(0), cv::Scalar(256));
+    cv::Mat texture;
+    cv::resize(small, texture, cv::Size(small.cols * 8, small.rows * 8), 0, 0, cv::INTER_CUBIC);
+    return texture(cv::Rect(0, 0, size.width, size.height)).clone();
+}
+
+}  // namespace mev
@@ -0,0 +1,80 @@
+#include "ImuIntegration.h"
+#include "Synthetic.h"
+#include "TimeOffset.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// synthetic frame of rotating camera, the IMU records are since the previous frame
+struct SyntheticFrame {
+    int64_t timestamp{0};
+    vector<Feature> features;
+    vector<ImuRecord> imu;
+};
+
+// 10 s of 30 fps camera rotating in sinusoid among directions at infinity, and 200 Hz gyroscope 10 ms late
+static vector<SyntheticFrame> syntheticRotation(const Matx33d& cameraMatrix, const Matx33d& cameraImu) {
+    RNG rng(0);
+    vector<Vec3d> directions(2000);
+    for (auto& d : directions) {
+        d = Vec3d(rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0));
+        d /= norm(d);
+    }
+    auto velocity = [](double t) {
+        return Vec3d(sin(2.1 * t) + 0.5 * sin(5.3 * t), 0.8 * cos(1.7 * t) + 0.3 * sin(7.1 * t), 0.6 * sin(3.1 * t));
+    };
+    vector<SyntheticFrame> frames;
+    SyntheticFrame frame;
+    Matx33d rotation = Matx33d::eye();
+    const int64_t dt = 100000;
+    for (int64_t t = 0; t < 10000000000; t += dt) {
+        rotation = rotation * expRotation(velocity(t * 1.0E-9) * (dt * 1.0E-9));
+        if (t % 5000000 == 0) {
+            ImuRecord record;
+            record.timestamp = t;
+            Vec3d w = cameraImu.t() * velocity(t * 1.0E-9 - 0.01);
+            for (int i = 0; i < 3; ++i) {
+                record.gyro[i] = w[i] + rng.gaussian(0.005);
+            }
+            frame.imu.emplace_back(record);
+        }
+        if (t % 33300000 == 0) {
+            frame.timestamp = t;
+            for (size_t i = 0; i < directions.size() && frame.features.size() < 150; ++i) {
+                Vec3d c = rotation.t() * directions[i];
+                Vec3d p = cameraMatrix * c;
+                Feature f;
+                f.id = i;
+                f.point = Point2f(static_cast<float>(p[0] / p[2] + rng.gaussian(0.5)),
+                                  static_cast<float>(p[1] / p[2] + rng.gaussian(0.5)));
+                f.age = 1;
+                if (c[2] > 0.3 && f.point.x >= 0 && f.point.x < 640 && f.point.y >= 0 && f.point.y < 480) {
+                    frame.features.emplace_back(f);
+                }
+            }
+            frames.emplace_back(std::move(frame));
+            frame = SyntheticFrame();
+        }
+    }
+    return frames;
+}
+
+// estimate the time offset of all frames, 5 s sliding window and +-50 ms search range
+static void BM_TimeOffset(benchmark::State& state) {
+    const Matx33d cameraMatrix(500, 0, 320, 0, 500, 240, 0, 0, 1);
+    const Matx33d cameraImu = expRotation(Vec3d(0.1, -0.2, 1.5));
+    auto frames = syntheticRotation(cameraMatrix, cameraImu);
+    double offset{0};
+    for (auto _ : state) {
+        TimeOffsetEstimator estimator(cameraMatrix, cameraImu);
+        for (auto& frame : frames) {
+            estimator.addImu(ImuSpan{frame.imu.data(), frame.imu.size()});
+            estimator.addFrame(frame.timestamp, frame.features);
+        }
+        offset = estimator.estimate().offset;
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(frames.size()));
+    state.counters["offset_ms"] = offset * 1.0E-6;
+}
+BENCHMARK(BM_TimeOffset)->Unit(benchmark::kMillisecond);
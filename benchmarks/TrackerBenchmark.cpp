@@ -0,0 +1,70 @@
+#include <opencv2/imgproc.hpp>
+#include "FeatureTracker.h"
+#include "Synthetic.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// frame number of synthetic sequence
+constexpr int kTrackFrames = 16;
+
+// synthetic gray sequence of a smooth random texture moving 2 pixels right and 1 pixel down each frame, and back
+static vector<Mat> syntheticSequence(const Size& size) {
+    Mat texture = syntheticTexture(Size(size.width + 2 * kTrackFrames, size.height + kTrackFrames));
+    vector<Mat> frames;
+    for (int i = 0; i < kTrackFrames; ++i) {
+        frames.emplace_back(texture(Rect(2 * i, i, size.width, size.height)).clone());
+    }
+    for (int i = kTrackFrames - 2; i > 0; --i) {
+        frames.emplace_back(frames[i]);
+    }
+    return frames;
+}
+
+// KLT tracking of left image, including gray conversion, pyramid building, tracking and detection. With prediction,
+// the motion between frames is given as homography like the IMU rotation homography
+static void kltTrack(benchmark::State& state, bool predict) {
+    Size size = resolution(state);
+    vector<Mat> frames = syntheticSequence(size);
+    vector<Mat> bgrFrames(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        cvtColor(frames[i], bgrFrames[i], COLOR_GRAY2BGR);
+    }
+    FeatureTracker tracker;
+    const Matx33d forward(1, 0, 2, 0, 1, 1, 0, 0, 1);
+    const Matx33d backward(1, 0, -2, 0, 1, -1, 0, 0, 1);
+    size_t index{0};
+    for (auto _ : state) {
+        size_t i = index++ % bgrFrames.size();
+        // the sequence moves forward to frame kTrackFrames - 1 and then backward to frame 0
+        const Matx33d* homography{nullptr};
+        if (predict && index > 1) {
+            homography = i > 0 && i < kTrackFrames ? &forward : &backward;
+        }
+        auto& features = tracker.track(bgrFrames[i], homography);
+        benchmark::DoNotOptimize(features.data());
+    }
+    auto& statistics = tracker.statistics();
+    double frameNum = static_cast<double>(statistics.frames);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["features"] = static_cast<double>(statistics.tracked + statistics.detected) / frameNum;
+    state.counters["tracked"] = static_cast<double>(statistics.tracked) / frameNum;
+    state.counters["pyramidMs"] = statistics.pyramidTime * 1.0E-6 / frameNum;
+    state.counters["trackMs"] = statistics.trackTime * 1.0E-6 / frameNum;
+    state.counters["detectMs"] = statistics.detectTime * 1.0E-6 / frameNum;
+}
+
+static void BM_KltTrack(benchmark::State& state) { kltTrack(state, false); }
+BENCHMARK(BM_KltTrack)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_KltTrackPredicted(benchmark::State& state) { kltTrack(state, true); }
+BENCHMARK(BM_KltTrackPredicted)
+    ->ArgNames({"width", "height"})
+    ->Args({1280, 720})
+    ->Args({640, 480})
+    ->Unit(benchmark::kMillisecond);
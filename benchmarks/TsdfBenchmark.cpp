@@ -0,0 +1,70 @@
+#include "ImuIntegration.h"
+#include "Synthetic.h"
+#include "TsdfVolume.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+
+// frame number of synthetic depth sequence
+constexpr int kTsdfFrames = 8;
+
+// synthetic depth sequence of a 4x4 m room, the camera is 1 m above the floor, looks forward and down, and pans
+static void syntheticRoom(const DepthCamera& camera, const Size& size, vector<Mat>* depths,
+                          vector<StampedPose>* poses) {
+    // optical frame to world frame(x forward, y left, z up)
+    const Matx33d optical(0, 0, 1, -1, 0, 0, 0, -1, 0);
+    for (int i = 0; i < kTsdfFrames; ++i) {
+        StampedPose pose;
+        double yaw = (i - kTsdfFrames / 2) * 0.02;
+        pose.rotation = expRotation(Vec3d(0, 0, yaw)) * expRotation(Vec3d(0, 0.3, 0)) * optical;
+        pose.translation = Vec3d(0.02 * i, 0, 1);
+        Mat depth(size, CV_16UC1, Scalar(0));
+        for (int v = 0; v < size.height; ++v) {
+            auto row = depth.ptr<uint16_t>(v);
+            for (int u = 0; u < size.width; ++u) {
+                // ray cast to the floor and walls, the scale of the ray with unit z is the depth
+                Vec3d ray = pose.rotation * Vec3d((u - camera.cx) / camera.fx, (v - camera.cy) / camera.fy, 1);
+                const Vec3d& t = pose.translation;
+                double s = 1E9;
+                s = ray[2] < 0 ? min(s, -t[2] / ray[2]) : s;
+                s = ray[0] > 0 ? min(s, (3 - t[0]) / ray[0]) : s;
+                s = ray[1] != 0 ? min(s, ((ray[1] > 0 ? 2 : -2) - t[1]) / ray[1]) : s;
+                row[u] = s < 10 ? static_cast<uint16_t>(s * 1000) : 0;
+            }
+        }
+        depths->emplace_back(depth);
+        poses->emplace_back(pose);
+    }
+}
+
+// integrate the sequence in loop, arguments are (width, height, threads)
+static void BM_TsdfIntegrate(benchmark::State& state) {
+    Size size = resolution(state);
+    DepthCamera camera;
+    camera.fx = camera.fy = size.width * 0.6;
+    camera.cx = size.width / 2.0;
+    camera.cy = size.height / 2.0;
+    vector<Mat> depths;
+    vector<StampedPose> poses;
+    syntheticRoom(camera, size, &depths, &poses);
+    TsdfOptions options;
+    options.threads = static_cast<int>(state.range(2));
+    TsdfVolume volume(camera, options);
+    size_t i{0};
+    for (auto _ : state) {
+        volume.integrate(depths[i % kTsdfFrames], poses[i % kTsdfFrames]);
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["blocks"] = static_cast<double>(volume.blockNum());
+}
+BENCHMARK(BM_TsdfIntegrate)
+    ->ArgNames({"width", "height", "threads"})
+    ->Args({640, 480, 1})
+    ->Args({640, 480, 2})
+    ->Args({640, 480, 4})
+    ->Args({640, 480, 8})
+    ->Args({1280, 720, 8})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
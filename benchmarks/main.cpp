@@ -0,0 +1,26 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// benchmark main, the results are printed as JSON by default so they could be compared across commits, use
+// "--benchmark_format=console" to print as table, or "--benchmark_out=<file>" to save to file
+int main(int argc, char* argv[]) {
+    std::vector<char*> args(argv, argv + argc);
+    bool hasFormat{false};
+    for (int i = 1; i < argc; ++i) {
+        hasFormat |= std::strncmp(argv[i], "--benchmark_format", 18) == 0;
+    }
+    std::string jsonFormat = "--benchmark_format=json";
+    if (!hasFormat) {
+        args.insert(args.begin() + 1, &jsonFormat[0]);
+    }
+    int newArgc = static_cast<int>(args.size());
+    benchmark::Initialize(&newArgc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(newArgc, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
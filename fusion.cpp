@@ -0,0 +1,120 @@
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/filesystem.hpp>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <opencv2/imgcodecs.hpp>
+#include "ClockSync.h"
+#include "DepthFilter.h"
+#include "DepthSequence.h"
+#include "Trajectory.h"
+#include "TsdfVolume.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+namespace fs = boost::filesystem;
+
+// get the section string
+string section(const string& text) {
+    return fmt::format(fmt::fg(fmt::color::cyan), "{:═^{}}", " " + text + " ",
+                       max(100, static_cast<int>(text.size() + 12)));
+}
+
+int main(int argc, char* argv[]) {
+    // argument parser
+    cxxopts::Options options(argv[0], "Fuse the depth sequence with camera poses to TSDF volume, and save the surface");
+    // clang-format off
+    options.add_options()("d,depth", "depth sequence folder, which is saved by MyntEyeVision --depth_save",
+                          cxxopts::value<string>())
+        ("p,poses", "camera trajectory, \"timestamp tx ty tz qx qy qz qw\" per line, the timestamp is the host "
+                    "timestamp in ns", cxxopts::value<string>())
+        ("o,output", "output PLY file of surface points", cxxopts::value<string>()->default_value("tsdf.ply"))
+        ("voxel", "voxel size, m", cxxopts::value<double>()->default_value("0.01"))
+        ("truncation", "truncation distance, m", cxxopts::value<double>()->default_value("0.04"))
+        ("maxDepth", "max depth to integrate, m", cxxopts::value<double>()->default_value("4.0"))
+        ("memory", "memory budget of voxel blocks, MB", cxxopts::value<double>()->default_value("512"))
+        ("threads", "thread number, 0 for CPU number", cxxopts::value<int>()->default_value("0"))
+        ("maxGap", "max time gap of poses to interpolate, ms", cxxopts::value<double>()->default_value("100"))
+        ("filter", "filter the depth by DepthFilter before integration", cxxopts::value<bool>())
+        ("h,help", "help message");
+    // clang-format on
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("depth") || !result.count("poses")) {
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    // init glog
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_alsologtostderr = true;
+    FLAGS_colorlogtostderr = true;
+
+    cout << section("Fusion") << endl;
+    fs::path depthFolder{result["depth"].as<string>()};
+    DepthCamera camera;
+    CHECK(readDepthCamera(depthFolder, &camera))
+        << fmt::format("cannot read depth camera from \"{}\"", (depthFolder / "camera.yaml").string());
+    vector<DepthFrameFile> frames = findDepthFrames(depthFolder);
+    CHECK(!frames.empty()) << fmt::format("cannot find any depth image in \"{}\"", depthFolder.string());
+    vector<StampedPose> trajectory;
+    CHECK(loadTrajectory(result["poses"].as<string>(), &trajectory) && !trajectory.empty())
+        << "cannot load camera trajectory";
+    LOG(INFO) << fmt::format("depth camera, fx = {}, fy = {}, cx = {}, cy = {}, depth scale = {}, {} frames, {} poses",
+                             camera.fx, camera.fy, camera.cx, camera.cy, camera.depthScale, frames.size(),
+                             trajectory.size());
+
+    TsdfOptions tsdfOptions;
+    tsdfOptions.voxelSize = result["voxel"].as<double>();
+    tsdfOptions.truncation = result["truncation"].as<double>();
+    tsdfOptions.maxDepth = result["maxDepth"].as<double>();
+    tsdfOptions.memoryBudget = result["memory"].as<double>();
+    tsdfOptions.threads = result["threads"].as<int>();
+    TsdfVolume volume(camera, tsdfOptions);
+    unique_ptr<DepthFilter> depthFilter;
+    if (result["filter"].as<bool>()) {
+        depthFilter = make_unique<DepthFilter>();
+    }
+    const int64_t maxGap = static_cast<int64_t>(result["maxGap"].as<double>() * 1.0E6);
+
+    // replay as fast as possible, the time of reading image isn't counted
+    size_t skipped{0};
+    int64_t fuseTime{0};
+    for (auto& frame : frames) {
+        StampedPose pose;
+        if (!interpolatePose(trajectory, frame.timestamp, maxGap, &pose)) {
+            ++skipped;
+            continue;
+        }
+        Mat depth = imread(frame.path.string(), IMREAD_ANYDEPTH);
+        if (depth.type() != CV_16UC1) {
+            LOG(WARNING) << fmt::format("skip invalid depth image \"{}\"", frame.path.string());
+            ++skipped;
+            continue;
+        }
+        int64_t startTime = hostNow();
+        if (depthFilter) {
+            depthFilter->filter(depth);
+        }
+        volume.integrate(depth, pose);
+        fuseTime += hostNow() - startTime;
+    }
+
+    auto& statistics = volume.statistics();
+    double fused = static_cast<double>(max<uint64_t>(statistics.frames, 1));
+    LOG(INFO) << fmt::format("fuse {} frames, skip {} frames without pose, {:.3f} ms per frame({:.1f} fps), allocate = "
+                             "{:.3f} ms, integrate = {:.3f} ms, evict = {:.3f} ms",
+                             statistics.frames, skipped, fuseTime * 1.0E-6 / fused,
+                             fused / max(fuseTime * 1.0E-9, 1E-9),
+                             statistics.allocateTime * 1.0E-6 / fused, statistics.integrateTime * 1.0E-6 / fused,
+                             statistics.evictTime * 1.0E-6 / fused);
+    LOG(INFO) << fmt::format("blocks = {}/{}, {:.0f} visible blocks per frame, allocated = {}, evicted = {}, dropped "
+                             "= {}",
+                             volume.blockNum(), volume.capacity(), statistics.visibleBlocks / fused,
+                             statistics.allocatedBlocks, statistics.evictedBlocks, statistics.droppedBlocks);
+    volume.savePly(result["output"].as<string>());
+
+    google::ShutdownGoogleLogging();
+    return 0;
+}
@@ -1,15 +1,75 @@
 #include <fmt/color.h>
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <mynteyed/camera.h>
-#include <mynteyed/utils.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <cmath>
+#include <deque>
+#include <fstream>
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include "ClockSync.h"
+#include "DepthFilter.h"
+#include "DepthSequence.h"
+#include "Device.h"
+#include "FeatureTracker.h"
+#include "FrameBundle.h"
+#include "ImuBuffer.h"
+#include "ImuIntegration.h"
+#include "ObstacleDetector.h"
+#include "Odometry.h"
+#include "ShmRing.h"
+#include "SparseStereo.h"
+#include "StereoSynchronizer.h"
+#include "TimeOffset.h"
+#include "Trace.h"
+#include "Trajectory.h"
+#include "TsdfVolume.h"
 
 using namespace std;
 using namespace cv;
 using namespace mynteyed;
+using namespace mev;
+
+DEFINE_double(sync_tolerance, 5.0, "max timestamp difference(ms) to match left, right and depth frames");
+DEFINE_int32(sync_queue_size, 5, "max queue size of each stream in synchronizer");
+DEFINE_bool(sync_frame_id, true, "whether the frame ID should also be the same to match frames");
+DEFINE_int32(device_index, -1, "open device by index without prompt, -1 to select");
+DEFINE_string(device_serial, "", "open device by serial number without prompt");
+DEFINE_bool(skip_stream_info, false, "skip printing the stream information of device to open faster");
+DEFINE_int32(open_retries, 10, "max retry number to open device, with exponential backoff");
+DEFINE_string(shm_name, "", "publish images to shared memory ring with the name for other processes, empty to disable");
+DEFINE_int32(shm_slots, 16, "slot number of shared memory ring");
+DEFINE_bool(track, false, "track features on left image by pyramidal KLT and show the tracks");
+DEFINE_int32(track_features, 150, "max feature number to track");
+DEFINE_bool(track_fast, true, "detect FAST corners to track, or Shi-Tomasi corners if false");
+DEFINE_bool(track_imu, true, "predict feature positions by the gyroscope rotation before tracking");
+DEFINE_bool(time_offset, false, "estimate the camera-IMU time offset online from the tracked features and gyroscope");
+DEFINE_bool(stereo, false, "match the tracked features in right image to get sparse 3D landmarks, the camera is "
+                           "opened with rectified color images");
+DEFINE_string(stereo_cost, "zncc", "matching cost of sparse stereo, sad or zncc");
+DEFINE_bool(vo, false, "run stereo-inertial odometry and publish the \"pose\" stream if --shm_name is set, the camera "
+                       "is opened with rectified color images");
+DEFINE_int32(vo_features, 150, "max feature number to track of odometry");
+DEFINE_string(vo_output, "", "save the trajectory of odometry to file, empty to disable");
+DEFINE_bool(depth_filter, false, "filter the depth by spatial and temporal filters and hole filling before showing");
+DEFINE_string(depth_hole_fill, "farthest", "hole filling of depth filter, none, farthest or nearest");
+DEFINE_bool(obstacle, false, "detect obstacles from depth, show the occupancy grid and log the nearest obstacle");
+DEFINE_double(mount_height, 0.3, "camera height above ground on robot, m");
+DEFINE_double(mount_pitch, 0.0, "camera pitch on robot, degree, positive is looking down");
+DEFINE_double(mount_roll, 0.0, "camera roll on robot, degree");
+DEFINE_string(depth_save, "", "save the raw depth and depth camera to folder for replay, empty to disable");
+DEFINE_bool(tsdf, false, "fuse the depth to TSDF volume with the camera poses of odometry or from shared memory");
+DEFINE_string(tsdf_pose_shm, "", "shared memory ring of camera poses, the \"pose\" stream of 1x7 CV_64FC1 "
+                                 "[tx, ty, tz, qx, qy, qz, qw] at host timestamp");
+DEFINE_double(tsdf_voxel, 0.01, "voxel size of TSDF volume, m");
+DEFINE_double(tsdf_memory, 512, "memory budget of TSDF volume, MB");
+DEFINE_double(tsdf_max_gap, 100, "max time gap of poses to interpolate the pose of depth, ms");
+DEFINE_string(tsdf_output, "tsdf.ply", "PLY file to save the surface points of TSDF volume at exit");
+DEFINE_string(trace, "", "write the trace of capture and display to file in Chrome trace format, empty to disable");
 
 // get the section string
 string section(const string& text) {
@@ -22,33 +82,28 @@ int main(int argc, char* argv[]) {
     google::ParseCommandLineFlags(&argc, &argv, true);
     FLAGS_alsologtostderr = true;
     FLAGS_colorlogtostderr = true;
+    enableTrace(!FLAGS_trace.empty());
+    setTraceThreadName("main");
 
-    // get device information(list)
-    cout << section("Device Information") << endl;
+    // open camera, select device by index or serial number without prompt if set
+    cout << section("Open Camera") << endl;
     Camera cam;
     DeviceInfo deviceInfo;
-    if (!util::select(cam, &deviceInfo)) {
-        LOG(FATAL) << "cannot get device information";
-    }
-    cout << "Print Device Information..." << endl;
-    // print out device information
-    util::print_stream_infos(cam, deviceInfo.index);
-
-    // open camera
-    cout << section("Open Camera") << endl;
-    LOG(INFO) << fmt::format("open device, index = {}, name = {}", deviceInfo.index, deviceInfo.name) << endl;
+    DeviceOptions deviceOptions;
+    deviceOptions.index = FLAGS_device_index;
+    deviceOptions.serial = FLAGS_device_serial;
+    deviceOptions.printStreamInfo = !FLAGS_skip_stream_info;
+    deviceOptions.retries = FLAGS_open_retries;
     // set open parameters
-    OpenParams openParams(deviceInfo.index);
+    OpenParams openParams;
     openParams.framerate = 30;
     openParams.dev_mode = DeviceMode::DEVICE_ALL;
-    openParams.color_mode = ColorMode::COLOR_RAW;
+    // sparse stereo and odometry match along the rows of rectified images
+    openParams.color_mode = FLAGS_stereo || FLAGS_vo ? ColorMode::COLOR_RECTIFIED : ColorMode::COLOR_RAW;
     openParams.stream_mode = StreamMode::STREAM_2560x720;
     // open
-    cam.Open(openParams);
-    if (!cam.IsOpened()) {
+    if (!openDevice(cam, openParams, deviceOptions, &deviceInfo)) {
         LOG(FATAL) << "open camera failed";
-    } else {
-        LOG(INFO) << "open device success";
     }
     LOG(INFO) << fmt::format("data support, image info = {}, motion = {}, distance = {}, location = {}",
                              cam.IsImageInfoSupported(), cam.IsMotionDatasSupported(), cam.IsDistanceDatasSupported(),
@@ -90,71 +145,375 @@ int main(int argc, char* argv[]) {
 
     // create window and show image
     cout << section("Read Data") << endl;
-    while (true) {
-        cam.WaitForStream();
-
-        // get left stream
-        auto leftStream = cam.GetStreamData(ImageType::IMAGE_LEFT_COLOR);
-        if (leftStream.img) {
-            // auto imgFormat = leftStream.img->format();  // the image format is COLOR_YUYV
-            Mat img = leftStream.img->To(ImageFormat::COLOR_BGR)->ToMat();
-            imshow("Left", img);
+    // host/device clock synchronization, fitted by the left image receive time
+    ClockSync clockSync;
+    // IMU buffer, the IMU records between frames are attached to frame bundle
+    ImuBuffer imuBuffer;
+    // synchronizer to match left, right and depth
+    SyncOptions syncOptions;
+    syncOptions.tolerance = static_cast<int64_t>(FLAGS_sync_tolerance * 1.0E6);
+    syncOptions.queueSize = static_cast<size_t>(FLAGS_sync_queue_size);
+    syncOptions.useFrameId = FLAGS_sync_frame_id;
+    syncOptions.withRight = cam.IsStreamDataEnabled(ImageType::IMAGE_RIGHT_COLOR);
+    syncOptions.withDepth = cam.IsStreamDataEnabled(ImageType::IMAGE_DEPTH);
+    StereoSynchronizer synchronizer(syncOptions, &imuBuffer);
+    // feature tracker of left image
+    TrackerOptions trackerOptions;
+    trackerOptions.maxFeatures = FLAGS_track_features;
+    trackerOptions.useFast = FLAGS_track_fast;
+    FeatureTracker tracker(trackerOptions);
+    Mat trackImage;
+    // camera matrix of left camera and the rotation from IMU to left camera, the motion extrinsics is from left camera
+    // to IMU, p_imu = R * p_left + t
+    const Matx33d cameraMatrix(streamIntrinsics.left.fx, 0, streamIntrinsics.left.cx, 0, streamIntrinsics.left.fy,
+                               streamIntrinsics.left.cy, 0, 0, 1);
+    const auto& er = motionExtrinsics.rotation;
+    const Matx33d cameraImu =
+        Matx33d(er[0][0], er[0][1], er[0][2], er[1][0], er[1][1], er[1][2], er[2][0], er[2][1], er[2][2]).t();
+    int64_t lastTrackTime{0};  // left timestamp of last tracked frame
+    // sparse stereo matcher, the rectified camera is the projection of left camera, and the baseline is the translation
+    // of cached extrinsics in mm
+    StereoCamera stereoCamera;
+    stereoCamera.fx = streamIntrinsics.left.p[0];
+    stereoCamera.fy = streamIntrinsics.left.p[5];
+    stereoCamera.cx = streamIntrinsics.left.p[2];
+    stereoCamera.cy = streamIntrinsics.left.p[6];
+    const auto& et = streamExtrinsics.translation;
+    stereoCamera.baseline = sqrt(et[0] * et[0] + et[1] * et[1] + et[2] * et[2]) * 1.0E-3;
+    // camera of tracked image and the rotation from IMU to it, to predict feature positions by gyroscope and estimate
+    // time offset. The tracked image is rectified with --stereo or --vo, then the camera is the projection of rectified
+    // left camera, and the rotation from IMU includes the rectification rotation
+    const bool rectified = openParams.color_mode == ColorMode::COLOR_RECTIFIED;
+    const Matx33d trackMatrix =
+        rectified ? Matx33d(stereoCamera.fx, 0, stereoCamera.cx, 0, stereoCamera.fy, stereoCamera.cy, 0, 0, 1)
+                  : cameraMatrix;
+    const Matx33d trackImu = rectified ? Matx33d(streamIntrinsics.left.r) * cameraImu : cameraImu;
+    SparseStereoOptions stereoOptions;
+    stereoOptions.cost = boost::iequals(FLAGS_stereo_cost, "sad") ? MatchCost::SAD : MatchCost::ZNCC;
+    unique_ptr<SparseStereoMatcher> stereoMatcher;
+    if (FLAGS_stereo) {
+        CHECK(FLAGS_track) << "sparse stereo matches the tracked features, it should be run with --track";
+        LOG(INFO) << fmt::format("sparse stereo, fx = {}, fy = {}, cx = {}, cy = {}, baseline = {} m", stereoCamera.fx,
+                                 stereoCamera.fy, stereoCamera.cx, stereoCamera.cy, stereoCamera.baseline);
+        stereoMatcher = make_unique<SparseStereoMatcher>(stereoCamera, stereoOptions);
+    }
+    // camera-IMU time offset of the tracked image
+    unique_ptr<TimeOffsetEstimator> timeOffset;
+    if (FLAGS_time_offset) {
+        CHECK(FLAGS_track) << "time offset estimation uses the tracked features, it should be run with --track";
+        timeOffset = make_unique<TimeOffsetEstimator>(trackMatrix, trackImu);
+    }
+    // stereo-inertial odometry on rectified images, the rotation from IMU to rectified left camera includes the
+    // rectification rotation of left camera
+    unique_ptr<StereoInertialOdometry> odometry;
+    ofstream voOutput;
+    if (FLAGS_vo) {
+        CHECK(syncOptions.withRight) << "odometry needs the right stream";
+        OdometryOptions odometryOptions;
+        odometryOptions.tracker.maxFeatures = FLAGS_vo_features;
+        odometryOptions.tracker.useFast = FLAGS_track_fast;
+        odometryOptions.stereo = stereoOptions;
+        odometry = make_unique<StereoInertialOdometry>(stereoCamera, Matx33d(streamIntrinsics.left.r) * cameraImu,
+                                                       odometryOptions);
+        if (!FLAGS_vo_output.empty()) {
+            voOutput.open(FLAGS_vo_output);
+            CHECK(voOutput.is_open()) << "cannot create odometry trajectory: " << FLAGS_vo_output;
+            voOutput << "# timestamp(ns) tx ty tz qx qy qz qw" << endl;
         }
-        if (leftStream.img_info) {
-            LOG(INFO) << fmt::format("left frame ID = {}, timestamp = {}, exposure time = {}",
-                                     leftStream.img_info->frame_id, leftStream.img_info->timestamp,
-                                     leftStream.img_info->exposure_time);
+    }
+    // depth post processing
+    unique_ptr<DepthFilter> depthFilter;
+    if (FLAGS_depth_filter) {
+        DepthFilterOptions depthOptions;
+        CHECK(parseHoleFill(FLAGS_depth_hole_fill, &depthOptions.holeFill))
+            << "unknown hole filling: " << FLAGS_depth_hole_fill;
+        depthFilter = make_unique<DepthFilter>(depthOptions);
+    }
+    // the depth is aligned to the rectified left image
+    DepthCamera depthCamera;
+    depthCamera.fx = streamIntrinsics.left.p[0];
+    depthCamera.fy = streamIntrinsics.left.p[5];
+    depthCamera.cx = streamIntrinsics.left.p[2];
+    depthCamera.cy = streamIntrinsics.left.p[6];
+    if (!FLAGS_depth_save.empty()) {
+        CHECK(syncOptions.withDepth) << "depth saving needs the depth stream";
+        boost::filesystem::create_directories(FLAGS_depth_save);
+        CHECK(writeDepthCamera(FLAGS_depth_save, depthCamera)) << "cannot write depth camera";
+    }
+    // obstacle detector
+    unique_ptr<ObstacleDetector> obstacleDetector;
+    Mat obstacleImage;
+    if (FLAGS_obstacle) {
+        CHECK(syncOptions.withDepth) << "obstacle detection needs the depth stream";
+        MountingPose mountingPose;
+        mountingPose.height = FLAGS_mount_height;
+        mountingPose.pitch = FLAGS_mount_pitch;
+        mountingPose.roll = FLAGS_mount_roll;
+        obstacleDetector = make_unique<ObstacleDetector>(depthCamera, mountingPose);
+    }
+    // TSDF volume, the depth waits in queue until the pose after it is received, as the odometry has latency. The poses
+    // are from the odometry of this process, or from shared memory
+    unique_ptr<TsdfVolume> tsdfVolume;
+    unique_ptr<ShmSubscriber> poseSubscriber;
+    vector<StampedPose> poses;
+    deque<StreamImage> tsdfDepths;
+    const int64_t tsdfMaxGap = static_cast<int64_t>(FLAGS_tsdf_max_gap * 1.0E6);
+    if (FLAGS_tsdf) {
+        CHECK(syncOptions.withDepth) << "TSDF fusion needs the depth stream";
+        CHECK(FLAGS_vo || !FLAGS_tsdf_pose_shm.empty()) << "TSDF fusion needs the camera poses, set --vo or "
+                                                            "--tsdf_pose_shm";
+        if (!FLAGS_tsdf_pose_shm.empty()) {
+            poseSubscriber = make_unique<ShmSubscriber>(FLAGS_tsdf_pose_shm);
+            CHECK(poseSubscriber->isOpened()) << "cannot open pose shared memory: " << FLAGS_tsdf_pose_shm;
         }
-
-        // get right stream, the image format is COLOR_YUYV
-        auto rightStream = cam.GetStreamData(ImageType::IMAGE_RIGHT_COLOR);
-        if (rightStream.img) {
-            // auto imgFormat = rightStream.img->format();  // the image format is COLOR_YUYV
-            Mat img = rightStream.img->To(ImageFormat::COLOR_BGR)->ToMat();
-            imshow("Right", img);
+        TsdfOptions tsdfOptions;
+        tsdfOptions.voxelSize = FLAGS_tsdf_voxel;
+        tsdfOptions.truncation = 4 * FLAGS_tsdf_voxel;
+        tsdfOptions.memoryBudget = FLAGS_tsdf_memory;
+        tsdfVolume = make_unique<TsdfVolume>(depthCamera, tsdfOptions);
+    }
+    // shared memory publisher
+    unique_ptr<ShmPublisher> publisher;
+    if (!FLAGS_shm_name.empty()) {
+        publisher = make_unique<ShmPublisher>(FLAGS_shm_name, static_cast<size_t>(FLAGS_shm_slots));
+    }
+    // receive all frames of stream and push to synchronizer
+    auto receive = [&](ImageType type, SyncStream stream, const string& name, int64_t receiveTime) {
+        vector<StreamData> streamDatas;
+        {
+            TraceScope trace("GetStreamData");
+            streamDatas = cam.GetStreamDatas(type);
         }
-        if (rightStream.img_info) {
-            LOG(INFO) << fmt::format("right frame ID = {}, timestamp = {}, exposure time = {}",
-                                     rightStream.img_info->frame_id, rightStream.img_info->timestamp,
-                                     rightStream.img_info->exposure_time);
+        for (size_t i = 0; i < streamDatas.size(); ++i) {
+            StreamImage image;
+            bool converted{false};
+            {
+                TraceScope trace("convert");
+                converted = toStreamImage(streamDatas[i], &image);
+            }
+            if (!converted) {
+                continue;
+            }
+            // only the latest left frame is received just now, use it to update clock model
+            if (stream == SyncStream::Left && i + 1 == streamDatas.size()) {
+                clockSync.update(image.timestamp, receiveTime);
+            }
+            image.hostTimestamp = clockSync.toHost(image.timestamp);
+            if (publisher) {
+                TraceScope trace("publish");
+                publisher->publish(name, image.frameId, image.timestamp, image.hostTimestamp, image.image);
+            }
+            LOG(INFO) << fmt::format("{} frame ID = {}, timestamp = {}, host timestamp = {} ns, exposure time = {}",
+                                     name, streamDatas[i].img_info->frame_id, streamDatas[i].img_info->timestamp,
+                                     image.hostTimestamp, streamDatas[i].img_info->exposure_time);
+            synchronizer.push(stream, std::move(image));
+        }
+    };
+    while (true) {
+        {
+            TraceScope trace("WaitForStream");
+            cam.WaitForStream();
         }
+        int64_t receiveTime = hostNow();
 
-        // get depth
-        auto depthStream = cam.GetStreamData(ImageType::IMAGE_DEPTH);
-        if (depthStream.img) {
-            // auto imgFormat = depthStream.img->format();  // the image format is IMAGE_GRAY_16
-            Mat img = depthStream.img->ToMat();
-            imshow("Depth", img);
+        // get left and right stream, the image format is COLOR_YUYV
+        receive(ImageType::IMAGE_LEFT_COLOR, SyncStream::Left, "left", receiveTime);
+        if (syncOptions.withRight) {
+            receive(ImageType::IMAGE_RIGHT_COLOR, SyncStream::Right, "right", receiveTime);
         }
-        if (depthStream.img_info) {
-            LOG(INFO) << fmt::format("depth frame ID = {}, timestamp = {}, exposure time = {}",
-                                     depthStream.img_info->frame_id, depthStream.img_info->timestamp,
-                                     depthStream.img_info->exposure_time);
+        // get depth, the image format is IMAGE_GRAY_16
+        if (syncOptions.withDepth) {
+            receive(ImageType::IMAGE_DEPTH, SyncStream::Depth, "depth", receiveTime);
         }
 
         // get IMU
         auto motionData = cam.GetMotionDatas();
         for (auto& motion : motionData) {
             if (motion.imu) {
+                ImuRecord record = toImuRecord(*motion.imu);
+                record.hostTimestamp = clockSync.toHost(record.timestamp);
+                imuBuffer.push(record);
                 if (motion.imu->flag == MYNTEYE_IMU_ACCEL) {
-                    LOG(INFO) << fmt::format("IMU, timestamp = {}, temp = {}, acc = [{}, {}, {}]",
-                                             motion.imu->timestamp, motion.imu->temperature, motion.imu->accel[0],
-                                             motion.imu->accel[1], motion.imu->accel[2]);
+                    LOG(INFO) << fmt::format("IMU, timestamp = {}, host timestamp = {} ns, temp = {}, "
+                                             "acc = [{}, {}, {}]",
+                                             motion.imu->timestamp, record.hostTimestamp, motion.imu->temperature,
+                                             motion.imu->accel[0], motion.imu->accel[1], motion.imu->accel[2]);
                 } else if (motion.imu->flag == MYNTEYE_IMU_GYRO) {
-                    LOG(INFO) << fmt::format("IMU, timestamp = {}, temp = {}, gyro = [{}, {}, {}]",
-                                             motion.imu->timestamp, motion.imu->temperature, motion.imu->gyro[0],
-                                             motion.imu->gyro[1], motion.imu->gyro[2]);
+                    LOG(INFO) << fmt::format("IMU, timestamp = {}, host timestamp = {} ns, temp = {}, "
+                                             "gyro = [{}, {}, {}]",
+                                             motion.imu->timestamp, record.hostTimestamp, motion.imu->temperature,
+                                             motion.imu->gyro[0], motion.imu->gyro[1], motion.imu->gyro[2]);
                 } else if (motion.imu->flag == MYNTEYE_IMU_ACCEL_GYRO_CALIB) {
-                    LOG(INFO) << fmt::format("IMU, timestamp = {}, temp = {}, acc = [{}, {}, {}], gyro = [{}, {}, {}]",
-                                             motion.imu->timestamp, motion.imu->temperature, motion.imu->accel[0],
-                                             motion.imu->accel[1], motion.imu->accel[2], motion.imu->gyro[0],
-                                             motion.imu->gyro[1], motion.imu->gyro[2]);
+                    LOG(INFO) << fmt::format("IMU, timestamp = {}, host timestamp = {} ns, temp = {}, "
+                                             "acc = [{}, {}, {}], gyro = [{}, {}, {}]",
+                                             motion.imu->timestamp, record.hostTimestamp, motion.imu->temperature,
+                                             motion.imu->accel[0], motion.imu->accel[1], motion.imu->accel[2],
+                                             motion.imu->gyro[0], motion.imu->gyro[1], motion.imu->gyro[2]);
                 } else {
                     LOG(ERROR) << "unknow IMU type";
                 }
             }
         }
 
+        // get synchronized bundles and show
+        FrameBundle bundle;
+        while (synchronizer.pop(&bundle)) {
+            TraceScope trace("display");
+            LOG(INFO) << fmt::format("frame bundle, left frame ID = {}, IMU number = {}", bundle.left.frameId,
+                                     bundle.imu.size);
+            imshow("Left", bundle.left.image);
+            if (FLAGS_track) {
+                {
+                    TraceScope trace("track");
+                    // the IMU of bundle is since the previous left frame, only predict if it covers the interval
+                    // since last tracked frame, at most 20 ms gap
+                    Matx33d homography;
+                    bool predict = FLAGS_track_imu && !bundle.imu.empty() && lastTrackTime > 0 &&
+                                   bundle.imu.front().timestamp - lastTrackTime < 20000000;
+                    if (predict) {
+                        Matx33d imuRotation = integrateGyro(bundle.imu, lastTrackTime, bundle.left.timestamp);
+                        homography = rotationHomography(trackMatrix, trackImu, imuRotation);
+                    }
+                    tracker.track(bundle.left.image, predict ? &homography : nullptr);
+                    lastTrackTime = bundle.left.timestamp;
+                }
+                if (timeOffset) {
+                    TraceScope trace("time offset");
+                    timeOffset->addImu(bundle.imu);
+                    if (timeOffset->addFrame(bundle.left.timestamp, tracker.features())) {
+                        auto& estimate = timeOffset->estimate();
+                        LOG(INFO) << fmt::format("time offset, {:.3f} +/- {:.3f} ms, correlation = {:.4f}, "
+                                                 "excitation = {:.3f} rad/s, samples = {}, valid = {}",
+                                                 estimate.offset * 1.0E-6, estimate.stddev * 1.0E-6,
+                                                 estimate.correlation, estimate.excitation, estimate.samples,
+                                                 estimate.valid);
+                        if (publisher) {
+                            // 1x4 [offset(ms), stddev(ms), correlation, valid]
+                            Matx<double, 1, 4> offset(estimate.offset * 1.0E-6, estimate.stddev * 1.0E-6,
+                                                      estimate.correlation, estimate.valid ? 1.0 : 0.0);
+                            publisher->publish("time_offset", bundle.left.frameId, bundle.left.timestamp,
+                                               bundle.left.hostTimestamp, Mat(offset));
+                        }
+                    }
+                }
+                if (stereoMatcher && bundle.right.isValid()) {
+                    TraceScope trace("stereo");
+                    stereoMatcher->match(bundle.left.image, bundle.right.image, tracker.features());
+                }
+                // draw the features, the color changes from red to green with the tracked frame number, and the
+                // stereo points are circled, from blue to white with the depth
+                bundle.left.image.copyTo(trackImage);
+                for (auto& f : tracker.features()) {
+                    int age = min(f.age, 10);
+                    circle(trackImage, f.point, 3, Scalar(0, 25 * age, 255 - 25 * age), -1);
+                }
+                if (stereoMatcher) {
+                    for (auto& p : stereoMatcher->points()) {
+                        int c = static_cast<int>(min(p.position.z, 10.f) * 25);
+                        circle(trackImage, p.left, 6, Scalar(255, c, c), 1);
+                    }
+                }
+                imshow("Tracks", trackImage);
+            }
+            if (odometry && bundle.right.isValid()) {
+                // the poses are output by the front-end thread, get the ready ones without waiting
+                odometry->push(bundle);
+                OdometryPose odometryPose;
+                while (odometry->tryPop(&odometryPose)) {
+                    auto& p = odometryPose.pose;
+                    LOG(INFO) << fmt::format("odometry, frame ID = {}, position = [{:.3f}, {:.3f}, {:.3f}] m, "
+                                             "inliers = {}, lost = {}, latency = {:.3f} ms",
+                                             odometryPose.frameId, p.translation[0], p.translation[1],
+                                             p.translation[2], odometryPose.inliers, odometryPose.lost,
+                                             odometryPose.latency * 1.0E-6);
+                    if (publisher) {
+                        publisher->publish("pose", odometryPose.frameId, odometryPose.timestamp, p.timestamp,
+                                           poseToMat(p));
+                    }
+                    if (voOutput.is_open()) {
+                        voOutput << formatPose(p) << "\n";
+                    }
+                    if (tsdfVolume && !poseSubscriber) {
+                        poses.emplace_back(p);
+                    }
+                }
+            }
+            if (bundle.right.isValid()) {
+                imshow("Right", bundle.right.image);
+            }
+            if (bundle.depth.isValid()) {
+                if (!FLAGS_depth_save.empty()) {
+                    TraceScope trace("depth save");
+                    writeDepthFrame(FLAGS_depth_save, bundle.depth);
+                }
+                if (depthFilter) {
+                    TraceScope trace("depth filter");
+                    depthFilter->filter(bundle.depth.image);
+                }
+                imshow("Depth", bundle.depth.image);
+                if (tsdfVolume) {
+                    TraceScope trace("tsdf");
+                    // receive the poses, and keep the ones which may be used by the queued depth
+                    ShmFrame poseFrame;
+                    StampedPose pose;
+                    while (poseSubscriber && poseSubscriber->next(&poseFrame, 0)) {
+                        if (poseFrame.stream == "pose" &&
+                            poseFromMat(poseFrame.image, poseFrame.hostTimestamp, &pose) && poseFrame.isValid()) {
+                            poses.emplace_back(pose);
+                        }
+                    }
+                    StreamImage depth = bundle.depth;
+                    depth.image = bundle.depth.image.clone();
+                    tsdfDepths.emplace_back(depth);
+                    while (tsdfDepths.size() > 30) {
+                        tsdfDepths.pop_front();
+                    }
+                    while (!tsdfDepths.empty() && !poses.empty() &&
+                           tsdfDepths.front().hostTimestamp <= poses.back().timestamp) {
+                        if (interpolatePose(poses, tsdfDepths.front().hostTimestamp, tsdfMaxGap, &pose)) {
+                            tsdfVolume->integrate(tsdfDepths.front().image, pose);
+                        }
+                        tsdfDepths.pop_front();
+                    }
+                    if (poses.size() > 1) {
+                        int64_t keepTime = tsdfDepths.empty() ? poses.back().timestamp
+                                                              : tsdfDepths.front().hostTimestamp;
+                        auto it = lower_bound(poses.begin(), poses.end(), keepTime,
+                                              [](const StampedPose& p, int64_t t) { return p.timestamp < t; });
+                        poses.erase(poses.begin(), it == poses.begin() ? it : it - 1);
+                    }
+                }
+                if (obstacleDetector) {
+                    {
+                        TraceScope trace("obstacle");
+                        obstacleDetector->detect(bundle.depth.image);
+                    }
+                    auto& sectors = obstacleDetector->sectors();
+                    LOG(INFO) << fmt::format("obstacle, nearest = {:.2f} m, ground inliers = {}, sectors = {:.2f}",
+                                             obstacleDetector->nearest(), obstacleDetector->ground().inliers,
+                                             fmt::join(sectors, ", "));
+                    if (publisher) {
+                        auto& depth = bundle.depth;
+                        publisher->publish("obstacles", depth.frameId, depth.timestamp, depth.hostTimestamp,
+                                           obstacleDetector->occupancy());
+                        publisher->publish("sectors", depth.frameId, depth.timestamp, depth.hostTimestamp,
+                                           Mat(1, static_cast<int>(sectors.size()), CV_32FC1,
+                                               const_cast<float*>(sectors.data())));
+                    }
+                    // the unknown cells are gray, the free cells are white and the occupied cells are black
+                    const Mat& occupancy = obstacleDetector->occupancy();
+                    Mat grid(occupancy.size(), CV_8UC1, Scalar(128));
+                    grid.setTo(Scalar(255), occupancy == static_cast<int>(CellState::Free));
+                    grid.setTo(Scalar(0), occupancy == static_cast<int>(CellState::Occupied));
+                    resize(grid, obstacleImage, Size(), 3, 3, INTER_NEAREST);
+                    cvtColor(obstacleImage, obstacleImage, COLOR_GRAY2BGR);
+                    circle(obstacleImage, Point(obstacleImage.cols / 2, obstacleImage.rows / 2), 5, Scalar(0, 0, 255),
+                           -1);
+                    imshow("Obstacles", obstacleImage);
+                }
+            }
+        }
+
         /* // get distance
         auto distanceData = cam.GetDistanceDatas();
         for (auto& distance : distanceData) {
@@ -174,13 +533,122 @@ int main(int argc, char* argv[]) {
         } */
 
         // exit
-        auto key = static_cast<char>(waitKey(1));
+        char key{0};
+        {
+            TraceScope trace("display");
+            key = static_cast<char>(waitKey(1));
+        }
         if (key == 27 || key == 'q' || key == 'Q' || key == 'x' || key == 'X') {
             break;
         }
     }
 
+    // synchronization statistics
+    auto syncStatistics = synchronizer.statistics();
+    LOG(INFO) << fmt::format("synchronization, bundles = {}, received = {}, unmatched = {}", syncStatistics.bundles,
+                             syncStatistics.received, syncStatistics.unmatched);
+
+    // tracking statistics
+    if (FLAGS_track) {
+        auto& trackStatistics = tracker.statistics();
+        double frames = static_cast<double>(max<uint64_t>(trackStatistics.frames, 1));
+        int64_t trackTime = trackStatistics.pyramidTime + trackStatistics.trackTime + trackStatistics.detectTime;
+        LOG(INFO) << fmt::format("tracking, frames = {}, predicted = {}, tracked = {:.1f}, detected = {:.1f} per "
+                                 "frame, time = {:.3f} ms(pyramid = {:.3f}, track = {:.3f}, detect = {:.3f}) per frame",
+                                 trackStatistics.frames, trackStatistics.predicted, trackStatistics.tracked / frames,
+                                 trackStatistics.detected / frames, trackTime * 1.0E-6 / frames,
+                                 trackStatistics.pyramidTime * 1.0E-6 / frames,
+                                 trackStatistics.trackTime * 1.0E-6 / frames,
+                                 trackStatistics.detectTime * 1.0E-6 / frames);
+    }
+
+    if (timeOffset) {
+        auto& offsetStatistics = timeOffset->statistics();
+        auto& estimate = timeOffset->estimate();
+        double frames = static_cast<double>(max<uint64_t>(offsetStatistics.frames, 1));
+        LOG(INFO) << fmt::format("time offset, frames = {}, rotations = {}, estimates = {}, valid = {}, last = {:.3f} "
+                                 "+/- {:.3f} ms, time = {:.3f} ms(rotation = {:.3f}, search = {:.3f}) per frame",
+                                 offsetStatistics.frames, offsetStatistics.rotations, offsetStatistics.estimates,
+                                 offsetStatistics.valid, estimate.offset * 1.0E-6, estimate.stddev * 1.0E-6,
+                                 (offsetStatistics.rotationTime + offsetStatistics.estimateTime) * 1.0E-6 / frames,
+                                 offsetStatistics.rotationTime * 1.0E-6 / frames,
+                                 offsetStatistics.estimateTime * 1.0E-6 / frames);
+    }
+
+    if (stereoMatcher) {
+        auto& stereoStatistics = stereoMatcher->statistics();
+        double frames = static_cast<double>(max<uint64_t>(stereoStatistics.frames, 1));
+        LOG(INFO) << fmt::format("sparse stereo, frames = {}, features = {:.1f}, matched = {:.1f} per frame, time = "
+                                 "{:.3f} ms per frame",
+                                 stereoStatistics.frames, stereoStatistics.features / frames,
+                                 stereoStatistics.matched / frames, stereoStatistics.matchTime * 1.0E-6 / frames);
+    }
+
+    if (odometry) {
+        odometry->stop();
+        auto odometryStatistics = odometry->statistics();
+        double frames = static_cast<double>(max<uint64_t>(odometryStatistics.frames, 1));
+        double optimizations = static_cast<double>(max<uint64_t>(odometryStatistics.optimizations, 1));
+        LOG(INFO) << fmt::format("odometry, frames = {}, dropped = {}, lost = {}, keyframes = {}, time = {:.3f} ms("
+                                 "track = {:.3f}, stereo = {:.3f}, pose = {:.3f}, keyframe = {:.3f}) per frame, "
+                                 "latency = {:.3f} ms, optimization = {:.3f} ms with {:.0f} landmarks",
+                                 odometryStatistics.frames, odometryStatistics.dropped, odometryStatistics.lost,
+                                 odometryStatistics.keyframes,
+                                 (odometryStatistics.trackTime + odometryStatistics.stereoTime +
+                                  odometryStatistics.poseTime) * 1.0E-6 / frames,
+                                 odometryStatistics.trackTime * 1.0E-6 / frames,
+                                 odometryStatistics.stereoTime * 1.0E-6 / frames,
+                                 odometryStatistics.poseTime * 1.0E-6 / frames,
+                                 odometryStatistics.keyframeTime * 1.0E-6 / frames,
+                                 odometryStatistics.latency * 1.0E-6 / frames,
+                                 odometryStatistics.optimizeTime * 1.0E-6 / optimizations,
+                                 odometryStatistics.landmarks / optimizations);
+    }
+
+    if (depthFilter) {
+        auto& depthStatistics = depthFilter->statistics();
+        double frames = static_cast<double>(max<uint64_t>(depthStatistics.frames, 1));
+        LOG(INFO) << fmt::format("depth filter, frames = {}, time = {:.3f} ms(spatial = {:.3f}, temporal = {:.3f}, "
+                                 "hole filling = {:.3f}) per frame",
+                                 depthStatistics.frames,
+                                 (depthStatistics.spatialTime + depthStatistics.temporalTime +
+                                  depthStatistics.holeFillTime) * 1.0E-6 / frames,
+                                 depthStatistics.spatialTime * 1.0E-6 / frames,
+                                 depthStatistics.temporalTime * 1.0E-6 / frames,
+                                 depthStatistics.holeFillTime * 1.0E-6 / frames);
+    }
+
+    if (obstacleDetector) {
+        auto& obstacleStatistics = obstacleDetector->statistics();
+        double frames = static_cast<double>(max<uint64_t>(obstacleStatistics.frames, 1));
+        LOG(INFO) << fmt::format("obstacle detection, frames = {}, ground found = {}, points = {:.0f} per frame, time "
+                                 "= {:.3f} ms(project = {:.3f}, ground = {:.3f}, grid = {:.3f}) per frame",
+                                 obstacleStatistics.frames, obstacleStatistics.groundFound,
+                                 obstacleStatistics.points / frames,
+                                 (obstacleStatistics.projectTime + obstacleStatistics.groundTime +
+                                  obstacleStatistics.gridTime) * 1.0E-6 / frames,
+                                 obstacleStatistics.projectTime * 1.0E-6 / frames,
+                                 obstacleStatistics.groundTime * 1.0E-6 / frames,
+                                 obstacleStatistics.gridTime * 1.0E-6 / frames);
+    }
+
+    if (tsdfVolume) {
+        auto& tsdfStatistics = tsdfVolume->statistics();
+        double frames = static_cast<double>(max<uint64_t>(tsdfStatistics.frames, 1));
+        LOG(INFO) << fmt::format("TSDF fusion, frames = {}, blocks = {}/{}, evicted = {}, dropped = {}, time = {:.3f} "
+                                 "ms(allocate = {:.3f}, integrate = {:.3f}) per frame",
+                                 tsdfStatistics.frames, tsdfVolume->blockNum(), tsdfVolume->capacity(),
+                                 tsdfStatistics.evictedBlocks, tsdfStatistics.droppedBlocks,
+                                 (tsdfStatistics.allocateTime + tsdfStatistics.integrateTime) * 1.0E-6 / frames,
+                                 tsdfStatistics.allocateTime * 1.0E-6 / frames,
+                                 tsdfStatistics.integrateTime * 1.0E-6 / frames);
+        tsdfVolume->savePly(FLAGS_tsdf_output);
+    }
+
     cam.Close();
+    if (!FLAGS_trace.empty()) {
+        writeTrace(FLAGS_trace);
+    }
 
     google::ShutDownCommandLineFlags();
     google::ShutdownGoogleLogging();
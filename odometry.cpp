@@ -0,0 +1,146 @@
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "ClockSync.h"
+#include "ImuBuffer.h"
+#include "Odometry.h"
+#include "Recording.h"
+#include "StereoSynchronizer.h"
+#include "Trajectory.h"
+
+using namespace std;
+using namespace cv;
+using namespace mev;
+namespace fs = boost::filesystem;
+
+// get the section string
+string section(const string& text) {
+    return fmt::format(fmt::fg(fmt::color::cyan), "{:═^{}}", " " + text + " ",
+                       max(100, static_cast<int>(text.size() + 12)));
+}
+
+int main(int argc, char* argv[]) {
+    // argument parser
+    cxxopts::Options options(argv[0], "Run stereo-inertial odometry on a recording, and save the camera trajectory");
+    // clang-format off
+    options.add_options()("i,input", "device folder of recording, which contains calibration.yaml and segments",
+                          cxxopts::value<string>())
+        ("o,output", "output trajectory, \"timestamp tx ty tz qx qy qz qw\" per line, the timestamp is the host "
+                     "timestamp in ns, which could be used by fusion", cxxopts::value<string>()->default_value(
+                         "trajectory.txt"))
+        ("features", "max feature number to track", cxxopts::value<int>()->default_value("150"))
+        ("window", "keyframe number of sliding window", cxxopts::value<int>()->default_value("8"))
+        ("gyroSigma", "std of gyroscope rotation between keyframes, rad/sqrt(s), 0 to disable",
+         cxxopts::value<double>()->default_value("0.01"))
+        ("realtime", "replay at the recording rate and drop frames if the odometry is busy, like live camera",
+         cxxopts::value<bool>())
+        ("h,help", "help message");
+    // clang-format on
+    auto result = options.parse(argc, argv);
+    if (result.count("help") || !result.count("input")) {
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    // init glog
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_alsologtostderr = true;
+    FLAGS_colorlogtostderr = true;
+
+    cout << section("Odometry") << endl;
+    fs::path folder{result["input"].as<string>()};
+    RecordingCalibration calibration;
+    CHECK(readCalibration(folder / "calibration.yaml", &calibration)) << "cannot read calibration of recording";
+    StereoRectifier rectifier(calibration);
+    auto& camera = rectifier.camera();
+    LOG(INFO) << fmt::format("rectified camera, fx = {}, fy = {}, cx = {}, cy = {}, baseline = {} m", camera.fx,
+                             camera.fy, camera.cx, camera.cy, camera.baseline);
+
+    // the IMU and images are fed in time order as the live camera
+    ImuBuffer imuBuffer;
+    SyncOptions syncOptions;
+    syncOptions.withDepth = false;
+    StereoSynchronizer synchronizer(syncOptions, &imuBuffer);
+    const bool realtime = result["realtime"].as<bool>();
+    OdometryOptions odometryOptions;
+    odometryOptions.tracker.maxFeatures = result["features"].as<int>();
+    odometryOptions.windowSize = result["window"].as<int>();
+    odometryOptions.gyroSigma = result["gyroSigma"].as<double>();
+    odometryOptions.dropFrames = realtime;
+    StereoInertialOdometry odometry(rectifier.camera(), rectifier.cameraImu(), odometryOptions);
+
+    ofstream trajectory(result["output"].as<string>());
+    CHECK(trajectory.is_open()) << fmt::format("cannot create trajectory \"{}\"", result["output"].as<string>());
+    trajectory << "# timestamp(ns) tx ty tz qx qy qz qw" << endl;
+    size_t poseNum{0}, lostNum{0};
+    auto save = [&](const OdometryPose& pose) {
+        trajectory << formatPose(pose.pose) << "\n";
+        ++poseNum;
+        lostNum += pose.lost;
+    };
+
+    RecordingReader reader(folder);
+    CHECK_GT(reader.segmentNum(), 0) << fmt::format("cannot find any closed segment in \"{}\"", folder.string());
+    RecordingItem item;
+    FrameBundle bundle;
+    OdometryPose pose;
+    Mat rectified;
+    int64_t startTime = hostNow();
+    int64_t firstTimestamp{-1};
+    while (reader.next(&item)) {
+        if (!item.isImage) {
+            imuBuffer.push(item.imu);
+            continue;
+        }
+        bool isLeft = item.stream == "left";
+        if (!isLeft && item.stream != "right") {
+            continue;
+        }
+        if (realtime) {
+            // wait until the time of image since the first one
+            firstTimestamp = firstTimestamp < 0 ? item.image.timestamp : firstTimestamp;
+            this_thread::sleep_for(
+                chrono::nanoseconds(item.image.timestamp - firstTimestamp - (hostNow() - startTime)));
+        }
+        rectifier.rectify(item.image.image, isLeft, rectified);
+        item.image.image = rectified.clone();
+        synchronizer.push(isLeft ? SyncStream::Left : SyncStream::Right, std::move(item.image));
+        while (synchronizer.pop(&bundle)) {
+            odometry.push(bundle);
+        }
+        while (odometry.tryPop(&pose)) {
+            save(pose);
+        }
+    }
+    odometry.stop();
+    while (odometry.pop(&pose)) {
+        save(pose);
+    }
+    double duration = (hostNow() - startTime) * 1.0E-9;
+
+    auto statistics = odometry.statistics();
+    double frames = static_cast<double>(max<uint64_t>(statistics.frames, 1));
+    double optimizations = static_cast<double>(max<uint64_t>(statistics.optimizations, 1));
+    LOG(INFO) << fmt::format("odometry, {} poses in {:.2f} s({:.1f} fps), dropped = {}, lost = {}, keyframes = {}",
+                             poseNum, duration, poseNum / max(duration, 1E-9), statistics.dropped, lostNum,
+                             statistics.keyframes);
+    LOG(INFO) << fmt::format("front-end, time = {:.3f} ms(track = {:.3f}, stereo = {:.3f}, pose = {:.3f}) per frame, "
+                             "latency = {:.3f} ms",
+                             (statistics.trackTime + statistics.stereoTime + statistics.poseTime) * 1.0E-6 / frames,
+                             statistics.trackTime * 1.0E-6 / frames, statistics.stereoTime * 1.0E-6 / frames,
+                             statistics.poseTime * 1.0E-6 / frames, statistics.latency * 1.0E-6 / frames);
+    LOG(INFO) << fmt::format("back-end, keyframe selection = {:.3f} ms per frame, {} optimizations, {:.0f} landmarks, "
+                             "{:.3f} ms per optimization",
+                             statistics.keyframeTime * 1.0E-6 / frames, statistics.optimizations,
+                             statistics.landmarks / optimizations, statistics.optimizeTime * 1.0E-6 / optimizations);
+    LOG(INFO) << fmt::format("save trajectory to \"{}\"", result["output"].as<string>());
+
+    google::ShutdownGoogleLogging();
+    return 0;
+}
@@ -3,19 +3,73 @@
 #include <fmt/ranges.h>
 #include <glog/logging.h>
 #include <mynteyed/camera.h>
-#include <mynteyed/utils.h>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <csignal>
 #include <cxxopts.hpp>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
+#include "ClockSync.h"
+#include "Device.h"
+#include "Metrics.h"
+#include "PipelineBenchmark.h"
+#include "RecordPipeline.h"
+#include "Recovery.h"
+#include "SegmentWriter.h"
+#include "ShmRing.h"
+#include "ThreadPolicy.h"
+#include "Trace.h"
 
 using namespace std;
 using namespace cv;
 using namespace mynteyed;
+using namespace mev;
 namespace fs = boost::filesystem;
 
+// stop flag, set by SIGINT or SIGTERM
+static atomic<bool> gStop{false};
+
+// signal handler to stop recording
+static void signalHandler(int) { gStop = true; }
+
+// frame counter of stream, updated in capture thread and read by metrics exporter
+struct StreamCounter {
+    atomic<uint64_t> frames{0};   // received frame number
+    atomic<uint64_t> dropped{0};  // dropped frame number by device, detected by frame ID gap
+    uint32_t lastFrameId{0};      // frame ID of last frame
+
+    // update with the frame ID of new frame
+    void update(uint32_t frameId) {
+        if (frames > 0 && frameId > lastFrameId + 1) {
+            dropped += frameId - lastFrameId - 1;
+        }
+        lastFrameId = frameId;
+        ++frames;
+    }
+};
+
+// capture device, each device has its own capture thread, clock model and writer
+struct CaptureDevice {
+    size_t id{0};                         // device index in recorder, which is also the device index in pipeline
+    string name;                          // device name in recorder, "cam<id>"
+    fs::path folder;                      // save folder
+    Camera cam;                           // camera
+    DeviceInfo info;                      // device information
+    bool rightEnabled{false};             // whether right camera is enabled
+    ClockSync clockSync;                  // host/device clock synchronization, fitted by the image receive time
+    unique_ptr<SegmentWriter> writer;     // segment writer
+    map<string, StreamCounter> counters;  // frame counters of each stream
+    atomic<uint64_t> imuNum{0};           // received IMU number
+    std::thread thread;                   // capture thread
+};
+
 // get the section string
 string section(const string& text) {
     return fmt::format(fmt::fg(fmt::color::cyan), "{:═^{}}", " " + text + " ",
@@ -31,6 +85,66 @@ int main(int argc, char* argv[]) {
         ("streamMode", "stream mode", cxxopts::value<string>()->default_value("1280x720"))
         ("streamFormat", "stream format", cxxopts::value<string>()->default_value("MJPG"))
         ("showImage", "show image", cxxopts::value<bool>())
+        ("segmentDuration", "max duration of one segment(s), 0 for unlimited",
+            cxxopts::value<double>()->default_value("300"))
+        ("segmentSize", "max size of one segment(GB), 0 for unlimited", cxxopts::value<double>()->default_value("2"))
+        ("minFreeSpace", "min free disk space(GB) to continue recording", cxxopts::value<double>()->default_value("1"))
+        ("retention", "retention policy when disk is full, stop or keep",
+            cxxopts::value<string>()->default_value("stop"))
+        ("keepDuration", "only keep the last K minutes for keep policy, 0 for unlimited",
+            cxxopts::value<double>()->default_value("0"))
+        ("checkpoint", "write checkpoint every N images, 0 to disable", cxxopts::value<size_t>()->default_value("30"))
+        ("checkpointDuration", "write checkpoint at least every N seconds, so the IMU is checkpointed when the images "
+            "stall, 0 to disable", cxxopts::value<double>()->default_value("1"))
+        ("append", "append to the existing recording in folder instead of removing it, the unclosed segments will be "
+            "recovered", cxxopts::value<bool>())
+        ("encodeThreads", "encode thread number", cxxopts::value<int>()->default_value("2"))
+        ("benchmark", "benchmark the record pipeline without device, for all stream modes and formats, or the replay "
+            "recording", cxxopts::value<bool>())
+        ("replay", "recording folder to replay in benchmark, empty for synthetic images",
+            cxxopts::value<string>()->default_value(""))
+        ("benchmarkFrames", "frame number of each benchmark", cxxopts::value<size_t>()->default_value("300"))
+        ("trace", "write the trace of capture pipeline to file in Chrome trace format, empty to disable",
+            cxxopts::value<string>()->default_value(""))
+        ("deviceIndex", "open devices by index without prompt, comma separated to record multiple devices, -1 to "
+            "select", cxxopts::value<vector<int>>()->default_value("-1"))
+        ("deviceSerial", "open devices by serial number without prompt, comma separated to record multiple devices",
+            cxxopts::value<vector<string>>())
+        ("capturePolicy", "scheduling policy of capture threads, such as \"cpus=2,3;fifo=80\", the capture thread of "
+            "each device is pinned to one CPU in turn", cxxopts::value<string>()->default_value(""))
+        ("encodePolicy", "scheduling policy of encode threads, such as \"cpus=0-1;nice=5\"",
+            cxxopts::value<string>()->default_value(""))
+        ("writePolicy", "scheduling policy of write thread, such as \"nice=-5\"",
+            cxxopts::value<string>()->default_value(""))
+        ("skipStreamInfo", "skip printing the stream information of device to open faster", cxxopts::value<bool>())
+        ("openRetries", "max retry number to open device, with exponential backoff",
+            cxxopts::value<int>()->default_value("10"))
+        ("shmName", "publish images to shared memory ring with the name for other processes, empty to disable",
+            cxxopts::value<string>()->default_value(""))
+        ("shmSlots", "slot number of shared memory ring", cxxopts::value<size_t>()->default_value("16"))
+        ("metricsPort", "serve metrics in Prometheus text format on localhost port, 0 to disable",
+            cxxopts::value<int>()->default_value("0"))
+        ("metricsFile", "write metrics in Prometheus text format to file periodically, empty to disable",
+            cxxopts::value<string>()->default_value(""))
+        ("metricsInterval", "interval to write metrics file(s)", cxxopts::value<double>()->default_value("5"))
+        ("leftTransform", "transform of left frames before encoding, such as \"roi=0,240,1280,240;binning=2;"
+            "decimation=3\", the intrinsics in calibration are adjusted", cxxopts::value<string>()->default_value(""))
+        ("rightTransform", "transform of right frames before encoding, the same as left if empty",
+            cxxopts::value<string>()->default_value(""))
+        ("overload", "action under overload, block, drop-oldest, drop-newest, decimate, degrade-quality or raw",
+            cxxopts::value<string>()->default_value("block"))
+        ("highWatermark", "enter overload if encode queue is above the ratio of capacity",
+            cxxopts::value<double>()->default_value("0.8"))
+        ("lowWatermark", "leave overload if encode queue is below the ratio of capacity",
+            cxxopts::value<double>()->default_value("0.3"))
+        ("maxWriteLatency", "enter overload if the pending images take longer(s) to write at measured disk throughput, "
+            "0 to disable", cxxopts::value<double>()->default_value("2"))
+        ("maxPendingWrite", "max encoded images(MB) waiting to write, the encoding waits above it so the overload "
+            "action applies to slow disk, 0 for unlimited", cxxopts::value<double>()->default_value("256"))
+        ("decimateRate", "frame rate(Hz) of each stream under overload for decimate action",
+            cxxopts::value<double>()->default_value("5"))
+        ("degradedQuality", "JPEG quality under overload for degrade-quality action",
+            cxxopts::value<int>()->default_value("70"))
         ("h,help", "help message");
     // clang-format on
     auto result = options.parse(argc, argv);
@@ -43,6 +157,44 @@ int main(int argc, char* argv[]) {
     string streamModeName = result["streamMode"].as<string>();
     string streamFormatName = result["streamFormat"].as<string>();
     bool showImg = result["showImage"].as<bool>();
+    SegmentOptions segmentOptions;
+    segmentOptions.maxDuration = result["segmentDuration"].as<double>();
+    segmentOptions.maxSize = result["segmentSize"].as<double>();
+    segmentOptions.minFreeSpace = result["minFreeSpace"].as<double>();
+    string retentionName = result["retention"].as<string>();
+    segmentOptions.keepDuration = result["keepDuration"].as<double>();
+    segmentOptions.checkpointInterval = result["checkpoint"].as<size_t>();
+    segmentOptions.checkpointDuration = result["checkpointDuration"].as<double>();
+    bool append = result["append"].as<bool>();
+    PipelineOptions pipelineOptions;
+    pipelineOptions.encodeThreads = result["encodeThreads"].as<int>();
+    bool benchmark = result["benchmark"].as<bool>();
+    string replayFolder = result["replay"].as<string>();
+    size_t benchmarkFrames = result["benchmarkFrames"].as<size_t>();
+    string traceFile = result["trace"].as<string>();
+    auto deviceIndexes = result["deviceIndex"].as<vector<int>>();
+    auto deviceSerials = result.count("deviceSerial") ? result["deviceSerial"].as<vector<string>>() : vector<string>();
+    string capturePolicyText = result["capturePolicy"].as<string>();
+    string encodePolicyText = result["encodePolicy"].as<string>();
+    string writePolicyText = result["writePolicy"].as<string>();
+    bool printStreamInfo = !result["skipStreamInfo"].as<bool>();
+    int openRetries = result["openRetries"].as<int>();
+    string shmName = result["shmName"].as<string>();
+    size_t shmSlots = result["shmSlots"].as<size_t>();
+    MetricsOptions metricsOptions;
+    metricsOptions.port = result["metricsPort"].as<int>();
+    metricsOptions.file = result["metricsFile"].as<string>();
+    metricsOptions.interval = result["metricsInterval"].as<double>();
+    string leftTransformText = result["leftTransform"].as<string>();
+    string rightTransformText = result["rightTransform"].as<string>();
+    string overloadName = result["overload"].as<string>();
+    auto& overloadOptions = pipelineOptions.overload;
+    overloadOptions.highWatermark = result["highWatermark"].as<double>();
+    overloadOptions.lowWatermark = result["lowWatermark"].as<double>();
+    overloadOptions.maxWriteLatency = result["maxWriteLatency"].as<double>();
+    pipelineOptions.maxPendingBytes = static_cast<uint64_t>(result["maxPendingWrite"].as<double>() * 1024 * 1024);
+    overloadOptions.decimateRate = result["decimateRate"].as<double>();
+    overloadOptions.degradedQuality = result["degradedQuality"].as<int>();
 
     // check stream mode
     vector<string> streamModeNames = {"2560x720", "1280x720", "1280x480", "640x480"};
@@ -60,6 +212,95 @@ int main(int argc, char* argv[]) {
         cout << options.help() << endl;
         return 0;
     }
+    // check retention policy
+    if (boost::iequals(retentionName, "stop")) {
+        segmentOptions.retention = RetentionPolicy::Stop;
+    } else if (boost::iequals(retentionName, "keep")) {
+        segmentOptions.retention = RetentionPolicy::Keep;
+    } else {
+        cout << fmt::format("input retention policy should be one item in {}", vector<string>{"stop", "keep"}) << endl
+             << endl;
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    // check frame transforms, the image size of each stream is half width of stereo stream mode
+    if (rightTransformText.empty()) {
+        rightTransformText = leftTransformText;
+    }
+    int streamWidth = stoi(streamModeName.substr(0, streamModeName.find_first_of("xX")));
+    int streamHeight = stoi(streamModeName.substr(streamModeName.find_first_of("xX") + 1));
+    if (boost::iequals(streamModeName, "2560x720") || boost::iequals(streamModeName, "1280x480")) {
+        streamWidth /= 2;
+    }
+    for (auto& v : vector<pair<string, string>>{{"left", leftTransformText}, {"right", rightTransformText}}) {
+        auto& transform = pipelineOptions.transforms[v.first];
+        string error;
+        if (!parseFrameTransform(v.second, &transform)) {
+            cout << fmt::format("invalid {} transform \"{}\", should be like \"roi=0,240,1280,240;binning=2;"
+                                "decimation=3\", the binning should be 1, 2 or 4",
+                                v.first, v.second)
+                 << endl
+                 << endl;
+            cout << options.help() << endl;
+            return 0;
+        }
+        if (!checkFrameTransform(transform, Size(streamWidth, streamHeight), &error)) {
+            cout << fmt::format("invalid {} transform \"{}\" for stream mode {}: {}", v.first, v.second,
+                                streamModeName, error)
+                 << endl
+                 << endl;
+            cout << options.help() << endl;
+            return 0;
+        }
+    }
+
+    // check overload policy
+    if (!parseOverloadAction(overloadName, &overloadOptions.action)) {
+        cout << fmt::format("input overload action should be one item in {}",
+                            vector<string>{"block", "drop-oldest", "drop-newest", "decimate", "degrade-quality", "raw"})
+             << endl
+             << endl;
+        cout << options.help() << endl;
+        return 0;
+    }
+    if (overloadOptions.lowWatermark >= overloadOptions.highWatermark) {
+        cout << "low watermark should be less than high watermark" << endl << endl;
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    // check devices, the devices are selected by serial number if set, otherwise by index
+    vector<DeviceOptions> deviceOptions(deviceSerials.empty() ? deviceIndexes.size() : deviceSerials.size());
+    for (size_t i = 0; i < deviceOptions.size(); ++i) {
+        if (deviceSerials.empty()) {
+            deviceOptions[i].index = deviceIndexes[i];
+        } else {
+            deviceOptions[i].serial = deviceSerials[i];
+        }
+        deviceOptions[i].printStreamInfo = printStreamInfo;
+        deviceOptions[i].retries = openRetries;
+        if (deviceOptions.size() > 1 && deviceOptions[i].index < 0 && deviceOptions[i].serial.empty()) {
+            cout << "device index or serial number should be set for multiple devices" << endl << endl;
+            cout << options.help() << endl;
+            return 0;
+        }
+    }
+    // check thread policies
+    ThreadPolicy capturePolicy;
+    for (auto& v : vector<pair<string, ThreadPolicy*>>{{capturePolicyText, &capturePolicy},
+                                                       {encodePolicyText, &pipelineOptions.encodePolicy},
+                                                       {writePolicyText, &pipelineOptions.writePolicy}}) {
+        if (!parseThreadPolicy(v.first, v.second)) {
+            cout << fmt::format("invalid thread policy \"{}\", should be like \"cpus=0,2-3;fifo=80\" or "
+                                "\"cpus=0;nice=-5\", the FIFO priority and nice can't be both set",
+                                v.first)
+                 << endl
+                 << endl;
+            cout << options.help() << endl;
+            return 0;
+        }
+    }
 
     // print input parameters
     cout << section("Recorder") << endl;
@@ -68,12 +309,83 @@ int main(int argc, char* argv[]) {
     cout << fmt::format("stream mode: {}", streamModeName) << endl;
     cout << fmt::format("stream format: {}", streamFormatName) << endl;
     cout << fmt::format("show image: {}", showImg) << endl;
+    cout << fmt::format("segment duration = {} s, size = {} GB", segmentOptions.maxDuration, segmentOptions.maxSize)
+         << endl;
+    cout << fmt::format("min free space = {} GB, retention policy: {}, keep duration = {} min",
+                        segmentOptions.minFreeSpace, retentionName, segmentOptions.keepDuration)
+         << endl;
+    cout << fmt::format("checkpoint interval = {} images, {} s, append: {}", segmentOptions.checkpointInterval,
+                        segmentOptions.checkpointDuration, append)
+         << endl;
+    cout << fmt::format("encode threads = {}", pipelineOptions.encodeThreads) << endl;
+    cout << fmt::format("transform, left: \"{}\", right: \"{}\"",
+                        formatFrameTransform(pipelineOptions.transforms["left"]),
+                        formatFrameTransform(pipelineOptions.transforms["right"]))
+         << endl;
+    cout << fmt::format("overload action: {}, watermark = [{}, {}], max write latency = {} s, max pending write = {} "
+                        "MB, decimate rate = {} Hz, degraded quality = {}",
+                        overloadActionName(overloadOptions.action), overloadOptions.lowWatermark,
+                        overloadOptions.highWatermark, overloadOptions.maxWriteLatency,
+                        pipelineOptions.maxPendingBytes / 1024.0 / 1024.0, overloadOptions.decimateRate,
+                        overloadOptions.degradedQuality)
+         << endl;
+    cout << fmt::format("device index = {}, serial = {}", deviceIndexes, deviceSerials) << endl;
+    cout << fmt::format("thread policy, capture: \"{}\", encode: \"{}\", write: \"{}\"",
+                        formatThreadPolicy(capturePolicy), formatThreadPolicy(pipelineOptions.encodePolicy),
+                        formatThreadPolicy(pipelineOptions.writePolicy))
+         << endl;
+    cout << fmt::format("print stream info: {}, open retries = {}", printStreamInfo, openRetries) << endl;
+    cout << fmt::format("trace file: {}", traceFile) << endl;
+    cout << fmt::format("shared memory: {}, slots = {}", shmName, shmSlots) << endl;
+    cout << fmt::format("metrics port = {}, file: {}, interval = {} s", metricsOptions.port, metricsOptions.file,
+                        metricsOptions.interval)
+         << endl;
 
     // init glog
     google::InitGoogleLogging(argv[0]);
     FLAGS_alsologtostderr = true;
     FLAGS_colorlogtostderr = true;
 
+    // trace the capture pipeline, the trace is enabled before the pipeline threads start
+    enableTrace(!traceFile.empty());
+    setTraceThreadName("main");
+
+    // benchmark the record pipeline, the data is written to the save folder to measure the target disk
+    if (benchmark) {
+        cout << section("Benchmark") << endl;
+        vector<BenchmarkSource> sources;
+        if (!replayFolder.empty()) {
+            sources.emplace_back(replaySource(replayFolder));
+        } else {
+            for (auto& mode : streamModeNames) {
+                sources.emplace_back(syntheticSource(mode, RawFormat::YUYV));
+                sources.emplace_back(syntheticSource(mode, RawFormat::MJPG));
+            }
+        }
+        cout << fmt::format("{:<16}{:>10}{:>12}{:>14}{:>14}{:>14}{:>14}{:>12}{:>12}", "source", "max fps", "copy(ms)",
+                            "convert(ms)", "encode(ms)", "write(ms)", "IMU(us)", "MB", "MB/s")
+             << endl;
+        for (auto& source : sources) {
+            // the frame transforms are only applied to the synthetic source of the stream mode
+            PipelineOptions benchmarkOptions = pipelineOptions;
+            if (!replayFolder.empty() || !boost::istarts_with(source.name, streamModeName + " ")) {
+                benchmarkOptions.transforms.clear();
+            }
+            auto r =
+                runPipelineBenchmark(source, fs::path(rootFolder) / "benchmark", benchmarkOptions, benchmarkFrames);
+            // CPU time per frame of each stage, and per record for IMU
+            double frames = static_cast<double>(r.frames);
+            cout << fmt::format("{:<16}{:>10.1f}{:>12.3f}{:>14.3f}{:>14.3f}{:>14.3f}{:>14.3f}{:>12.1f}{:>12.1f}",
+                                r.name, r.fps, r.copyTime * 1.0E-6 / frames, r.statistics.convertTime * 1.0E-6 / frames,
+                                r.statistics.encodeTime * 1.0E-6 / frames, r.statistics.writeTime * 1.0E-6 / frames,
+                                r.statistics.imuTime * 1.0E-3 / max<uint64_t>(r.statistics.imu, 1), r.bytes * 1.0E-6,
+                                r.bytes * 1.0E-6 / r.duration)
+                 << endl;
+        }
+        google::ShutdownGoogleLogging();
+        return 0;
+    }
+
     // get stream mode from string
     StreamMode streamMode;
     if (boost::iequals(streamModeName, "2560x720")) {
@@ -95,137 +407,303 @@ int main(int argc, char* argv[]) {
 
     // create directories
     fs::path rootPath{rootFolder};
-    fs::path leftPath = rootPath / "left";
-    fs::path rightPath = rootPath / "right";
-    // remove old file and create save folder
-    if (fs::is_directory(rootPath)) {
+    if (!append && fs::is_directory(rootPath)) {
+        // remove old file
         fs::remove_all(rootPath);
     }
     fs::create_directories(rootPath);
-    fs::create_directories(leftPath);
-    fs::create_directories(rightPath);
-
-    // create IMU file name
-    fs::path imuPath = rootPath / "imu.csv";
-    std::fstream imuFile(imuPath.string(), ios::out);
-    CHECK(imuFile.is_open()) << fmt::format("cannot create IMU file \"{}\"", imuPath.string());
-    imuFile << "# Timestamp(ns), AccX(m/s^2), AccY(m/s^2), AccZ(m/s^2), GyroX(rad/s), GyroY(rad/s), GyroZ(rad/s)"
-            << endl;
-
-    // get device information(list)
-    cout << section("Device Information") << endl;
-    Camera cam;
-    DeviceInfo deviceInfo;
-    if (!util::select(cam, &deviceInfo)) {
-        LOG(FATAL) << "cannot get device information";
-    }
-    // print out device information
-    util::print_stream_infos(cam, deviceInfo.index);
-
-    // open camera
+
+    // open cameras, select device by index or serial number without prompt if set. For multiple devices, each device
+    // is saved to its own folder "cam<N>" in root folder, with its own segments and calibration
     cout << section("Open Camera") << endl;
-    LOG(INFO) << fmt::format("open device, index = {}, name = {}", deviceInfo.index, deviceInfo.name) << endl;
-    // set open parameters
-    OpenParams openParams(deviceInfo.index);
-    openParams.framerate = frameRate;
-    openParams.dev_mode = DeviceMode::DEVICE_COLOR;
-    openParams.color_mode = ColorMode::COLOR_RAW;
-    openParams.stream_mode = streamMode;
-    openParams.color_stream_format = streamFormat;
-    // open
-    cam.Open(openParams);
-    if (!cam.IsOpened()) {
-        LOG(FATAL) << "open camera failed";
-    } else {
-        LOG(INFO) << "open device success";
-    }
+    vector<unique_ptr<CaptureDevice>> devices;
+    for (size_t i = 0; i < deviceOptions.size(); ++i) {
+        auto device = make_unique<CaptureDevice>();
+        device->id = i;
+        device->name = fmt::format("cam{}", i);
+        device->folder = deviceOptions.size() == 1 ? rootPath : rootPath / device->name;
+        // set open parameters
+        OpenParams openParams;
+        openParams.framerate = frameRate;
+        openParams.dev_mode = DeviceMode::DEVICE_COLOR;
+        openParams.color_mode = ColorMode::COLOR_RAW;
+        openParams.stream_mode = streamMode;
+        openParams.color_stream_format = streamFormat;
+        // open
+        if (!openDevice(device->cam, openParams, deviceOptions[i], &device->info)) {
+            LOG(FATAL) << fmt::format("open camera {} failed", device->name);
+        }
 
-    // data enable
-    cam.EnableImageInfo(true);
-    cam.EnableProcessMode(ProcessMode::PROC_IMU_ALL);
-    cam.EnableMotionDatas();
-    bool isRightCameraEnable = cam.IsStreamDataEnabled(ImageType::IMAGE_RIGHT_COLOR);
-    LOG(INFO) << fmt::format("FPS = {} Hz", cam.GetOpenParams().framerate);
-    LOG(INFO) << fmt::format("is left enabled = {}", cam.IsStreamDataEnabled(ImageType::IMAGE_LEFT_COLOR));
-    LOG(INFO) << fmt::format("is right enabled = {}", isRightCameraEnable);
+        // data enable
+        device->cam.EnableImageInfo(true);
+        device->cam.EnableProcessMode(ProcessMode::PROC_IMU_ALL);
+        device->cam.EnableMotionDatas();
+        device->rightEnabled = device->cam.IsStreamDataEnabled(ImageType::IMAGE_RIGHT_COLOR);
+        LOG(INFO) << fmt::format("{}: FPS = {} Hz, is left enabled = {}, is right enabled = {}", device->name,
+                                 device->cam.GetOpenParams().framerate,
+                                 device->cam.IsStreamDataEnabled(ImageType::IMAGE_LEFT_COLOR), device->rightEnabled);
+
+        // recover the unclosed segments of last recording
+        if (append && fs::is_directory(device->folder)) {
+            size_t recoveredNum = recoverSession(device->folder);
+            LOG_IF(INFO, recoveredNum > 0)
+                << fmt::format("recover {} segments in \"{}\"", recoveredNum, device->folder.string());
+        }
+        fs::create_directories(device->folder);
+        writeCalibration(device->folder / "calibration.yaml", device->cam, streamMode, pipelineOptions.transforms);
+
+        // segment writer, the images and IMU are saved to segments in device folder
+        device->writer = make_unique<SegmentWriter>(device->folder, segmentOptions, vector<string>{"left", "right"});
+        device->counters["left"];
+        device->counters["right"];
+        devices.emplace_back(std::move(device));
+    }
+    // session information, the device list
+    {
+        ofstream sessionFile((rootPath / "session.yaml").string());
+        sessionFile << fmt::format("stream_mode: {}\nstream_format: {}\nframe_rate: {}\ndevices:\n", streamModeName,
+                                   streamFormatName, frameRate);
+        for (auto& device : devices) {
+            sessionFile << fmt::format("  - name: {}\n    index: {}\n    serial: \"{}\"\n    folder: \"{}\"\n",
+                                       device->name, device->info.index, device->info.sn,
+                                       fs::relative(device->folder, rootPath).string());
+        }
+    }
 
     // obtain sensor data and save
     cout << section("Process Sensor Data") << endl;
-    size_t leftImageNum{0}, rightImageNum{0};
-    constexpr double kDeg2Rad = M_PI / 180.;
-    constexpr double kG{9.81};
-    while (true) {
-        cam.WaitForStream();
-
-        // get left stream
-        auto leftStream = cam.GetStreamData(ImageType::IMAGE_LEFT_COLOR);
-        if (leftStream.img && leftStream.img_info) {
-            LOG(INFO) << fmt::format("process left image, index = {}, frame ID = {}, timestamp = {:.5f} s",
-                                     leftImageNum, leftStream.img_info->frame_id,
-                                     leftStream.img_info->timestamp * 1.E-5);
-
-#if 0
+    // record pipeline, all devices share the encode and write threads
+    vector<SegmentWriter*> writers;
+    for (auto& device : devices) {
+        writers.emplace_back(device->writer.get());
+    }
+    RecordPipeline pipeline(writers, pipelineOptions);
+    // shared memory publisher, the stream name is "cam<N>/<stream>" for multiple devices
+    unique_ptr<ShmPublisher> publisher;
+    if (!shmName.empty()) {
+        publisher = make_unique<ShmPublisher>(shmName, shmSlots);
+    }
+    // latest images to show in main thread, since imshow() isn't thread safe
+    mutex displayMutex;
+    map<string, Mat> displayImages;
+    // push image to pipeline
+    auto saveImage = [&](CaptureDevice& device, const string& stream, const StreamData& streamData,
+                         int64_t receiveTime) {
+        RawFrame frame;
+        frame.stream = stream;
+        frame.device = device.id;
+        frame.frameId = streamData.img_info->frame_id;
+        device.counters.at(stream).update(frame.frameId);
+        frame.timestamp = deviceToNs(streamData.img_info->timestamp);
+        device.clockSync.update(frame.timestamp, receiveTime);
+        frame.hostTimestamp = device.clockSync.toHost(frame.timestamp);
+        // skip the decimated frame before copy and conversion, so the CPU is cut in proportion. They are not shown or
+        // published either
+        if (pipeline.decimate(stream, frame.frameId)) {
+            return;
+        }
+        {
+            TraceScope trace("copy");
+            toRawFrame(*streamData.img, &frame);
+        }
+
+        // the BGR image is only converted here for other processes and display, the recorded frames are converted in
+        // encode threads
+        if (publisher || showImg) {
+            Mat bgr;
             {
-                // save YUYV image to .bin file
-                fs::path savePath = leftPath / fmt::format("{}.bin", leftStream.img_info->frame_id);
-                ofstream outFs(savePath.string(), ios::binary);
-                CHECK(outFs.is_open()) << fmt::format("cannot open \"{}\" to save YUYV image", savePath.string());
-                outFs.write(reinterpret_cast<const char*>(leftStream.img->data()), leftStream.img->data_size());
-                outFs.close();
+                TraceScope trace("convert");
+                bgr = frame.format == RawFormat::BGR ? frame.image
+                                                     : streamData.img->To(ImageFormat::COLOR_BGR)->ToMat();
             }
-#endif
-            // Mat img = leftStream.img->To(ImageFormat::COLOR_BGR)->ToMat();
-            // fs::path fileName = leftPath / fmt::format("{}.jpg", leftStream.img_info->timestamp * 1.0E4);
-            // imwrite(fileName.string(), img);
-
-            // show
-            // if (showImg || imgNum / 10 == 0) {
-            //     imshow("Left", img);
-            // }
-        }
-        ++leftImageNum;
-
-#if false
-        // get right stream
-        if (isRightCameraEnable) {
-            auto rightStream = cam.GetStreamData(ImageType::IMAGE_RIGHT_COLOR);
-            if (rightStream.img && rightStream.img_info) {
-                LOG(INFO) << fmt::format("process right image, index = {}", rightImageNum);
-                Mat img = rightStream.img->To(ImageFormat::COLOR_BGR)->ToMat();
-                fs::path fileName = rightPath / fmt::format("{}.jpg", rightStream.img_info->timestamp * 1.0E4);
-                imwrite(fileName.string(), img);
-
-                // // show
-                // if (showImg || rightImageNum / 10 == 0) {
-                //     imshow("Right", img);
-                // }
+            // publish to other processes
+            if (publisher) {
+                TraceScope trace("publish");
+                publisher->publish(devices.size() == 1 ? stream : device.name + "/" + stream, frame.frameId,
+                                   frame.timestamp, frame.hostTimestamp, bgr);
             }
-            ++rightImageNum;
-        }
-
-        // get IMU
-        auto motionData = cam.GetMotionDatas();
-        for (auto& motion : motionData) {
-            if (motion.imu) {
-                imuFile << fmt::format("{},{},{}, {},{},{},{}", motion.imu->timestamp * 1.0E4,
-                                       motion.imu->gyro[0] * kDeg2Rad, motion.imu->gyro[1] * kDeg2Rad,
-                                       motion.imu->gyro[2] * kDeg2Rad, motion.imu->accel[0] * kG,
-                                       motion.imu->accel[1] * kG, motion.imu->accel[2] * kG)
-                        << endl;
+            // show
+            if (showImg) {
+                lock_guard<mutex> lock(displayMutex);
+                displayImages[devices.size() == 1 ? stream : device.name + " " + stream] = bgr;
             }
         }
+        TraceScope trace("push");
+        pipeline.push(std::move(frame));
+    };
+    // capture loop of device
+    auto capture = [&](CaptureDevice& device) {
+        setTraceThreadName(fmt::format("capture{}", device.id));
+        // each device is pinned to one CPU in turn
+        ThreadPolicy policy = capturePolicy;
+        if (!policy.cpus.empty()) {
+            policy.cpus = {capturePolicy.cpus[device.id % capturePolicy.cpus.size()]};
+        }
+        applyThreadPolicy(policy, fmt::format("capture{}", device.id));
+        auto& cam = device.cam;
+        while (!gStop && !pipeline.isStopped()) {
+            {
+                TraceScope trace("WaitForStream");
+                cam.WaitForStream();
+            }
 
-#endif
+            // get left stream
+            StreamData leftStream;
+            {
+                TraceScope trace("GetStreamData");
+                leftStream = cam.GetStreamData(ImageType::IMAGE_LEFT_COLOR);
+            }
+            int64_t receiveTime = hostNow();
+            if (leftStream.img && leftStream.img_info) {
+                LOG(INFO) << fmt::format("{}: process left image, index = {}, frame ID = {}, timestamp = {:.5f} s",
+                                         device.name, device.counters.at("left").frames.load(),
+                                         leftStream.img_info->frame_id,
+                                         deviceToNs(leftStream.img_info->timestamp) * 1.0E-9);
+                saveImage(device, "left", leftStream, receiveTime);
+            }
+
+            // get right stream
+            if (device.rightEnabled) {
+                StreamData rightStream;
+                {
+                    TraceScope trace("GetStreamData");
+                    rightStream = cam.GetStreamData(ImageType::IMAGE_RIGHT_COLOR);
+                }
+                receiveTime = hostNow();
+                if (rightStream.img && rightStream.img_info) {
+                    LOG(INFO) << fmt::format("{}: process right image, index = {}", device.name,
+                                             device.counters.at("right").frames.load());
+                    saveImage(device, "right", rightStream, receiveTime);
+                }
+            }
 
-        // exit
-        // auto key = static_cast<char>(waitKey(1));
-        // if (key == 27 || key == 'q' || key == 'Q' || key == 'x' || key == 'X') {
-        //     break;
-        // }
+            // get IMU, the IMU is received in batch, so only the image is used to fit clock model
+            auto motionData = cam.GetMotionDatas();
+            for (auto& motion : motionData) {
+                if (motion.imu) {
+                    ImuRecord record = toImuRecord(*motion.imu);
+                    record.hostTimestamp = device.clockSync.toHost(record.timestamp);
+                    pipeline.push(record, device.id);
+                    ++device.imuNum;
+                }
+            }
+        }
+    };
+    // metrics exporter, the rates are calculated between two collections of the same sink, so the HTTP scrapes and
+    // file writes don't shorten the intervals of each other
+    map<MetricsSink, map<string, RateMeter>> sinkRateMeters;
+    map<MetricsSink, map<int, RateMeter>> sinkCpuMeters;
+    MetricsExporter metricsExporter(metricsOptions, [&](MetricsText& text, MetricsSink sink) {
+        int64_t now = hostNow();
+        auto& rateMeters = sinkRateMeters[sink];
+        auto& cpuMeters = sinkCpuMeters[sink];
+        for (auto& d : devices) {
+            for (auto& c : d->counters) {
+                text.add("mev_frames_total", "counter", "Received frame number", c.second.frames,
+                         fmt::format("device=\"{}\",stream=\"{}\"", d->name, c.first));
+            }
+        }
+        for (auto& d : devices) {
+            for (auto& c : d->counters) {
+                text.add("mev_fps", "gauge", "Received frame rate, Hz",
+                         rateMeters[d->name + c.first].update(c.second.frames, now),
+                         fmt::format("device=\"{}\",stream=\"{}\"", d->name, c.first));
+            }
+        }
+        for (auto& d : devices) {
+            for (auto& c : d->counters) {
+                text.add("mev_dropped_frames_total", "counter",
+                         "Dropped frame number by device, detected by frame ID gap", c.second.dropped,
+                         fmt::format("device=\"{}\",stream=\"{}\"", d->name, c.first));
+            }
+        }
+        for (auto& d : devices) {
+            text.add("mev_imu_total", "counter", "Received IMU record number", d->imuNum,
+                     fmt::format("device=\"{}\"", d->name));
+        }
+        for (auto& d : devices) {
+            text.add("mev_imu_rate", "gauge", "Received IMU rate, Hz",
+                     rateMeters[d->name + "imu"].update(d->imuNum, now), fmt::format("device=\"{}\"", d->name));
+        }
+        for (auto& d : devices) {
+            text.add("mev_clock_drift_ppm", "gauge", "Clock drift of host relative to device, ppm",
+                     d->clockSync.model().drift * 1.0E6, fmt::format("device=\"{}\"", d->name));
+        }
+        text.add("mev_queue_size", "gauge", "Queue size of record pipeline", pipeline.encodeQueueSize(),
+                 "queue=\"encode\"");
+        text.add("mev_queue_size", "gauge", "Queue size of record pipeline", pipeline.writeQueueSize(),
+                 "queue=\"write\"");
+        auto statistics = pipeline.statistics();
+        text.add("mev_written_images_total", "counter", "Written image number", statistics.images);
+        text.add("mev_pipeline_dropped_images_total", "counter", "Dropped image number after the writer is stopped",
+                 statistics.dropped);
+        text.add("mev_overloaded", "gauge", "Whether the record pipeline is overloaded", statistics.overloaded);
+        text.add("mev_overloads_total", "counter", "Transition number into overload", statistics.overloads);
+        text.add("mev_overload_dropped_images_total", "counter", "Dropped image number by overload policy",
+                 statistics.overloadDropped);
+        text.add("mev_pending_write_bytes", "gauge", "Encoded image bytes waiting to write", statistics.pendingBytes);
+        text.add("mev_disk_throughput_mbps", "gauge", "Measured disk throughput of image writing, MB/s",
+                 statistics.diskThroughput * 1.0E-6);
+        text.add("mev_written_bytes_total", "counter", "Written bytes", statistics.bytes);
+        text.add("mev_write_mbps", "gauge", "Write speed, MB/s",
+                 rateMeters["bytes"].update(statistics.bytes, now) * 1.0E-6);
+        DiskSpace diskSpace;
+        if (getDiskSpace(rootFolder, &diskSpace)) {
+            text.add("mev_disk_available_bytes", "gauge", "Available disk space of save folder", diskSpace.available);
+        }
+        auto threads = threadCpuTimes();
+        for (auto& t : threads) {
+            text.add("mev_thread_cpu_seconds_total", "counter", "CPU time of thread, s", t.cpuTime,
+                     fmt::format("thread=\"{}\",tid=\"{}\"", t.name, t.tid));
+        }
+        for (auto& t : threads) {
+            text.add("mev_thread_cpu_usage", "gauge", "CPU usage of thread, 1 for one core",
+                     cpuMeters[t.tid].update(t.cpuTime, now),
+                     fmt::format("thread=\"{}\",tid=\"{}\"", t.name, t.tid));
+        }
+    });
+    // stop by SIGINT or SIGTERM, the data in queues will be saved before exit
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+    for (auto& device : devices) {
+        device->thread = thread(capture, ref(*device));
+    }
+    // show images in main thread
+    while (!gStop && !pipeline.isStopped()) {
+        if (showImg) {
+            {
+                lock_guard<mutex> lock(displayMutex);
+                TraceScope trace("display");
+                for (auto& v : displayImages) {
+                    imshow(v.first, v.second);
+                }
+                displayImages.clear();
+            }
+            waitKey(10);
+        } else {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
     }
 
-    imuFile.close();
-    cam.Close();
+    LOG_IF(INFO, gStop) << "receive stop signal";
+    for (auto& device : devices) {
+        device->thread.join();
+        LOG(INFO) << fmt::format("{}: clock model, drift = {:.3f} ppm, residual std = {:.3f} ms", device->name,
+                                 device->clockSync.model().drift * 1.0E6, device->clockSync.residualStd() * 1.0E-6);
+    }
+    pipeline.stop();
+    auto statistics = pipeline.statistics();
+    LOG(INFO) << fmt::format("record pipeline, written images = {}, IMU = {}, dropped images = {}, overloads = {}, "
+                             "dropped by overload = {}",
+                             statistics.images, statistics.imu, statistics.dropped, statistics.overloads,
+                             statistics.overloadDropped);
+    LOG_IF(INFO, statistics.decimated > 0) << fmt::format("skipped {} images by decimation", statistics.decimated);
+    for (auto& device : devices) {
+        device->cam.Close();
+    }
+    if (!traceFile.empty()) {
+        writeTrace(traceFile);
+    }
 
     google::ShutdownGoogleLogging();
     return 0;
@@ -0,0 +1,67 @@
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/filesystem.hpp>
+#include <cxxopts.hpp>
+#include <iostream>
+#include "Recovery.h"
+
+using namespace std;
+using namespace mev;
+namespace fs = boost::filesystem;
+
+// get the section string
+string section(const string& text) {
+    return fmt::format(fmt::fg(fmt::color::cyan), "{:═^{}}", " " + text + " ",
+                       max(100, static_cast<int>(text.size() + 12)));
+}
+
+int main(int argc, char* argv[]) {
+    // argument parser
+    cxxopts::Options options(argv[0], "Recover the unclosed segments of killed recording");
+    // clang-format off
+    options.add_options()("f,folder", "recording folder", cxxopts::value<string>()->default_value("./data"))
+        ("s,segment", "only recover this segment folder", cxxopts::value<string>())
+        ("h,help", "help message");
+    // clang-format on
+    auto result = options.parse(argc, argv);
+    if (result.count("help")) {
+        cout << options.help() << endl;
+        return 0;
+    }
+    string rootFolder = result["folder"].as<string>();
+
+    // init glog
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_alsologtostderr = true;
+    FLAGS_colorlogtostderr = true;
+
+    cout << section("Recover") << endl;
+    fs::path rootPath{rootFolder};
+    CHECK(fs::is_directory(rootPath)) << fmt::format("recording folder \"{}\" is not exist", rootFolder);
+    if (result.count("segment")) {
+        // recover one segment
+        SegmentInfo info;
+        if (!recoverSegment(rootPath / result["segment"].as<string>(), &info)) {
+            LOG(ERROR) << "recover segment failed";
+            return -1;
+        }
+        // the segment list is in the device folder of segment
+        fs::path deviceFolder = (rootPath / result["segment"].as<string>()).parent_path();
+        auto segments = findClosedSegments(deviceFolder);
+        writeSegmentList(deviceFolder, deque<SegmentInfo>(segments.begin(), segments.end()));
+    } else {
+        // recover all segments of each device
+        for (auto& deviceFolder : findDeviceFolders(rootPath)) {
+            if (!fs::is_directory(deviceFolder)) {
+                LOG(WARNING) << fmt::format("device folder \"{}\" is not exist", deviceFolder.string());
+                continue;
+            }
+            size_t recoveredNum = recoverSession(deviceFolder);
+            LOG(INFO) << fmt::format("recover {} segments in \"{}\"", recoveredNum, deviceFolder.string());
+        }
+    }
+
+    google::ShutdownGoogleLogging();
+    return 0;
+}
@@ -14,7 +14,7 @@ def analysis_img_fps(root_folder: str, camera_name: str):
     times = []
     for f in os.listdir(img_folder):
         if f.endswith('.png') or f.endswith('.jpg'):
-            times.append(float(f.split('.')[0].split('_')[-1]) / 100.)  # to ms
+            times.append(float(f.split('.')[0].split('_')[-1]) * 1.E-6)  # ns to ms
     if len(times) == 0:
         return
 
@@ -35,15 +35,16 @@ def analysis_img_fps(root_folder: str, camera_name: str):
 def analysis_imu_fps(imu_file: str):
     if not os.path.exists(imu_file):
         return
-    imu = np.loadtxt(imu_file, delimiter=',')
+    # timestamp(ns), host timestamp(ns), acc(3), gyro(3)
+    imu = np.loadtxt(imu_file, delimiter=',', ndmin=2)
 
     # acc
-    acc_times = imu[imu[:, 1] != 0, 0] / 100.  # to ms
+    acc_times = imu[imu[:, 2] != 0, 0] * 1.E-6  # ns to ms
     acc_delta = acc_times[1:] - acc_times[:-1]
     print(f'acc, mean = {acc_delta.mean():.5f} ms, min = {acc_delta.min():.5f} ms, max = {acc_delta.max():.5f} ms',
           f', freq = {1000 / acc_delta.mean():.5f} Hz')
     # gyro
-    gyro_times = imu[imu[:, -1] != 0, 0] / 100.  # to ms
+    gyro_times = imu[imu[:, -1] != 0, 0] * 1.E-6  # ns to ms
     gyro_delta = gyro_times[1:] - gyro_times[:-1]
     print(f'gyro, mean = {gyro_delta.mean():.5f} ms, min = {gyro_delta.min():.5f} ms, max = {gyro_delta.max():.5f} ms',
           f', freq = {1000 / gyro_delta.mean():.5f} Hz')
@@ -67,7 +68,7 @@ def analysis_imu_fps(imu_file: str):
 def main():
     # argument parser
     parser = argparse.ArgumentParser(description='Analysis the recorded data quality of MYNT EYE camera')
-    parser.add_argument('--folder', type=str, required=True, help='data folder')
+    parser.add_argument('--folder', type=str, required=True, help='segment folder of recorded data')
     args = parser.parse_args()
     print(args)
     data_path = args.folder
@@ -75,7 +76,7 @@ def main():
     # check the image timestamp
     analysis_img_fps(data_path, "left")
     analysis_img_fps(data_path, "right")
-    analysis_imu_fps(path.join(data_path, 'imu.txt'))
+    analysis_imu_fps(path.join(data_path, 'imu.csv'))
 
     plt.show(block=True)
 
@@ -0,0 +1,163 @@
+#include "AllanVariance.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+AllanVariance::AllanVariance(const AllanOptions& options) : options_(options) {
+    CHECK_GT(options_.pointsPerDecade, 0) << "points per decade should be greater than 0";
+    CHECK_GE(options_.minClusters, 2) << "min cluster number should be at least 2";
+    for (auto& sums : sums_) {
+        sums.assign(1, 0.0);
+    }
+}
+
+void AllanVariance::add(int64_t timestamp, const Vec3d& values) {
+    if (sampleNum() == 0) {
+        offset_ = values;
+        firstTime_ = timestamp;
+    } else {
+        maxInterval_ = max(maxInterval_, timestamp - lastTime_);
+    }
+    lastTime_ = timestamp;
+    for (int i = 0; i < 3; ++i) {
+        sums_[i].push_back(sums_[i].back() + (values[i] - offset_[i]));
+    }
+}
+
+double AllanVariance::samplePeriod() const {
+    size_t n = sampleNum();
+    return n > 1 ? (lastTime_ - firstTime_) * 1.0E-9 / static_cast<double>(n - 1) : 0.0;
+}
+
+array<AllanCurve, 3> AllanVariance::compute() const {
+    array<AllanCurve, 3> curves;
+    const size_t n = sampleNum();
+    const double tau0 = samplePeriod();
+    // log spaced cluster sizes, the longest one still has minClusters non-overlapping clusters
+    const size_t maxSize = n / static_cast<size_t>(options_.minClusters);
+    vector<size_t> sizes;
+    for (int i = 0;; ++i) {
+        auto m = static_cast<size_t>(llround(pow(10.0, static_cast<double>(i) / options_.pointsPerDecade)));
+        if (m > maxSize) {
+            break;
+        }
+        if (sizes.empty() || m != sizes.back()) {
+            sizes.emplace_back(m);
+        }
+    }
+    if (sizes.empty() || tau0 <= 0) {
+        return curves;
+    }
+
+    // each job is one axis and cluster size, all jobs have the same cost O(N), so they are split evenly to stripes
+    const int jobNum = static_cast<int>(3 * sizes.size());
+    vector<double> variances(jobNum);
+    const int stripes = options_.threads > 0 ? options_.threads : max(getNumThreads(), 1);
+    parallel_for_(
+        Range(0, jobNum),
+        [&](const Range& range) {
+            for (int j = range.start; j < range.end; ++j) {
+                const double* theta = sums_[j % 3].data();
+                const size_t m = sizes[j / 3];
+                const size_t count = n + 1 - 2 * m;
+                // 4 partial sums to break the dependency of additions
+                double sum[4]{0, 0, 0, 0};
+                size_t k = 0;
+                for (; k + 4 <= count; k += 4) {
+                    for (int i = 0; i < 4; ++i) {
+                        double d = theta[k + i + 2 * m] - 2 * theta[k + i + m] + theta[k + i];
+                        sum[i] += d * d;
+                    }
+                }
+                for (; k < count; ++k) {
+                    double d = theta[k + 2 * m] - 2 * theta[k + m] + theta[k];
+                    sum[0] += d * d;
+                }
+                variances[j] = (sum[0] + sum[1] + sum[2] + sum[3]) / (2.0 * m * m * count);
+            }
+        },
+        stripes);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        auto& curve = curves[axis];
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            double m = static_cast<double>(sizes[i]);
+            curve.taus.emplace_back(m * tau0);
+            curve.deviations.emplace_back(sqrt(variances[3 * i + axis]));
+            curve.errors.emplace_back(1 / sqrt(2 * (static_cast<double>(n) / m - 1)));
+        }
+    }
+    return curves;
+}
+
+NoiseParameters estimateNoise(const AllanCurve& curve) {
+    NoiseParameters noise;
+    const size_t n = curve.taus.size();
+    if (n < 3) {
+        return noise;
+    }
+    vector<double> x(n), y(n);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = log10(curve.taus[i]);
+        y[i] = log10(max(curve.deviations[i], numeric_limits<double>::min()));
+    }
+    // the slope of each point is fitted by least squares with 2 neighbors on each side, the curve is noisy at long tau
+    vector<double> slopes(n);
+    for (size_t i = 0; i < n; ++i) {
+        size_t begin = i >= 2 ? i - 2 : 0, end = min(n, i + 3);
+        double mx{0}, my{0};
+        for (size_t j = begin; j < end; ++j) {
+            mx += x[j];
+            my += y[j];
+        }
+        mx /= static_cast<double>(end - begin);
+        my /= static_cast<double>(end - begin);
+        double sxy{0}, sxx{0};
+        for (size_t j = begin; j < end; ++j) {
+            sxy += (x[j] - mx) * (y[j] - my);
+            sxx += (x[j] - mx) * (x[j] - mx);
+        }
+        slopes[i] = sxy / sxx;
+    }
+    // fit the line with fixed slope to the points whose slope is near it, weighted by the inverse variance of each
+    // point, the white noise is before the bottom of curve and the random walk is after it
+    const size_t bottom = min_element(curve.deviations.begin(), curve.deviations.end()) - curve.deviations.begin();
+    auto fitLine = [&](double slope, size_t begin, size_t end, double* tau) {
+        double sum{0}, weights{0}, best{numeric_limits<double>::max()};
+        for (size_t i = begin; i < end; ++i) {
+            if (abs(slopes[i] - slope) > 0.1) {
+                continue;
+            }
+            double w = 1 / max(curve.errors[i] * curve.errors[i], 1.0E-12);
+            sum += w * (y[i] - slope * x[i]);
+            weights += w;
+            // the representative tau is the point nearest to the slope
+            if (abs(slopes[i] - slope) < best) {
+                best = abs(slopes[i] - slope);
+                *tau = curve.taus[i];
+            }
+        }
+        return weights > 0 ? sum / weights : numeric_limits<double>::quiet_NaN();
+    };
+    // white noise, log(sigma) = -1/2 * log(tau) + log(N)
+    double intercept = fitLine(-0.5, 0, bottom + 1, &noise.noiseTau);
+    if (!std::isnan(intercept)) {
+        noise.noiseDensity = pow(10.0, intercept);
+    }
+    // random walk, log(sigma) = 1/2 * log(tau) + log(K / sqrt(3)), it's only found in long recordings
+    intercept = fitLine(0.5, bottom, n, &noise.randomWalkTau);
+    if (!std::isnan(intercept)) {
+        noise.randomWalk = pow(10.0, intercept + 0.5 * log10(3.0));
+    }
+    // bias instability, the flat bottom is sqrt(2 * ln(2) / pi) * B
+    noise.biasInstability = curve.deviations[bottom] / sqrt(2 * log(2) / CV_PI);
+    return noise;
+}
+
+}  // namespace mev
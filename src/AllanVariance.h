@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace mev {
+
+// Allan variance options
+struct AllanOptions {
+    int pointsPerDecade{20};  // cluster time number per decade, log spaced
+    int minClusters{9};       // min non-overlapping cluster number of the longest cluster time
+    int threads{0};           // thread number to compute the curves, 0 for OpenCV thread number
+};
+
+// overlapping Allan deviation of one axis
+struct AllanCurve {
+    std::vector<double> taus;        // cluster time, s
+    std::vector<double> deviations;  // Allan deviation, in the unit of sample
+    std::vector<double> errors;      // relative error of each deviation
+};
+
+/**
+ * @brief Noise parameters from Allan deviation, IEEE Std 952. The noise density and random walk are in the continuous
+ * time units used by VIO, such as rad/s/sqrt(Hz) and rad/s^2/sqrt(Hz) for gyroscope
+ */
+struct NoiseParameters {
+    double noiseDensity{0};     // white noise density, deviation at tau = 1 s of the -1/2 slope line, 0 if not found
+    double randomWalk{0};       // bias random walk, deviation at tau = 3 s of the +1/2 slope line, 0 if not found
+    double biasInstability{0};  // bias instability, min deviation / 0.664
+    double noiseTau{0};         // cluster time nearest to the -1/2 slope, s
+    double randomWalkTau{0};    // cluster time nearest to the +1/2 slope, s
+};
+
+/**
+ * @brief Overlapping Allan variance of 3-axis samples, such as gyroscope or accelerator. The samples are added in
+ * stream, only the cumulative sum of each axis is kept(8 bytes per sample and axis), so the variance of each cluster
+ * size m is
+ *
+ *  sigma^2(m * tau0) = sum((theta[k + 2m] - 2 * theta[k + m] + theta[k])^2) / (2 * m^2 * (N - 2m))
+ *
+ * in O(N) without re-summing the clusters. The curves of all axes and cluster times are computed in parallel
+ */
+class AllanVariance {
+  public:
+    explicit AllanVariance(const AllanOptions& options = AllanOptions());
+
+    /**
+     * @brief Add a sample, the samples should be uniformly sampled in time order
+     *
+     * @param timestamp Timestamp of sample, ns
+     * @param values    Sample of 3 axes
+     */
+    void add(std::int64_t timestamp, const cv::Vec3d& values);
+
+    /**
+     * @brief Compute the overlapping Allan deviation of each axis
+     *
+     * @return Curves of x, y and z axes, empty if there are too few samples
+     */
+    std::array<AllanCurve, 3> compute() const;
+
+    // sample number
+    inline std::size_t sampleNum() const { return sums_[0].size() - 1; }
+
+    // average sample period, s
+    double samplePeriod() const;
+
+    // max sample interval, s. The Allan variance is biased if it's much larger than the average period(lost samples)
+    inline double maxInterval() const { return maxInterval_ * 1.0E-9; }
+
+  private:
+    AllanOptions options_;
+    std::vector<double> sums_[3];  // cumulative sums of the samples minus the first one, starts with 0
+    cv::Vec3d offset_;             // first sample, subtracted to keep the precision of sums
+    std::int64_t firstTime_{0};    // timestamp of first sample, ns
+    std::int64_t lastTime_{0};     // timestamp of last sample, ns
+    std::int64_t maxInterval_{0};  // max sample interval, ns
+};
+
+/**
+ * @brief Estimate the noise parameters from Allan deviation curve. The log-log slope of each point is fitted with its
+ * neighbors, then the -1/2 slope line is fitted to the points before the bottom of curve whose slope is within 0.1 of
+ * it, and the +1/2 slope line to the points after the bottom, weighted by the error of each point
+ *
+ * @param curve Allan deviation curve
+ * @return Noise parameters
+ */
+NoiseParameters estimateNoise(const AllanCurve& curve);
+
+}  // namespace mev
@@ -0,0 +1,161 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace mev {
+
+/**
+ * @brief Thread safe blocking queue with optional capacity. After close(), push will fail and pop will return the
+ * remaining items until the queue is empty, so the consumer could drain all data before exit
+ *
+ * @tparam T Item type
+ */
+template <typename T>
+class BlockingQueue {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param capacity  Max size of queue, 0 for unlimited
+     */
+    explicit BlockingQueue(std::size_t capacity = 0) : capacity_(capacity) {}
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+  public:
+    /**
+     * @brief Push item to queue, block if the queue is full
+     *
+     * @param item  Item
+     * @return False if the queue is closed
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [&] { return closed_ || capacity_ == 0 || queue_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        queue_.emplace_back(std::move(item));
+        lock.unlock();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Push item to queue without blocking
+     *
+     * @param item  Item
+     * @return False if the queue is full or closed
+     */
+    bool tryPush(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closed_ || (capacity_ != 0 && queue_.size() >= capacity_)) {
+            return false;
+        }
+        queue_.emplace_back(std::move(item));
+        lock.unlock();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Push item to queue without blocking, drop the oldest item if the queue is full
+     *
+     * @param item      Item
+     * @param dropped   Output whether the oldest item is dropped, could be nullptr
+     * @return False if the queue is closed
+     */
+    bool pushDropOldest(T item, bool* dropped = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (dropped) {
+            *dropped = false;
+        }
+        if (closed_) {
+            return false;
+        }
+        if (capacity_ != 0 && queue_.size() >= capacity_) {
+            queue_.pop_front();
+            if (dropped) {
+                *dropped = true;
+            }
+        }
+        queue_.emplace_back(std::move(item));
+        lock.unlock();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop item from queue, block until there is any item or the queue is closed
+     *
+     * @param item  Output item
+     * @return False if the queue is closed and empty
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [&] { return closed_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return false;
+        }
+        item = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop item from queue without blocking
+     *
+     * @param item  Output item
+     * @return False if the queue is empty
+     */
+    bool tryPop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        item = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // close the queue, wake up all waiting threads
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    // whether the queue is closed
+    bool isClosed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+    // current size
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    // capacity, 0 for unlimited
+    inline std::size_t capacity() const { return capacity_; }
+
+  private:
+    std::size_t capacity_;  // max size, 0 for unlimited
+    bool closed_{false};    // whether closed
+    std::deque<T> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
+
+}  // namespace mev
@@ -0,0 +1,461 @@
+#include "Census.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+// SSSE3 and AVX2 functions are compiled by target attribute and selected at runtime, so no -mavx2 is needed
+#define MEV_SIMD_X86
+#define MEV_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define MEV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// census of one pixel. The neighbors in raster order are grouped by 8, group k is the byte k of census, and the first
+// neighbor of each group is the highest bit, which is the same bit order as SIMD versions
+template <int Rows, int Cols, typename T>
+inline T censusPixel(const uint8_t* p, ptrdiff_t step) {
+    const uint8_t c = *p;
+    T value{0};
+    T group{0};
+    int n{0};
+    for (int dy = -Rows / 2; dy <= Rows / 2; ++dy) {
+        for (int dx = -Cols / 2; dx <= Cols / 2; ++dx) {
+            if (dy == 0 && dx == 0) {
+                continue;
+            }
+            group = (group << 1) | (p[dy * step + dx] < c);
+            if (++n % 8 == 0) {
+                value |= group << (n - 8);
+                group = 0;
+            }
+        }
+    }
+    if (n % 8 != 0) {
+        value |= group << (n - n % 8);
+    }
+    return value;
+}
+
+#if defined(MEV_SIMD_X86)
+// pack the 3 census bytes of 16 pixels to 32 bits census
+inline void packCensus(const __m128i* groups, uint32_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(groups[0], groups[1]);
+    __m128i hi = _mm_unpackhi_epi8(groups[0], groups[1]);
+    __m128i lo2 = _mm_unpacklo_epi8(groups[2], zero);
+    __m128i hi2 = _mm_unpackhi_epi8(groups[2], zero);
+    auto dst = reinterpret_cast<__m128i*>(out);
+    _mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, lo2));
+    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, lo2));
+    _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, hi2));
+    _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, hi2));
+}
+
+// pack the 8 census bytes of 16 pixels to 64 bits census
+inline void packCensus(const __m128i* groups, uint64_t* out) {
+    // 16 bits of byte pairs, w[2k] for pixels 0-7 and w[2k + 1] for pixels 8-15
+    __m128i w[8];
+    for (int k = 0; k < 4; ++k) {
+        w[2 * k] = _mm_unpacklo_epi8(groups[2 * k], groups[2 * k + 1]);
+        w[2 * k + 1] = _mm_unpackhi_epi8(groups[2 * k], groups[2 * k + 1]);
+    }
+    auto dst = reinterpret_cast<__m128i*>(out);
+    for (int h = 0; h < 2; ++h, dst += 4) {
+        __m128i lo = _mm_unpacklo_epi16(w[h], w[h + 2]);       // bytes 0-3 of pixels 0-3
+        __m128i hi = _mm_unpackhi_epi16(w[h], w[h + 2]);       // bytes 0-3 of pixels 4-7
+        __m128i lo2 = _mm_unpacklo_epi16(w[h + 4], w[h + 6]);  // bytes 4-7 of pixels 0-3
+        __m128i hi2 = _mm_unpackhi_epi16(w[h + 4], w[h + 6]);  // bytes 4-7 of pixels 4-7
+        _mm_storeu_si128(dst, _mm_unpacklo_epi32(lo, lo2));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi32(lo, lo2));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi32(hi, hi2));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi32(hi, hi2));
+    }
+}
+
+// census of 16 pixels per iteration with SSE2, return the first x which is not processed
+template <int Rows, int Cols, typename T>
+int censusRowSse(const uint8_t* row, ptrdiff_t step, int width, T* out) {
+    constexpr int kGroups = (Rows * Cols - 1 + 7) / 8;
+    const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+    int x = Cols / 2;
+    for (; x + 16 + Cols / 2 <= width; x += 16) {
+        const uint8_t* p = row + x;
+        // compare as signed bytes by flipping the sign bit
+        __m128i c = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), sign);
+        __m128i groups[kGroups];
+        __m128i group = _mm_setzero_si128();
+        int n{0};
+        for (int dy = -Rows / 2; dy <= Rows / 2; ++dy) {
+            for (int dx = -Cols / 2; dx <= Cols / 2; ++dx) {
+                if (dy == 0 && dx == 0) {
+                    continue;
+                }
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + dy * step + dx));
+                // group = group * 2 + (v < c), the mask of comparison is -1
+                group = _mm_sub_epi8(_mm_add_epi8(group, group), _mm_cmpgt_epi8(c, _mm_xor_si128(v, sign)));
+                if (++n % 8 == 0) {
+                    groups[n / 8 - 1] = group;
+                    group = _mm_setzero_si128();
+                }
+            }
+        }
+        if (n % 8 != 0) {
+            groups[kGroups - 1] = group;
+        }
+        packCensus(groups, out + x);
+    }
+    return x;
+}
+
+// census of 32 pixels per iteration with AVX2, return the first x which is not processed
+template <int Rows, int Cols, typename T>
+MEV_TARGET_AVX2 int censusRowAvx2(const uint8_t* row, ptrdiff_t step, int width, T* out) {
+    constexpr int kGroups = (Rows * Cols - 1 + 7) / 8;
+    const __m256i sign = _mm256_set1_epi8(static_cast<char>(0x80));
+    int x = Cols / 2;
+    for (; x + 32 + Cols / 2 <= width; x += 32) {
+        const uint8_t* p = row + x;
+        __m256i c = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), sign);
+        __m256i groups[kGroups];
+        __m256i group = _mm256_setzero_si256();
+        int n{0};
+        for (int dy = -Rows / 2; dy <= Rows / 2; ++dy) {
+            for (int dx = -Cols / 2; dx <= Cols / 2; ++dx) {
+                if (dy == 0 && dx == 0) {
+                    continue;
+                }
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + dy * step + dx));
+                group = _mm256_sub_epi8(_mm256_add_epi8(group, group),
+                                        _mm256_cmpgt_epi8(c, _mm256_xor_si256(v, sign)));
+                if (++n % 8 == 0) {
+                    groups[n / 8 - 1] = group;
+                    group = _mm256_setzero_si256();
+                }
+            }
+        }
+        if (n % 8 != 0) {
+            groups[kGroups - 1] = group;
+        }
+        // the unpack of AVX2 works in 128 bits lanes, so pack each half by SSE2
+        __m128i lo[kGroups];
+        __m128i hi[kGroups];
+        for (int k = 0; k < kGroups; ++k) {
+            lo[k] = _mm256_castsi256_si128(groups[k]);
+            hi[k] = _mm256_extracti128_si256(groups[k], 1);
+        }
+        packCensus(lo, out + x);
+        packCensus(hi, out + x + 16);
+    }
+    return x;
+}
+#endif
+
+template <int Rows, int Cols, typename T>
+void censusImage(const Mat& gray, Mat& census, int type, SimdLevel level) {
+    census.create(gray.size(), type);
+    census.setTo(Scalar::all(0));
+    const ptrdiff_t step = static_cast<ptrdiff_t>(gray.step);
+    for (int y = Rows / 2; y < gray.rows - Rows / 2; ++y) {
+        const uint8_t* row = gray.ptr<uint8_t>(y);
+        T* out = census.ptr<T>(y);
+        int x = Cols / 2;
+#if defined(MEV_SIMD_X86)
+        if (level == SimdLevel::AVX2) {
+            x = censusRowAvx2<Rows, Cols>(row, step, gray.cols, out);
+        } else if (level == SimdLevel::SSE) {
+            x = censusRowSse<Rows, Cols>(row, step, gray.cols, out);
+        }
+#else
+        (void)level;
+#endif
+        for (; x < gray.cols - Cols / 2; ++x) {
+            out[x] = censusPixel<Rows, Cols, T>(row + x, step);
+        }
+    }
+}
+
+// scalar Hamming cost of row from x0
+template <typename T>
+void hammingRowScalar(const T* left, const T* right, int x0, int width, uint16_t* out) {
+    for (int x = x0; x < width; ++x) {
+        out[x] = static_cast<uint16_t>(sizeof(T) == 8 ? __builtin_popcountll(left[x] ^ right[x])
+                                                      : __builtin_popcount(static_cast<uint32_t>(left[x] ^ right[x])));
+    }
+}
+
+#if defined(MEV_SIMD_X86)
+// bit count of each 32 bits, by the nibble lookup table of PSHUFB
+MEV_TARGET_SSSE3 inline __m128i popcount32(__m128i v) {
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+    __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    return _mm_madd_epi16(_mm_maddubs_epi16(_mm_add_epi8(lo, hi), _mm_set1_epi8(1)), _mm_set1_epi16(1));
+}
+
+// Hamming distance of 4 pixels in 32 bits
+MEV_TARGET_SSSE3 inline __m128i hamming4(const uint32_t* l, const uint32_t* r) {
+    return popcount32(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(l)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(r))));
+}
+
+MEV_TARGET_SSSE3 inline __m128i hamming4(const uint64_t* l, const uint64_t* r) {
+    __m128i a = popcount32(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(l)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(r))));
+    __m128i b = popcount32(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(l + 2)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + 2))));
+    // add the counts of low and high 32 bits
+    return _mm_hadd_epi32(a, b);
+}
+
+// Hamming cost of 8 pixels per iteration with SSSE3, return the first x which is not processed
+template <typename T>
+MEV_TARGET_SSSE3 int hammingRowSse(const T* left, const T* right, int x0, int width, uint16_t* out) {
+    int x = x0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i a = hamming4(left + x, right + x);
+        __m128i b = hamming4(left + x + 4, right + x + 4);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packs_epi32(a, b));
+    }
+    return x;
+}
+
+MEV_TARGET_AVX2 inline __m256i popcount32(__m256i v) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,  //
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_add_epi8(lo, hi), _mm256_set1_epi8(1)),
+                             _mm256_set1_epi16(1));
+}
+
+// Hamming distance of 8 pixels in 32 bits
+MEV_TARGET_AVX2 inline __m256i hamming8(const uint32_t* l, const uint32_t* r) {
+    return popcount32(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(l)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r))));
+}
+
+MEV_TARGET_AVX2 inline __m256i hamming8(const uint64_t* l, const uint64_t* r) {
+    __m256i a = popcount32(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(l)),
+                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r))));
+    __m256i b = popcount32(_mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(l + 4)),
+                                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + 4))));
+    // the horizontal add is in 128 bits lanes, pixels (0, 1, 4, 5 | 2, 3, 6, 7) are reordered to 0-7
+    return _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), 0xD8);
+}
+
+// Hamming cost of 16 pixels per iteration with AVX2, return the first x which is not processed
+template <typename T>
+MEV_TARGET_AVX2 int hammingRowAvx2(const T* left, const T* right, int x0, int width, uint16_t* out) {
+    int x = x0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i a = hamming8(left + x, right + x);
+        __m256i b = hamming8(left + x + 8, right + x + 8);
+        // the pack is in 128 bits lanes too
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), packed);
+    }
+    return x;
+}
+
+// add or subtract row of 16 bits with SSE2 or AVX2, return the first x which is not processed
+MEV_TARGET_AVX2 int accumulateRowAvx2(const uint16_t* row, int width, bool add, uint16_t* sum) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + x));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        a = add ? _mm256_add_epi16(a, b) : _mm256_sub_epi16(a, b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + x), a);
+    }
+    return x;
+}
+
+inline int accumulateRowSse(const uint16_t* row, int width, bool add, uint16_t* sum) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        a = add ? _mm_add_epi16(a, b) : _mm_sub_epi16(a, b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + x), a);
+    }
+    return x;
+}
+
+// horizontal box sum of padded row, out[x] = sum(padded[x, x + window)), return the first x which is not processed
+MEV_TARGET_AVX2 int boxRowAvx2(const uint16_t* padded, int width, int window, uint16_t* out) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int k = 0; k < window; ++k) {
+            sum = _mm256_add_epi16(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(padded + x + k)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), sum);
+    }
+    return x;
+}
+
+inline int boxRowSse(const uint16_t* padded, int width, int window, uint16_t* out) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i sum = _mm_setzero_si128();
+        for (int k = 0; k < window; ++k) {
+            sum = _mm_add_epi16(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(padded + x + k)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), sum);
+    }
+    return x;
+}
+#endif
+
+template <typename T>
+void hammingVolume(const Mat& left, const Mat& right, int maxDisparity, int bits, Mat& cost, SimdLevel level) {
+    const int width = left.cols;
+    cost.create(left.rows * maxDisparity, width, CV_16UC1);
+    for (int y = 0; y < left.rows; ++y) {
+        const T* l = left.ptr<T>(y);
+        const T* r = right.ptr<T>(y);
+        for (int d = 0; d < maxDisparity; ++d) {
+            uint16_t* out = cost.ptr<uint16_t>(y * maxDisparity + d);
+            int x0 = min(d, width);
+            std::fill(out, out + x0, static_cast<uint16_t>(bits));
+            // compare left(x) with right(x - d), so the right row is offset by -d
+            int x = x0;
+#if defined(MEV_SIMD_X86)
+            if (level == SimdLevel::AVX2) {
+                x = hammingRowAvx2(l, r - d, x0, width, out);
+            } else if (level == SimdLevel::SSE) {
+                x = hammingRowSse(l, r - d, x0, width, out);
+            }
+#else
+            (void)level;
+#endif
+            hammingRowScalar(l, r - d, x, width, out);
+        }
+    }
+}
+
+}  // namespace
+
+string simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SSE:
+            return "sse";
+        case SimdLevel::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+SimdLevel bestSimdLevel() {
+#if defined(MEV_SIMD_X86)
+    static const SimdLevel level = __builtin_cpu_supports("avx2")
+                                       ? SimdLevel::AVX2
+                                       : (__builtin_cpu_supports("ssse3") ? SimdLevel::SSE : SimdLevel::Scalar);
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+int censusBits(CensusWindow window) { return window == CensusWindow::W5x5 ? 24 : 62; }
+
+void censusTransform(const Mat& gray, CensusWindow window, Mat& census, SimdLevel level) {
+    CHECK_EQ(gray.type(), CV_8UC1) << "census transform needs 8 bits gray image";
+    CHECK(census.data != gray.data) << "census transform couldn't be in place";
+    level = min(level, bestSimdLevel());
+    if (window == CensusWindow::W5x5) {
+        censusImage<5, 5, uint32_t>(gray, census, CV_32SC1, level);
+    } else {
+        censusImage<7, 9, uint64_t>(gray, census, CV_64FC1, level);
+    }
+}
+
+void hammingCost(const Mat& left, const Mat& right, int maxDisparity, Mat& cost, SimdLevel level) {
+    CHECK(left.size() == right.size() && left.type() == right.type()) << "left and right census are different";
+    CHECK(left.type() == CV_32SC1 || left.type() == CV_64FC1) << "invalid census type";
+    CHECK_GT(maxDisparity, 0) << "disparity number should be greater than 0";
+    level = min(level, bestSimdLevel());
+    if (left.type() == CV_32SC1) {
+        hammingVolume<uint32_t>(left, right, maxDisparity, censusBits(CensusWindow::W5x5), cost, level);
+    } else {
+        hammingVolume<uint64_t>(left, right, maxDisparity, censusBits(CensusWindow::W7x9), cost, level);
+    }
+}
+
+void aggregateCost(const Mat& cost, int maxDisparity, int window, Mat& aggregated, SimdLevel level) {
+    CHECK_EQ(cost.type(), CV_16UC1) << "invalid cost volume type";
+    CHECK(maxDisparity > 0 && cost.rows % maxDisparity == 0) << "invalid disparity number of cost volume";
+    // the max sum of 7x9 census is 62 * 31 * 31, which fits in 16 bits
+    CHECK(window > 0 && window % 2 == 1 && window <= 31) << "window should be odd and not greater than 31";
+    CHECK(aggregated.data != cost.data) << "cost aggregation couldn't be in place";
+    level = min(level, bestSimdLevel());
+    const int width = cost.cols;
+    const int height = cost.rows / maxDisparity;
+    const int radius = window / 2;
+    aggregated.create(cost.size(), CV_16UC1);
+
+    // column sums of each disparity, padded by radius zeros at both sides for horizontal box sum
+    const int stride = width + 2 * radius;
+    vector<uint16_t> columns(static_cast<size_t>(stride) * maxDisparity, 0);
+    auto accumulate = [&](int y, bool add) {
+        for (int d = 0; d < maxDisparity; ++d) {
+            const uint16_t* row = cost.ptr<uint16_t>(y * maxDisparity + d);
+            uint16_t* sum = columns.data() + d * stride + radius;
+            int x{0};
+#if defined(MEV_SIMD_X86)
+            if (level == SimdLevel::AVX2) {
+                x = accumulateRowAvx2(row, width, add, sum);
+            } else if (level == SimdLevel::SSE) {
+                x = accumulateRowSse(row, width, add, sum);
+            }
+#endif
+            for (; x < width; ++x) {
+                sum[x] = static_cast<uint16_t>(add ? sum[x] + row[x] : sum[x] - row[x]);
+            }
+        }
+    };
+
+    for (int y = 0; y < radius && y < height; ++y) {
+        accumulate(y, true);
+    }
+    for (int y = 0; y < height; ++y) {
+        // slide the window of rows [y - radius, y + radius]
+        if (y + radius < height) {
+            accumulate(y + radius, true);
+        }
+        if (y - radius - 1 >= 0) {
+            accumulate(y - radius - 1, false);
+        }
+        for (int d = 0; d < maxDisparity; ++d) {
+            const uint16_t* padded = columns.data() + d * stride;
+            uint16_t* out = aggregated.ptr<uint16_t>(y * maxDisparity + d);
+            int x{0};
+#if defined(MEV_SIMD_X86)
+            if (level == SimdLevel::AVX2) {
+                x = boxRowAvx2(padded, width, window, out);
+            } else if (level == SimdLevel::SSE) {
+                x = boxRowSse(padded, width, window, out);
+            }
+#endif
+            for (; x < width; ++x) {
+                uint32_t sum{0};
+                for (int k = 0; k < window; ++k) {
+                    sum += padded[x + k];
+                }
+                out[x] = static_cast<uint16_t>(sum);
+            }
+        }
+    }
+}
+
+}  // namespace mev
@@ -0,0 +1,68 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace mev {
+
+// window of census transform
+enum class CensusWindow {
+    W5x5,  // 5x5 window, 24 bits census in uint32, stored as CV_32SC1
+    W7x9,  // 7 rows x 9 columns window, 62 bits census in uint64, stored as CV_64FC1
+};
+
+// SIMD instruction set of stereo kernels
+enum class SimdLevel {
+    Scalar,  // plain C++
+    SSE,     // SSE2 for census, SSSE3 for Hamming cost
+    AVX2,    // AVX2
+};
+
+// name of SIMD level, "scalar", "sse" or "avx2"
+std::string simdLevelName(SimdLevel level);
+
+// the best SIMD level supported by both compiler and CPU, which is detected at runtime
+SimdLevel bestSimdLevel();
+
+// bit number of census window, 24 for 5x5 and 62 for 7x9, which is also the max Hamming cost
+int censusBits(CensusWindow window);
+
+/**
+ * @brief Census transform of 8 bits gray image. Each neighbor in window is compared with the center pixel, and the bit
+ * is set if it's less than center. The pixels within half window of border are 0.
+ *
+ * @param gray      Rectified gray image, CV_8UC1
+ * @param window    Census window
+ * @param census    Output census, CV_32SC1 for 5x5 and CV_64FC1(as 64 bits storage) for 7x9
+ * @param level     SIMD level, it's limited to bestSimdLevel()
+ */
+void censusTransform(const cv::Mat& gray, CensusWindow window, cv::Mat& census,
+                     SimdLevel level = bestSimdLevel());
+
+/**
+ * @brief Hamming cost volume of left and right census, cost(y, x, d) = popcount(left(y, x) ^ right(y, x - d)).
+ *
+ * The cost volume is CV_16UC1 of (height * maxDisparity) rows and width columns, the costs of row y and disparity d
+ * are stored in row (y * maxDisparity + d), so each row is contiguous in x. The cost of x < d is the bit number.
+ *
+ * @param left          Census of left image
+ * @param right         Census of right image, with the same size and type of left census
+ * @param maxDisparity  Disparity number, the disparities are [0, maxDisparity)
+ * @param cost          Output cost volume
+ * @param level         SIMD level, it's limited to bestSimdLevel()
+ */
+void hammingCost(const cv::Mat& left, const cv::Mat& right, int maxDisparity, cv::Mat& cost,
+                 SimdLevel level = bestSimdLevel());
+
+/**
+ * @brief Aggregate cost volume by box sum of window x window pixels for each disparity, the pixels out of image are 0.
+ *
+ * @param cost          Cost volume of hammingCost()
+ * @param maxDisparity  Disparity number of cost volume
+ * @param window        Window size, odd number
+ * @param aggregated    Output aggregated cost volume, CV_16UC1 with the same layout as cost volume
+ * @param level         SIMD level, it's limited to bestSimdLevel()
+ */
+void aggregateCost(const cv::Mat& cost, int maxDisparity, int window, cv::Mat& aggregated,
+                   SimdLevel level = bestSimdLevel());
+
+}  // namespace mev
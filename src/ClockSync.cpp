@@ -0,0 +1,180 @@
+#include "ClockSync.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+namespace mev {
+
+int64_t hostNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// median of data, the data will be reordered
+static double median(vector<double>& data) {
+    auto mid = data.begin() + data.size() / 2;
+    nth_element(data.begin(), mid, data.end());
+    return *mid;
+}
+
+ClockSync::ClockSync(const ClockSyncOptions& options) : options_(options) {
+    CHECK_GE(options_.minSamples, 2) << "min sample number should be at least 2";
+    CHECK_GE(options_.windowSize, options_.minSamples) << "window size should not be less than min sample number";
+}
+
+bool ClockSync::update(int64_t device, int64_t host) {
+    lock_guard<mutex> lock(mutex_);
+
+    // outlier rejection with current model
+    if (valid_) {
+        double residual = static_cast<double>(host - model_.toHost(device));
+        double threshold =
+            max(options_.outlierThreshold * residualStd_, static_cast<double>(options_.minOutlierResidual));
+        if (abs(residual) > threshold) {
+            ++rejectedNum_;
+            // too many consecutive outliers, the device clock may be reset
+            if (rejectedNum_ > options_.windowSize / 2) {
+                LOG(WARNING) << fmt::format(
+                    "too many outliers in clock synchronization, reset model, residual = {:.3f} ms", residual * 1.0E-6);
+                samples_.clear();
+                valid_ = false;
+                rejectedNum_ = 0;
+            }
+            return false;
+        }
+    }
+    rejectedNum_ = 0;
+
+    samples_.emplace_back(device, host);
+    while (samples_.size() > options_.windowSize) {
+        samples_.pop_front();
+    }
+    if (samples_.size() >= options_.minSamples) {
+        fit();
+    }
+    return true;
+}
+
+int64_t ClockSync::toHost(int64_t device) const {
+    lock_guard<mutex> lock(mutex_);
+    if (valid_) {
+        return model_.toHost(device);
+    }
+    if (!samples_.empty()) {
+        return device + (samples_.back().second - samples_.back().first);
+    }
+    return device;
+}
+
+bool ClockSync::isValid() const {
+    lock_guard<mutex> lock(mutex_);
+    return valid_;
+}
+
+ClockModel ClockSync::model() const {
+    lock_guard<mutex> lock(mutex_);
+    return model_;
+}
+
+double ClockSync::residualStd() const {
+    lock_guard<mutex> lock(mutex_);
+    return residualStd_;
+}
+
+void ClockSync::reset() {
+    lock_guard<mutex> lock(mutex_);
+    samples_.clear();
+    valid_ = false;
+    residualStd_ = 0;
+    rejectedNum_ = 0;
+}
+
+void ClockSync::fit() {
+    // use the first sample as reference, and fit y = a + b * x, x = device - device0(s), y = host - host0 - x(ns)
+    const int64_t device0 = samples_.front().first;
+    const int64_t host0 = samples_.front().second;
+    const size_t n = samples_.size();
+    vector<double> xs(n), ys(n);
+    for (size_t i = 0; i < n; ++i) {
+        int64_t dx = samples_[i].first - device0;
+        xs[i] = dx * 1.0E-9;
+        ys[i] = static_cast<double>(samples_[i].second - host0 - dx);
+    }
+
+    // least square fitting with inliers
+    auto lineFit = [&](const vector<bool>& inliers, double& a, double& b) {
+        double sx{0}, sy{0}, sxx{0}, sxy{0};
+        size_t m{0};
+        for (size_t i = 0; i < n; ++i) {
+            if (inliers[i]) {
+                sx += xs[i];
+                sy += ys[i];
+                sxx += xs[i] * xs[i];
+                sxy += xs[i] * ys[i];
+                ++m;
+            }
+        }
+        double det = m * sxx - sx * sx;
+        if (m < 2 || abs(det) < 1.0E-12) {
+            b = 0;
+            a = m > 0 ? sy / m : 0;
+        } else {
+            b = (m * sxy - sx * sy) / det;
+            a = (sy - b * sx) / m;
+        }
+    };
+
+    // first fitting with all samples
+    vector<bool> inliers(n, true);
+    double a{0}, b{0};
+    lineFit(inliers, a, b);
+
+    // reject outliers by median absolute deviation, and fit again
+    vector<double> residuals(n);
+    for (size_t i = 0; i < n; ++i) {
+        residuals[i] = ys[i] - (a + b * xs[i]);
+    }
+    vector<double> temp = residuals;
+    double med = median(temp);
+    for (auto& v : temp) {
+        v = abs(v - med);
+    }
+    double sigma = 1.4826 * median(temp);
+    double threshold = max(options_.outlierThreshold * sigma, static_cast<double>(options_.minOutlierResidual));
+    size_t inlierNum{0};
+    for (size_t i = 0; i < n; ++i) {
+        inliers[i] = abs(residuals[i] - med) <= threshold;
+        inlierNum += inliers[i];
+    }
+    if (inlierNum < options_.minSamples) {
+        return;
+    }
+    lineFit(inliers, a, b);
+
+    // residual standard deviation and lower envelope
+    double sum{0};
+    temp.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (inliers[i]) {
+            double r = ys[i] - (a + b * xs[i]);
+            sum += r * r;
+            temp.emplace_back(r);
+        }
+    }
+    residualStd_ = sqrt(sum / inlierNum);
+    auto quantile = temp.begin() + static_cast<size_t>(options_.envelopeQuantile * (temp.size() - 1));
+    nth_element(temp.begin(), quantile, temp.end());
+    a += *quantile;
+
+    // b is in ns/s, so the drift is b * 1E-9
+    model_.deviceRef = device0;
+    model_.hostRef = host0 + static_cast<int64_t>(a);
+    model_.drift = b * 1.0E-9;
+    valid_ = true;
+}
+
+}  // namespace mev
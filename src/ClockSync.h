@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace mev {
+
+// get host monotonic time, ns
+std::int64_t hostNow();
+
+// clock synchronization options
+struct ClockSyncOptions {
+    std::size_t windowSize{300};          // max sample number in sliding window
+    std::size_t minSamples{10};           // min sample number to fit model
+    double outlierThreshold{3.0};         // outlier threshold, multiple of robust sigma
+    std::int64_t minOutlierResidual{200000};  // min residual to be an outlier, ns
+    double envelopeQuantile{0.05};            // quantile of residual as the lower envelope of receive time
+};
+
+// linear clock model, host = hostRef + (device - deviceRef) * (1 + drift)
+struct ClockModel {
+    std::int64_t deviceRef{0};  // reference device time, ns
+    std::int64_t hostRef{0};    // host time at reference device time, ns
+    double drift{0};            // clock drift of host relative to device, host/device - 1
+
+    // convert device time to host time
+    inline std::int64_t toHost(std::int64_t device) const {
+        double dt = static_cast<double>(device - deviceRef);
+        return hostRef + static_cast<std::int64_t>(dt + dt * drift);
+    }
+};
+
+/**
+ * @brief Host/device clock synchronization. The device timestamp is paired with the host receive time, and an online
+ * linear model(offset and drift) is fitted in a sliding window, the late arrivals are rejected as outliers by the
+ * residual to median(MAD). The transport and scheduling delay is always positive, so the offset is moved to the lower
+ * envelope(a low quantile of residual), then the host time of a sample is the host receive time without the jitter, but
+ * it still contains the min transport latency.
+ */
+class ClockSync {
+  public:
+    explicit ClockSync(const ClockSyncOptions& options = ClockSyncOptions());
+
+  public:
+    /**
+     * @brief Add a sample pair and update the model
+     *
+     * @param device    Device timestamp, ns
+     * @param host      Host receive time, ns
+     * @return False if the sample is rejected as outlier
+     */
+    bool update(std::int64_t device, std::int64_t host);
+
+    // convert device time to host time, ns. Before the model is valid, the offset of the last sample is used
+    std::int64_t toHost(std::int64_t device) const;
+
+    // whether the model is fitted
+    bool isValid() const;
+
+    // current model
+    ClockModel model() const;
+
+    // standard deviation of inlier residual, ns
+    double residualStd() const;
+
+    // reset all samples
+    void reset();
+
+  private:
+    // fit model with samples in window
+    void fit();
+
+  private:
+    ClockSyncOptions options_;
+    mutable std::mutex mutex_;
+    std::deque<std::pair<std::int64_t, std::int64_t>> samples_;  // samples, (device, host)
+    ClockModel model_;                                           // current model
+    bool valid_{false};                                          // whether the model is fitted
+    double residualStd_{0};                                      // standard deviation of inlier residual, ns
+    std::size_t rejectedNum_{0};                                 // consecutive rejected sample number
+};
+
+}  // namespace mev
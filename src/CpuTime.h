@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace mev {
+
+// CPU time of current thread, ns
+inline std::int64_t threadCpuTime() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// add the CPU time of current thread in scope to counter
+class ScopedCpuTime {
+  public:
+    explicit ScopedCpuTime(std::atomic<std::int64_t>& counter) : counter_(counter), start_(threadCpuTime()) {}
+    ~ScopedCpuTime() { counter_ += threadCpuTime() - start_; }
+
+    ScopedCpuTime(const ScopedCpuTime&) = delete;
+    ScopedCpuTime& operator=(const ScopedCpuTime&) = delete;
+
+  private:
+    std::atomic<std::int64_t>& counter_;
+    std::int64_t start_;
+};
+
+}  // namespace mev
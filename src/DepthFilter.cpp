@@ -0,0 +1,321 @@
+#include "DepthFilter.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <cmath>
+#include <map>
+#include "ClockSync.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// names of hole filling
+const map<HoleFill, string> kHoleFillNames = {
+    {HoleFill::None, "none"},
+    {HoleFill::Farthest, "farthest"},
+    {HoleFill::Nearest, "nearest"},
+};
+
+// operations of one 16 bits value, the mask is 0xFFFF or 0. It's the scalar fallback and the tail of SIMD rows, so the
+// results are the same as SIMD
+struct Scalar16 {
+    using V = uint16_t;
+    static constexpr int kLanes = 1;
+    static inline V load(const uint16_t* p) { return *p; }
+    static inline void store(uint16_t* p, V v) { *p = v; }
+    static inline V dup(uint16_t v) { return v; }
+    static inline V add(V a, V b) { return static_cast<V>(a + b); }
+    static inline V sub(V a, V b) { return static_cast<V>(a - b); }
+    static inline V addSat(V a, V b) { return static_cast<V>(min(a + b, 0xFFFF)); }
+    static inline V subSat(V a, V b) { return static_cast<V>(a > b ? a - b : 0); }
+    static inline V mulHigh(V a, V b) { return static_cast<V>((static_cast<uint32_t>(a) * b) >> 16); }
+    static inline V equal(V a, V b) { return a == b ? 0xFFFF : 0; }
+    static inline V bitAnd(V a, V b) { return a & b; }
+    static inline V bitOr(V a, V b) { return a | b; }
+    static inline V andNot(V a, V b) { return static_cast<V>(~a & b); }
+    static inline V select(V mask, V a, V b) { return static_cast<V>((mask & a) | (~mask & b)); }
+};
+
+#if defined(__SSE2__)
+struct Simd16 {
+    using V = __m128i;
+    static constexpr int kLanes = 8;
+    static inline V load(const uint16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static inline void store(uint16_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static inline V dup(uint16_t v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static inline V add(V a, V b) { return _mm_add_epi16(a, b); }
+    static inline V sub(V a, V b) { return _mm_sub_epi16(a, b); }
+    static inline V addSat(V a, V b) { return _mm_adds_epu16(a, b); }
+    static inline V subSat(V a, V b) { return _mm_subs_epu16(a, b); }
+    static inline V mulHigh(V a, V b) { return _mm_mulhi_epu16(a, b); }
+    static inline V equal(V a, V b) { return _mm_cmpeq_epi16(a, b); }
+    static inline V bitAnd(V a, V b) { return _mm_and_si128(a, b); }
+    static inline V bitOr(V a, V b) { return _mm_or_si128(a, b); }
+    static inline V andNot(V a, V b) { return _mm_andnot_si128(a, b); }
+    static inline V select(V mask, V a, V b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+};
+#elif defined(__aarch64__)
+struct Simd16 {
+    using V = uint16x8_t;
+    static constexpr int kLanes = 8;
+    static inline V load(const uint16_t* p) { return vld1q_u16(p); }
+    static inline void store(uint16_t* p, V v) { vst1q_u16(p, v); }
+    static inline V dup(uint16_t v) { return vdupq_n_u16(v); }
+    static inline V add(V a, V b) { return vaddq_u16(a, b); }
+    static inline V sub(V a, V b) { return vsubq_u16(a, b); }
+    static inline V addSat(V a, V b) { return vqaddq_u16(a, b); }
+    static inline V subSat(V a, V b) { return vqsubq_u16(a, b); }
+    static inline V mulHigh(V a, V b) {
+        uint32x4_t lo = vmull_u16(vget_low_u16(a), vget_low_u16(b));
+        uint32x4_t hi = vmull_u16(vget_high_u16(a), vget_high_u16(b));
+        return vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+    }
+    static inline V equal(V a, V b) { return vceqq_u16(a, b); }
+    static inline V bitAnd(V a, V b) { return vandq_u16(a, b); }
+    static inline V bitOr(V a, V b) { return vorrq_u16(a, b); }
+    static inline V andNot(V a, V b) { return vbicq_u16(b, a); }
+    static inline V select(V mask, V a, V b) { return vbslq_u16(mask, a, b); }
+};
+#else
+using Simd16 = Scalar16;
+#endif
+
+// mask of a < b
+template <typename Ops>
+inline typename Ops::V less(typename Ops::V a, typename Ops::V b) {
+    return Ops::andNot(Ops::equal(Ops::subSat(b, a), Ops::dup(0)), Ops::dup(0xFFFF));
+}
+
+// mask of v != 0
+template <typename Ops>
+inline typename Ops::V nonzero(typename Ops::V v) {
+    return Ops::andNot(Ops::equal(v, Ops::dup(0)), Ops::dup(0xFFFF));
+}
+
+// |a - b|
+template <typename Ops>
+inline typename Ops::V absDiff(typename Ops::V a, typename Ops::V b) {
+    return Ops::bitOr(Ops::subSat(a, b), Ops::subSat(b, a));
+}
+
+// fixed point weights of current and other value, which sum to 65536
+struct Weights {
+    uint16_t current{0};
+    uint16_t other{0};
+};
+
+Weights toWeights(double alpha) {
+    Weights w;
+    w.current = static_cast<uint16_t>(min(max(lround(alpha * 65536), 1L), 65535L));
+    w.other = static_cast<uint16_t>(65536 - w.current);
+    return w;
+}
+
+// run kernel of x on row with SIMD, then the tail with scalar
+template <template <typename> class Kernel, typename... Args>
+inline void runRow(int width, Args&&... args) {
+    int x{0};
+    for (; x + Simd16::kLanes <= width; x += Simd16::kLanes) {
+        Kernel<Simd16>::run(x, args...);
+    }
+    for (; x < width; ++x) {
+        Kernel<Scalar16>::run(x, args...);
+    }
+}
+
+// set the depth out of [minDepth, maxDepth] to 0
+template <typename Ops>
+struct RangeKernel {
+    static inline void run(int x, uint16_t* row, uint16_t minDepth, uint16_t maxDepth) {
+        auto v = Ops::load(row + x);
+        auto out = less<Ops>(v, Ops::dup(minDepth));
+        out = Ops::bitOr(out, less<Ops>(Ops::dup(maxDepth), v));
+        Ops::store(row + x, Ops::andNot(out, v));
+    }
+};
+
+// smooth the current row with the filtered previous row if both are valid and the step is less than delta
+template <typename Ops>
+struct SmoothKernel {
+    static inline void run(int x, const uint16_t* prev, uint16_t* row, Weights w, uint16_t delta) {
+        auto p = Ops::load(prev + x);
+        auto c = Ops::load(row + x);
+        auto valid = Ops::bitAnd(nonzero<Ops>(p), nonzero<Ops>(c));
+        auto mask = Ops::bitAnd(valid, less<Ops>(absDiff<Ops>(c, p), Ops::dup(delta)));
+        auto smoothed = Ops::add(Ops::mulHigh(c, Ops::dup(w.current)), Ops::mulHigh(p, Ops::dup(w.other)));
+        Ops::store(row + x, Ops::select(mask, smoothed, c));
+    }
+};
+
+// temporal filter of row, the history and missing frame number are updated
+template <typename Ops>
+struct TemporalKernel {
+    static inline void run(int x, uint16_t* row, uint16_t* history, uint16_t* missing, Weights w, uint16_t delta,
+                           uint16_t persistence) {
+        auto c = Ops::load(row + x);
+        auto h = Ops::load(history + x);
+        auto m = Ops::load(missing + x);
+        auto valid = nonzero<Ops>(c);
+        auto hasHistory = nonzero<Ops>(h);
+        // valid: smooth with history if the change is small, otherwise use current depth(moving or new)
+        auto close = Ops::bitAnd(hasHistory, less<Ops>(absDiff<Ops>(c, h), Ops::dup(delta)));
+        auto smoothed = Ops::add(Ops::mulHigh(c, Ops::dup(w.current)), Ops::mulHigh(h, Ops::dup(w.other)));
+        auto updated = Ops::select(close, smoothed, c);
+        // missing: keep the history for persistence frames
+        auto kept = Ops::bitAnd(h, less<Ops>(m, Ops::dup(persistence)));
+        auto out = Ops::select(valid, updated, kept);
+        Ops::store(row + x, out);
+        Ops::store(history + x, out);
+        Ops::store(missing + x, Ops::andNot(valid, Ops::addSat(m, Ops::dup(1))));
+    }
+};
+
+// fill the holes of row by the farthest or nearest valid neighbor of 4 neighbors. The source rows are padded by 1
+// pixel, so pixel x of dst is x + 1 of source rows
+template <typename Ops>
+struct HoleFillKernel {
+    static inline void run(int x, const uint16_t* up, const uint16_t* src, const uint16_t* down, uint16_t* dst,
+                           bool farthest) {
+        auto c = Ops::load(src + x + 1);
+        auto n0 = Ops::load(up + x + 1);
+        auto n1 = Ops::load(down + x + 1);
+        auto n2 = Ops::load(src + x);
+        auto n3 = Ops::load(src + x + 2);
+        typename Ops::V fill;
+        if (farthest) {
+            // max(a, b) = (a - b)+ + b, the holes are 0 so they are never the max
+            fill = Ops::add(Ops::subSat(n0, n1), n1);
+            fill = Ops::add(Ops::subSat(fill, n2), n2);
+            fill = Ops::add(Ops::subSat(fill, n3), n3);
+        } else {
+            // min(a, b) = a - (a - b)+ on value - 1, so the holes are 65535 and never the min, then add 1 back
+            const auto one = Ops::dup(1);
+            auto a = Ops::sub(n0, one);
+            auto b = Ops::sub(n1, one);
+            fill = Ops::sub(a, Ops::subSat(a, b));
+            b = Ops::sub(n2, one);
+            fill = Ops::sub(fill, Ops::subSat(fill, b));
+            b = Ops::sub(n3, one);
+            fill = Ops::sub(fill, Ops::subSat(fill, b));
+            fill = Ops::add(fill, one);
+        }
+        Ops::store(dst + x, Ops::select(nonzero<Ops>(c), c, fill));
+    }
+};
+
+}  // namespace
+
+bool parseHoleFill(const string& name, HoleFill* holeFill) {
+    for (auto& v : kHoleFillNames) {
+        if (boost::iequals(v.second, name)) {
+            *holeFill = v.first;
+            return true;
+        }
+    }
+    return false;
+}
+
+DepthFilter::DepthFilter(const DepthFilterOptions& options) : options_(options) {
+    CHECK(options_.minDepth >= 0 && options_.minDepth <= options_.maxDepth && options_.maxDepth <= 0xFFFF)
+        << "invalid depth range";
+    CHECK(options_.spatialAlpha > 0 && options_.spatialAlpha <= 1) << "spatial alpha should be in (0, 1]";
+    CHECK(options_.temporalAlpha > 0 && options_.temporalAlpha <= 1) << "temporal alpha should be in (0, 1]";
+}
+
+void DepthFilter::filter(Mat& depth) {
+    CHECK_EQ(depth.type(), CV_16UC1) << "depth should be 16 bits image";
+    ++statistics_.frames;
+    int64_t startTime = hostNow();
+    const auto minDepth = static_cast<uint16_t>(options_.minDepth);
+    const auto maxDepth = static_cast<uint16_t>(options_.maxDepth);
+    for (int y = 0; y < depth.rows; ++y) {
+        runRow<RangeKernel>(depth.cols, depth.ptr<uint16_t>(y), minDepth, maxDepth);
+    }
+    if (options_.spatial) {
+        spatialFilter(depth);
+    }
+    int64_t spatialTime = hostNow();
+    statistics_.spatialTime += spatialTime - startTime;
+
+    if (options_.temporal) {
+        temporalFilter(depth);
+    }
+    int64_t temporalTime = hostNow();
+    statistics_.temporalTime += temporalTime - spatialTime;
+
+    if (options_.holeFill != HoleFill::None) {
+        fillHoles(depth);
+    }
+    statistics_.holeFillTime += hostNow() - temporalTime;
+}
+
+void DepthFilter::reset() {
+    history_.release();
+    missing_.release();
+}
+
+void DepthFilter::spatialFilter(Mat& depth) {
+    const Weights w = toWeights(options_.spatialAlpha);
+    const auto delta = static_cast<uint16_t>(min(max(options_.spatialDelta, 0), 0xFFFF));
+    // recursive filter from top to bottom, then bottom to top, each row is smoothed with the filtered previous row
+    auto verticalPass = [&](Mat& image) {
+        for (int y = 1; y < image.rows; ++y) {
+            runRow<SmoothKernel>(image.cols, image.ptr<uint16_t>(y - 1), image.ptr<uint16_t>(y), w, delta);
+        }
+        for (int y = image.rows - 2; y >= 0; --y) {
+            runRow<SmoothKernel>(image.cols, image.ptr<uint16_t>(y + 1), image.ptr<uint16_t>(y), w, delta);
+        }
+    };
+    for (int i = 0; i < options_.spatialIterations; ++i) {
+        // the horizontal pass is the vertical pass of transposed image, which runs on contiguous rows with SIMD
+        transpose(depth, transposed_);
+        verticalPass(transposed_);
+        transpose(transposed_, depth);
+        verticalPass(depth);
+    }
+}
+
+void DepthFilter::temporalFilter(Mat& depth) {
+    if (history_.size() != depth.size()) {
+        history_.create(depth.size(), CV_16UC1);
+        missing_.create(depth.size(), CV_16UC1);
+        history_.setTo(Scalar::all(0));
+        missing_.setTo(Scalar::all(0));
+    }
+    const Weights w = toWeights(options_.temporalAlpha);
+    const auto delta = static_cast<uint16_t>(min(max(options_.temporalDelta, 0), 0xFFFF));
+    const auto persistence = static_cast<uint16_t>(min(max(options_.persistence, 0), 0xFFFF));
+    for (int y = 0; y < depth.rows; ++y) {
+        runRow<TemporalKernel>(depth.cols, depth.ptr<uint16_t>(y), history_.ptr<uint16_t>(y),
+                               missing_.ptr<uint16_t>(y), w, delta, persistence);
+    }
+}
+
+void DepthFilter::fillHoles(Mat& depth) {
+    // the copy is padded by 1 pixel of 0 at each side, so the kernel needs no border check. The padding is only
+    // cleared when it's allocated, the inner image is overwritten by each iteration
+    const bool farthest = options_.holeFill == HoleFill::Farthest;
+    if (copy_.rows != depth.rows + 2 || copy_.cols != depth.cols + 2) {
+        copy_.create(depth.rows + 2, depth.cols + 2, CV_16UC1);
+        copy_.setTo(Scalar::all(0));
+    }
+    Mat inner = copy_(Rect(1, 1, depth.cols, depth.rows));
+    for (int i = 0; i < options_.holeFillIterations; ++i) {
+        depth.copyTo(inner);
+        for (int y = 0; y < depth.rows; ++y) {
+            runRow<HoleFillKernel>(depth.cols, copy_.ptr<uint16_t>(y), copy_.ptr<uint16_t>(y + 1),
+                                   copy_.ptr<uint16_t>(y + 2), depth.ptr<uint16_t>(y), farthest);
+        }
+    }
+}
+
+}  // namespace mev
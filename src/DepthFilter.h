@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace mev {
+
+// how to fill the holes of depth
+enum class HoleFill {
+    None,      // keep the holes
+    Farthest,  // fill by the farthest valid neighbor, which is usually the background, so the objects don't grow
+    Nearest,   // fill by the nearest valid neighbor
+};
+
+// depth filter options, the depth is in mm and 0 is invalid
+struct DepthFilterOptions {
+    int minDepth{100};                      // min valid depth, mm
+    int maxDepth{20000};                    // max valid depth, mm
+    bool spatial{true};                     // whether to smooth by the edge-aware spatial filter
+    int spatialIterations{2};               // iterations of spatial filter, each has horizontal and vertical passes
+    double spatialAlpha{0.5};               // weight of the current pixel in spatial filter, (0, 1]
+    int spatialDelta{50};                   // max depth step to smooth, the larger steps are edges, mm
+    bool temporal{true};                    // whether to smooth by the temporal filter
+    double temporalAlpha{0.4};              // weight of the current frame in temporal filter, (0, 1]
+    int temporalDelta{100};                 // max depth change to smooth, the larger changes are motion, mm
+    int persistence{3};                     // max frame number to keep the last depth when the pixel is missing
+    HoleFill holeFill{HoleFill::Farthest};  // hole filling
+    int holeFillIterations{2};              // iterations of hole filling, each one fills the holes by 1 pixel more
+};
+
+// depth filter statistics
+struct DepthFilterStatistics {
+    std::uint64_t frames{0};       // filtered frame number
+    std::int64_t spatialTime{0};   // time of range check and spatial filter, ns
+    std::int64_t temporalTime{0};  // time of temporal filter, ns
+    std::int64_t holeFillTime{0};  // time of hole filling, ns
+};
+
+// parse hole filling name, "none", "farthest" or "nearest", case insensitive. Return false if unknown
+bool parseHoleFill(const std::string& name, HoleFill* holeFill);
+
+/**
+ * @brief Post processing of 16 bits depth stream, the depth is filtered in place by
+ *  1. range check, the depth out of [minDepth, maxDepth] is set to 0
+ *  2. edge-aware spatial filter, a recursive exponential filter in 4 directions, which only smooths the neighbors with
+ *     small depth step, so the object edges are kept
+ *  3. temporal exponential filter, the pixel is smoothed with its history if the change is small, and the last depth
+ *     is kept up to `persistence` frames if the pixel is missing, which removes the flicker
+ *  4. hole filling by the valid neighbors
+ *
+ * The filters run in rows with SIMD(SSE2 or NEON, scalar fallback) on 16 bits data with fixed point weights, the
+ * horizontal pass runs on the transposed image as the vertical pass. The history and work buffers are kept and reused,
+ * so nothing is allocated after the first frame. Not thread safe
+ */
+class DepthFilter {
+  public:
+    explicit DepthFilter(const DepthFilterOptions& options = DepthFilterOptions());
+
+    /**
+     * @brief Filter depth in place
+     *
+     * @param depth Depth image, CV_16UC1 in mm
+     */
+    void filter(cv::Mat& depth);
+
+    // clear the history of temporal filter, e.g., after the stream is restarted
+    void reset();
+
+    inline const DepthFilterOptions& options() const { return options_; }
+
+    inline const DepthFilterStatistics& statistics() const { return statistics_; }
+
+  private:
+    // spatial filter in place
+    void spatialFilter(cv::Mat& depth);
+
+    // temporal filter in place
+    void temporalFilter(cv::Mat& depth);
+
+    // hole filling in place
+    void fillHoles(cv::Mat& depth);
+
+  private:
+    DepthFilterOptions options_;
+    DepthFilterStatistics statistics_;
+    cv::Mat transposed_;  // transposed depth for horizontal pass of spatial filter
+    cv::Mat history_;     // last filtered depth of temporal filter
+    cv::Mat missing_;     // missing frame number of each pixel, CV_16UC1
+    cv::Mat copy_;        // copy of depth before each hole filling iteration
+};
+
+}  // namespace mev
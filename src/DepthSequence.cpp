@@ -0,0 +1,96 @@
+#include "DepthSequence.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <fstream>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+bool writeDepthCamera(const fs::path& folder, const DepthCamera& camera) {
+    fs::path path = folder / "camera.yaml";
+    ofstream file(path.string());
+    if (!file.is_open()) {
+        LOG(ERROR) << fmt::format("cannot create depth camera file \"{}\"", path.string());
+        return false;
+    }
+    file << fmt::format("fx: {}\n", camera.fx);
+    file << fmt::format("fy: {}\n", camera.fy);
+    file << fmt::format("cx: {}\n", camera.cx);
+    file << fmt::format("cy: {}\n", camera.cy);
+    file << fmt::format("depth_scale: {}\n", camera.depthScale);
+    return file.good();
+}
+
+bool readDepthCamera(const fs::path& folder, DepthCamera* camera) {
+    ifstream file((folder / "camera.yaml").string());
+    if (!file.is_open()) {
+        return false;
+    }
+    *camera = DepthCamera();
+    string line;
+    while (getline(file, line)) {
+        auto pos = line.find(':');
+        if (pos == string::npos) {
+            continue;
+        }
+        string key = line.substr(0, pos);
+        try {
+            double value = stod(line.substr(pos + 1));
+            if (key == "fx") {
+                camera->fx = value;
+            } else if (key == "fy") {
+                camera->fy = value;
+            } else if (key == "cx") {
+                camera->cx = value;
+            } else if (key == "cy") {
+                camera->cy = value;
+            } else if (key == "depth_scale") {
+                camera->depthScale = value;
+            }
+        } catch (const exception& e) {
+            LOG(ERROR) << fmt::format("invalid line in depth camera file: {}", line);
+            return false;
+        }
+    }
+    return camera->fx > 0 && camera->fy > 0 && camera->depthScale > 0;
+}
+
+bool writeDepthFrame(const fs::path& folder, const StreamImage& depth) {
+    fs::path path = folder / fmt::format("{}.png", depth.hostTimestamp);
+    if (!imwrite(path.string(), depth.image)) {
+        LOG(ERROR) << fmt::format("cannot write depth image \"{}\"", path.string());
+        return false;
+    }
+    return true;
+}
+
+vector<DepthFrameFile> findDepthFrames(const fs::path& folder) {
+    vector<DepthFrameFile> frames;
+    if (!fs::is_directory(folder)) {
+        return frames;
+    }
+    for (auto& entry : fs::directory_iterator(folder)) {
+        const fs::path& path = entry.path();
+        if (path.extension() != ".png") {
+            continue;
+        }
+        try {
+            DepthFrameFile frame;
+            frame.timestamp = stoll(path.stem().string());
+            frame.path = path;
+            frames.emplace_back(frame);
+        } catch (const exception& e) {
+            LOG(WARNING) << fmt::format("skip depth image without timestamp name \"{}\"", path.string());
+        }
+    }
+    sort(frames.begin(), frames.end(),
+         [](const DepthFrameFile& a, const DepthFrameFile& b) { return a.timestamp < b.timestamp; });
+    return frames;
+}
+
+}  // namespace mev
@@ -0,0 +1,33 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <vector>
+#include "FrameBundle.h"
+
+namespace mev {
+
+// depth sequence folder, which could be replayed without device
+//
+//  folder/
+//      camera.yaml         depth camera, fx, fy, cx, cy and depth scale
+//      <timestamp>.png     16 bits depth images, the file name is the host timestamp in ns
+
+// depth image file of depth sequence
+struct DepthFrameFile {
+    std::int64_t timestamp{0};     // host timestamp, ns
+    boost::filesystem::path path;  // image file
+};
+
+// write depth camera to "camera.yaml" of folder, return false if failed
+bool writeDepthCamera(const boost::filesystem::path& folder, const DepthCamera& camera);
+
+// read depth camera from "camera.yaml" of folder, return false if not found or invalid
+bool readDepthCamera(const boost::filesystem::path& folder, DepthCamera* camera);
+
+// write depth image to folder as "<host timestamp>.png", return false if failed
+bool writeDepthFrame(const boost::filesystem::path& folder, const StreamImage& depth);
+
+// find the depth images of folder, sorted by timestamp
+std::vector<DepthFrameFile> findDepthFrames(const boost::filesystem::path& folder);
+
+}  // namespace mev
@@ -0,0 +1,169 @@
+#include "Device.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <mynteyed/utils.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+using namespace mynteyed;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+namespace {
+
+// format camera intrinsics to YAML with indent
+string formatIntrinsics(const CameraIntrinsics& in, const string& indent) {
+    return fmt::format("{0}width: {1}\n{0}height: {2}\n{0}fx: {3}\n{0}fy: {4}\n{0}cx: {5}\n{0}cy: {6}\n"
+                       "{0}coeffs: [{7}, {8}, {9}, {10}, {11}]\n",
+                       indent, in.width, in.height, in.fx, in.fy, in.cx, in.cy, in.coeffs[0], in.coeffs[1],
+                       in.coeffs[2], in.coeffs[3], in.coeffs[4]);
+}
+
+// format intrinsics of recorded frames with the transform to YAML with indent, the distortion isn't changed by ROI and
+// binning since it's applied to normalized coordinates
+string formatIntrinsics(CameraIntrinsics in, const FrameTransform& transform, const string& indent) {
+    cv::Size size = transformSize(transform, cv::Size(in.width, in.height));
+    cv::Rect roi = transformRoi(transform, cv::Size(in.width, in.height));
+    in.width = static_cast<uint16_t>(size.width);
+    in.height = static_cast<uint16_t>(size.height);
+    transformIntrinsics(transform, &in.fx, &in.fy, &in.cx, &in.cy);
+    return formatIntrinsics(in, indent) +
+           fmt::format("{0}roi: [{1}, {2}, {3}, {4}]\n{0}binning: {5}\n{0}decimation: {6}\n", indent, roi.x, roi.y,
+                       roi.width, roi.height, transform.binning, transform.decimation);
+}
+
+// format extrinsics to YAML with indent, the rotation is row major
+string formatExtrinsics(const Extrinsics& ex, const string& indent) {
+    const auto& r = ex.rotation;
+    return fmt::format("{0}rotation: [{1}, {2}, {3}, {4}, {5}, {6}, {7}, {8}, {9}]\n"
+                       "{0}translation: [{10}, {11}, {12}]\n",
+                       indent, r[0][0], r[0][1], r[0][2], r[1][0], r[1][1], r[1][2], r[2][0], r[2][1], r[2][2],
+                       ex.translation[0], ex.translation[1], ex.translation[2]);
+}
+
+}  // namespace
+
+constexpr double kDeg2Rad = M_PI / 180.;
+constexpr double kG{9.81};
+
+ImuRecord toImuRecord(const ImuData& imu) {
+    ImuRecord record;
+    record.timestamp = deviceToNs(imu.timestamp);
+    for (int i = 0; i < 3; ++i) {
+        record.acc[i] = imu.accel[i] * kG;
+        record.gyro[i] = imu.gyro[i] * kDeg2Rad;
+    }
+    return record;
+}
+
+bool toStreamImage(const StreamData& data, StreamImage* image) {
+    if (!data.img || !data.img_info) {
+        return false;
+    }
+    image->frameId = data.img_info->frame_id;
+    image->timestamp = deviceToNs(data.img_info->timestamp);
+    switch (data.img->format()) {
+        case ImageFormat::COLOR_YUYV:
+        case ImageFormat::COLOR_RGB:
+        case ImageFormat::COLOR_MJPG:
+            image->image = data.img->To(ImageFormat::COLOR_BGR)->ToMat();
+            break;
+        default:
+            image->image = data.img->ToMat();
+            break;
+    }
+    return true;
+}
+
+void toRawFrame(Image& image, RawFrame* frame) {
+    // the data is copied since the device buffer is reused, which is much cheaper than the conversion
+    switch (image.format()) {
+        case ImageFormat::COLOR_YUYV:
+            frame->format = RawFormat::YUYV;
+            frame->image = cv::Mat(image.height(), image.width(), CV_8UC2, image.data()).clone();
+            break;
+        case ImageFormat::COLOR_MJPG:
+            frame->format = RawFormat::MJPG;
+            frame->image = cv::Mat(1, static_cast<int>(image.valid_size()), CV_8UC1, image.data()).clone();
+            break;
+        default:
+            frame->format = RawFormat::BGR;
+            frame->image = image.To(ImageFormat::COLOR_BGR)->ToMat();
+            break;
+    }
+}
+
+bool selectDevice(const Camera& cam, const DeviceOptions& options, DeviceInfo* info) {
+    // select by index directly, enumerating devices takes time
+    if (options.serial.empty() && options.index >= 0) {
+        *info = DeviceInfo();
+        info->index = options.index;
+        return true;
+    }
+    if (options.serial.empty()) {
+        return util::select(cam, info);
+    }
+    for (auto& device : cam.GetDeviceInfos()) {
+        if (device.sn == options.serial) {
+            *info = device;
+            return true;
+        }
+    }
+    LOG(WARNING) << fmt::format("cannot find device with serial number \"{}\"", options.serial);
+    return false;
+}
+
+bool openDevice(Camera& cam, OpenParams params, const DeviceOptions& options, DeviceInfo* info) {
+    // after the first selection by prompt, retry with the selected index
+    DeviceOptions selection = options;
+    double delay = options.retryDelay;
+    for (int i = 0; i <= options.retries; ++i) {
+        if (i > 0) {
+            LOG(WARNING) << fmt::format("open device failed, retry {}/{} after {:.2f} s", i, options.retries, delay);
+            this_thread::sleep_for(chrono::duration<double>(delay));
+            delay = min(delay * 2, options.maxRetryDelay);
+        }
+        if (!selectDevice(cam, selection, info)) {
+            continue;
+        }
+        if (selection.serial.empty()) {
+            selection.index = info->index;
+        }
+        if (i == 0 && options.printStreamInfo) {
+            util::print_stream_infos(cam, info->index);
+        }
+        params.dev_index = info->index;
+        cam.Open(params);
+        if (cam.IsOpened()) {
+            LOG(INFO) << fmt::format("open device success, index = {}, name = {}, serial = {}", info->index, info->name,
+                                     info->sn);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool writeCalibration(const fs::path& file, Camera& cam, StreamMode mode,
+                      const map<string, FrameTransform>& transforms) {
+    ofstream calibFile(file.string());
+    if (!calibFile.is_open()) {
+        LOG(ERROR) << fmt::format("cannot create calibration file \"{}\"", file.string());
+        return false;
+    }
+    auto intrinsics = cam.GetStreamIntrinsics(mode);
+    auto transform = [&](const string& stream) {
+        auto it = transforms.find(stream);
+        return it == transforms.end() ? FrameTransform() : it->second;
+    };
+    calibFile << "left:\n" << formatIntrinsics(intrinsics.left, transform("left"), "  ");
+    calibFile << "right:\n" << formatIntrinsics(intrinsics.right, transform("right"), "  ");
+    calibFile << "left_to_right:\n" << formatExtrinsics(cam.GetStreamExtrinsics(mode), "  ");
+    calibFile << "left_imu:\n" << formatExtrinsics(cam.GetMotionExtrinsics(), "  ");
+    return static_cast<bool>(calibFile);
+}
+
+}  // namespace mev
@@ -0,0 +1,89 @@
+#pragma once
+#include <mynteyed/camera.h>
+#include <boost/filesystem.hpp>
+#include <map>
+#include <string>
+#include "FrameBundle.h"
+#include "FrameTransform.h"
+#include "RecordPipeline.h"
+#include "Types.h"
+
+namespace mev {
+
+// device selection and open options
+struct DeviceOptions {
+    int index{-1};               // device index, -1 for not set
+    std::string serial;          // device serial number, empty for not set
+    bool printStreamInfo{true};  // whether print the stream information of device, which is slow
+    int retries{10};             // max retry number to open device
+    double retryDelay{0.05};     // initial retry delay(s), doubled after each failure
+    double maxRetryDelay{1.0};   // max retry delay, s
+};
+
+/**
+ * @brief Select device without prompt. The device is selected by serial number if set, otherwise by index without
+ * enumerating devices. If neither is set, the only device is selected, or prompt to select if there are several
+ * devices
+ *
+ * @param cam       Camera
+ * @param options   Device options
+ * @param info      Output device information, only the index is valid if selected by index
+ * @return False if the device is not found
+ */
+bool selectDevice(const mynteyed::Camera& cam, const DeviceOptions& options, mynteyed::DeviceInfo* info);
+
+/**
+ * @brief Select and open device, retry with exponential backoff if failed, so the capture could be restarted quickly
+ * after a USB hiccup. The device is selected again before each retry, since its index may change after reconnection
+ *
+ * @param cam       Camera
+ * @param params    Open parameters, the device index will be set by selection
+ * @param options   Device options
+ * @param info      Output device information
+ * @return True if the device is opened
+ */
+bool openDevice(mynteyed::Camera& cam, mynteyed::OpenParams params, const DeviceOptions& options,
+                mynteyed::DeviceInfo* info);
+
+/**
+ * @brief Convert IMU data of device to IMU record in SI unit, the host timestamp is not set
+ *
+ * @param imu   IMU data, the accelerator is in g and the gyroscope is in deg/s
+ * @return IMU record
+ */
+ImuRecord toImuRecord(const mynteyed::ImuData& imu);
+
+/**
+ * @brief Convert stream data of device to stream image, the color image is converted to BGR and the depth image is
+ * kept as it is. The host timestamp is not set
+ *
+ * @param data  Stream data
+ * @param image Output stream image
+ * @return False if the stream data has no image or image information
+ */
+bool toStreamImage(const mynteyed::StreamData& data, StreamImage* image);
+
+/**
+ * @brief Copy the color image of device to raw frame for record pipeline. The YUYV and MJPG data are kept as they are,
+ * so they are converted(or written as it is) in encode threads, and the others are converted to BGR
+ *
+ * @param image Color image of device
+ * @param frame Output raw frame, only the format and image are set
+ */
+void toRawFrame(mynteyed::Image& image, RawFrame* frame);
+
+/**
+ * @brief Write the calibration of opened device to YAML file, including the intrinsics of left and right camera, the
+ * extrinsics from left to right camera, and the extrinsics between left camera and IMU. The intrinsics are adjusted
+ * for the ROI and binning of recorded frames, and the transform is written with them
+ *
+ * @param file          Output file
+ * @param cam           Opened camera
+ * @param mode          Stream mode, the intrinsics depend on it
+ * @param transforms    Frame transform of each stream("left" and "right"), empty for full frames
+ * @return True for success
+ */
+bool writeCalibration(const boost::filesystem::path& file, mynteyed::Camera& cam, mynteyed::StreamMode mode,
+                      const std::map<std::string, FrameTransform>& transforms = {});
+
+}  // namespace mev
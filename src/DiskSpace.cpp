@@ -0,0 +1,19 @@
+#include "DiskSpace.h"
+#include <sys/statvfs.h>
+
+using namespace std;
+
+namespace mev {
+
+bool getDiskSpace(const string& path, DiskSpace* space) {
+    struct statvfs stat {};
+    if (statvfs(path.c_str(), &stat) != 0) {
+        return false;
+    }
+    space->capacity = static_cast<uint64_t>(stat.f_blocks) * stat.f_frsize;
+    space->free = static_cast<uint64_t>(stat.f_bfree) * stat.f_frsize;
+    space->available = static_cast<uint64_t>(stat.f_bavail) * stat.f_frsize;
+    return true;
+}
+
+}  // namespace mev
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace mev {
+
+constexpr double kGB = 1024. * 1024. * 1024.;
+
+// disk space of the file system, in bytes
+struct DiskSpace {
+    std::uint64_t capacity{0};   // total size
+    std::uint64_t free{0};       // free size
+    std::uint64_t available{0};  // free size for unprivileged user
+};
+
+/**
+ * @brief Get the disk space of file system which contains the path, use statvfs()
+ *
+ * @param path  Any file or folder in the file system
+ * @param space Output disk space
+ * @return True for success
+ */
+bool getDiskSpace(const std::string& path, DiskSpace* space);
+
+}  // namespace mev
@@ -0,0 +1,192 @@
+#include "FeatureTracker.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video.hpp>
+#include "ClockSync.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+FeatureTracker::FeatureTracker(const TrackerOptions& options) : options_(options) {
+    CHECK_GT(options_.maxFeatures, 0) << "max feature number should be greater than 0";
+    CHECK(options_.gridCols > 0 && options_.gridRows > 0) << "grid size should be greater than 0";
+    CHECK(options_.windowSize % 2 == 1 && options_.predictWindowSize % 2 == 1) << "window size should be odd";
+}
+
+const vector<Feature>& FeatureTracker::track(const Mat& image, const Matx33d* homography) {
+    int64_t t0 = hostNow();
+    buildPyramid(image, homography ? options_.predictPyramidLevels : options_.pyramidLevels);
+    int64_t t1 = hostNow();
+    trackFeatures(homography);
+    int64_t t2 = hostNow();
+    detectFeatures();
+    int64_t t3 = hostNow();
+
+    // keep the pyramid for next frame, and the buffers of previous pyramid will be reused
+    swap(pyramid_, prevPyramid_);
+    ++statistics_.frames;
+    statistics_.pyramidTime += t1 - t0;
+    statistics_.trackTime += t2 - t1;
+    statistics_.detectTime += t3 - t2;
+    return features_;
+}
+
+void FeatureTracker::reset() {
+    features_.clear();
+    prevPyramid_.clear();
+}
+
+void FeatureTracker::buildPyramid(const Mat& image, int levels) {
+    switch (image.channels()) {
+        case 3:
+            cvtColor(image, gray_, COLOR_BGR2GRAY);
+            break;
+        case 2:
+            cvtColor(image, gray_, COLOR_YUV2GRAY_YUYV);
+            break;
+        default:
+            gray_ = image;
+            break;
+    }
+    // the previous frame is invalid if the image size is changed
+    if (!prevPyramid_.empty() && prevPyramid_[0].size() != gray_.size()) {
+        reset();
+    }
+    Size window(options_.windowSize, options_.windowSize);
+    buildOpticalFlowPyramid(gray_, pyramid_, window, levels);
+}
+
+void FeatureTracker::trackFeatures(const Matx33d* homography) {
+    if (prevPyramid_.empty() || features_.empty()) {
+        return;
+    }
+    prevPoints_.resize(features_.size());
+    points_.resize(features_.size());
+    for (size_t i = 0; i < features_.size(); ++i) {
+        prevPoints_[i] = features_[i].point;
+        // predict the position by homography as the initial flow
+        if (homography) {
+            const auto& H = *homography;
+            const auto& p = prevPoints_[i];
+            double w = H(2, 0) * p.x + H(2, 1) * p.y + H(2, 2);
+            points_[i].x = static_cast<float>((H(0, 0) * p.x + H(0, 1) * p.y + H(0, 2)) / w);
+            points_[i].y = static_cast<float>((H(1, 0) * p.x + H(1, 1) * p.y + H(1, 2)) / w);
+        }
+    }
+    int windowSize = homography ? options_.predictWindowSize : options_.windowSize;
+    int levels = homography ? options_.predictPyramidLevels : options_.pyramidLevels;
+    int flags = homography ? OPTFLOW_USE_INITIAL_FLOW : 0;
+    statistics_.predicted += homography != nullptr;
+    Size window(windowSize, windowSize);
+    TermCriteria criteria(TermCriteria::COUNT | TermCriteria::EPS, options_.maxIterations, options_.epsilon);
+    calcOpticalFlowPyrLK(prevPyramid_, pyramid_, prevPoints_, points_, status_, errors_, window, levels, criteria,
+                         flags);
+    if (options_.backwardCheck) {
+        backPoints_ = prevPoints_;
+        calcOpticalFlowPyrLK(pyramid_, prevPyramid_, points_, backPoints_, backStatus_, errors_, window, levels,
+                             criteria, OPTFLOW_USE_INITIAL_FLOW);
+    }
+
+    // remove the lost features, which are failed to track, out of image or inconsistent with backward tracking
+    const float border = 1;
+    const float maxX = static_cast<float>(gray_.cols) - 1 - border;
+    const float maxY = static_cast<float>(gray_.rows) - 1 - border;
+    const double maxBackwardError2 = options_.maxBackwardError * options_.maxBackwardError;
+    size_t n = 0;
+    for (size_t i = 0; i < features_.size(); ++i) {
+        const auto& p = points_[i];
+        bool ok = status_[i] && p.x >= border && p.y >= border && p.x <= maxX && p.y <= maxY;
+        if (ok && options_.backwardCheck) {
+            auto d = backPoints_[i] - prevPoints_[i];
+            ok = backStatus_[i] && d.x * d.x + d.y * d.y <= maxBackwardError2;
+        }
+        if (ok) {
+            features_[n] = features_[i];
+            features_[n].point = p;
+            ++features_[n].age;
+            ++n;
+        }
+    }
+    statistics_.tracked += n;
+    statistics_.lost += features_.size() - n;
+    features_.resize(n);
+}
+
+void FeatureTracker::detectFeatures() {
+    if (static_cast<int>(features_.size()) >= options_.maxFeatures) {
+        return;
+    }
+
+    // count features of each cell, and mask the area around them
+    const int cellNum = options_.gridCols * options_.gridRows;
+    const int maxCellFeatures = (options_.maxFeatures + cellNum - 1) / cellNum;
+    const int cellWidth = gray_.cols / options_.gridCols;
+    const int cellHeight = gray_.rows / options_.gridRows;
+    cellCounts_.assign(cellNum, 0);
+    mask_.create(gray_.size(), CV_8UC1);
+    mask_.setTo(Scalar(255));
+    auto cellIndex = [&](const Point2f& p) {
+        int c = min(static_cast<int>(p.x) / cellWidth, options_.gridCols - 1);
+        int r = min(static_cast<int>(p.y) / cellHeight, options_.gridRows - 1);
+        return r * options_.gridCols + c;
+    };
+    for (auto& f : features_) {
+        ++cellCounts_[cellIndex(f.point)];
+        circle(mask_, f.point, options_.minDistance, Scalar(0), -1);
+    }
+
+    // detect new features in the cells with fewer features, the last row and column cover the remaining pixels
+    auto addFeature = [&](const Point2f& p) {
+        Feature f;
+        f.id = nextId_++;
+        f.point = p;
+        features_.emplace_back(f);
+        circle(mask_, p, options_.minDistance, Scalar(0), -1);
+        ++statistics_.detected;
+    };
+    for (int r = 0; r < options_.gridRows; ++r) {
+        for (int c = 0; c < options_.gridCols; ++c) {
+            int need = maxCellFeatures - cellCounts_[r * options_.gridCols + c];
+            if (need <= 0) {
+                continue;
+            }
+            Rect cell(c * cellWidth, r * cellHeight, cellWidth, cellHeight);
+            if (c + 1 == options_.gridCols) {
+                cell.width = gray_.cols - cell.x;
+            }
+            if (r + 1 == options_.gridRows) {
+                cell.height = gray_.rows - cell.y;
+            }
+            Point2f offset(static_cast<float>(cell.x), static_cast<float>(cell.y));
+            if (options_.useFast) {
+                // take the strongest corners which are far enough from existing features
+                FAST(gray_(cell), keypoints_, options_.fastThreshold, true);
+                sort(keypoints_.begin(), keypoints_.end(),
+                     [](const KeyPoint& a, const KeyPoint& b) { return a.response > b.response; });
+                for (auto& kp : keypoints_) {
+                    if (need <= 0) {
+                        break;
+                    }
+                    Point2f p = kp.pt + offset;
+                    if (mask_.at<uint8_t>(static_cast<int>(p.y), static_cast<int>(p.x)) == 0) {
+                        continue;
+                    }
+                    addFeature(p);
+                    --need;
+                }
+            } else {
+                goodFeaturesToTrack(gray_(cell), corners_, need, options_.qualityLevel, options_.minDistance,
+                                    mask_(cell));
+                for (auto& p : corners_) {
+                    addFeature(p + offset);
+                }
+            }
+        }
+    }
+}
+
+}  // namespace mev
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace mev {
+
+// feature tracker options
+struct TrackerOptions {
+    int maxFeatures{150};          // max feature number, they are distributed in grid cells evenly
+    int gridCols{8};               // column number of detection grid
+    int gridRows{6};               // row number of detection grid
+    int minDistance{20};           // min distance between features, pixel
+    bool useFast{true};            // detect FAST corners, or Shi-Tomasi corners if false
+    int fastThreshold{20};         // threshold of FAST detector
+    double qualityLevel{0.01};     // quality level of Shi-Tomasi detector
+    int windowSize{21};            // window size of Lucas-Kanade
+    int pyramidLevels{3};          // max level of pyramid, 0 for single level
+    int maxIterations{20};         // max iterations of Lucas-Kanade at each level
+    double epsilon{0.03};          // min update to stop Lucas-Kanade iteration, pixel
+    bool backwardCheck{false};     // track back to previous frame to reject wrong tracks, it doubles the tracking time
+    double maxBackwardError{1.0};  // max distance between the backward tracked and the original point, pixel
+    int predictWindowSize{15};     // window size of Lucas-Kanade with predicted positions
+    int predictPyramidLevels{1};   // max level of pyramid with predicted positions
+};
+
+// tracked feature
+struct Feature {
+    std::uint64_t id{0};  // unique ID
+    cv::Point2f point;    // position in current image
+    int age{0};           // tracked frame number since detected, 0 for new feature
+};
+
+// tracker statistics, the time is wall time
+struct TrackerStatistics {
+    std::uint64_t frames{0};      // processed frame number
+    std::uint64_t predicted{0};   // frame number tracked with predicted positions
+    std::uint64_t tracked{0};     // total tracked feature number
+    std::uint64_t lost{0};        // total lost feature number
+    std::uint64_t detected{0};    // total detected feature number
+    std::int64_t pyramidTime{0};  // time to convert image and build pyramid, ns
+    std::int64_t trackTime{0};    // time to track features, ns
+    std::int64_t detectTime{0};   // time to detect new features, ns
+};
+
+/**
+ * @brief Front-end feature tracker. The features are tracked by pyramidal Lucas-Kanade from previous frame, and new
+ * FAST or Shi-Tomasi corners are detected in the grid cells with fewer features, so the features spread over the image.
+ *
+ * The pyramid of current frame is kept as the previous pyramid of next frame instead of being rebuilt, and the two
+ * pyramids are swapped each frame, so their buffers are allocated only once for the same image size.
+ *
+ * If the rotation between frames is known from the gyroscope, the feature positions are predicted by the rotation
+ * homography before tracking, then a smaller window and fewer pyramid levels are enough even for fast rotations. Not
+ * thread safe
+ */
+class FeatureTracker {
+  public:
+    explicit FeatureTracker(const TrackerOptions& options = TrackerOptions());
+
+    /**
+     * @brief Track features in new frame
+     *
+     * @param image         Gray, BGR or YUYV image
+     * @param homography    Homography to predict the feature positions from previous frame, such as the rotation
+     *                      homography from IMU, nullptr for no prediction
+     * @return Features in current frame
+     */
+    const std::vector<Feature>& track(const cv::Mat& image, const cv::Matx33d* homography = nullptr);
+
+    // features in current frame
+    inline const std::vector<Feature>& features() const { return features_; }
+
+    // options
+    inline const TrackerOptions& options() const { return options_; }
+
+    // statistics
+    inline const TrackerStatistics& statistics() const { return statistics_; }
+
+    // clear the features and previous frame, the next frame will be detected only
+    void reset();
+
+  private:
+    // convert image to gray and build pyramid with max level
+    void buildPyramid(const cv::Mat& image, int levels);
+
+    // track features from previous pyramid to current pyramid, predict the positions by homography if not nullptr
+    void trackFeatures(const cv::Matx33d* homography);
+
+    // detect new features in grid cells with fewer features
+    void detectFeatures();
+
+  private:
+    TrackerOptions options_;
+    TrackerStatistics statistics_;
+    std::uint64_t nextId_{0};  // ID of next new feature
+    std::vector<Feature> features_;
+
+    // reused buffers
+    cv::Mat gray_;                          // gray image
+    cv::Mat mask_;                          // mask of detection, 0 around existing features
+    std::vector<cv::Mat> pyramid_;          // pyramid of current frame
+    std::vector<cv::Mat> prevPyramid_;      // pyramid of previous frame
+    std::vector<cv::Point2f> prevPoints_;   // feature points in previous frame
+    std::vector<cv::Point2f> points_;       // tracked points in current frame
+    std::vector<cv::Point2f> backPoints_;   // backward tracked points in previous frame
+    std::vector<std::uint8_t> status_;      // tracking status
+    std::vector<std::uint8_t> backStatus_;  // backward tracking status
+    std::vector<float> errors_;             // tracking errors
+    std::vector<cv::KeyPoint> keypoints_;   // detected FAST corners of one cell
+    std::vector<cv::Point2f> corners_;      // detected Shi-Tomasi corners of one cell
+    std::vector<int> cellCounts_;           // feature number of each cell
+};
+
+}  // namespace mev
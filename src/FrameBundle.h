@@ -0,0 +1,35 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include "ImuBuffer.h"
+
+namespace mev {
+
+// image of one stream
+struct StreamImage {
+    std::uint32_t frameId{0};       // frame ID
+    std::int64_t timestamp{0};      // device timestamp, ns
+    std::int64_t hostTimestamp{0};  // host timestamp, ns
+    cv::Mat image;                  // BGR image for color stream, 16 bits image for depth stream
+
+    // whether the image is valid
+    inline bool isValid() const { return !image.empty(); }
+};
+
+// pinhole camera of depth image, the depth is aligned to the rectified left image
+struct DepthCamera {
+    double fx{0};             // focal length x, pixel
+    double fy{0};             // focal length y, pixel
+    double cx{0};             // principal point x, pixel
+    double cy{0};             // principal point y, pixel
+    double depthScale{1E-3};  // depth unit, m
+};
+
+// frame bundle, the images of one frame and the IMU records since the previous frame
+struct FrameBundle {
+    StreamImage left;   // left image
+    StreamImage right;  // right image
+    StreamImage depth;  // depth image
+    ImuSpan imu;        // IMU records in (previous left timestamp, left timestamp], it's a view of IMU buffer
+};
+
+}  // namespace mev
@@ -0,0 +1,120 @@
+#include "FrameTransform.h"
+#include <fmt/format.h>
+#include <opencv2/imgproc.hpp>
+#include <boost/algorithm/string.hpp>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+bool parseFrameTransform(const string& text, FrameTransform* transform) {
+    *transform = FrameTransform();
+    vector<string> items;
+    boost::split(items, text, boost::is_any_of(";"), boost::token_compress_on);
+    try {
+        for (auto& item : items) {
+            boost::trim(item);
+            if (item.empty()) {
+                continue;
+            }
+            auto pos = item.find('=');
+            if (pos == string::npos) {
+                return false;
+            }
+            string key = boost::trim_copy(item.substr(0, pos));
+            string value = boost::trim_copy(item.substr(pos + 1));
+            if (key == "roi") {
+                vector<string> values;
+                boost::split(values, value, boost::is_any_of(","));
+                if (values.size() != 4) {
+                    return false;
+                }
+                transform->roi = Rect(stoi(values[0]), stoi(values[1]), stoi(values[2]), stoi(values[3]));
+                if (transform->roi.x < 0 || transform->roi.y < 0 || transform->roi.width <= 0 ||
+                    transform->roi.height <= 0) {
+                    return false;
+                }
+            } else if (key == "binning") {
+                transform->binning = stoi(value);
+                if (transform->binning != 1 && transform->binning != 2 && transform->binning != 4) {
+                    return false;
+                }
+            } else if (key == "decimation") {
+                transform->decimation = stoi(value);
+                if (transform->decimation < 1) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    return true;
+}
+
+string formatFrameTransform(const FrameTransform& transform) {
+    vector<string> items;
+    if (transform.roi.area() > 0) {
+        items.emplace_back(fmt::format("roi={},{},{},{}", transform.roi.x, transform.roi.y, transform.roi.width,
+                                       transform.roi.height));
+    }
+    if (transform.binning != 1) {
+        items.emplace_back(fmt::format("binning={}", transform.binning));
+    }
+    if (transform.decimation != 1) {
+        items.emplace_back(fmt::format("decimation={}", transform.decimation));
+    }
+    return boost::join(items, ";");
+}
+
+bool checkFrameTransform(const FrameTransform& transform, const Size& size, string* error) {
+    Rect roi = transformRoi(transform, size);
+    if ((roi & Rect(0, 0, size.width, size.height)) != roi) {
+        *error = fmt::format("ROI [{}, {}, {}, {}] is out of image {}x{}", roi.x, roi.y, roi.width, roi.height,
+                             size.width, size.height);
+        return false;
+    }
+    int alignX = max(transform.binning, 2);
+    if (roi.x % alignX != 0 || roi.width % alignX != 0 || roi.y % transform.binning != 0 ||
+        roi.height % transform.binning != 0) {
+        *error = fmt::format("ROI x and width should be multiple of {}, y and height should be multiple of {}",
+                             alignX, transform.binning);
+        return false;
+    }
+    return true;
+}
+
+Rect transformRoi(const FrameTransform& transform, const Size& size) {
+    return transform.roi.area() > 0 ? transform.roi : Rect(0, 0, size.width, size.height);
+}
+
+Size transformSize(const FrameTransform& transform, const Size& size) {
+    Rect roi = transformRoi(transform, size);
+    return Size(roi.width / transform.binning, roi.height / transform.binning);
+}
+
+void transformIntrinsics(const FrameTransform& transform, double* fx, double* fy, double* cx, double* cy) {
+    double b = transform.binning;
+    *fx /= b;
+    *fy /= b;
+    *cx = (*cx - transform.roi.x + 0.5) / b - 0.5;
+    *cy = (*cy - transform.roi.y + 0.5) / b - 0.5;
+}
+
+void binImage(const Mat& image, int binning, Mat& output) {
+    if (binning == 1) {
+        output = image;
+        return;
+    }
+    resize(image, output, Size(image.cols / binning, image.rows / binning), 0, 0, INTER_AREA);
+}
+
+void applyFrameTransform(const FrameTransform& transform, const Mat& image, Mat& output) {
+    binImage(image(transformRoi(transform, image.size())), transform.binning, output);
+}
+
+}  // namespace mev
@@ -0,0 +1,77 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace mev {
+
+// transform of recorded frames of one stream, applied before encoding
+struct FrameTransform {
+    cv::Rect roi;       // region of interest in full image, empty for full image
+    int binning{1};     // spatial binning(1, 2 or 4), the ROI is averaged over binning x binning pixels
+    int decimation{1};  // temporal decimation, keep the frames whose frame ID is a multiple of it
+
+    // whether nothing is set
+    inline bool empty() const { return roi.area() == 0 && binning == 1 && decimation == 1; }
+};
+
+/**
+ * @brief Parse frame transform, the items are separated by ';', such as "roi=0,240,1280,240;binning=2;decimation=3"
+ *
+ * @param text      Transform text, empty for no transform
+ * @param transform Output transform
+ * @return False if invalid
+ */
+bool parseFrameTransform(const std::string& text, FrameTransform* transform);
+
+// format frame transform to text, which could be parsed by parseFrameTransform()
+std::string formatFrameTransform(const FrameTransform& transform);
+
+/**
+ * @brief Check whether the transform is valid for the image size. The ROI should be inside the image, the x and width
+ * of ROI should be even to crop YUYV image, and all of them should be multiple of binning
+ *
+ * @param transform Frame transform
+ * @param size      Full image size
+ * @param error     Output error message
+ * @return True if valid
+ */
+bool checkFrameTransform(const FrameTransform& transform, const cv::Size& size, std::string* error);
+
+// get the ROI of transform in full image, which is the full image if ROI isn't set
+cv::Rect transformRoi(const FrameTransform& transform, const cv::Size& size);
+
+// get the image size after transform
+cv::Size transformSize(const FrameTransform& transform, const cv::Size& size);
+
+/**
+ * @brief Transform the pinhole intrinsics for ROI and binning. The binned pixel (u', v') covers the full image pixels
+ * [b * u', b * u' + b), so u' = (u - x + 0.5) / b - 0.5
+ *
+ * @param transform Frame transform
+ * @param fx        Focal length x, in/out
+ * @param fy        Focal length y, in/out
+ * @param cx        Principal point x, in/out
+ * @param cy        Principal point y, in/out
+ */
+void transformIntrinsics(const FrameTransform& transform, double* fx, double* fy, double* cx, double* cy);
+
+/**
+ * @brief Bin image by area averaging
+ *
+ * @param image     Input image
+ * @param binning   Binning, 1 for no binning and the output refers to the input image
+ * @param output    Output image, its buffer is reused
+ */
+void binImage(const cv::Mat& image, int binning, cv::Mat& output);
+
+/**
+ * @brief Crop the ROI of image and bin it. The YUYV image should be cropped before conversion and then binned, since
+ * the chroma is shared by 2 pixels
+ *
+ * @param transform Frame transform
+ * @param image     Full image
+ * @param output    Output image, its buffer is reused
+ */
+void applyFrameTransform(const FrameTransform& transform, const cv::Mat& image, cv::Mat& output);
+
+}  // namespace mev
@@ -0,0 +1,89 @@
+#include "ImuBuffer.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace mev {
+
+ImuBuffer::ImuBuffer(size_t capacity) {
+    // round up the storage size to page size
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    CHECK_EQ(pageSize % sizeof(ImuRecord), 0) << "page size should be multiple of IMU record size";
+    size_t bytes = max<size_t>(capacity, 1) * sizeof(ImuRecord);
+    bytes = (bytes + pageSize - 1) / pageSize * pageSize;
+    capacity_ = bytes / sizeof(ImuRecord);
+
+    // map the same memory file twice to consecutive address
+    int fd = memfd_create("mev_imu_buffer", MFD_CLOEXEC);
+    PCHECK(fd >= 0) << "cannot create memory file for IMU buffer";
+    PCHECK(ftruncate(fd, static_cast<off_t>(bytes)) == 0) << "cannot resize memory file for IMU buffer";
+    auto* base = static_cast<uint8_t*>(mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    PCHECK(base != MAP_FAILED) << "cannot reserve address for IMU buffer";
+    PCHECK(mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED)
+        << "cannot map IMU buffer";
+    PCHECK(mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED)
+        << "cannot map mirror of IMU buffer";
+    close(fd);
+    data_ = reinterpret_cast<ImuRecord*>(base);
+}
+
+ImuBuffer::~ImuBuffer() { munmap(data_, 2 * capacity_ * sizeof(ImuRecord)); }
+
+bool ImuBuffer::push(const ImuRecord& record) {
+    lock_guard<mutex> lock(mutex_);
+    if (size_ > 0 && record.timestamp < data_[head_ + size_ - 1].timestamp) {
+        LOG(WARNING) << fmt::format("drop out of order IMU record, timestamp = {} ns, latest = {} ns", record.timestamp,
+                                    data_[head_ + size_ - 1].timestamp);
+        return false;
+    }
+    if (size_ < capacity_) {
+        data_[(head_ + size_) % capacity_] = record;
+        ++size_;
+    } else {
+        // overwrite the oldest one
+        data_[head_] = record;
+        head_ = (head_ + 1) % capacity_;
+    }
+    return true;
+}
+
+ImuSpan ImuBuffer::slice(int64_t t0, int64_t t1) const {
+    lock_guard<mutex> lock(mutex_);
+    ImuSpan span;
+    if (size_ == 0 || t1 <= t0) {
+        return span;
+    }
+    // the records from head are contiguous in mirrored storage
+    const ImuRecord* first = data_ + head_;
+    const ImuRecord* last = first + size_;
+    auto begin = upper_bound(first, last, t0, [](int64_t t, const ImuRecord& r) { return t < r.timestamp; });
+    auto end = upper_bound(begin, last, t1, [](int64_t t, const ImuRecord& r) { return t < r.timestamp; });
+    span.data = begin;
+    span.size = static_cast<size_t>(end - begin);
+    return span;
+}
+
+ImuSpan ImuBuffer::latest(size_t n) const {
+    lock_guard<mutex> lock(mutex_);
+    ImuSpan span;
+    span.size = min(n, size_);
+    span.data = data_ + head_ + size_ - span.size;
+    return span;
+}
+
+int64_t ImuBuffer::latestTime() const {
+    lock_guard<mutex> lock(mutex_);
+    return size_ == 0 ? numeric_limits<int64_t>::min() : data_[head_ + size_ - 1].timestamp;
+}
+
+size_t ImuBuffer::size() const {
+    lock_guard<mutex> lock(mutex_);
+    return size_;
+}
+
+}  // namespace mev
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include "Types.h"
+
+namespace mev {
+
+// zero-copy view of contiguous IMU records
+struct ImuSpan {
+    const ImuRecord* data{nullptr};  // first record
+    std::size_t size{0};             // record number
+
+    inline const ImuRecord* begin() const { return data; }
+    inline const ImuRecord* end() const { return data + size; }
+    inline bool empty() const { return size == 0; }
+    inline const ImuRecord& operator[](std::size_t i) const { return data[i]; }
+    inline const ImuRecord& front() const { return data[0]; }
+    inline const ImuRecord& back() const { return data[size - 1]; }
+};
+
+/**
+ * @brief Time indexed IMU ring buffer. The storage is mapped twice to consecutive virtual memory(mirrored ring buffer),
+ * so the records in any time interval are always contiguous and could be returned as a zero-copy span, even if they
+ * wrap around the end of ring.
+ *
+ * There is only one writer, a span is valid until `capacity` new records are pushed after it's returned, then the
+ * records in it will be overwritten.
+ */
+class ImuBuffer {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param capacity  Min record number, it will be rounded up to fill whole memory pages
+     */
+    explicit ImuBuffer(std::size_t capacity = 4096);
+
+    ~ImuBuffer();
+
+    ImuBuffer(const ImuBuffer&) = delete;
+    ImuBuffer& operator=(const ImuBuffer&) = delete;
+
+  public:
+    /**
+     * @brief Push IMU record, the timestamp should be increasing
+     *
+     * @param record    IMU record
+     * @return False if the record is out of order and dropped
+     */
+    bool push(const ImuRecord& record);
+
+    /**
+     * @brief Get the records in time interval (t0, t1], so the slices of consecutive frames don't overlap
+     *
+     * @param t0    Start device timestamp(exclusive), ns
+     * @param t1    End device timestamp(inclusive), ns
+     * @return Records in interval, the older records which have been overwritten are not included
+     */
+    ImuSpan slice(std::int64_t t0, std::int64_t t1) const;
+
+    // the latest N records
+    ImuSpan latest(std::size_t n) const;
+
+    // timestamp of the latest record, ns. Return min value if the buffer is empty
+    std::int64_t latestTime() const;
+
+    // record number in buffer
+    std::size_t size() const;
+
+    // max record number
+    inline std::size_t capacity() const { return capacity_; }
+
+  private:
+    std::size_t capacity_{0};  // max record number
+    ImuRecord* data_{nullptr};  // mirrored storage, data_[i] and data_[i + capacity_] are the same memory
+    std::size_t head_{0};       // index of the oldest record, in [0, capacity_)
+    std::size_t size_{0};       // record number
+    mutable std::mutex mutex_;
+};
+
+}  // namespace mev
@@ -0,0 +1,90 @@
+#include "ImuIntegration.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// whether the record has gyroscope
+bool hasGyro(const ImuRecord& record) { return record.gyro[0] != 0 || record.gyro[1] != 0 || record.gyro[2] != 0; }
+
+}  // namespace
+
+Matx33d expRotation(const Vec3d& w) {
+    double theta = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    Matx33d wx(0, -w[2], w[1], w[2], 0, -w[0], -w[1], w[0], 0);
+    Matx33d R = Matx33d::eye();
+    if (theta < 1.0E-8) {
+        // first order approximation for small angle
+        return R + wx;
+    }
+    return R + wx * (sin(theta) / theta) + wx * wx * ((1 - cos(theta)) / (theta * theta));
+}
+
+Vec3d logRotation(const Matx33d& R) {
+    double c = max(-1.0, min(1.0, (R(0, 0) + R(1, 1) + R(2, 2) - 1) * 0.5));
+    double theta = acos(c);
+    Vec3d v(R(2, 1) - R(1, 2), R(0, 2) - R(2, 0), R(1, 0) - R(0, 1));
+    if (theta < 1.0E-8) {
+        // first order approximation for small angle
+        return v * 0.5;
+    }
+    if (theta > CV_PI - 1.0E-6) {
+        // the axis is the column of R + I with the max norm when the angle is close to pi
+        Matx33d S = R + Matx33d::eye();
+        int k{0};
+        for (int i = 1; i < 3; ++i) {
+            k = S(i, i) > S(k, k) ? i : k;
+        }
+        Vec3d axis(S(0, k), S(1, k), S(2, k));
+        return axis * (theta / norm(axis));
+    }
+    return v * (theta / (2 * sin(theta)));
+}
+
+Matx33d integrateGyro(const ImuSpan& imu, int64_t t0, int64_t t1) {
+    Matx33d R = Matx33d::eye();
+    const ImuRecord* last{nullptr};  // last gyroscope record
+    int64_t t = t0;                  // integrated time
+    auto integrate = [&](const Vec3d& w, int64_t end) {
+        end = min(end, t1);
+        if (end > t) {
+            R = R * expRotation(w * ((end - t) * 1.0E-9));
+            t = end;
+        }
+    };
+    for (auto& record : imu) {
+        if (!hasGyro(record)) {
+            continue;
+        }
+        Vec3d w(record.gyro[0], record.gyro[1], record.gyro[2]);
+        if (!last) {
+            // hold the first record before it
+            integrate(w, record.timestamp);
+        } else {
+            Vec3d w0(last->gyro[0], last->gyro[1], last->gyro[2]);
+            integrate((w0 + w) * 0.5, record.timestamp);
+        }
+        last = &record;
+        if (t >= t1) {
+            break;
+        }
+    }
+    // hold the last record after it
+    if (last) {
+        integrate(Vec3d(last->gyro[0], last->gyro[1], last->gyro[2]), t1);
+    }
+    return R;
+}
+
+Matx33d rotationHomography(const Matx33d& cameraMatrix, const Matx33d& cameraImu, const Matx33d& imuRotation) {
+    // rotation of camera from previous to current frame, p_current = R * p_previous
+    Matx33d R = cameraImu * imuRotation.t() * cameraImu.t();
+    return cameraMatrix * R * cameraMatrix.inv();
+}
+
+}  // namespace mev
@@ -0,0 +1,48 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include "ImuBuffer.h"
+
+namespace mev {
+
+/**
+ * @brief Exponential map of rotation vector(axis * angle) to rotation matrix by Rodrigues' formula
+ *
+ * @param w Rotation vector, rad
+ * @return Rotation matrix
+ */
+cv::Matx33d expRotation(const cv::Vec3d& w);
+
+/**
+ * @brief Logarithm map of rotation matrix to rotation vector(axis * angle), the inverse of expRotation()
+ *
+ * @param R Rotation matrix
+ * @return Rotation vector, rad, the angle is in [0, pi]
+ */
+cv::Vec3d logRotation(const cv::Matx33d& R);
+
+/**
+ * @brief Integrate the gyroscope to get the rotation of IMU in time interval [t0, t1]. The angular velocity between
+ * two records is the average of them, and it's held by the first or last record out of the records. The records
+ * without gyroscope(all zero, such as the accelerator only records) are skipped
+ *
+ * @param imu   IMU records, the timestamp should be increasing
+ * @param t0    Start device timestamp, ns
+ * @param t1    End device timestamp, ns
+ * @return Rotation of IMU at t1 relative to t0, which rotates the vector in IMU frame of t1 to t0. Identity if there is
+ * no gyroscope record
+ */
+cv::Matx33d integrateGyro(const ImuSpan& imu, std::int64_t t0, std::int64_t t1);
+
+/**
+ * @brief Get the infinite homography which maps the pixel of previous frame to current frame by the rotation of IMU,
+ * the translation is ignored, so it's exact for far points and a good prediction for fast rotations
+ *
+ * @param cameraMatrix  Camera matrix
+ * @param cameraImu     Rotation from IMU frame to camera frame, p_camera = cameraImu * p_imu
+ * @param imuRotation   Rotation of IMU at current frame relative to previous frame, from integrateGyro()
+ * @return Homography from previous pixel to current pixel
+ */
+cv::Matx33d rotationHomography(const cv::Matx33d& cameraMatrix, const cv::Matx33d& cameraImu,
+                               const cv::Matx33d& imuRotation);
+
+}  // namespace mev
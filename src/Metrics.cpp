@@ -0,0 +1,186 @@
+#include "Metrics.h"
+#include <arpa/inet.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+void MetricsText::add(const string& name, const string& type, const string& help, double value,
+                      const string& labels) {
+    if (metrics_.insert(name).second) {
+        text_ += fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+    }
+    if (labels.empty()) {
+        text_ += fmt::format("{} {}\n", name, value);
+    } else {
+        text_ += fmt::format("{}{{{}}} {}\n", name, labels, value);
+    }
+}
+
+double RateMeter::update(double total, int64_t time) {
+    double rate{0};
+    if (time_ != 0 && time > time_) {
+        rate = (total - total_) * 1.0E9 / static_cast<double>(time - time_);
+    }
+    total_ = total;
+    time_ = time;
+    return rate;
+}
+
+vector<ThreadCpuTime> threadCpuTimes() {
+    static const double kTicks = static_cast<double>(sysconf(_SC_CLK_TCK));
+    vector<ThreadCpuTime> threads;
+    boost::system::error_code ec;
+    for (fs::directory_iterator it("/proc/self/task", ec), end; !ec && it != end; it.increment(ec)) {
+        ifstream file((it->path() / "stat").string());
+        string stat;
+        if (!getline(file, stat)) {
+            continue;
+        }
+        // pid (comm) state ppid ..., the comm may contain space, and utime and stime are the 14th and 15th fields
+        auto left = stat.find('(');
+        auto right = stat.rfind(')');
+        if (left == string::npos || right == string::npos) {
+            continue;
+        }
+        ThreadCpuTime info;
+        info.tid = stoi(stat.substr(0, left));
+        info.name = stat.substr(left + 1, right - left - 1);
+        unsigned long utime{0}, stime{0};
+        if (sscanf(stat.c_str() + right + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) !=
+            2) {
+            continue;
+        }
+        info.cpuTime = static_cast<double>(utime + stime) / kTicks;
+        threads.emplace_back(info);
+    }
+    return threads;
+}
+
+MetricsExporter::MetricsExporter(const MetricsOptions& options, Collector collector)
+    : options_(options), collector_(std::move(collector)) {
+    if (options_.port > 0) {
+        // only listen on localhost
+        serverFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        PCHECK(serverFd_ >= 0) << "cannot create metrics socket";
+        int reuse{1};
+        setsockopt(serverFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+        if (::bind(serverFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(serverFd_, 4) != 0) {
+            PLOG(ERROR) << fmt::format("cannot serve metrics on localhost:{}", options_.port);
+            close(serverFd_);
+            serverFd_ = -1;
+        } else {
+            LOG(INFO) << fmt::format("serve metrics on http://localhost:{}/metrics", options_.port);
+        }
+    }
+    if (serverFd_ >= 0 || !options_.file.empty()) {
+        thread_ = thread(&MetricsExporter::run, this);
+    }
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (serverFd_ >= 0) {
+        close(serverFd_);
+    }
+}
+
+void MetricsExporter::run() {
+    pthread_setname_np(pthread_self(), "metrics");
+    const auto interval = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(max(options_.interval, 0.1)));
+    auto nextWrite = chrono::steady_clock::now();
+    while (!stop_) {
+        if (!options_.file.empty() && chrono::steady_clock::now() >= nextWrite) {
+            writeFile();
+            nextWrite += interval;
+        }
+        // wait for connection, and check the stop flag every 100 ms
+        if (serverFd_ >= 0) {
+            pollfd pfd{serverFd_, POLLIN, 0};
+            if (poll(&pfd, 1, 100) > 0 && (pfd.revents & POLLIN)) {
+                int fd = accept4(serverFd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd >= 0) {
+                    reply(fd);
+                    close(fd);
+                }
+            }
+        } else {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+    }
+    // write the final metrics
+    if (!options_.file.empty()) {
+        writeFile();
+    }
+}
+
+string MetricsExporter::collect(MetricsSink sink) {
+    MetricsText text;
+    collector_(text, sink);
+    return text.str();
+}
+
+void MetricsExporter::writeFile() {
+    // write to temporary file and rename, so the reader never sees partial file
+    string tmpFile = options_.file + ".tmp";
+    {
+        ofstream file(tmpFile);
+        file << collect(MetricsSink::File);
+        if (!file) {
+            LOG(ERROR) << fmt::format("cannot write metrics file \"{}\"", tmpFile);
+            return;
+        }
+    }
+    boost::system::error_code ec;
+    fs::rename(tmpFile, options_.file, ec);
+    LOG_IF(ERROR, ec) << fmt::format("cannot rename metrics file \"{}\": {}", options_.file, ec.message());
+}
+
+void MetricsExporter::reply(int fd) {
+    // wait the request for at most 1 s, only GET is supported and the path is ignored
+    char request[1024];
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) <= 0 || recv(fd, request, sizeof(request), 0) <= 0) {
+        return;
+    }
+    string response;
+    if (strncmp(request, "GET ", 4) == 0) {
+        string body = collect(MetricsSink::Http);
+        response = fmt::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: {}\r\nConnection: close\r\n\r\n{}",
+                               body.size(), body);
+    } else {
+        response = "HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n\r\n";
+    }
+    size_t sent{0};
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+}  // namespace mev
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mev {
+
+// metrics exporter options
+struct MetricsOptions {
+    int port{0};           // localhost port to serve metrics by HTTP, 0 to disable
+    std::string file;      // file to write metrics periodically, empty to disable
+    double interval{5.0};  // interval to write file, s
+};
+
+// sink which the metrics are collected for, each has its own collection interval
+enum class MetricsSink { Http, File };
+
+/**
+ * @brief Builder of metrics text in Prometheus text exposition format
+ *
+ *  # HELP mev_images_total Written image number
+ *  # TYPE mev_images_total counter
+ *  mev_images_total{stream="left"} 1024
+ */
+class MetricsText {
+  public:
+    /**
+     * @brief Add one sample, the HELP and TYPE lines are added before the first sample of metric
+     *
+     * @param name      Metric name
+     * @param type      Metric type, "counter" or "gauge"
+     * @param help      Help text
+     * @param value     Value
+     * @param labels    Labels without braces, such as stream="left"
+     */
+    void add(const std::string& name, const std::string& type, const std::string& help, double value,
+             const std::string& labels = "");
+
+    // get the text
+    inline const std::string& str() const { return text_; }
+
+  private:
+    std::string text_;               // text
+    std::set<std::string> metrics_;  // added metric names
+};
+
+// rate of a counter between two updates
+class RateMeter {
+  public:
+    /**
+     * @brief Update the counter and get the rate since last update
+     *
+     * @param total Current counter value
+     * @param time  Current time, ns
+     * @return Rate per second, 0 for the first update
+     */
+    double update(double total, std::int64_t time);
+
+  private:
+    double total_{0};       // counter of last update
+    std::int64_t time_{0};  // time of last update, 0 for not updated
+};
+
+// CPU time of thread
+struct ThreadCpuTime {
+    int tid{0};         // thread ID
+    std::string name;   // thread name
+    double cpuTime{0};  // user and system CPU time, s
+};
+
+// get the CPU time of all threads in current process from /proc/self/task
+std::vector<ThreadCpuTime> threadCpuTimes();
+
+/**
+ * @brief Metrics exporter, serve the metrics on a localhost port by HTTP for scraper, and/or write them to file
+ * periodically. The metrics are collected by callback in exporter thread when requested, and the sink is passed so
+ * the rates can be calculated between two collections of the same sink
+ */
+class MetricsExporter {
+  public:
+    // callback to collect metrics
+    using Collector = std::function<void(MetricsText&, MetricsSink)>;
+
+    /**
+     * @brief Constructor, start the exporter thread if port or file is set
+     *
+     * @param options   Options
+     * @param collector Callback to collect metrics, called in exporter thread
+     */
+    MetricsExporter(const MetricsOptions& options, Collector collector);
+
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  private:
+    // exporter thread loop
+    void run();
+
+    // collect metrics text for sink
+    std::string collect(MetricsSink sink);
+
+    // write metrics to file
+    void writeFile();
+
+    // reply one HTTP request
+    void reply(int fd);
+
+  private:
+    MetricsOptions options_;
+    Collector collector_;
+    int serverFd_{-1};  // server socket, -1 if not serving
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+};
+
+}  // namespace mev
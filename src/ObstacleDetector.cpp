@@ -0,0 +1,222 @@
+#include "ObstacleDetector.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "ClockSync.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+constexpr double kDegree = CV_PI / 180;
+
+// solve 3x3 linear equations by Cramer's rule, return false if singular
+bool solve3(const Matx33d& a, const Vec3d& b, Vec3d* x) {
+    double det = determinant(a);
+    if (abs(det) < 1E-12) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        Matx33d m = a;
+        for (int r = 0; r < 3; ++r) {
+            m(r, i) = b[r];
+        }
+        (*x)[i] = determinant(m) / det;
+    }
+    return true;
+}
+
+}  // namespace
+
+void mountingTransform(const MountingPose& pose, Matx33d* rotation, Vec3d* translation) {
+    // optical frame to robot frame without rotation, x_robot = z_camera, y_robot = -x_camera, z_robot = -y_camera
+    const Matx33d optical(0, 0, 1, -1, 0, 0, 0, -1, 0);
+    double cr = cos(pose.roll * kDegree), sr = sin(pose.roll * kDegree);
+    double cp = cos(pose.pitch * kDegree), sp = sin(pose.pitch * kDegree);
+    double cy = cos(pose.yaw * kDegree), sy = sin(pose.yaw * kDegree);
+    const Matx33d rx(1, 0, 0, 0, cr, -sr, 0, sr, cr);
+    const Matx33d ry(cp, 0, sp, 0, 1, 0, -sp, 0, cp);
+    const Matx33d rz(cy, -sy, 0, sy, cy, 0, 0, 0, 1);
+    *rotation = rz * ry * rx * optical;
+    *translation = Vec3d(pose.x, pose.y, pose.height);
+}
+
+ObstacleDetector::ObstacleDetector(const DepthCamera& camera, const MountingPose& pose, const ObstacleOptions& options)
+    : camera_(camera), options_(options), rng_(0) {
+    CHECK(camera_.fx > 0 && camera_.fy > 0) << "invalid depth camera";
+    CHECK_GT(options_.step, 0) << "step should be greater than 0";
+    CHECK_GT(options_.cellSize, 0) << "cell size should be greater than 0";
+    CHECK_GT(options_.sectors, 0) << "sector number should be greater than 0";
+    CHECK_GT(options_.minCellPoints, 0) << "min point number of occupied cell should be greater than 0";
+    mountingTransform(pose, &rotation_, &translation_);
+    sectors_.assign(options_.sectors, numeric_limits<float>::infinity());
+}
+
+void ObstacleDetector::detect(const Mat& depth) {
+    CHECK_EQ(depth.type(), CV_16UC1) << "depth should be 16 bits image";
+    ++statistics_.frames;
+    int64_t startTime = hostNow();
+    project(depth);
+    int64_t projectTime = hostNow();
+    statistics_.projectTime += projectTime - startTime;
+    statistics_.points += points_.size();
+
+    // keep the last plane if not found, it's a better guess than the nominal ground when the floor is occluded
+    if (estimateGround()) {
+        ++statistics_.groundFound;
+    } else {
+        ground_.inliers = 0;
+    }
+    int64_t groundTime = hostNow();
+    statistics_.groundTime += groundTime - projectTime;
+
+    updateGrid();
+    statistics_.gridTime += hostNow() - groundTime;
+}
+
+float ObstacleDetector::nearest() const { return *min_element(sectors_.begin(), sectors_.end()); }
+
+void ObstacleDetector::project(const Mat& depth) {
+    points_.clear();
+    for (int v = options_.step / 2; v < depth.rows; v += options_.step) {
+        const uint16_t* row = depth.ptr<uint16_t>(v);
+        const double y = (v - camera_.cy) / camera_.fy;
+        for (int u = options_.step / 2; u < depth.cols; u += options_.step) {
+            double z = row[u] * camera_.depthScale;
+            if (row[u] == 0 || z < options_.minRange || z > options_.maxRange) {
+                continue;
+            }
+            Vec3d p((u - camera_.cx) / camera_.fx * z, y * z, z);
+            points_.emplace_back(rotation_ * p + translation_);
+        }
+    }
+}
+
+bool ObstacleDetector::estimateGround() {
+    // the ground candidates are the points near the nominal ground, subsampled to at most ransacPoints
+    samples_.clear();
+    size_t candidates = count_if(points_.begin(), points_.end(),
+                                 [&](const Vec3d& p) { return abs(p[2]) < options_.maxGroundHeight; });
+    size_t stride = max<size_t>(1, (candidates + options_.ransacPoints - 1) / max(options_.ransacPoints, 1));
+    size_t n{0};
+    for (auto& p : points_) {
+        if (abs(p[2]) < options_.maxGroundHeight && n++ % stride == 0) {
+            samples_.emplace_back(p);
+        }
+    }
+    if (static_cast<int>(samples_.size()) < max(options_.minGroundPoints, 3)) {
+        return false;
+    }
+
+    // RANSAC of 3 points, the plane should be nearly horizontal
+    const int sampleNum = static_cast<int>(samples_.size());
+    const double minNormalZ = cos(options_.maxGroundTilt * kDegree);
+    GroundPlane best;
+    for (int i = 0; i < options_.ransacIterations; ++i) {
+        const Vec3d& a = samples_[rng_.uniform(0, sampleNum)];
+        const Vec3d& b = samples_[rng_.uniform(0, sampleNum)];
+        const Vec3d& c = samples_[rng_.uniform(0, sampleNum)];
+        Vec3d normal = (b - a).cross(c - a);
+        double length = norm(normal);
+        if (length < 1E-9) {
+            continue;
+        }
+        normal *= (normal[2] < 0 ? -1 : 1) / length;
+        if (normal[2] < minNormalZ) {
+            continue;
+        }
+        GroundPlane plane;
+        plane.normal = normal;
+        plane.d = -normal.dot(a);
+        for (auto& p : samples_) {
+            plane.inliers += abs(plane.height(p)) < options_.groundThreshold;
+        }
+        if (plane.inliers > best.inliers) {
+            best = plane;
+        }
+    }
+    if (best.inliers < options_.minGroundPoints) {
+        return false;
+    }
+
+    // refine by least squares of z = a * x + b * y + c on inliers
+    Matx33d ata = Matx33d::zeros();
+    Vec3d atb(0, 0, 0);
+    inliers_.clear();
+    for (int i = 0; i < sampleNum; ++i) {
+        const Vec3d& p = samples_[i];
+        if (abs(best.height(p)) < options_.groundThreshold) {
+            Vec3d row(p[0], p[1], 1);
+            ata += row * row.t();
+            atb += row * p[2];
+            inliers_.emplace_back(i);
+        }
+    }
+    Vec3d coeffs;
+    if (solve3(ata, atb, &coeffs)) {
+        Vec3d normal(-coeffs[0], -coeffs[1], 1);
+        double length = norm(normal);
+        best.normal = normal / length;
+        best.d = -coeffs[2] / length;
+    }
+    best.inliers = static_cast<int>(inliers_.size());
+    ground_ = best;
+    return true;
+}
+
+void ObstacleDetector::updateGrid() {
+    const int size = cvRound(options_.gridSize / options_.cellSize);
+    const double half = options_.gridSize / 2;
+    occupancy_.create(size, size, CV_8UC1);
+    occupancy_.setTo(Scalar(static_cast<int>(CellState::Unknown)));
+    heights_.create(size, size, CV_32FC1);
+    heights_.setTo(Scalar(numeric_limits<float>::quiet_NaN()));
+    obstacleCounts_.assign(static_cast<size_t>(size) * size, 0);
+    fill(sectors_.begin(), sectors_.end(), numeric_limits<float>::infinity());
+
+    const double halfFov = options_.sectorFov / 2;
+    for (auto& p : points_) {
+        double h = ground_.height(p);
+        // the points above robot could be passed under
+        if (h > options_.maxObstacleHeight) {
+            continue;
+        }
+        int r = static_cast<int>(floor((half - p[0]) / options_.cellSize));
+        int c = static_cast<int>(floor((half - p[1]) / options_.cellSize));
+        if (r < 0 || r >= size || c < 0 || c >= size) {
+            continue;
+        }
+        float& height = heights_.at<float>(r, c);
+        if (std::isnan(height) || h > height) {
+            height = static_cast<float>(h);
+        }
+        uint8_t& state = occupancy_.at<uint8_t>(r, c);
+        if (h < options_.minObstacleHeight) {
+            // the points much lower than ground may be holes or stairs down, they are unknown
+            if (h > -options_.minObstacleHeight && state == static_cast<uint8_t>(CellState::Unknown)) {
+                state = static_cast<uint8_t>(CellState::Free);
+            }
+            continue;
+        }
+        // the cell is occupied when it has enough obstacle points, then update the sector by the cell center
+        if (++obstacleCounts_[r * size + c] != options_.minCellPoints) {
+            continue;
+        }
+        state = static_cast<uint8_t>(CellState::Occupied);
+        double x = half - (r + 0.5) * options_.cellSize;
+        double y = half - (c + 0.5) * options_.cellSize;
+        double angle = atan2(y, x) / kDegree;
+        if (abs(angle) > halfFov) {
+            continue;
+        }
+        int sector = min(static_cast<int>((angle + halfFov) / options_.sectorFov * options_.sectors),
+                         options_.sectors - 1);
+        sectors_[sector] = min(sectors_[sector], static_cast<float>(hypot(x, y)));
+    }
+}
+
+}  // namespace mev
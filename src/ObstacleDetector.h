@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+#include "FrameBundle.h"
+
+namespace mev {
+
+// mounting pose of camera on robot. The robot frame is x forward, y left and z up, with origin on the ground
+struct MountingPose {
+    double x{0};       // position x, m
+    double y{0};       // position y, m
+    double height{0};  // height above ground, m
+    double roll{0};    // roll around x axis, degree
+    double pitch{0};   // pitch around y axis, degree, positive is looking down
+    double yaw{0};     // yaw around z axis, degree, positive is looking left
+};
+
+/**
+ * @brief Get the transformation from camera optical frame(x right, y down, z forward) to robot frame
+ *
+ * @param pose          Mounting pose
+ * @param rotation      Output rotation, p_robot = rotation * p_camera + translation
+ * @param translation   Output translation
+ */
+void mountingTransform(const MountingPose& pose, cv::Matx33d* rotation, cv::Vec3d* translation);
+
+// state of occupancy grid cell
+enum class CellState : std::uint8_t {
+    Unknown = 0,   // no point
+    Free = 1,      // ground points only
+    Occupied = 2,  // obstacle points
+};
+
+// obstacle detector options, the lengths are in m
+struct ObstacleOptions {
+    int step{4};                     // pixel step to subsample depth
+    double minRange{0.2};            // min depth to use
+    double maxRange{6.0};            // max depth to use
+    double cellSize{0.05};           // cell size of grid
+    double gridSize{8.0};            // side length of square grid centered at robot origin
+    int ransacPoints{800};           // max sampled point number of RANSAC
+    int ransacIterations{50};        // iteration number of RANSAC
+    double groundThreshold{0.03};    // max distance of ground inliers to plane
+    double maxGroundHeight{0.3};     // max height of ground candidates relative to the ground of mounting pose
+    double maxGroundTilt{15.0};      // max angle between ground normal and robot z axis, degree
+    int minGroundPoints{50};         // min inlier number of ground plane
+    double minObstacleHeight{0.08};  // min height above ground of obstacles
+    double maxObstacleHeight{1.5};   // max height above ground of obstacles, points above robot are ignored
+    int minCellPoints{2};            // min obstacle point number of occupied cell
+    int sectors{24};                 // number of angular sectors
+    double sectorFov{120.0};         // field of view of all sectors around x axis, degree
+};
+
+// ground plane in robot frame, n . p + d = 0, and n is up
+struct GroundPlane {
+    cv::Vec3d normal{0, 0, 1};  // unit normal
+    double d{0};                // offset
+    int inliers{0};             // inlier number of RANSAC, 0 if the plane isn't estimated in this frame
+
+    // height of point above plane
+    inline double height(const cv::Vec3d& p) const { return normal.dot(p) + d; }
+};
+
+// obstacle detector statistics
+struct ObstacleStatistics {
+    std::uint64_t frames{0};       // processed frame number
+    std::uint64_t points{0};       // total back-projected point number
+    std::uint64_t groundFound{0};  // frame number that ground plane is estimated
+    std::int64_t projectTime{0};   // time to back-project depth, ns
+    std::int64_t groundTime{0};    // time of ground RANSAC, ns
+    std::int64_t gridTime{0};      // time to update grid and sectors, ns
+};
+
+/**
+ * @brief Obstacle detector from depth image. The subsampled depth is back-projected to robot frame by the depth camera
+ * and mounting pose, the ground plane is estimated by RANSAC on the points near the nominal ground and refined by least
+ * squares, then the points are classified by the height above ground and accumulated to an occupancy grid and a height
+ * grid around the robot. The nearest occupied cell of each angular sector is the obstacle distance for avoidance.
+ *
+ * The grid image is forward up and left on left side, the robot origin is at the center. If the ground plane isn't
+ * found, the last plane(or the nominal ground of mounting pose) is used. Not thread safe
+ */
+class ObstacleDetector {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param camera    Depth camera
+     * @param pose      Mounting pose of camera
+     * @param options   Detector options
+     */
+    ObstacleDetector(const DepthCamera& camera, const MountingPose& pose,
+                     const ObstacleOptions& options = ObstacleOptions());
+
+    /**
+     * @brief Detect obstacles from depth
+     *
+     * @param depth Depth image, CV_16UC1
+     */
+    void detect(const cv::Mat& depth);
+
+    // occupancy grid, CV_8UC1 of CellState
+    inline const cv::Mat& occupancy() const { return occupancy_; }
+
+    // height grid, the max height above ground of each cell, CV_32FC1, NaN if unknown
+    inline const cv::Mat& heights() const { return heights_; }
+
+    // nearest obstacle distance of each sector from right to left, m, infinity if no obstacle
+    inline const std::vector<float>& sectors() const { return sectors_; }
+
+    // ground plane of last frame
+    inline const GroundPlane& ground() const { return ground_; }
+
+    // nearest obstacle distance of all sectors, infinity if no obstacle
+    float nearest() const;
+
+    inline const ObstacleOptions& options() const { return options_; }
+
+    inline const ObstacleStatistics& statistics() const { return statistics_; }
+
+  private:
+    // back-project subsampled depth to robot frame
+    void project(const cv::Mat& depth);
+
+    // estimate ground plane by RANSAC, return false if not found
+    bool estimateGround();
+
+    // update grid and sectors with the points
+    void updateGrid();
+
+  private:
+    DepthCamera camera_;
+    ObstacleOptions options_;
+    ObstacleStatistics statistics_;
+    cv::Matx33d rotation_;                       // rotation from camera to robot
+    cv::Vec3d translation_;                      // translation from camera to robot
+    cv::RNG rng_;                                // random generator of RANSAC
+    std::vector<cv::Vec3d> points_;              // points in robot frame
+    std::vector<cv::Vec3d> samples_;             // ground candidates
+    std::vector<int> inliers_;                   // inlier indices of samples
+    GroundPlane ground_;                         // ground plane
+    cv::Mat occupancy_;                          // occupancy grid
+    cv::Mat heights_;                            // height grid
+    std::vector<std::uint16_t> obstacleCounts_;  // obstacle point number of each cell
+    std::vector<float> sectors_;                 // nearest obstacle distance of each sector
+};
+
+}  // namespace mev
@@ -0,0 +1,770 @@
+#include "Odometry.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include "ClockSync.h"
+#include "ImuIntegration.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// chi-square thresholds at 95% of 2 DOF(mono) and 3 DOF(stereo) observations
+constexpr double kChi2Mono = 5.991;
+constexpr double kChi2Stereo = 7.815;
+// min depth of landmark in camera, m
+constexpr double kMinDepth = 0.05;
+// cost of landmark behind camera, so the optimizer won't move landmarks there
+constexpr double kBehindCost = 100.0;
+
+typedef Matx<double, 3, 6> Matx36d;
+typedef Matx<double, 6, 3> Matx63d;
+
+// observation of landmark to estimate pose
+struct PoseObservation {
+    Vec3d landmark;      // landmark in world
+    Point2f point;       // position in left image
+    float disparity{0};  // disparity, 0 if not matched
+    bool inlier{true};
+};
+
+// skew symmetric matrix of cross product
+inline Matx33d skew(const Vec3d& v) { return Matx33d(0, -v[2], v[1], v[2], 0, -v[0], -v[1], v[0], 0); }
+
+/**
+ * @brief Project the point in camera frame to left and right image, and get the residual to observation. The right row
+ * is zero if the observation isn't matched in right image
+ *
+ * @param camera    Rectified stereo camera
+ * @param p         Point in camera frame
+ * @param point     Observed position in left image
+ * @param disparity Observed disparity, 0 if not matched
+ * @param residual  Output residual, observation - projection, (u, v, u_right)
+ * @param jacobian  Output Jacobian of projection to the point, nullptr if not needed
+ * @return False if the point is behind camera
+ */
+bool project(const StereoCamera& camera, const Vec3d& p, const Point2f& point, float disparity, Vec3d* residual,
+             Matx33d* jacobian) {
+    if (p[2] < kMinDepth) {
+        return false;
+    }
+    double iz = 1 / p[2];
+    double u = camera.fx * p[0] * iz + camera.cx;
+    (*residual)[0] = point.x - u;
+    (*residual)[1] = point.y - (camera.fy * p[1] * iz + camera.cy);
+    (*residual)[2] = disparity > 0 ? point.x - disparity - (u - camera.fx * camera.baseline * iz) : 0;
+    if (jacobian) {
+        double iz2 = iz * iz;
+        *jacobian = Matx33d(camera.fx * iz, 0, -camera.fx * p[0] * iz2,  // u
+                            0, camera.fy * iz, -camera.fy * p[1] * iz2,  // v
+                            camera.fx * iz, 0, -camera.fx * (p[0] - camera.baseline) * iz2);
+        if (disparity <= 0) {
+            (*jacobian)(2, 0) = (*jacobian)(2, 1) = (*jacobian)(2, 2) = 0;
+        }
+    }
+    return true;
+}
+
+// chi-square threshold of observation
+inline double chi2Threshold(float disparity) { return disparity > 0 ? kChi2Stereo : kChi2Mono; }
+
+// Huber weight of normalized squared error
+inline double huberWeight(double e2, double threshold) { return e2 <= threshold ? 1.0 : sqrt(threshold / e2); }
+
+// Huber cost of normalized squared error
+inline double huberCost(double e2, double threshold) {
+    return e2 <= threshold ? e2 : 2 * sqrt(threshold * e2) - threshold;
+}
+
+// Jacobian of projection to pose perturbation(rotation, translation), R <- R * exp(w), t <- t + dt
+inline Matx36d poseJacobian(const Matx33d& J, const Vec3d& p, const Matx33d& Rt) {
+    Matx33d Jr = J * skew(p);
+    Matx33d Jt = -(J * Rt);
+    Matx36d Jp;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            Jp(i, j) = Jr(i, j);
+            Jp(i, j + 3) = Jt(i, j);
+        }
+    }
+    return Jp;
+}
+
+/**
+ * @brief Estimate camera pose from landmarks by Gauss-Newton in 4 rounds like ORB-SLAM, the observations are
+ * classified to inliers and outliers by chi-square test after each round, and only the inliers are used in next round.
+ * The Huber loss is used except in the last round
+ *
+ * @param camera        Rectified stereo camera
+ * @param sigma         Std of feature position, pixel
+ * @param observations  Observations, the inlier flag is updated
+ * @param R             Initial and output rotation from camera to world
+ * @param t             Initial and output translation
+ * @return Inlier number
+ */
+int estimatePose(const StereoCamera& camera, double sigma, vector<PoseObservation>& observations, Matx33d& R,
+                 Vec3d& t) {
+    const double info = 1 / (sigma * sigma);
+    int inliers{0};
+    for (int round = 0; round < 4; ++round) {
+        for (int iteration = 0; iteration < 10; ++iteration) {
+            Matx66d H;
+            Vec6d b;
+            Matx33d Rt = R.t();
+            int used{0};
+            for (auto& o : observations) {
+                Vec3d e;
+                Matx33d J;
+                Vec3d p = Rt * (o.landmark - t);
+                if (!o.inlier || !project(camera, p, o.point, o.disparity, &e, &J)) {
+                    continue;
+                }
+                double w = info * (round < 3 ? huberWeight(e.dot(e) * info, chi2Threshold(o.disparity)) : 1.0);
+                Matx36d Jp = poseJacobian(J, p, Rt);
+                H += Jp.t() * Jp * w;
+                b += Jp.t() * e * w;
+                ++used;
+            }
+            if (used < 3) {
+                return 0;
+            }
+            Vec6d dx = H.solve(b, DECOMP_CHOLESKY);
+            R = R * expRotation(Vec3d(dx[0], dx[1], dx[2]));
+            t += Vec3d(dx[3], dx[4], dx[5]);
+            if (norm(dx) < 1.0E-6) {
+                break;
+            }
+        }
+
+        // classify all observations, the outliers may become inliers after the pose is refined
+        inliers = 0;
+        Matx33d Rt = R.t();
+        for (auto& o : observations) {
+            Vec3d e;
+            o.inlier = project(camera, Rt * (o.landmark - t), o.point, o.disparity, &e, nullptr) &&
+                       e.dot(e) * info < chi2Threshold(o.disparity);
+            inliers += o.inlier;
+        }
+    }
+    return inliers;
+}
+
+}  // namespace
+
+StereoInertialOdometry::StereoInertialOdometry(const StereoCamera& camera, const Matx33d& cameraImu,
+                                               const OdometryOptions& options)
+    : camera_(camera),
+      cameraImu_(cameraImu),
+      cameraMatrix_(camera.fx, 0, camera.cx, 0, camera.fy, camera.cy, 0, 0, 1),
+      options_(options),
+      frames_(options.queueSize),
+      poses_(options.dropFrames ? 64 : 0),
+      tracker_(options.tracker),
+      stereo_(camera, options.stereo),
+      rotation_(Matx33d::eye()) {
+    CHECK_GT(camera_.fx, 0) << "invalid camera";
+    CHECK_GT(camera_.baseline, 0) << "invalid baseline";
+    CHECK_GE(options_.windowSize, 2) << "the sliding window should have at least 2 keyframes";
+    frontEndThread_ = thread(&StereoInertialOdometry::frontEndLoop, this);
+    keyframeThread_ = thread(&StereoInertialOdometry::keyframeLoop, this);
+    optimizerThread_ = thread(&StereoInertialOdometry::optimizerLoop, this);
+}
+
+StereoInertialOdometry::~StereoInertialOdometry() { stop(); }
+
+bool StereoInertialOdometry::push(const FrameBundle& bundle) {
+    if (stopped_ || !bundle.right.isValid()) {
+        return false;
+    }
+    for (auto& record : bundle.imu) {
+        imu_.push(record);
+    }
+    InputFrame frame;
+    frame.frameId = bundle.left.frameId;
+    frame.timestamp = bundle.left.timestamp;
+    frame.hostTimestamp = bundle.left.hostTimestamp;
+    frame.pushTime = hostNow();
+    frame.left = bundle.left.image.clone();
+    frame.right = bundle.right.image.clone();
+    if (!options_.dropFrames) {
+        return frames_.push(std::move(frame));
+    }
+    bool dropped{false};
+    bool ok = frames_.pushDropOldest(std::move(frame), &dropped);
+    if (dropped) {
+        lock_guard<mutex> lock(mutex_);
+        ++statistics_.dropped;
+    }
+    return ok;
+}
+
+bool StereoInertialOdometry::tryPop(OdometryPose* pose) { return poses_.tryPop(*pose); }
+
+bool StereoInertialOdometry::pop(OdometryPose* pose) { return poses_.pop(*pose); }
+
+void StereoInertialOdometry::stop() {
+    if (stopped_) {
+        return;
+    }
+    stopped_ = true;
+    // each thread closes the queue to next thread when its input queue is drained
+    frames_.close();
+    frontEndThread_.join();
+    keyframeThread_.join();
+    optimizerThread_.join();
+    poses_.close();
+}
+
+OdometryStatistics StereoInertialOdometry::statistics() const {
+    lock_guard<mutex> lock(mutex_);
+    return statistics_;
+}
+
+void StereoInertialOdometry::frontEndLoop() {
+    setTraceThreadName("vo front-end");
+    InputFrame frame;
+    while (frames_.pop(frame)) {
+        track(frame);
+    }
+    tracked_.close();
+}
+
+void StereoInertialOdometry::track(const InputFrame& frame) {
+    applyMapUpdate();
+
+    // track features with the prediction of gyroscope rotation since last frame
+    int64_t startTime = hostNow();
+    Matx33d gyroRotation = Matx33d::eye();
+    Matx33d homography;
+    bool predict{false};
+    if (initialized_) {
+        ImuSpan imu = imu_.slice(lastTimestamp_, frame.timestamp);
+        if (!imu.empty()) {
+            Matx33d imuRotation = integrateGyro(imu, lastTimestamp_, frame.timestamp);
+            gyroRotation = cameraImu_ * imuRotation * cameraImu_.t();
+            homography = rotationHomography(cameraMatrix_, cameraImu_, imuRotation);
+            predict = true;
+        }
+    }
+    const vector<Feature>* features{nullptr};
+    {
+        TraceScope trace("vo track");
+        features = &tracker_.track(frame.left, predict ? &homography : nullptr);
+    }
+    int64_t stereoStartTime = hostNow();
+    const vector<StereoPoint>* points{nullptr};
+    {
+        TraceScope trace("vo stereo");
+        points = &stereo_.match(frame.left, frame.right, *features);
+    }
+    int64_t poseStartTime = hostNow();
+    TraceScope trace("vo pose");
+
+    // observations, the stereo points are in the order of features
+    TrackedFrame tracked;
+    tracked.timestamp = frame.timestamp;
+    tracked.gyroRotation = gyroRotation;
+    tracked.observations.resize(features->size());
+    vector<const StereoPoint*> stereoPoints(features->size(), nullptr);
+    for (size_t i = 0, j = 0; i < features->size(); ++i) {
+        auto& o = tracked.observations[i];
+        o.id = (*features)[i].id;
+        o.point = (*features)[i].point;
+        if (j < points->size() && (*points)[j].id == o.id) {
+            o.disparity = (*points)[j].disparity;
+            stereoPoints[i] = &(*points)[j++];
+        }
+    }
+
+    // estimate pose from the prediction of gyroscope rotation and constant velocity
+    OdometryPose output;
+    Matx33d R;
+    Vec3d t;
+    if (!initialized_) {
+        R = gravityRotation(frame.timestamp);
+        t = Vec3d(0, 0, 0);
+        tracked.reset = true;
+    } else {
+        double dt = (frame.timestamp - lastTimestamp_) * 1.0E-9;
+        R = rotation_ * gyroRotation;
+        t = translation_ + velocity_ * dt;
+        vector<PoseObservation> poseObservations;
+        vector<size_t> indexes;
+        for (size_t i = 0; i < tracked.observations.size(); ++i) {
+            auto& o = tracked.observations[i];
+            auto it = localMap_.find(o.id);
+            if (it != localMap_.end()) {
+                poseObservations.emplace_back();
+                poseObservations.back().landmark = it->second;
+                poseObservations.back().point = o.point;
+                poseObservations.back().disparity = o.disparity;
+                indexes.emplace_back(i);
+            }
+        }
+        Matx33d predictedRotation = R;
+        Vec3d predictedTranslation = t;
+        if (static_cast<int>(poseObservations.size()) >= options_.minInliers) {
+            output.inliers = estimatePose(camera_, options_.pixelSigma, poseObservations, R, t);
+        }
+        if (output.inliers < options_.minInliers) {
+            // lost, reset the map at predicted pose
+            R = predictedRotation;
+            t = predictedTranslation;
+            output.lost = true;
+            tracked.reset = true;
+            localMap_.clear();
+            velocity_ = Vec3d(0, 0, 0);
+            ++epoch_;
+        } else {
+            for (size_t i = 0; i < poseObservations.size(); ++i) {
+                if (!poseObservations[i].inlier) {
+                    tracked.observations[indexes[i]].outlier = true;
+                }
+            }
+            velocity_ = dt > 0 ? (t - translation_) / dt : velocity_;
+        }
+    }
+
+    // local map of tracked landmarks, the lost tracks and outliers are removed, and the new stereo points are added
+    unordered_map<uint64_t, Vec3d> localMap;
+    localMap.reserve(tracked.observations.size());
+    for (size_t i = 0; i < tracked.observations.size(); ++i) {
+        auto& o = tracked.observations[i];
+        auto it = localMap_.find(o.id);
+        if (o.outlier) {
+            continue;
+        } else if (it != localMap_.end()) {
+            localMap.emplace(o.id, it->second);
+        } else if (stereoPoints[i]) {
+            auto& p = stereoPoints[i]->position;
+            localMap.emplace(o.id, R * Vec3d(p.x, p.y, p.z) + t);
+        }
+    }
+    localMap_.swap(localMap);
+    initialized_ = true;
+    lastTimestamp_ = frame.timestamp;
+    rotation_ = R;
+    translation_ = t;
+
+    tracked.rotation = tracked.frontRotation = R;
+    tracked.translation = tracked.frontTranslation = t;
+    tracked.epoch = epoch_;
+    tracked_.push(std::move(tracked));
+
+    int64_t endTime = hostNow();
+    output.frameId = frame.frameId;
+    output.timestamp = frame.timestamp;
+    output.pose.timestamp = frame.hostTimestamp;
+    output.pose.rotation = R;
+    output.pose.translation = t;
+    output.latency = endTime - frame.pushTime;
+    {
+        lock_guard<mutex> lock(mutex_);
+        ++statistics_.frames;
+        statistics_.lost += output.lost;
+        statistics_.trackTime += stereoStartTime - startTime;
+        statistics_.stereoTime += poseStartTime - stereoStartTime;
+        statistics_.poseTime += endTime - poseStartTime;
+        statistics_.latency += output.latency;
+    }
+    poses_.pushDropOldest(std::move(output));
+}
+
+void StereoInertialOdometry::applyMapUpdate() {
+    MapUpdate update;
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (!mapUpdate_.valid) {
+            return;
+        }
+        update = std::move(mapUpdate_);
+        mapUpdate_.valid = false;
+    }
+    if (update.epoch != epoch_) {
+        return;
+    }
+    // the correction from front-end world to optimized world by the keyframe pose, which is applied to the landmarks
+    // created after the keyframe and the current pose, then the optimized landmarks replace the front-end ones
+    Matx33d Rc = update.rotation * update.frontRotation.t();
+    Vec3d tc = update.translation - Rc * update.frontTranslation;
+    for (auto& landmark : localMap_) {
+        landmark.second = Rc * landmark.second + tc;
+    }
+    for (auto& landmark : update.landmarks) {
+        auto it = localMap_.find(landmark.first);
+        if (it != localMap_.end()) {
+            it->second = landmark.second;
+        }
+    }
+    rotation_ = Rc * rotation_;
+    translation_ = Rc * translation_ + tc;
+    velocity_ = Rc * velocity_;
+}
+
+Matx33d StereoInertialOdometry::gravityRotation(int64_t timestamp) const {
+    // the accelerator points up if the camera is static, average the records in last 0.2 s
+    Vec3d acc(0, 0, 0);
+    for (auto& record : imu_.slice(timestamp - 200000000, timestamp)) {
+        acc += Vec3d(record.acc[0], record.acc[1], record.acc[2]);
+    }
+    if (norm(acc) < 1.0E-6) {
+        LOG(WARNING) << "there isn't any accelerator record, the world frame is the first camera frame";
+        return Matx33d::eye();
+    }
+    // the min rotation from up in camera frame to z of world
+    Vec3d up = cameraImu_ * acc * (1 / norm(acc));
+    Vec3d axis = up.cross(Vec3d(0, 0, 1));
+    double s = norm(axis);
+    double c = up[2];
+    if (s < 1.0E-9) {
+        return c > 0 ? Matx33d::eye() : expRotation(Vec3d(CV_PI, 0, 0));
+    }
+    return expRotation(axis * (atan2(s, c) / s));
+}
+
+void StereoInertialOdometry::keyframeLoop() {
+    setTraceThreadName("vo keyframe");
+    TrackedFrame frame;
+    TrackedFrame keyframe;
+    bool hasKeyframe{false};
+    Matx33d gyroRotation = Matx33d::eye();  // gyroscope rotation since last keyframe
+    while (tracked_.pop(frame)) {
+        TraceScope trace("vo keyframe");
+        int64_t startTime = hostNow();
+        gyroRotation = gyroRotation * frame.gyroRotation;
+        bool insert = !hasKeyframe || frame.reset || isKeyframe(frame, keyframe);
+        if (insert) {
+            frame.gyroRotation = gyroRotation;
+            gyroRotation = Matx33d::eye();
+            keyframe = frame;
+            hasKeyframe = true;
+            keyframes_.push(std::move(frame));
+        }
+        lock_guard<mutex> lock(mutex_);
+        statistics_.keyframes += insert;
+        statistics_.keyframeTime += hostNow() - startTime;
+    }
+    keyframes_.close();
+}
+
+bool StereoInertialOdometry::isKeyframe(const TrackedFrame& frame, const TrackedFrame& keyframe) const {
+    if ((frame.timestamp - keyframe.timestamp) * 1.0E-9 >= options_.maxKeyframeInterval) {
+        return true;
+    }
+    // the features of keyframe, and whether they are landmarks
+    unordered_map<uint64_t, pair<Point2f, bool>> keyframeFeatures;
+    keyframeFeatures.reserve(keyframe.observations.size());
+    int landmarks{0};
+    for (auto& o : keyframe.observations) {
+        bool isLandmark = o.disparity > 0 && !o.outlier;
+        keyframeFeatures.emplace(o.id, make_pair(o.point, isLandmark));
+        landmarks += isLandmark;
+    }
+    int tracked{0}, shared{0};
+    double parallax{0};
+    for (auto& o : frame.observations) {
+        auto it = keyframeFeatures.find(o.id);
+        if (it != keyframeFeatures.end()) {
+            tracked += it->second.second;
+            parallax += norm(o.point - it->second.first);
+            ++shared;
+        }
+    }
+    return shared == 0 || tracked < options_.keyframeRatio * landmarks ||
+           parallax / shared >= options_.keyframeParallax;
+}
+
+void StereoInertialOdometry::optimizerLoop() {
+    setTraceThreadName("vo optimizer");
+    TrackedFrame keyframe;
+    while (keyframes_.pop(keyframe)) {
+        TraceScope trace("vo optimize");
+        int64_t startTime = hostNow();
+        addKeyframe(std::move(keyframe));
+        // add the keyframes arrived during last optimization together, so the optimizer never falls behind
+        while (keyframes_.tryPop(keyframe)) {
+            addKeyframe(std::move(keyframe));
+        }
+        optimizeWindow();
+        removeOutliers();
+        removeLandmarks();
+
+        // send the optimized pose of last keyframe and its landmarks to front-end
+        const TrackedFrame& last = window_.back();
+        MapUpdate update;
+        update.valid = true;
+        update.epoch = last.epoch;
+        update.frontRotation = last.frontRotation;
+        update.frontTranslation = last.frontTranslation;
+        update.rotation = last.rotation;
+        update.translation = last.translation;
+        for (auto& o : last.observations) {
+            auto it = landmarks_.find(o.id);
+            if (!o.outlier && it != landmarks_.end()) {
+                update.landmarks.emplace_back(o.id, it->second);
+            }
+        }
+        lock_guard<mutex> lock(mutex_);
+        mapUpdate_ = std::move(update);
+        ++statistics_.optimizations;
+        statistics_.landmarks += landmarks_.size();
+        statistics_.optimizeTime += hostNow() - startTime;
+    }
+}
+
+void StereoInertialOdometry::addKeyframe(TrackedFrame keyframe) {
+    if (keyframe.reset) {
+        window_.clear();
+        landmarks_.clear();
+    }
+    if (!window_.empty()) {
+        // the front-end pose may miss the latest corrections, so chain the relative pose from previous keyframe in
+        // front-end world to the optimized previous keyframe
+        const TrackedFrame& previous = window_.back();
+        Matx33d Rt = previous.frontRotation.t();
+        keyframe.rotation = previous.rotation * Rt * keyframe.frontRotation;
+        keyframe.translation =
+            previous.rotation * (Rt * (keyframe.frontTranslation - previous.frontTranslation)) + previous.translation;
+    }
+
+    // triangulate new landmarks by disparity
+    for (auto& o : keyframe.observations) {
+        if (o.outlier || o.disparity <= 0 || landmarks_.count(o.id)) {
+            continue;
+        }
+        double z = camera_.fx * camera_.baseline / o.disparity;
+        Vec3d p((o.point.x - camera_.cx) * z / camera_.fx, (o.point.y - camera_.cy) * z / camera_.fy, z);
+        landmarks_.emplace(o.id, keyframe.rotation * p + keyframe.translation);
+    }
+    window_.emplace_back(std::move(keyframe));
+    if (window_.size() > static_cast<size_t>(options_.windowSize)) {
+        window_.pop_front();
+        removeLandmarks();
+    }
+}
+
+void StereoInertialOdometry::optimizeWindow() {
+    // the first keyframe is fixed, the pose parameters of others are (rotation, translation) perturbations
+    const int poseNum = static_cast<int>(window_.size()) - 1;
+    const double info = 1 / (options_.pixelSigma * options_.pixelSigma);
+    double lambda{1.0E-4};
+    double cost = windowCost();
+
+    // normal equations of one landmark, and the blocks between it and the poses observing it
+    struct LandmarkBlock {
+        uint64_t id{0};
+        Matx33d H;
+        Vec3d b;
+        vector<pair<int, Matx63d>> poses;  // pose index and pose-landmark block
+        Matx33d Hinv;
+    };
+    unordered_map<uint64_t, size_t> blockIndex;
+    vector<LandmarkBlock> blocks;
+    for (int iteration = 0; iteration < options_.iterations; ++iteration) {
+        Mat H = Mat::zeros(6 * poseNum, 6 * poseNum, CV_64FC1);
+        Mat b = Mat::zeros(6 * poseNum, 1, CV_64FC1);
+        auto addPoseBlock = [&](int i, int j, const Matx66d& block) {
+            for (int r = 0; r < 6; ++r) {
+                for (int c = 0; c < 6; ++c) {
+                    H.at<double>(6 * i + r, 6 * j + c) += block(r, c);
+                }
+            }
+        };
+        auto addPoseVector = [&](int i, const Vec6d& v) {
+            for (int r = 0; r < 6; ++r) {
+                b.at<double>(6 * i + r) += v[r];
+            }
+        };
+
+        // reprojection errors
+        blockIndex.clear();
+        blocks.clear();
+        for (int k = 0; k < static_cast<int>(window_.size()); ++k) {
+            const TrackedFrame& keyframe = window_[k];
+            Matx33d Rt = keyframe.rotation.t();
+            for (auto& o : keyframe.observations) {
+                auto it = landmarks_.find(o.id);
+                if (o.outlier || it == landmarks_.end()) {
+                    continue;
+                }
+                Vec3d e;
+                Matx33d J;
+                Vec3d p = Rt * (it->second - keyframe.translation);
+                if (!project(camera_, p, o.point, o.disparity, &e, &J)) {
+                    continue;
+                }
+                double w = info * huberWeight(e.dot(e) * info, chi2Threshold(o.disparity));
+                auto index = blockIndex.emplace(o.id, blocks.size());
+                if (index.second) {
+                    blocks.emplace_back();
+                    blocks.back().id = o.id;
+                }
+                LandmarkBlock& block = blocks[index.first->second];
+                Matx33d Jl = J * Rt;
+                block.H += Jl.t() * Jl * w;
+                block.b += Jl.t() * e * w;
+                if (k > 0) {
+                    Matx36d Jp = poseJacobian(J, p, Rt);
+                    addPoseBlock(k - 1, k - 1, Jp.t() * Jp * w);
+                    addPoseVector(k - 1, Jp.t() * e * w);
+                    block.poses.emplace_back(k - 1, Jp.t() * Jl * w);
+                }
+            }
+        }
+
+        // gyroscope rotations between keyframes, r = log(dR^T * R_i^T * R_j), dr/dw_j = I, dr/dw_i = -(R_i^T R_j)^T
+        for (int k = 1; options_.gyroSigma > 0 && k < static_cast<int>(window_.size()); ++k) {
+            const TrackedFrame& previous = window_[k - 1];
+            const TrackedFrame& current = window_[k];
+            double dt = max((current.timestamp - previous.timestamp) * 1.0E-9, 1.0E-3);
+            double w = 1 / (options_.gyroSigma * options_.gyroSigma * dt);
+            Matx33d E = previous.rotation.t() * current.rotation;
+            Vec3d r = logRotation(current.gyroRotation.t() * E);
+            Matx66d Hjj, Hii, Hij;
+            Vec6d bj, bi;
+            Matx33d Ji = -E.t();
+            Matx33d Hii3 = Ji.t() * Ji * w, Hij3 = Ji.t() * w;
+            Vec3d bi3 = Ji.t() * r * (-w);
+            for (int i = 0; i < 3; ++i) {
+                Hjj(i, i) = w;
+                bj[i] = -w * r[i];
+                bi[i] = bi3[i];
+                for (int j = 0; j < 3; ++j) {
+                    Hii(i, j) = Hii3(i, j);
+                    Hij(i, j) = Hij3(i, j);
+                }
+            }
+            addPoseBlock(k - 1, k - 1, Hjj);
+            addPoseVector(k - 1, bj);
+            if (k > 1) {
+                addPoseBlock(k - 2, k - 2, Hii);
+                addPoseBlock(k - 2, k - 1, Hij);
+                addPoseBlock(k - 1, k - 2, Hij.t());
+                addPoseVector(k - 2, bi);
+            }
+        }
+
+        // Levenberg-Marquardt damping, and marginalize the landmarks by Schur complement
+        for (int i = 0; i < 6 * poseNum; ++i) {
+            H.at<double>(i, i) *= 1 + lambda;
+        }
+        for (auto& block : blocks) {
+            for (int i = 0; i < 3; ++i) {
+                block.H(i, i) = block.H(i, i) * (1 + lambda) + 1.0E-9;
+            }
+            block.Hinv = block.H.inv(DECOMP_CHOLESKY);
+            for (auto& a : block.poses) {
+                Matx63d HaHinv = a.second * block.Hinv;
+                addPoseVector(a.first, -(HaHinv * block.b));
+                for (auto& c : block.poses) {
+                    addPoseBlock(a.first, c.first, -(HaHinv * c.second.t()));
+                }
+            }
+        }
+        Mat dx = Mat::zeros(6 * poseNum, 1, CV_64FC1);
+        if (poseNum > 0 && !solve(H, b, dx, DECOMP_CHOLESKY)) {
+            lambda *= 10;
+            continue;
+        }
+
+        // update and keep the old landmarks to revert if the cost increases
+        for (int k = 1; k < static_cast<int>(window_.size()); ++k) {
+            const double* d = dx.ptr<double>(6 * (k - 1));
+            window_[k].rotation = window_[k].rotation * expRotation(Vec3d(d[0], d[1], d[2]));
+            window_[k].translation += Vec3d(d[3], d[4], d[5]);
+        }
+        vector<pair<uint64_t, Vec3d>> oldLandmarks;
+        oldLandmarks.reserve(blocks.size());
+        for (auto& block : blocks) {
+            Vec3d rhs = block.b;
+            for (auto& a : block.poses) {
+                rhs -= a.second.t() * Vec6d(dx.ptr<double>(6 * a.first));
+            }
+            Vec3d& landmark = landmarks_[block.id];
+            oldLandmarks.emplace_back(block.id, landmark);
+            landmark += block.Hinv * rhs;
+        }
+        double newCost = windowCost();
+        if (newCost < cost) {
+            bool converged = cost - newCost < 1.0E-6 * cost;
+            cost = newCost;
+            lambda = max(lambda * 0.1, 1.0E-7);
+            if (converged) {
+                break;
+            }
+        } else {
+            for (int k = 1; k < static_cast<int>(window_.size()); ++k) {
+                const double* d = dx.ptr<double>(6 * (k - 1));
+                window_[k].rotation = window_[k].rotation * expRotation(-Vec3d(d[0], d[1], d[2]));
+                window_[k].translation -= Vec3d(d[3], d[4], d[5]);
+            }
+            for (auto& landmark : oldLandmarks) {
+                landmarks_[landmark.first] = landmark.second;
+            }
+            lambda *= 10;
+        }
+    }
+}
+
+double StereoInertialOdometry::windowCost() const {
+    const double info = 1 / (options_.pixelSigma * options_.pixelSigma);
+    double cost{0};
+    for (auto& keyframe : window_) {
+        Matx33d Rt = keyframe.rotation.t();
+        for (auto& o : keyframe.observations) {
+            auto it = landmarks_.find(o.id);
+            if (o.outlier || it == landmarks_.end()) {
+                continue;
+            }
+            Vec3d e;
+            if (project(camera_, Rt * (it->second - keyframe.translation), o.point, o.disparity, &e, nullptr)) {
+                cost += huberCost(e.dot(e) * info, chi2Threshold(o.disparity));
+            } else {
+                cost += kBehindCost;
+            }
+        }
+    }
+    for (size_t k = 1; options_.gyroSigma > 0 && k < window_.size(); ++k) {
+        double dt = max((window_[k].timestamp - window_[k - 1].timestamp) * 1.0E-9, 1.0E-3);
+        Vec3d r = logRotation(window_[k].gyroRotation.t() * window_[k - 1].rotation.t() * window_[k].rotation);
+        cost += r.dot(r) / (options_.gyroSigma * options_.gyroSigma * dt);
+    }
+    return cost;
+}
+
+void StereoInertialOdometry::removeOutliers() {
+    const double info = 1 / (options_.pixelSigma * options_.pixelSigma);
+    for (auto& keyframe : window_) {
+        Matx33d Rt = keyframe.rotation.t();
+        for (auto& o : keyframe.observations) {
+            auto it = landmarks_.find(o.id);
+            if (o.outlier || it == landmarks_.end()) {
+                continue;
+            }
+            Vec3d e;
+            o.outlier = !project(camera_, Rt * (it->second - keyframe.translation), o.point, o.disparity, &e,
+                                 nullptr) ||
+                        e.dot(e) * info >= chi2Threshold(o.disparity);
+        }
+    }
+}
+
+void StereoInertialOdometry::removeLandmarks() {
+    unordered_map<uint64_t, Vec3d> landmarks;
+    landmarks.reserve(landmarks_.size());
+    for (auto& keyframe : window_) {
+        for (auto& o : keyframe.observations) {
+            auto it = landmarks_.find(o.id);
+            if (!o.outlier && it != landmarks_.end()) {
+                landmarks.emplace(*it);
+            }
+        }
+    }
+    landmarks_.swap(landmarks);
+}
+
+}  // namespace mev
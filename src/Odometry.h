@@ -0,0 +1,241 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "BlockingQueue.h"
+#include "FeatureTracker.h"
+#include "FrameBundle.h"
+#include "ImuBuffer.h"
+#include "SparseStereo.h"
+#include "Trajectory.h"
+
+namespace mev {
+
+// stereo-inertial odometry options
+struct OdometryOptions {
+    TrackerOptions tracker;           // feature tracker of left image
+    SparseStereoOptions stereo;       // sparse stereo matcher
+    std::size_t queueSize{2};         // max frame number waiting for front-end
+    bool dropFrames{true};            // drop the oldest frame if front-end is busy(live), or block push(replay)
+    int minInliers{15};               // min inlier landmark number of pose estimation, or the tracking is lost
+    double pixelSigma{1.0};           // std of feature position, pixel
+    double keyframeParallax{20.0};    // insert keyframe if the average parallax since last keyframe is larger, pixel
+    double keyframeRatio{0.6};        // insert keyframe if the ratio of tracked landmarks of last keyframe is less
+    double maxKeyframeInterval{1.0};  // max time between keyframes, s
+    int windowSize{8};                // keyframe number of sliding window
+    int iterations{5};                // max Levenberg-Marquardt iterations of sliding window optimization
+    double gyroSigma{0.01};           // std of gyroscope rotation between keyframes, rad/sqrt(s), 0 to disable
+};
+
+// camera pose of frame from front-end
+struct OdometryPose {
+    std::uint32_t frameId{0};   // frame ID of left image
+    std::int64_t timestamp{0};  // device timestamp, ns
+    StampedPose pose;           // camera pose of rectified left camera, the timestamp is the host timestamp
+    int inliers{0};             // inlier landmark number of pose estimation
+    bool lost{false};           // whether tracking is lost, then the pose is predicted and the map is reset
+    std::int64_t latency{0};    // time from push to pose output, ns
+};
+
+// odometry statistics, the time is the wall time of each stage
+struct OdometryStatistics {
+    std::uint64_t frames{0};         // processed frame number by front-end
+    std::uint64_t dropped{0};        // dropped frame number as front-end is busy
+    std::uint64_t lost{0};           // lost frame number
+    std::uint64_t keyframes{0};      // keyframe number
+    std::uint64_t optimizations{0};  // sliding window optimization number
+    std::uint64_t landmarks{0};      // total landmark number of sliding window of all optimizations
+    std::int64_t trackTime{0};       // time to track features, ns
+    std::int64_t stereoTime{0};      // time to match stereo, ns
+    std::int64_t poseTime{0};        // time to estimate pose and update local map, ns
+    std::int64_t keyframeTime{0};    // time to select keyframes, ns
+    std::int64_t optimizeTime{0};    // time of sliding window optimization, ns
+    std::int64_t latency{0};         // total latency from push to pose output, ns
+};
+
+/**
+ * @brief Stereo-inertial odometry on rectified stereo images and IMU. It runs in 3 threads connected by queues:
+ *
+ *  push --> frame queue --> front-end --> keyframe selection --> sliding window optimizer
+ *                              |  ^-------- optimized landmarks ----------------|
+ *                              v
+ *                         pose queue --> pop
+ *
+ *  1. front-end, the features are tracked with the gyroscope rotation prediction and matched in right image, then the
+ *     pose is estimated against the local map of tracked landmarks by robust Gauss-Newton, and the new stereo points
+ *     are added to map. The pose of each frame is output at frame rate
+ *  2. keyframe selection, a keyframe is inserted if the tracked landmarks of last keyframe are few, the parallax is
+ *     large or the time is long since last keyframe
+ *  3. sliding window optimizer, the keyframe poses and landmarks in window are optimized by the stereo reprojection
+ *     errors and the gyroscope rotations between keyframes, the landmarks are solved by Schur complement. The first
+ *     keyframe is fixed. The optimized landmarks are sent back to front-end
+ *
+ * The world frame is gravity aligned by the accelerator of first frame, z is up. If the tracking is lost, the map is
+ * reset at the predicted pose, so the trajectory continues
+ */
+class StereoInertialOdometry {
+  public:
+    /**
+     * @brief Constructor, start the threads
+     *
+     * @param camera    Rectified stereo camera
+     * @param cameraImu Rotation from IMU frame to rectified left camera frame, p_camera = cameraImu * p_imu
+     * @param options   Odometry options
+     */
+    StereoInertialOdometry(const StereoCamera& camera, const cv::Matx33d& cameraImu,
+                           const OdometryOptions& options = OdometryOptions());
+
+    ~StereoInertialOdometry();
+
+    StereoInertialOdometry(const StereoInertialOdometry&) = delete;
+    StereoInertialOdometry& operator=(const StereoInertialOdometry&) = delete;
+
+  public:
+    /**
+     * @brief Push frame bundle, the images are copied. The oldest frame is dropped if front-end is busy and dropFrames
+     * is set, or block until front-end is ready
+     *
+     * @param bundle    Frame bundle with rectified left and right images, and the IMU since previous frame
+     * @return False if the odometry is stopped or there is no right image
+     */
+    bool push(const FrameBundle& bundle);
+
+    /**
+     * @brief Pop the pose of next frame without blocking
+     *
+     * @param pose  Output pose
+     * @return False if there isn't any pose
+     */
+    bool tryPop(OdometryPose* pose);
+
+    /**
+     * @brief Pop the pose of next frame, block until there is any pose or the odometry is stopped
+     *
+     * @param pose  Output pose
+     * @return False if the odometry is stopped and all poses are popped
+     */
+    bool pop(OdometryPose* pose);
+
+    // stop odometry, wait for all pushed frames processed
+    void stop();
+
+    // get statistics
+    OdometryStatistics statistics() const;
+
+    inline const OdometryOptions& options() const { return options_; }
+
+  private:
+    // frame waiting for front-end
+    struct InputFrame {
+        std::uint32_t frameId{0};
+        std::int64_t timestamp{0};      // device timestamp, ns
+        std::int64_t hostTimestamp{0};  // host timestamp, ns
+        std::int64_t pushTime{0};       // host time of push, ns
+        cv::Mat left;
+        cv::Mat right;
+    };
+
+    // feature observation, the disparity is 0 if not matched in right image
+    struct Observation {
+        std::uint64_t id{0};
+        cv::Point2f point;
+        float disparity{0};
+        bool outlier{false};  // marked by optimizer
+    };
+
+    // frame tracked by front-end, which is also the keyframe in sliding window
+    struct TrackedFrame {
+        std::int64_t timestamp{0};              // device timestamp, ns
+        cv::Matx33d rotation;                   // rotation from camera to world
+        cv::Vec3d translation;                  // camera position in world
+        cv::Matx33d frontRotation;              // rotation estimated by front-end
+        cv::Vec3d frontTranslation;             // translation estimated by front-end
+        cv::Matx33d gyroRotation;               // gyroscope rotation from previous frame(or keyframe), camera frame
+        bool reset{false};                      // whether the map is reset at this frame
+        int epoch{0};                           // map reset number of front-end
+        std::vector<Observation> observations;  // tracked features
+    };
+
+    // optimized result sent back to front-end
+    struct MapUpdate {
+        bool valid{false};
+        int epoch{0};               // map reset number of keyframe, the update is discarded if the map is reset
+        cv::Matx33d frontRotation;  // keyframe pose estimated by front-end
+        cv::Vec3d frontTranslation;
+        cv::Matx33d rotation;  // keyframe pose optimized
+        cv::Vec3d translation;
+        std::vector<std::pair<std::uint64_t, cv::Vec3d>> landmarks;  // optimized landmarks of keyframe
+    };
+
+    // thread loops
+    void frontEndLoop();
+    void keyframeLoop();
+    void optimizerLoop();
+
+    // front-end process of one frame
+    void track(const InputFrame& frame);
+
+    // apply the optimized landmarks and the correction of keyframe pose to local map
+    void applyMapUpdate();
+
+    // rotation from camera to gravity aligned world frame by the accelerator before timestamp
+    cv::Matx33d gravityRotation(std::int64_t timestamp) const;
+
+    // whether the tracked frame should be a keyframe
+    bool isKeyframe(const TrackedFrame& frame, const TrackedFrame& keyframe) const;
+
+    // add keyframe to sliding window, triangulate new landmarks and slide the window
+    void addKeyframe(TrackedFrame keyframe);
+
+    // optimize sliding window by Levenberg-Marquardt
+    void optimizeWindow();
+
+    // robust cost of sliding window
+    double windowCost() const;
+
+    // mark the observations with large reprojection errors as outliers
+    void removeOutliers();
+
+    // remove the landmarks without any inlier observation in window
+    void removeLandmarks();
+
+  private:
+    StereoCamera camera_;
+    cv::Matx33d cameraImu_;
+    cv::Matx33d cameraMatrix_;
+    OdometryOptions options_;
+    BlockingQueue<InputFrame> frames_;
+    BlockingQueue<TrackedFrame> tracked_;
+    BlockingQueue<TrackedFrame> keyframes_;
+    BlockingQueue<OdometryPose> poses_;
+    ImuBuffer imu_;  // IMU records of pushed frames
+    std::thread frontEndThread_;
+    std::thread keyframeThread_;
+    std::thread optimizerThread_;
+    bool stopped_{false};
+
+    // front-end state
+    FeatureTracker tracker_;
+    SparseStereoMatcher stereo_;
+    bool initialized_{false};
+    int epoch_{0};                                           // map reset number
+    std::int64_t lastTimestamp_{0};                          // device timestamp of last frame, ns
+    cv::Matx33d rotation_;                                   // rotation of last frame
+    cv::Vec3d translation_;                                  // translation of last frame
+    cv::Vec3d velocity_{0, 0, 0};                            // velocity of last frame, m/s
+    std::unordered_map<std::uint64_t, cv::Vec3d> localMap_;  // tracked landmarks in world
+
+    // sliding window of optimizer
+    std::deque<TrackedFrame> window_;
+    std::unordered_map<std::uint64_t, cv::Vec3d> landmarks_;  // landmarks in world
+
+    MapUpdate mapUpdate_;  // latest optimized result, protected by mutex
+    OdometryStatistics statistics_;
+    mutable std::mutex mutex_;  // protect map update and statistics
+};
+
+}  // namespace mev
@@ -0,0 +1,125 @@
+#include "OverloadPolicy.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/algorithm/string.hpp>
+
+using namespace std;
+
+namespace mev {
+
+namespace {
+
+// names of overload actions
+const map<OverloadAction, string> kActionNames = {
+    {OverloadAction::Block, "block"},
+    {OverloadAction::DropOldest, "drop-oldest"},
+    {OverloadAction::DropNewest, "drop-newest"},
+    {OverloadAction::Decimate, "decimate"},
+    {OverloadAction::DegradeQuality, "degrade-quality"},
+    {OverloadAction::Raw, "raw"},
+};
+
+// time to write the pending bytes at disk throughput, s
+double writeLatency(const PipelineLoad& load) {
+    return load.diskThroughput > 0 ? load.pendingBytes / load.diskThroughput : 0;
+}
+
+}  // namespace
+
+string overloadActionName(OverloadAction action) { return kActionNames.at(action); }
+
+bool parseOverloadAction(const string& name, OverloadAction* action) {
+    for (auto& v : kActionNames) {
+        if (boost::iequals(v.second, name)) {
+            *action = v.first;
+            return true;
+        }
+    }
+    return false;
+}
+
+OverloadPolicy::OverloadPolicy(const OverloadOptions& options) : options_(options) {
+    CHECK_LT(options_.lowWatermark, options_.highWatermark) << "low watermark should be less than high watermark";
+}
+
+bool OverloadPolicy::update(const PipelineLoad& load, int64_t time) {
+    double queueRatio =
+        load.encodeQueueCapacity > 0 ? static_cast<double>(load.encodeQueueSize) / load.encodeQueueCapacity : 0;
+    double pendingRatio = load.pendingCapacity > 0 ? static_cast<double>(load.pendingBytes) / load.pendingCapacity : 0;
+    double latency = writeLatency(load);
+    bool diskOverload = pendingRatio >= options_.highWatermark ||
+                        (options_.maxWriteLatency > 0 && latency >= options_.maxWriteLatency);
+    bool diskDrained = pendingRatio <= options_.lowWatermark &&
+                       (options_.maxWriteLatency <= 0 || latency <= options_.maxWriteLatency / 2);
+
+    lock_guard<mutex> lock(mutex_);
+    if (!overloaded_) {
+        bool encodeOverload = queueRatio >= options_.highWatermark;
+        if (encodeOverload || diskOverload) {
+            overloaded_ = true;
+            diskOverloaded_ = diskOverload;
+            enterTime_ = time;
+            enterDropped_ = dropped_;
+            ++transitions_;
+            LOG(WARNING) << fmt::format("enter overload by {}, action: {}, encode queue = {}/{}, pending write = "
+                                        "{:.1f} MB, disk throughput = {:.1f} MB/s, write latency = {:.2f} s",
+                                        diskOverload ? "disk" : "encoding", overloadActionName(options_.action),
+                                        load.encodeQueueSize, load.encodeQueueCapacity, load.pendingBytes * 1.0E-6,
+                                        load.diskThroughput * 1.0E-6, latency);
+        }
+    } else if (queueRatio <= options_.lowWatermark && diskDrained) {
+        overloaded_ = false;
+        diskOverloaded_ = false;
+        LOG(WARNING) << fmt::format("leave overload after {:.3f} s, dropped {} frames, encode queue = {}/{}, pending "
+                                    "write = {:.1f} MB",
+                                    (time - enterTime_) * 1.0E-9, dropped_ - enterDropped_, load.encodeQueueSize,
+                                    load.encodeQueueCapacity, load.pendingBytes * 1.0E-6);
+        lastKept_.clear();
+    } else {
+        // the full write queue backs up into the encode queue, so it's by disk until the write queue is drained
+        diskOverloaded_ = diskOverloaded_ ? !diskDrained : diskOverload;
+    }
+    return overloaded_;
+}
+
+bool OverloadPolicy::decimate(const string& stream, int64_t timestamp) {
+    lock_guard<mutex> lock(mutex_);
+    if (!overloaded_ || options_.decimateRate <= 0) {
+        return false;
+    }
+    auto it = lastKept_.find(stream);
+    // allow 10% jitter of frame interval
+    if (it != lastKept_.end() && timestamp - it->second < 0.9E9 / options_.decimateRate) {
+        ++dropped_;
+        return true;
+    }
+    lastKept_[stream] = timestamp;
+    return false;
+}
+
+void OverloadPolicy::countDropped() {
+    lock_guard<mutex> lock(mutex_);
+    ++dropped_;
+}
+
+bool OverloadPolicy::isOverloaded() const {
+    lock_guard<mutex> lock(mutex_);
+    return overloaded_;
+}
+
+bool OverloadPolicy::isEncodeOverloaded() const {
+    lock_guard<mutex> lock(mutex_);
+    return overloaded_ && !diskOverloaded_;
+}
+
+uint64_t OverloadPolicy::transitions() const {
+    lock_guard<mutex> lock(mutex_);
+    return transitions_;
+}
+
+uint64_t OverloadPolicy::dropped() const {
+    lock_guard<mutex> lock(mutex_);
+    return dropped_;
+}
+
+}  // namespace mev
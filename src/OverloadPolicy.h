@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace mev {
+
+// action of record pipeline under overload, the IMU is never dropped
+enum class OverloadAction {
+    Block,           // block the capture until the encode queue isn't full, only report the overload
+    DropOldest,      // drop the oldest frame in encode queue when it's full
+    DropNewest,      // drop the new frame when the encode queue is full
+    Decimate,        // only keep frames at N Hz of each stream
+    DegradeQuality,  // encode JPEG with lower quality
+    Raw,             // write the device data without encoding under encoding overload, MJPG as it is and others as
+                     // uncompressed BMP. It blocks like Block under disk overload, as the raw data is larger
+};
+
+// overload policy options
+struct OverloadOptions {
+    OverloadAction action{OverloadAction::Block};  // action under overload
+    double highWatermark{0.8};                     // enter overload if encode or write queue is above the ratio
+    double lowWatermark{0.3};                      // leave overload if both queues are below the ratio of capacity
+    double maxWriteLatency{2.0};  // enter overload if writing the pending images takes longer(s) at disk throughput
+    double decimateRate{5.0};     // frame rate of each stream for Decimate action, Hz
+    int degradedQuality{70};      // JPEG quality for DegradeQuality action
+};
+
+// get the name of overload action
+std::string overloadActionName(OverloadAction action);
+
+// parse overload action from name, such as "drop-oldest", return false if invalid
+bool parseOverloadAction(const std::string& name, OverloadAction* action);
+
+// load of record pipeline
+struct PipelineLoad {
+    std::size_t encodeQueueSize{0};      // encode queue size
+    std::size_t encodeQueueCapacity{0};  // encode queue capacity
+    std::uint64_t pendingBytes{0};       // encoded image bytes in write queue
+    std::uint64_t pendingCapacity{0};    // max encoded image bytes in write queue, 0 for unlimited
+    double diskThroughput{0};            // measured disk throughput, bytes/s, 0 for unknown
+};
+
+/**
+ * @brief Overload policy engine. The pipeline is overloaded if the encode queue is above the high watermark (encoding
+ * can't keep up), or the pending images in write queue are above the high watermark of its capacity or take longer
+ * than max write latency at the measured disk throughput (disk can't keep up). It leaves overload when both queues are
+ * below the low watermark and the write latency is below half of the max. The overload is by disk until the write
+ * queue is drained, since the full write queue backs up into the encode queue. Every transition is logged with the
+ * load and the frames dropped during overload. Thread safe
+ */
+class OverloadPolicy {
+  public:
+    explicit OverloadPolicy(const OverloadOptions& options);
+
+    /**
+     * @brief Update the load and get the overload state
+     *
+     * @param load  Current load
+     * @param time  Current time, ns
+     * @return Whether the pipeline is overloaded
+     */
+    bool update(const PipelineLoad& load, std::int64_t time);
+
+    /**
+     * @brief Whether the frame should be dropped by decimation. Only the frames at decimate rate are kept under
+     * overload
+     *
+     * @param stream    Stream name
+     * @param timestamp Frame timestamp, ns
+     * @return True if the frame should be dropped
+     */
+    bool decimate(const std::string& stream, std::int64_t timestamp);
+
+    // count dropped frame
+    void countDropped();
+
+    // whether the pipeline is overloaded
+    bool isOverloaded() const;
+
+    // whether the pipeline is overloaded by encoding only, the disk keeps up
+    bool isEncodeOverloaded() const;
+
+    // overload options
+    inline const OverloadOptions& options() const { return options_; }
+
+    // transition number into overload
+    std::uint64_t transitions() const;
+
+    // total dropped frame number
+    std::uint64_t dropped() const;
+
+  private:
+    OverloadOptions options_;
+    mutable std::mutex mutex_;
+    bool overloaded_{false};                        // whether overloaded
+    bool diskOverloaded_{false};                    // whether the disk can't keep up during overload
+    std::int64_t enterTime_{0};                     // time to enter overload, ns
+    std::uint64_t transitions_{0};                  // transition number into overload
+    std::uint64_t dropped_{0};                      // total dropped frame number
+    std::uint64_t enterDropped_{0};                 // dropped frame number when entering overload
+    std::map<std::string, std::int64_t> lastKept_;  // timestamp of last kept frame of each stream for decimation
+};
+
+}  // namespace mev
@@ -0,0 +1,159 @@
+#include "PipelineBenchmark.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <fstream>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <random>
+#include "CpuTime.h"
+
+using namespace std;
+using namespace cv;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+// frame period of replay timestamp, 30 Hz
+constexpr int64_t kFramePeriod = 33333333;
+
+Mat syntheticYuyv(const Size& size, unsigned int seed) {
+    Mat img(size.height, size.width, CV_8UC2);
+    mt19937 rng(seed);
+    uniform_int_distribution<int> noise(-8, 8);
+    for (int r = 0; r < size.height; ++r) {
+        auto* p = img.ptr<uint8_t>(r);
+        for (int c = 0; c < size.width; ++c) {
+            int y = (r * 255 / size.height + c * 255 / size.width) / 2 + noise(rng);
+            p[2 * c] = static_cast<uint8_t>(min(255, max(0, y)));
+            // U for even column and V for odd column
+            int uv = c % 2 == 0 ? 128 + c * 64 / size.width : 128 - r * 64 / size.height;
+            p[2 * c + 1] = static_cast<uint8_t>(uv);
+        }
+    }
+    return img;
+}
+
+BenchmarkSource syntheticSource(const string& streamMode, RawFormat format, size_t imageNum) {
+    vector<string> tokens;
+    boost::split(tokens, streamMode, boost::is_any_of("xX"));
+    CHECK_EQ(tokens.size(), 2) << fmt::format("invalid stream mode \"{}\"", streamMode);
+    Size size(stoi(tokens[0]), stoi(tokens[1]));
+    bool stereo = boost::iequals(streamMode, "2560x720") || boost::iequals(streamMode, "1280x480");
+    if (stereo) {
+        size.width /= 2;
+    }
+
+    BenchmarkSource source;
+    source.name = fmt::format("{} {}", streamMode, format == RawFormat::YUYV ? "YUYV" : "MJPG");
+    source.format = format;
+    source.streams = stereo ? vector<string>{"left", "right"} : vector<string>{"left"};
+    for (size_t s = 0; s < source.streams.size(); ++s) {
+        vector<Mat> images;
+        for (size_t i = 0; i < imageNum; ++i) {
+            Mat yuyv = syntheticYuyv(size, static_cast<unsigned int>(s * imageNum + i));
+            if (format == RawFormat::MJPG) {
+                // the JPEG data from device
+                Mat bgr;
+                vector<uchar> buffer;
+                cvtColor(yuyv, bgr, COLOR_YUV2BGR_YUYV);
+                imencode(".jpg", bgr, buffer, {IMWRITE_JPEG_QUALITY, 90});
+                images.emplace_back(Mat(1, static_cast<int>(buffer.size()), CV_8UC1, buffer.data()).clone());
+            } else {
+                images.emplace_back(yuyv);
+            }
+        }
+        source.images.emplace_back(images);
+    }
+    return source;
+}
+
+BenchmarkSource replaySource(const fs::path& folder, size_t maxImages) {
+    BenchmarkSource source;
+    source.name = folder.filename().string();
+    source.format = RawFormat::MJPG;
+    for (auto& segment : findClosedSegments(folder)) {
+        ifstream indexFile((folder / segment.folder / "index.csv").string());
+        string line;
+        while (getline(indexFile, line)) {
+            vector<string> tokens;
+            boost::split(tokens, line, boost::is_any_of(","));
+            if (line.empty() || line[0] == '#' || tokens.size() != 5) {
+                continue;
+            }
+            // stream index
+            size_t s = find(source.streams.begin(), source.streams.end(), tokens[0]) - source.streams.begin();
+            if (s == source.streams.size()) {
+                source.streams.emplace_back(tokens[0]);
+                source.images.emplace_back();
+            }
+            if (source.images[s].size() >= maxImages) {
+                continue;
+            }
+            // load JPEG data
+            ifstream imageFile((folder / segment.folder / tokens[4]).string(), ios::binary);
+            vector<uchar> buffer((istreambuf_iterator<char>(imageFile)), istreambuf_iterator<char>());
+            if (!buffer.empty()) {
+                source.images[s].emplace_back(Mat(1, static_cast<int>(buffer.size()), CV_8UC1, buffer.data()).clone());
+            }
+        }
+    }
+    CHECK(!source.streams.empty()) << fmt::format("cannot find any image in \"{}\"", folder.string());
+    return source;
+}
+
+BenchmarkResult runPipelineBenchmark(const BenchmarkSource& source, const fs::path& folder,
+                                     const PipelineOptions& options, size_t frameNum, double imuRate) {
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+
+    BenchmarkResult result;
+    result.name = source.name;
+    result.frames = frameNum;
+    {
+        SegmentOptions segmentOptions;
+        segmentOptions.minFreeSpace = 0;
+        SegmentWriter writer(folder, segmentOptions, source.streams);
+        RecordPipeline pipeline(writer, options);
+
+        const int64_t imuPeriod = static_cast<int64_t>(1.0E9 / imuRate);
+        int64_t imuTime{0};
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < frameNum; ++i) {
+            int64_t timestamp = static_cast<int64_t>(i) * kFramePeriod;
+            for (size_t s = 0; s < source.streams.size(); ++s) {
+                if (pipeline.decimate(source.streams[s], static_cast<uint32_t>(i))) {
+                    continue;
+                }
+                RawFrame frame;
+                frame.stream = source.streams[s];
+                frame.frameId = static_cast<uint32_t>(i);
+                frame.timestamp = timestamp;
+                frame.hostTimestamp = timestamp;
+                frame.format = source.format;
+                // copy like the capture thread does from the device buffer
+                int64_t copyStart = threadCpuTime();
+                frame.image = source.images[s][i % source.images[s].size()].clone();
+                result.copyTime += threadCpuTime() - copyStart;
+                pipeline.push(std::move(frame));
+            }
+            for (; imuTime <= timestamp; imuTime += imuPeriod) {
+                ImuRecord record;
+                record.timestamp = imuTime;
+                record.hostTimestamp = imuTime;
+                record.acc[2] = 9.81;
+                pipeline.push(record);
+            }
+        }
+        pipeline.stop();
+        result.duration = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        result.fps = frameNum / result.duration;
+        result.bytes = writer.totalBytes();
+        result.statistics = pipeline.statistics();
+    }
+    fs::remove_all(folder);
+    return result;
+}
+
+}  // namespace mev
@@ -0,0 +1,73 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+#include "RecordPipeline.h"
+
+namespace mev {
+
+// source frames for pipeline benchmark, the images of each stream are replayed in loop
+struct BenchmarkSource {
+    std::string name;                           // source name
+    RawFormat format{RawFormat::BGR};           // raw format of images
+    std::vector<std::string> streams;           // stream names
+    std::vector<std::vector<cv::Mat>> images;   // images of each stream
+};
+
+// pipeline benchmark result
+struct BenchmarkResult {
+    std::string name;                 // source name
+    std::size_t frames{0};            // pushed frame number, one frame contains the images of all streams
+    double duration{0};               // wall time from the first frame pushed to all data written, s
+    double fps{0};                    // max sustainable frame rate, Hz
+    std::uint64_t bytes{0};           // written bytes
+    std::int64_t copyTime{0};         // CPU time to copy the device data in capture thread, ns
+    PipelineStatistics statistics;    // pipeline statistics
+};
+
+/**
+ * @brief Create synthetic YUYV image, gradient with noise, so the JPEG encoding cost is close to real image
+ *
+ * @param size  Image size
+ * @param seed  Random seed
+ * @return YUYV image, CV_8UC2
+ */
+cv::Mat syntheticYuyv(const cv::Size& size, unsigned int seed = 0);
+
+/**
+ * @brief Create synthetic source for stream mode and format. The stream mode 2560x720 and 1280x480 are stereo, which
+ * have left and right images with half width
+ *
+ * @param streamMode    Stream mode name, such as "2560x720"
+ * @param format        Raw format, YUYV or MJPG
+ * @param imageNum      Different image number of each stream
+ * @return Benchmark source
+ */
+BenchmarkSource syntheticSource(const std::string& streamMode, RawFormat format, std::size_t imageNum = 10);
+
+/**
+ * @brief Load the JPEG images of a recording as MJPG source
+ *
+ * @param folder    Recording folder, which contains segments
+ * @param maxImages Max image number of each stream to load
+ * @return Benchmark source
+ */
+BenchmarkSource replaySource(const boost::filesystem::path& folder, std::size_t maxImages = 100);
+
+/**
+ * @brief Feed the source to record pipeline as fast as possible, without device pacing, and measure the throughput.
+ * The frames go through the same path as the capture thread of recorder: skipped by decimation, then the YUYV or MJPG
+ * data is copied and pushed, and it's converted in encode threads
+ *
+ * @param source    Benchmark source
+ * @param folder    Folder to write data, it will be removed after benchmark
+ * @param options   Pipeline options
+ * @param frameNum  Frame number to push
+ * @param imuRate   IMU rate(Hz), the synthetic IMU is pushed with frames at 30 Hz timestamp
+ * @return Benchmark result
+ */
+BenchmarkResult runPipelineBenchmark(const BenchmarkSource& source, const boost::filesystem::path& folder,
+                                     const PipelineOptions& options, std::size_t frameNum, double imuRate = 200);
+
+}  // namespace mev
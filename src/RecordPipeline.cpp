@@ -0,0 +1,305 @@
+#include "RecordPipeline.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "ClockSync.h"
+#include "CpuTime.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+RecordPipeline::RecordPipeline(SegmentWriter& writer, const PipelineOptions& options)
+    : RecordPipeline(vector<SegmentWriter*>{&writer}, options) {}
+
+RecordPipeline::RecordPipeline(const vector<SegmentWriter*>& writers, const PipelineOptions& options)
+    : writers_(writers), options_(options), encodeQueue_(options.queueSize), overload_(options.overload) {
+    CHECK(!writers_.empty()) << "there should be at least one writer";
+    CHECK_GT(options_.encodeThreads, 0) << "encode thread number should be greater than 0";
+    for (int i = 0; i < options_.encodeThreads; ++i) {
+        encodeThreads_.emplace_back(&RecordPipeline::encodeLoop, this);
+    }
+    writeThread_ = thread(&RecordPipeline::writeLoop, this);
+}
+
+RecordPipeline::~RecordPipeline() { stop(); }
+
+bool RecordPipeline::push(RawFrame frame) {
+    if (isStopped()) {
+        return false;
+    }
+    CHECK_LT(frame.device, writers_.size()) << "invalid device index";
+    if (decimate(frame.stream, frame.frameId)) {
+        return true;
+    }
+
+    // update overload state, and handle the frame by overload action
+    PipelineLoad load;
+    load.encodeQueueSize = encodeQueue_.size();
+    load.encodeQueueCapacity = encodeQueue_.capacity();
+    load.pendingBytes = pendingBytes_;
+    load.pendingCapacity = options_.maxPendingBytes;
+    load.diskThroughput = diskThroughput_;
+    overload_.update(load, hostNow());
+    switch (options_.overload.action) {
+        case OverloadAction::DropOldest: {
+            bool dropped{false};
+            bool ok = encodeQueue_.pushDropOldest(std::move(frame), &dropped);
+            if (dropped) {
+                overload_.countDropped();
+            }
+            return ok;
+        }
+        case OverloadAction::DropNewest:
+            if (encodeQueue_.isClosed()) {
+                return false;
+            }
+            if (!encodeQueue_.tryPush(std::move(frame))) {
+                overload_.countDropped();
+            }
+            return true;
+        case OverloadAction::Decimate:
+            if (overload_.decimate(frame.stream + to_string(frame.device), frame.timestamp)) {
+                return true;
+            }
+            return encodeQueue_.push(std::move(frame));
+        default:
+            return encodeQueue_.push(std::move(frame));
+    }
+}
+
+bool RecordPipeline::decimate(const string& stream, uint32_t frameId) {
+    auto transform = findTransform(stream);
+    if (transform && frameId % transform->decimation != 0) {
+        ++decimatedNum_;
+        return true;
+    }
+    return false;
+}
+
+bool RecordPipeline::push(const ImuRecord& record, size_t device) {
+    if (isStopped()) {
+        return false;
+    }
+    CHECK_LT(device, writers_.size()) << "invalid device index";
+    WriteItem item;
+    item.device = device;
+    item.imu = record;
+    return writeQueue_.push(std::move(item));
+}
+
+void RecordPipeline::stop() {
+    if (stopped_) {
+        return;
+    }
+    stopped_ = true;
+
+    // drain encode queue first, then the write queue
+    LOG(INFO) << fmt::format("stop record pipeline, encode queue size = {}, write queue size = {}",
+                             encodeQueue_.size(), writeQueue_.size());
+    encodeQueue_.close();
+    for (auto& t : encodeThreads_) {
+        t.join();
+    }
+    writeQueue_.close();
+    writeThread_.join();
+    for (auto& writer : writers_) {
+        writer->close();
+    }
+    LOG(INFO) << "record pipeline stopped";
+}
+
+PipelineStatistics RecordPipeline::statistics() const {
+    PipelineStatistics statistics;
+    statistics.images = imageNum_;
+    statistics.imu = imuNum_;
+    statistics.dropped = droppedNum_;
+    statistics.decimated = decimatedNum_;
+    statistics.overloadDropped = overload_.dropped();
+    statistics.overloads = overload_.transitions();
+    statistics.overloaded = overload_.isOverloaded();
+    statistics.pendingBytes = pendingBytes_;
+    statistics.diskThroughput = diskThroughput_;
+    statistics.bytes = bytes_;
+    statistics.convertTime = convertTime_;
+    statistics.encodeTime = encodeTime_;
+    statistics.writeTime = writeTime_;
+    statistics.imuTime = imuTime_;
+    return statistics;
+}
+
+const FrameTransform* RecordPipeline::findTransform(const string& stream) const {
+    auto it = options_.transforms.find(stream);
+    return it == options_.transforms.end() || it->second.empty() ? nullptr : &it->second;
+}
+
+Mat RecordPipeline::convert(const RawFrame& frame, Mat& buffer) {
+    auto transform = findTransform(frame.stream);
+    if (!transform) {
+        switch (frame.format) {
+            case RawFormat::YUYV:
+                cvtColor(frame.image, buffer, COLOR_YUV2BGR_YUYV);
+                return buffer;
+            case RawFormat::MJPG:
+                buffer = imdecode(frame.image, IMREAD_COLOR);
+                return buffer;
+            default:
+                return frame.image;
+        }
+    }
+
+    Mat bgr;
+    switch (frame.format) {
+        case RawFormat::YUYV:
+            // crop before conversion, the ROI x and width are even, then bin the converted ROI
+            cvtColor(frame.image(transformRoi(*transform, frame.image.size())), buffer, COLOR_YUV2BGR_YUYV);
+            binImage(buffer, transform->binning, bgr);
+            break;
+        case RawFormat::MJPG: {
+            // bin by the DCT scaling of JPEG decoder, which is much faster than decoding the full image
+            int flag = transform->binning == 4 ? IMREAD_REDUCED_COLOR_4
+                                               : (transform->binning == 2 ? IMREAD_REDUCED_COLOR_2 : IMREAD_COLOR);
+            buffer = imdecode(frame.image, flag);
+            if (buffer.empty()) {
+                break;
+            }
+            Rect roi = transform->roi;
+            bgr = roi.area() == 0 ? buffer
+                                  : buffer(Rect(roi.x / transform->binning, roi.y / transform->binning,
+                                                roi.width / transform->binning, roi.height / transform->binning));
+            break;
+        }
+        default:
+            applyFrameTransform(*transform, frame.image, bgr);
+            break;
+    }
+    return bgr;
+}
+
+bool RecordPipeline::encode(const Mat& bgr, vector<uint8_t>* data, string* ext) {
+    const vector<int> params = {IMWRITE_JPEG_QUALITY, options_.jpegQuality};
+    const vector<int> degradedParams = {IMWRITE_JPEG_QUALITY, options_.overload.degradedQuality};
+
+    if (options_.overload.action == OverloadAction::DegradeQuality && overload_.isOverloaded()) {
+        *ext = "jpg";
+        return imencode(".jpg", bgr, *data, degradedParams);
+    }
+    // the MJPG data is written without conversion in encodeLoop(), the others are written uncompressed. Only if the
+    // encoding can't keep up, since the raw data makes the disk overload worse
+    if (options_.overload.action == OverloadAction::Raw && overload_.isEncodeOverloaded()) {
+        *ext = "bmp";
+        return imencode(".bmp", bgr, *data);
+    }
+    *ext = "jpg";
+    return imencode(".jpg", bgr, *data, params);
+}
+
+void RecordPipeline::encodeLoop() {
+    RawFrame frame;
+    Mat converted;  // reused buffer of converted image
+    setTraceThreadName("encode");
+    applyThreadPolicy(options_.encodePolicy, "encode");
+    while (encodeQueue_.pop(frame)) {
+        WriteItem item;
+        item.isImage = true;
+        item.device = frame.device;
+        item.image.stream = frame.stream;
+        item.image.frameId = frame.frameId;
+        item.image.timestamp = frame.timestamp;
+        item.image.hostTimestamp = frame.hostTimestamp;
+
+        // write the MJPG data as it is with raw action under encoding overload, unless it should be cropped or binned
+        auto transform = findTransform(frame.stream);
+        bool spatial = transform && (transform->roi.area() > 0 || transform->binning != 1);
+        if (frame.format == RawFormat::MJPG && !spatial && options_.overload.action == OverloadAction::Raw &&
+            overload_.isEncodeOverloaded()) {
+            item.image.ext = "jpg";
+            item.image.data.assign(frame.image.data, frame.image.data + frame.image.total() * frame.image.elemSize());
+            pushImage(std::move(item));
+            continue;
+        }
+
+        // convert to BGR with transform, the BGR raw frame is used directly and never written
+        Mat bgr;
+        {
+            ScopedCpuTime cpuTime(convertTime_);
+            TraceScope trace("convert");
+            bgr = convert(frame, converted);
+        }
+        if (bgr.empty()) {
+            LOG(ERROR) << fmt::format("cannot convert {} image, frame ID = {}", frame.stream, frame.frameId);
+            continue;
+        }
+
+        {
+            ScopedCpuTime cpuTime(encodeTime_);
+            TraceScope trace("encode");
+            if (!encode(bgr, &item.image.data, &item.image.ext)) {
+                LOG(ERROR) << fmt::format("cannot encode {} image, frame ID = {}", frame.stream, frame.frameId);
+                continue;
+            }
+        }
+        pushImage(std::move(item));
+    }
+}
+
+void RecordPipeline::pushImage(WriteItem item) {
+    const uint64_t size = item.image.data.size();
+    {
+        TraceScope trace("wait write");
+        unique_lock<mutex> lock(pendingMutex_);
+        // one image is always allowed, so a single large image doesn't wait forever
+        pendingWritten_.wait(lock, [&] {
+            return options_.maxPendingBytes == 0 || pendingBytes_ == 0 ||
+                   pendingBytes_ + size <= options_.maxPendingBytes;
+        });
+        pendingBytes_ += size;
+    }
+    writeQueue_.push(std::move(item));
+}
+
+void RecordPipeline::writeLoop() {
+    WriteItem item;
+    setTraceThreadName("write");
+    applyThreadPolicy(options_.writePolicy, "write");
+    while (writeQueue_.pop(item)) {
+        bool ok{false};
+        auto& writer = *writers_[item.device];
+        uint64_t writtenBytes = writer.totalBytes();
+        if (item.isImage) {
+            ScopedCpuTime cpuTime(writeTime_);
+            TraceScope trace("write image");
+            int64_t startTime = hostNow();
+            ok = writer.write(item.image);
+            int64_t duration = hostNow() - startTime;
+            imageNum_ += ok;
+            droppedNum_ += !ok;
+            {
+                lock_guard<mutex> lock(pendingMutex_);
+                pendingBytes_ -= item.image.data.size();
+            }
+            pendingWritten_.notify_all();
+            // update the disk throughput with exponential moving average of each image
+            if (ok && duration > 0) {
+                double throughput = item.image.data.size() * 1.0E9 / duration;
+                double last = diskThroughput_;
+                diskThroughput_ = last > 0 ? last * 0.95 + throughput * 0.05 : throughput;
+            }
+        } else {
+            ScopedCpuTime cpuTime(imuTime_);
+            TraceScope trace("write IMU");
+            ok = writer.write(item.imu);
+            imuNum_ += ok;
+        }
+        bytes_ += writer.totalBytes() - writtenBytes;
+        if (!ok && !writerStopped_) {
+            LOG(WARNING) << "writer is stopped, the remaining data will be dropped";
+            writerStopped_ = true;
+        }
+    }
+}
+
+}  // namespace mev
@@ -0,0 +1,208 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <thread>
+#include "BlockingQueue.h"
+#include "FrameTransform.h"
+#include "OverloadPolicy.h"
+#include "SegmentWriter.h"
+#include "ThreadPolicy.h"
+
+namespace mev {
+
+// format of raw frame
+enum class RawFormat {
+    BGR,   // BGR image, CV_8UC3
+    YUYV,  // YUYV image, CV_8UC2
+    MJPG,  // JPEG data, CV_8UC1 with one row
+};
+
+// raw frame from camera
+struct RawFrame {
+    std::string stream;                // stream name, "left" or "right"
+    std::uint32_t frameId{0};          // frame ID
+    std::int64_t timestamp{0};         // device timestamp, ns
+    std::int64_t hostTimestamp{0};     // host timestamp, ns
+    RawFormat format{RawFormat::BGR};  // image format
+    cv::Mat image;                     // image
+    std::size_t device{0};             // device index, which is the index of writer in pipeline
+};
+
+// pipeline options
+struct PipelineOptions {
+    std::size_t queueSize{60};                   // max size of encode queue
+    std::uint64_t maxPendingBytes{256 << 20};  // max encoded image bytes in write queue, 0 for unlimited
+    int encodeThreads{2};                        // encode thread number
+    int jpegQuality{95};                         // JPEG quality
+    ThreadPolicy encodePolicy;                   // scheduling policy of encode threads
+    ThreadPolicy writePolicy;                    // scheduling policy of write thread
+    OverloadOptions overload;                    // overload policy
+    std::map<std::string, FrameTransform> transforms;  // ROI, binning and decimation of each stream, by stream name
+};
+
+// pipeline statistics, the time is the CPU time of each stage
+struct PipelineStatistics {
+    std::uint64_t images{0};           // written image number
+    std::uint64_t imu{0};              // written IMU number
+    std::uint64_t dropped{0};          // dropped image number after the writer is stopped
+    std::uint64_t decimated{0};        // skipped image number by temporal decimation
+    std::uint64_t overloadDropped{0};  // dropped image number by overload policy
+    std::uint64_t overloads{0};        // transition number into overload
+    bool overloaded{false};            // whether overloaded now
+    std::uint64_t bytes{0};            // written bytes
+    std::uint64_t pendingBytes{0};     // encoded image bytes waiting to write
+    double diskThroughput{0};          // measured disk throughput, bytes/s
+    std::int64_t convertTime{0};       // CPU time to convert raw frame to BGR, ns
+    std::int64_t encodeTime{0};        // CPU time to encode JPEG, ns
+    std::int64_t writeTime{0};         // CPU time to write image, ns
+    std::int64_t imuTime{0};           // CPU time to write IMU, ns
+};
+
+/**
+ * @brief Record pipeline, the raw frames are converted to BGR and encoded to JPEG in encode threads, and then saved
+ * with IMU by the segment writer in write thread.
+ *
+ *  capture --> encode queue --> encode threads --> write queue --> write thread(segment writer)
+ *  IMU     ----------------------------------------^
+ *
+ * The encoded images in write queue are limited by max pending bytes, the encode threads wait above it, so a slow disk
+ * backs up into the encode queue. The IMU is pushed to write queue directly without the limit, so it will never be
+ * dropped. stop() will drain all queues before closing the writer.
+ *
+ * The pipeline is overloaded when the encode queue is above the high watermark or the pending encoded images are above
+ * the high watermark of the limit or couldn't be written in time at the measured disk throughput, then the frames are
+ * handled by the overload action: block the capture, drop the oldest or newest frame, decimate each stream, encode with
+ * lower JPEG quality or write raw data(only by encoding overload).
+ *
+ * The frames could be cropped and binned before encoding, or decimated before pushing to encode queue, by the frame
+ * transform of each stream.
+ *
+ * For multi-camera recording, each device has its own writer, and the frames and IMU are routed by device index. All
+ * devices share the encode threads and the write thread, so they don't compete for disk bandwidth.
+ */
+class RecordPipeline {
+  public:
+    /**
+     * @brief Constructor, start encode and write threads
+     *
+     * @param writer    Segment writer, it's only used in write thread
+     * @param options   Pipeline options
+     */
+    RecordPipeline(SegmentWriter& writer, const PipelineOptions& options);
+
+    /**
+     * @brief Constructor for multiple devices, start encode and write threads
+     *
+     * @param writers   Segment writer of each device, they are only used in write thread
+     * @param options   Pipeline options
+     */
+    RecordPipeline(const std::vector<SegmentWriter*>& writers, const PipelineOptions& options);
+
+    ~RecordPipeline();
+
+    RecordPipeline(const RecordPipeline&) = delete;
+    RecordPipeline& operator=(const RecordPipeline&) = delete;
+
+  public:
+    /**
+     * @brief Push raw frame to encode, the frame may be skipped by decimation or dropped by overload policy, or block
+     * if the encode queue is full with Block action
+     *
+     * @param frame Raw frame
+     * @return False if the pipeline is stopped
+     */
+    bool push(RawFrame frame);
+
+    /**
+     * @brief Whether the frame is skipped by the temporal decimation of stream transform, by frame ID so the left and
+     * right frames of the same ID are kept together. The skipped frames are counted. It's called by push(), and could
+     * be called before the frame is copied or converted to save CPU
+     *
+     * @param stream    Stream name
+     * @param frameId   Frame ID
+     * @return True if the frame should be skipped
+     */
+    bool decimate(const std::string& stream, std::uint32_t frameId);
+
+    /**
+     * @brief Push IMU to write
+     *
+     * @param record    IMU record
+     * @param device    Device index
+     * @return False if the pipeline is stopped
+     */
+    bool push(const ImuRecord& record, std::size_t device = 0);
+
+    // stop pipeline, wait all data in queues written and close writers
+    void stop();
+
+    // whether the pipeline is stopped, by stop() or any writer is stopped(disk full)
+    inline bool isStopped() const { return stopped_ || writerStopped_; }
+
+    // size of encode queue
+    inline std::size_t encodeQueueSize() const { return encodeQueue_.size(); }
+
+    // size of write queue
+    inline std::size_t writeQueueSize() const { return writeQueue_.size(); }
+
+    // get statistics
+    PipelineStatistics statistics() const;
+
+  private:
+    // item in write queue, image or IMU
+    struct WriteItem {
+        bool isImage{false};
+        std::size_t device{0};
+        ImageRecord image;
+        ImuRecord imu;
+    };
+
+    // encode thread loop
+    void encodeLoop();
+
+    // write thread loop
+    void writeLoop();
+
+    // get the transform of stream, nullptr if not set
+    const FrameTransform* findTransform(const std::string& stream) const;
+
+    // convert raw frame to BGR with transform, the buffer is reused. Return the BGR image, empty if failed
+    cv::Mat convert(const RawFrame& frame, cv::Mat& buffer);
+
+    // encode image by overload state, return false if failed
+    bool encode(const cv::Mat& bgr, std::vector<std::uint8_t>* data, std::string* ext);
+
+    // push encoded image to write queue, wait until the pending bytes are below the limit
+    void pushImage(WriteItem item);
+
+  private:
+    std::vector<SegmentWriter*> writers_;
+    PipelineOptions options_;
+    BlockingQueue<RawFrame> encodeQueue_;
+    BlockingQueue<WriteItem> writeQueue_;
+    std::vector<std::thread> encodeThreads_;
+    std::thread writeThread_;
+    bool stopped_{false};                         // whether stop() is called
+    std::atomic<bool> writerStopped_{false};      // whether any writer is stopped
+    OverloadPolicy overload_;                     // overload policy
+    std::atomic<std::uint64_t> pendingBytes_{0};  // encoded image bytes in write queue
+    std::mutex pendingMutex_;                     // mutex to wait for pending bytes
+    std::condition_variable pendingWritten_;      // notified when pending image is written
+    std::atomic<double> diskThroughput_{0};       // EMA of disk throughput, bytes/s
+
+    // statistics
+    std::atomic<std::uint64_t> imageNum_{0};
+    std::atomic<std::uint64_t> imuNum_{0};
+    std::atomic<std::uint64_t> droppedNum_{0};
+    std::atomic<std::uint64_t> decimatedNum_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+    std::atomic<std::int64_t> convertTime_{0};
+    std::atomic<std::int64_t> encodeTime_{0};
+    std::atomic<std::int64_t> writeTime_{0};
+    std::atomic<std::int64_t> imuTime_{0};
+};
+
+}  // namespace mev
@@ -0,0 +1,232 @@
+#include "Recording.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "SegmentWriter.h"
+
+using namespace std;
+using namespace cv;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+namespace {
+
+// parse the values of YAML scalar or flow sequence, such as "1280" or "[1, 2, 3]"
+bool parseValues(string value, vector<double>* values) {
+    boost::trim_if(value, boost::is_any_of(" []"));
+    vector<string> tokens;
+    boost::split(tokens, value, boost::is_any_of(","));
+    values->clear();
+    try {
+        for (auto& token : tokens) {
+            values->emplace_back(stod(token));
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    return !values->empty();
+}
+
+// get camera from the fields of calibration section
+bool toCamera(const map<string, vector<double>>& fields, CameraCalibration* camera) {
+    for (auto key : {"width", "height", "fx", "fy", "cx", "cy", "coeffs"}) {
+        if (!fields.count(key)) {
+            return false;
+        }
+    }
+    auto& coeffs = fields.at("coeffs");
+    if (coeffs.size() != 5) {
+        return false;
+    }
+    camera->size = Size(static_cast<int>(fields.at("width")[0]), static_cast<int>(fields.at("height")[0]));
+    camera->cameraMatrix =
+        Matx33d(fields.at("fx")[0], 0, fields.at("cx")[0], 0, fields.at("fy")[0], fields.at("cy")[0], 0, 0, 1);
+    for (int i = 0; i < 5; ++i) {
+        camera->coeffs[i] = coeffs[i];
+    }
+    return true;
+}
+
+// get extrinsics from the fields of calibration section
+bool toExtrinsics(const map<string, vector<double>>& fields, ExtrinsicsCalibration* extrinsics) {
+    auto rotation = fields.find("rotation");
+    auto translation = fields.find("translation");
+    if (rotation == fields.end() || rotation->second.size() != 9 || translation == fields.end() ||
+        translation->second.size() != 3) {
+        return false;
+    }
+    extrinsics->rotation = Matx33d(rotation->second.data());
+    extrinsics->translation = Vec3d(translation->second.data());
+    return true;
+}
+
+}  // namespace
+
+bool readCalibration(const fs::path& file, RecordingCalibration* calibration) {
+    ifstream calibFile(file.string());
+    if (!calibFile.is_open()) {
+        LOG(ERROR) << fmt::format("cannot open calibration file \"{}\"", file.string());
+        return false;
+    }
+    // fields of each section
+    map<string, map<string, vector<double>>> sections;
+    string section, line;
+    while (getline(calibFile, line)) {
+        auto pos = line.find(':');
+        if (line.empty() || line[0] == '#' || pos == string::npos) {
+            continue;
+        }
+        string key = boost::trim_copy(line.substr(0, pos));
+        if (line[0] != ' ') {
+            section = key;
+            continue;
+        }
+        vector<double> values;
+        if (!parseValues(line.substr(pos + 1), &values)) {
+            LOG(ERROR) << fmt::format("cannot parse line \"{}\" in calibration file \"{}\"", line, file.string());
+            return false;
+        }
+        sections[section][key] = values;
+    }
+    if (!toCamera(sections["left"], &calibration->left) || !toCamera(sections["right"], &calibration->right) ||
+        !toExtrinsics(sections["left_to_right"], &calibration->leftToRight) ||
+        !toExtrinsics(sections["left_imu"], &calibration->leftToImu)) {
+        LOG(ERROR) << fmt::format("incomplete calibration file \"{}\"", file.string());
+        return false;
+    }
+    return true;
+}
+
+StereoRectifier::StereoRectifier(const RecordingCalibration& calibration) {
+    CHECK(calibration.left.size == calibration.right.size) << "left and right image should have the same size";
+    const Size& size = calibration.left.size;
+    // the translation is in mm, so the baseline of rectified projection is in m
+    Mat R1, R2, P1, P2, Q;
+    stereoRectify(calibration.left.cameraMatrix, calibration.left.coeffs, calibration.right.cameraMatrix,
+                  calibration.right.coeffs, size, calibration.leftToRight.rotation,
+                  calibration.leftToRight.translation * 1.0E-3, R1, R2, P1, P2, Q, CALIB_ZERO_DISPARITY, 0);
+    initUndistortRectifyMap(calibration.left.cameraMatrix, calibration.left.coeffs, R1, P1, size, CV_16SC2,
+                            leftMaps_[0], leftMaps_[1]);
+    initUndistortRectifyMap(calibration.right.cameraMatrix, calibration.right.coeffs, R2, P2, size, CV_16SC2,
+                            rightMaps_[0], rightMaps_[1]);
+    camera_.fx = P1.at<double>(0, 0);
+    camera_.fy = P1.at<double>(1, 1);
+    camera_.cx = P1.at<double>(0, 2);
+    camera_.cy = P1.at<double>(1, 2);
+    camera_.baseline = abs(P2.at<double>(0, 3) / P2.at<double>(0, 0));
+    // the left camera to IMU is p_imu = R * p_left + t, and the rectified left camera is p_rectified = R1 * p_left
+    cameraImu_ = Matx33d(R1.ptr<double>()) * calibration.leftToImu.rotation.t();
+}
+
+void StereoRectifier::rectify(const Mat& image, bool isLeft, Mat& rectified) const {
+    const Mat* maps = isLeft ? leftMaps_ : rightMaps_;
+    remap(image, rectified, maps[0], maps[1], INTER_LINEAR);
+}
+
+RecordingReader::RecordingReader(const fs::path& folder, bool withImages) : folder_(folder), withImages_(withImages) {
+    for (auto& segment : findClosedSegments(folder)) {
+        segments_.emplace_back(segment.folder);
+    }
+}
+
+bool RecordingReader::next(RecordingItem* item) {
+    while (true) {
+        while (entry_ >= entries_.size()) {
+            if (!loadSegment()) {
+                return false;
+            }
+        }
+        const Entry& entry = entries_[entry_++];
+        item->isImage = entry.isImage;
+        if (!entry.isImage) {
+            item->imu = imu_[entry.index];
+            return true;
+        }
+        const ImageEntry& image = images_[entry.index];
+        fs::path path = folder_ / segments_[segment_ - 1] / image.file;
+        item->stream = image.stream;
+        item->image.frameId = image.frameId;
+        item->image.timestamp = image.timestamp;
+        item->image.hostTimestamp = image.hostTimestamp;
+        item->image.image = imread(path.string(), IMREAD_COLOR);
+        if (!item->image.image.empty()) {
+            return true;
+        }
+        LOG(WARNING) << fmt::format("skip invalid image \"{}\"", path.string());
+    }
+}
+
+bool RecordingReader::loadSegment() {
+    if (segment_ >= segments_.size()) {
+        return false;
+    }
+    fs::path folder = folder_ / segments_[segment_++];
+    entries_.clear();
+    entry_ = 0;
+    images_.clear();
+    imu_.clear();
+
+    string line;
+    vector<string> tokens;
+    ifstream indexFile;
+    if (withImages_) {
+        indexFile.open((folder / "index.csv").string());
+    }
+    while (indexFile.is_open() && getline(indexFile, line)) {
+        boost::split(tokens, line, boost::is_any_of(","));
+        if (line.empty() || line[0] == '#' || tokens.size() != 5) {
+            continue;
+        }
+        ImageEntry image;
+        try {
+            image.stream = tokens[0];
+            image.frameId = static_cast<uint32_t>(stoul(tokens[1]));
+            image.timestamp = stoll(tokens[2]);
+            image.hostTimestamp = stoll(tokens[3]);
+            image.file = tokens[4];
+        } catch (const exception&) {
+            LOG(WARNING) << fmt::format("skip invalid line \"{}\" in \"{}\"", line, (folder / "index.csv").string());
+            continue;
+        }
+        entries_.push_back({image.timestamp, true, images_.size()});
+        images_.emplace_back(image);
+    }
+    ifstream imuFile((folder / "imu.csv").string());
+    while (getline(imuFile, line)) {
+        boost::split(tokens, line, boost::is_any_of(","));
+        if (line.empty() || line[0] == '#' || tokens.size() != 8) {
+            continue;
+        }
+        ImuRecord record;
+        try {
+            record.timestamp = stoll(tokens[0]);
+            record.hostTimestamp = stoll(tokens[1]);
+            for (int i = 0; i < 3; ++i) {
+                record.acc[i] = stod(tokens[2 + i]);
+                record.gyro[i] = stod(tokens[5 + i]);
+            }
+        } catch (const exception&) {
+            LOG(WARNING) << fmt::format("skip invalid line \"{}\" in \"{}\"", line, (folder / "imu.csv").string());
+            continue;
+        }
+        entries_.push_back({record.timestamp, false, imu_.size()});
+        imu_.emplace_back(record);
+    }
+    // the IMU records are before the images with the same timestamp, as the IMU of frame is in (previous, current]
+    stable_sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+        return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && !a.isImage && b.isImage);
+    });
+    LOG(INFO) << fmt::format("load segment \"{}\", {} images, {} IMU records", folder.string(), images_.size(),
+                             imu_.size());
+    return true;
+}
+
+}  // namespace mev
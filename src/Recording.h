@@ -0,0 +1,137 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+#include "FrameBundle.h"
+#include "SparseStereo.h"
+#include "Types.h"
+
+namespace mev {
+
+// pinhole camera with radial-tangential distortion in calibration file
+struct CameraCalibration {
+    cv::Size size;                                 // image size of recorded frames
+    cv::Matx33d cameraMatrix{cv::Matx33d::eye()};  // camera matrix
+    cv::Vec<double, 5> coeffs;                     // distortion coefficients (k1, k2, p1, p2, k3)
+};
+
+// rigid transform in calibration file, p_to = rotation * p_from + translation
+struct ExtrinsicsCalibration {
+    cv::Matx33d rotation{cv::Matx33d::eye()};  // rotation
+    cv::Vec3d translation;                     // translation, mm
+};
+
+// calibration of recorded device, which is written by writeCalibration()
+struct RecordingCalibration {
+    CameraCalibration left;             // left camera
+    CameraCalibration right;            // right camera
+    ExtrinsicsCalibration leftToRight;  // from left camera to right camera
+    ExtrinsicsCalibration leftToImu;    // from left camera to IMU
+};
+
+/**
+ * @brief Read the calibration file "calibration.yaml" of recorded device
+ *
+ * @param file          Calibration file
+ * @param calibration   Output calibration
+ * @return False if the file cannot be read or any field is missing
+ */
+bool readCalibration(const boost::filesystem::path& file, RecordingCalibration* calibration);
+
+/**
+ * @brief Stereo rectification of recorded raw images, the maps are computed once, so the images are rectified like the
+ * COLOR_RECTIFIED mode of device
+ */
+class StereoRectifier {
+  public:
+    explicit StereoRectifier(const RecordingCalibration& calibration);
+
+    /**
+     * @brief Rectify image
+     *
+     * @param image     Raw image of left or right camera
+     * @param isLeft    Whether the image is of left camera
+     * @param rectified Output rectified image
+     */
+    void rectify(const cv::Mat& image, bool isLeft, cv::Mat& rectified) const;
+
+    // rectified stereo camera
+    inline const StereoCamera& camera() const { return camera_; }
+
+    // rotation from IMU frame to rectified left camera frame, p_camera = cameraImu * p_imu
+    inline const cv::Matx33d& cameraImu() const { return cameraImu_; }
+
+  private:
+    StereoCamera camera_;
+    cv::Matx33d cameraImu_;
+    cv::Mat leftMaps_[2];   // remap of left camera
+    cv::Mat rightMaps_[2];  // remap of right camera
+};
+
+// recorded image or IMU record
+struct RecordingItem {
+    bool isImage{false};  // image or IMU
+    std::string stream;   // stream name of image, such as "left" or "right"
+    StreamImage image;    // decoded image, BGR
+    ImuRecord imu;        // IMU record
+};
+
+/**
+ * @brief Read the images and IMU of a recorded device in device timestamp order, segment by segment. Only the index
+ * and IMU of current segment are in memory, and the images are decoded when read, so it streams long recordings
+ */
+class RecordingReader {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param folder        Device folder of recording, which contains the closed segments
+     * @param withImages    Whether to read the images, or only the IMU records
+     */
+    explicit RecordingReader(const boost::filesystem::path& folder, bool withImages = true);
+
+    /**
+     * @brief Read next item, the IMU records are before the images with the same timestamp
+     *
+     * @param item  Output item
+     * @return False if all items are read
+     */
+    bool next(RecordingItem* item);
+
+    // closed segment number
+    inline std::size_t segmentNum() const { return segments_.size(); }
+
+  private:
+    // item in index or IMU file
+    struct Entry {
+        std::int64_t timestamp{0};
+        bool isImage{false};
+        std::size_t index{0};  // index of image or IMU record
+    };
+
+    // image in index file
+    struct ImageEntry {
+        std::string stream;
+        std::uint32_t frameId{0};
+        std::int64_t timestamp{0};
+        std::int64_t hostTimestamp{0};
+        std::string file;
+    };
+
+    // load the index and IMU of next segment, return false if there isn't any segment
+    bool loadSegment();
+
+  private:
+    boost::filesystem::path folder_;
+    bool withImages_{true};
+    std::vector<std::string> segments_;  // closed segment folders
+    std::size_t segment_{0};             // index of next segment to load
+    std::vector<Entry> entries_;         // items of current segment in time order
+    std::size_t entry_{0};               // index of next entry
+    std::vector<ImageEntry> images_;     // images of current segment
+    std::vector<ImuRecord> imu_;         // IMU records of current segment
+};
+
+}  // namespace mev
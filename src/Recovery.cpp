@@ -0,0 +1,342 @@
+#include "Recovery.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <boost/algorithm/string.hpp>
+#include <fstream>
+#include <functional>
+#include <set>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+// image index entry
+struct IndexEntry {
+    string stream;
+    uint32_t frameId{0};
+    int64_t timestamp{0};
+    int64_t hostTimestamp{0};
+    string file;
+};
+
+// parse integer, return false if it's not entirely a number
+static bool parseInteger(const string& text, int64_t* value) {
+    try {
+        size_t pos{0};
+        *value = stoll(text, &pos);
+        return pos == text.size();
+    } catch (const exception& e) {
+        return false;
+    }
+}
+
+// parse image index line
+static bool parseIndexLine(const string& line, IndexEntry* entry) {
+    vector<string> tokens;
+    boost::split(tokens, line, boost::is_any_of(","));
+    int64_t frameId{0};
+    if (tokens.size() != 5 || !parseInteger(tokens[1], &frameId) || !parseInteger(tokens[2], &entry->timestamp) ||
+        !parseInteger(tokens[3], &entry->hostTimestamp) || tokens[0].empty() || tokens[4].empty()) {
+        return false;
+    }
+    entry->stream = tokens[0];
+    entry->frameId = static_cast<uint32_t>(frameId);
+    entry->file = tokens[4];
+    return true;
+}
+
+// parse IMU line, only the timestamp is output
+static bool parseImuLine(const string& line, int64_t* timestamp) {
+    vector<string> tokens;
+    boost::split(tokens, line, boost::is_any_of(","));
+    int64_t hostTimestamp{0};
+    if (tokens.size() != 8 || !parseInteger(tokens[0], timestamp) || !parseInteger(tokens[1], &hostTimestamp)) {
+        return false;
+    }
+    for (size_t i = 2; i < tokens.size(); ++i) {
+        try {
+            size_t pos{0};
+            stod(tokens[i], &pos);
+            if (pos != tokens[i].size()) {
+                return false;
+            }
+        } catch (const exception& e) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// read the synced file sizes of index and IMU from checkpoint, return false if there isn't checkpoint
+static bool readCheckpoint(const fs::path& folder, uint64_t* indexSize, uint64_t* imuSize) {
+    ifstream file((folder / "checkpoint.yaml").string());
+    if (!file.is_open()) {
+        return false;
+    }
+    bool hasIndex{false}, hasImu{false};
+    string line;
+    while (getline(file, line)) {
+        auto pos = line.find(':');
+        if (pos == string::npos) {
+            continue;
+        }
+        string key = line.substr(0, pos);
+        int64_t value{0};
+        if (!parseInteger(boost::trim_copy(line.substr(pos + 1)), &value) || value < 0) {
+            continue;
+        }
+        if (key == "index") {
+            *indexSize = static_cast<uint64_t>(value);
+            hasIndex = true;
+        } else if (key == "imu") {
+            *imuSize = static_cast<uint64_t>(value);
+            hasImu = true;
+        }
+    }
+    return hasIndex && hasImu;
+}
+
+// read the complete lines of file, the last line without line break is dropped. The data before synced size(from
+// checkpoint) has been synced to disk, but the data after it hasn't, which may be garbage after power loss or partial
+// after a failed write, so the lines after synced size are only kept until the first invalid one
+static vector<string> readCompleteLines(const fs::path& path, uint64_t syncedSize,
+                                        const function<bool(const string&)>& isValid) {
+    vector<string> lines;
+    ifstream file(path.string(), ios::binary);
+    if (!file.is_open()) {
+        return lines;
+    }
+    string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (content.size() < syncedSize) {
+        LOG(WARNING) << fmt::format("\"{}\" is shorter than the checkpoint, {} bytes synced data are lost",
+                                    path.string(), syncedSize - content.size());
+    }
+    size_t begin = 0;
+    for (size_t end = content.find('\n'); end != string::npos; end = content.find('\n', begin)) {
+        string line = content.substr(begin, end - begin);
+        if (end >= syncedSize && !line.empty() && line[0] != '#' && !isValid(line)) {
+            LOG(WARNING) << fmt::format("drop {} bytes after invalid line in unsynced data of \"{}\"",
+                                        content.size() - begin, path.string());
+            return lines;
+        }
+        lines.emplace_back(std::move(line));
+        begin = end + 1;
+    }
+    if (begin < content.size()) {
+        LOG(WARNING) << fmt::format("drop truncated line in \"{}\"", path.string());
+    }
+    return lines;
+}
+
+// write lines to file by temp file and rename, the file isn't replaced if failed
+static bool writeLines(const fs::path& path, const string& header, const vector<string>& lines) {
+    fs::path tempPath = path.string() + ".tmp";
+    ofstream file(tempPath.string());
+    if (!file.is_open()) {
+        LOG(ERROR) << fmt::format("cannot create file \"{}\"", tempPath.string());
+        return false;
+    }
+    file << header << "\n";
+    for (auto& line : lines) {
+        file << line << "\n";
+    }
+    file.close();
+    if (!file) {
+        LOG(ERROR) << fmt::format("cannot write file \"{}\"", tempPath.string());
+        fs::remove(tempPath);
+        return false;
+    }
+    fs::rename(tempPath, path);
+    return true;
+}
+
+bool isImageComplete(const fs::path& path) {
+    boost::system::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec || size == 0) {
+        return false;
+    }
+
+    string ext = boost::to_lower_copy(path.extension().string());
+    string tail;
+    if (ext == ".jpg" || ext == ".jpeg") {
+        tail = "\xFF\xD9";
+    } else if (ext == ".png") {
+        tail = string("IEND\xAE\x42\x60\x82", 8);
+    } else {
+        return true;
+    }
+    if (size < tail.size()) {
+        return false;
+    }
+    ifstream file(path.string(), ios::binary);
+    file.seekg(-static_cast<streamoff>(tail.size()), ios::end);
+    string data(tail.size(), '\0');
+    file.read(&data[0], data.size());
+    return file && data == tail;
+}
+
+bool recoverSegment(const fs::path& folder, SegmentInfo* info) {
+    *info = SegmentInfo();
+    info->folder = folder.filename().string();
+    if (sscanf(info->folder.c_str(), "segment_%zu", &info->index) != 1) {
+        LOG(ERROR) << fmt::format("\"{}\" is not a segment folder", folder.string());
+        return false;
+    }
+    LOG(INFO) << fmt::format("recover segment \"{}\"", folder.string());
+
+    // the synced sizes of the last checkpoint, all data is unsynced if there isn't any checkpoint
+    uint64_t syncedIndexSize{0}, syncedImuSize{0};
+    if (readCheckpoint(folder, &syncedIndexSize, &syncedImuSize)) {
+        LOG(INFO) << fmt::format("checkpoint, synced index = {} bytes, IMU = {} bytes", syncedIndexSize, syncedImuSize);
+    } else {
+        LOG(WARNING) << "cannot find checkpoint, all data is validated";
+    }
+
+    // read the partial index, only keep the complete images
+    vector<IndexEntry> entries;
+    set<string> indexedFiles;
+    size_t brokenNum{0};
+    auto isIndexValid = [](const string& line) {
+        IndexEntry entry;
+        return parseIndexLine(line, &entry);
+    };
+    for (auto& line : readCompleteLines(folder / "index.csv", syncedIndexSize, isIndexValid)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        IndexEntry entry;
+        if (!parseIndexLine(line, &entry)) {
+            ++brokenNum;
+            continue;
+        }
+        indexedFiles.insert(entry.file);
+        if (!isImageComplete(folder / entry.file)) {
+            ++brokenNum;
+            continue;
+        }
+        entries.emplace_back(entry);
+    }
+    size_t indexedNum = entries.size();
+
+    // add the complete images which are not in index, the frame ID and host timestamp are unknown
+    for (auto& streamEntry : fs::directory_iterator(folder)) {
+        if (!fs::is_directory(streamEntry.path())) {
+            continue;
+        }
+        string stream = streamEntry.path().filename().string();
+        info->imageNum[stream] = 0;
+        for (auto& fileEntry : fs::directory_iterator(streamEntry.path())) {
+            string file = stream + "/" + fileEntry.path().filename().string();
+            if (indexedFiles.count(file) != 0) {
+                continue;
+            }
+            IndexEntry entry;
+            entry.stream = stream;
+            entry.file = file;
+            try {
+                entry.timestamp = stoll(fileEntry.path().stem().string());
+            } catch (const exception& e) {
+                continue;
+            }
+            if (!isImageComplete(fileEntry.path())) {
+                ++brokenNum;
+                continue;
+            }
+            entries.emplace_back(entry);
+        }
+    }
+    sort(entries.begin(), entries.end(),
+         [](const IndexEntry& a, const IndexEntry& b) { return a.timestamp < b.timestamp; });
+    LOG(INFO) << fmt::format("images: indexed = {}, not indexed = {}, broken = {}", indexedNum,
+                             entries.size() - indexedNum, brokenNum);
+
+    // rebuild index
+    vector<string> indexLines;
+    info->startTime = numeric_limits<int64_t>::max();
+    info->endTime = numeric_limits<int64_t>::min();
+    for (auto& e : entries) {
+        indexLines.emplace_back(
+            fmt::format("{},{},{},{},{}", e.stream, e.frameId, e.timestamp, e.hostTimestamp, e.file));
+        ++info->imageNum[e.stream];
+        info->bytes += fs::file_size(folder / e.file);
+        info->startTime = min(info->startTime, e.timestamp);
+        info->endTime = max(info->endTime, e.timestamp);
+    }
+    if (!writeLines(folder / "index.csv", kIndexHeader, indexLines)) {
+        return false;
+    }
+
+    // drop the truncated IMU
+    vector<string> imuLines;
+    auto isImuValid = [](const string& line) {
+        int64_t timestamp{0};
+        return parseImuLine(line, &timestamp);
+    };
+    for (auto& line : readCompleteLines(folder / "imu.csv", syncedImuSize, isImuValid)) {
+        int64_t timestamp{0};
+        if (line.empty() || line[0] == '#' || !parseImuLine(line, &timestamp)) {
+            continue;
+        }
+        info->startTime = min(info->startTime, timestamp);
+        info->endTime = max(info->endTime, timestamp);
+        imuLines.emplace_back(line);
+        info->bytes += line.size() + 1;
+    }
+    info->imuNum = imuLines.size();
+    if (!writeLines(folder / "imu.csv", kImuHeader, imuLines)) {
+        return false;
+    }
+    LOG(INFO) << fmt::format("IMU number = {}", info->imuNum);
+
+    if (info->startTime > info->endTime) {
+        info->startTime = info->endTime = 0;
+    }
+    if (!writeSegmentInfo(folder, *info)) {
+        return false;
+    }
+    fs::remove(folder / "checkpoint.yaml");
+    return true;
+}
+
+vector<fs::path> findDeviceFolders(const fs::path& root) {
+    // the device list of session.yaml, such as "    folder: \"cam0\"", the folder is relative to root
+    vector<fs::path> folders;
+    ifstream sessionFile((root / "session.yaml").string());
+    string line;
+    while (getline(sessionFile, line)) {
+        boost::trim(line);
+        if (boost::starts_with(line, "folder:")) {
+            string folder = boost::trim_copy_if(line.substr(7), boost::is_any_of(" \""));
+            folders.emplace_back(folder.empty() || folder == "." ? root : root / folder);
+        }
+    }
+    if (folders.empty()) {
+        folders.emplace_back(root);
+    }
+    return folders;
+}
+
+size_t recoverSession(const fs::path& root) {
+    size_t recoveredNum{0};
+    for (auto& entry : fs::directory_iterator(root)) {
+        SegmentInfo info;
+        size_t index{0};
+        if (!fs::is_directory(entry.path()) ||
+            sscanf(entry.path().filename().c_str(), "segment_%zu", &index) != 1 ||
+            readSegmentInfo(entry.path(), &info)) {
+            continue;
+        }
+        if (recoverSegment(entry.path(), &info)) {
+            ++recoveredNum;
+        }
+    }
+
+    // rebuild segment list
+    auto segments = findClosedSegments(root);
+    writeSegmentList(root, deque<SegmentInfo>(segments.begin(), segments.end()));
+    return recoveredNum;
+}
+
+}  // namespace mev
@@ -0,0 +1,45 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include "SegmentWriter.h"
+
+namespace mev {
+
+/**
+ * @brief Check whether the image file is complete, the JPEG and PNG file are checked by their end marker, and other
+ * files are only checked by the size
+ *
+ * @param path  Image file path
+ * @return True if the image is complete
+ */
+bool isImageComplete(const boost::filesystem::path& path);
+
+/**
+ * @brief Recover an unclosed segment of a killed recording. The truncated lines in IMU and index are dropped, and the
+ * data after the synced sizes of checkpoint is only kept until the first invalid line, since it may be garbage after
+ * power loss. The index is rebuilt from the partial index and the complete images in stream folders, then the segment
+ * information is written so it becomes a closed segment
+ *
+ * @param folder    Segment folder
+ * @param info      Output segment information
+ * @return True for success
+ */
+bool recoverSegment(const boost::filesystem::path& folder, SegmentInfo* info);
+
+/**
+ * @brief Find the device folders of recording. A multi-device session lists its device folders(cam<N>) in
+ * "session.yaml", and a single device recording has its segments in root folder directly
+ *
+ * @param root  Root folder of recording
+ * @return Device folders
+ */
+std::vector<boost::filesystem::path> findDeviceFolders(const boost::filesystem::path& root);
+
+/**
+ * @brief Recover all unclosed segments in root folder, and rebuild the closed segment list
+ *
+ * @param root  Root folder
+ * @return Recovered segment number
+ */
+std::size_t recoverSession(const boost::filesystem::path& root);
+
+}  // namespace mev
@@ -0,0 +1,443 @@
+#include "SegmentWriter.h"
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+// check disk space every 1 s or every 64 MB
+constexpr int64_t kDiskCheckInterval = 1000000000;
+constexpr uint64_t kDiskCheckBytes = 64 * 1024 * 1024;
+
+// write all data to file descriptor
+static bool writeAll(int fd, const string& data) {
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+// create file and write header, return the file descriptor
+static int createFile(const fs::path& path, const string& header) {
+    int fd = ::open(path.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    CHECK_GE(fd, 0) << fmt::format("cannot create file \"{}\"", path.string());
+    CHECK(writeAll(fd, header)) << fmt::format("cannot write to file \"{}\"", path.string());
+    return fd;
+}
+
+string segmentFolderName(size_t index) { return fmt::format("segment_{:06d}", index); }
+
+string formatImuRecord(const ImuRecord& record) {
+    return fmt::format("{},{},{},{},{},{},{},{}\n", record.timestamp, record.hostTimestamp, record.acc[0], record.acc[1],
+                       record.acc[2], record.gyro[0], record.gyro[1], record.gyro[2]);
+}
+
+bool writeSegmentInfo(const fs::path& folder, const SegmentInfo& info) {
+    // write to temp file and then rename, to avoid broken file
+    fs::path infoPath = folder / "segment.yaml";
+    fs::path tempPath = folder / "segment.yaml.tmp";
+    ofstream infoFile(tempPath.string());
+    if (!infoFile.is_open()) {
+        LOG(ERROR) << fmt::format("cannot create segment information file \"{}\"", tempPath.string());
+        return false;
+    }
+    infoFile << fmt::format("index: {}\n", info.index);
+    infoFile << fmt::format("start: {}\n", info.startTime);
+    infoFile << fmt::format("end: {}\n", info.endTime);
+    infoFile << fmt::format("duration: {:.3f}\n", (info.endTime - info.startTime) * 1.0E-9);
+    infoFile << fmt::format("bytes: {}\n", info.bytes);
+    infoFile << fmt::format("imu: {}\n", info.imuNum);
+    infoFile << "images:\n";
+    for (auto& v : info.imageNum) {
+        infoFile << fmt::format("  {}: {}\n", v.first, v.second);
+    }
+    infoFile.close();
+    fs::rename(tempPath, infoPath);
+    return true;
+}
+
+bool readSegmentInfo(const fs::path& folder, SegmentInfo* info) {
+    ifstream infoFile((folder / "segment.yaml").string());
+    if (!infoFile.is_open()) {
+        return false;
+    }
+    *info = SegmentInfo();
+    info->folder = folder.filename().string();
+    bool hasIndex{false}, inImages{false};
+    string line;
+    while (getline(infoFile, line)) {
+        auto pos = line.find(':');
+        if (pos == string::npos) {
+            continue;
+        }
+        bool indented = !line.empty() && line[0] == ' ';
+        string key = line.substr(0, pos);
+        key.erase(0, key.find_first_not_of(' '));
+        string value = line.substr(pos + 1);
+        try {
+            if (indented && inImages) {
+                info->imageNum[key] = stoull(value);
+            } else if (key == "images") {
+                inImages = true;
+            } else {
+                inImages = false;
+                if (key == "index") {
+                    info->index = stoull(value);
+                    hasIndex = true;
+                } else if (key == "start") {
+                    info->startTime = stoll(value);
+                } else if (key == "end") {
+                    info->endTime = stoll(value);
+                } else if (key == "bytes") {
+                    info->bytes = stoull(value);
+                } else if (key == "imu") {
+                    info->imuNum = stoull(value);
+                }
+            }
+        } catch (const exception& e) {
+            LOG(ERROR) << fmt::format("cannot parse line \"{}\" in segment information of \"{}\"", line,
+                                      folder.string());
+            return false;
+        }
+    }
+    return hasIndex;
+}
+
+vector<SegmentInfo> findClosedSegments(const fs::path& root) {
+    vector<SegmentInfo> segments;
+    if (!fs::is_directory(root)) {
+        return segments;
+    }
+    for (auto& entry : fs::directory_iterator(root)) {
+        SegmentInfo info;
+        if (fs::is_directory(entry.path()) && readSegmentInfo(entry.path(), &info)) {
+            segments.emplace_back(info);
+        }
+    }
+    sort(segments.begin(), segments.end(),
+         [](const SegmentInfo& a, const SegmentInfo& b) { return a.index < b.index; });
+    return segments;
+}
+
+bool writeSegmentList(const fs::path& root, const deque<SegmentInfo>& segments) {
+    // write to temp file and then rename, to avoid broken file
+    fs::path listPath = root / "segments.csv";
+    fs::path tempPath = root / "segments.csv.tmp";
+    ofstream listFile(tempPath.string());
+    if (!listFile.is_open()) {
+        LOG(ERROR) << fmt::format("cannot create segment list file \"{}\"", tempPath.string());
+        return false;
+    }
+    listFile << "# Index, Folder, Start(ns), End(ns), Bytes" << endl;
+    for (auto& s : segments) {
+        listFile << fmt::format("{},{},{},{},{}\n", s.index, s.folder, s.startTime, s.endTime, s.bytes);
+    }
+    listFile.close();
+    fs::rename(tempPath, listPath);
+    return true;
+}
+
+SegmentWriter::SegmentWriter(const fs::path& root, const SegmentOptions& options, const vector<string>& streams)
+    : root_(root), options_(options), streams_(streams) {
+    CHECK(fs::is_directory(root_)) << fmt::format("root folder \"{}\" is not exist", root_.string());
+
+    // keep the closed segments in root folder, and the new segment index is after all existing segments
+    auto segments = findClosedSegments(root_);
+    closed_.assign(segments.begin(), segments.end());
+    earlierSegments_ = closed_.size();
+    current_.index = 0;
+    for (auto& entry : fs::directory_iterator(root_)) {
+        size_t index{0};
+        if (fs::is_directory(entry.path()) && sscanf(entry.path().filename().c_str(), "segment_%zu", &index) == 1) {
+            current_.index = max(current_.index, index + 1);
+        }
+    }
+    if (!closed_.empty()) {
+        LOG(INFO) << fmt::format("found {} closed segments in \"{}\"", closed_.size(), root_.string());
+        writeSegmentList(root_, closed_);
+    }
+}
+
+SegmentWriter::~SegmentWriter() { close(); }
+
+bool SegmentWriter::write(const ImageRecord& record) {
+    if (!prepare(record.timestamp, record.data.size())) {
+        return false;
+    }
+
+    // save image
+    string fileName = fmt::format("{}/{}.{}", record.stream, record.timestamp, record.ext);
+    fs::path savePath = path_ / fileName;
+    ofstream outFs(savePath.string(), ios::binary);
+    if (outFs.is_open()) {
+        outFs.write(reinterpret_cast<const char*>(record.data.data()), record.data.size());
+        outFs.close();
+    }
+    if (!outFs) {
+        // the partial image is removed and not indexed, and the segment is closed with the data written so far
+        PLOG(ERROR) << fmt::format("cannot save image \"{}\", stop recording", savePath.string());
+        boost::system::error_code ec;
+        fs::remove(savePath, ec);
+        close();
+        return false;
+    }
+
+    // append to index, the index is written after the image, so it never refers to a missing image
+    indexBuffer_ += fmt::format("{},{},{},{},{}\n", record.stream, record.frameId, record.timestamp,
+                                record.hostTimestamp, fileName);
+
+    current_.endTime = max(current_.endTime, record.timestamp);
+    current_.bytes += record.data.size();
+    ++current_.imageNum[record.stream];
+    totalBytes_ += record.data.size();
+
+    // checkpoint
+    ++pendingImages_;
+    if (options_.checkpointInterval > 0 && pendingImages_ >= options_.checkpointInterval) {
+        return checkpoint();
+    }
+    return checkpointByTime(record.timestamp);
+}
+
+bool SegmentWriter::write(const ImuRecord& record) {
+    string line = formatImuRecord(record);
+    if (!prepare(record.timestamp, line.size())) {
+        return false;
+    }
+    imuBuffer_ += line;
+
+    current_.endTime = max(current_.endTime, record.timestamp);
+    current_.bytes += line.size();
+    ++current_.imuNum;
+    totalBytes_ += line.size();
+
+    // the IMU is also checkpointed by time, since the images may stall
+    return checkpointByTime(record.timestamp);
+}
+
+bool SegmentWriter::checkpoint() {
+    if (!opened_) {
+        return true;
+    }
+    // the files may have partial data after a failed write, so never write again
+    if (stopped_) {
+        return false;
+    }
+
+    // flush index and IMU, the synced sizes only advance after the data is written. If failed(disk error), the recording
+    // is stopped, and the partial data after the synced sizes is dropped by recovery
+    if (!writeAll(indexFd_, indexBuffer_)) {
+        PLOG(ERROR) << fmt::format("cannot write index of segment \"{}\", stop recording", path_.string());
+        stopped_ = true;
+        return false;
+    }
+    indexFileSize_ += indexBuffer_.size();
+    indexBuffer_.clear();
+    if (!writeAll(imuFd_, imuBuffer_)) {
+        PLOG(ERROR) << fmt::format("cannot write IMU of segment \"{}\", stop recording", path_.string());
+        stopped_ = true;
+        return false;
+    }
+    imuFileSize_ += imuBuffer_.size();
+    imuBuffer_.clear();
+    pendingImages_ = 0;
+    checkpointTime_ = current_.endTime;
+
+    // sync all data in file system, including the images. If failed, the data isn't durable, so the checkpoint isn't
+    // advanced and the recording is stopped
+    if (syncfs(imuFd_) != 0) {
+        PLOG(ERROR) << fmt::format("cannot sync segment \"{}\", stop recording", path_.string());
+        stopped_ = true;
+        return false;
+    }
+
+    // write checkpoint, the data before the file sizes are complete
+    fs::path checkPath = path_ / "checkpoint.yaml";
+    fs::path tempPath = path_ / "checkpoint.yaml.tmp";
+    ofstream checkFile(tempPath.string());
+    if (!checkFile.is_open()) {
+        LOG(ERROR) << fmt::format("cannot create checkpoint file \"{}\"", tempPath.string());
+        return true;
+    }
+    checkFile << fmt::format("end: {}\n", current_.endTime);
+    checkFile << fmt::format("index: {}\n", indexFileSize_);
+    checkFile << fmt::format("imu: {}\n", imuFileSize_);
+    checkFile.close();
+    fs::rename(tempPath, checkPath);
+    return true;
+}
+
+void SegmentWriter::close() {
+    if (opened_) {
+        closeSegment();
+    }
+    stopped_ = true;
+}
+
+bool SegmentWriter::prepare(int64_t timestamp, size_t bytes) {
+    if (stopped_) {
+        return false;
+    }
+
+    if (!opened_) {
+        // check disk space before open the first segment
+        if (!checkDiskSpace(timestamp)) {
+            return false;
+        }
+        runStartTime_ = timestamp;
+        openSegment(timestamp);
+        return true;
+    }
+
+    // rotate to a new segment
+    bool timeout = options_.maxDuration > 0 && timestamp - current_.startTime >= options_.maxDuration * 1.0E9;
+    bool oversize = options_.maxSize > 0 && current_.bytes + bytes > options_.maxSize * kGB;
+    if (timeout || oversize) {
+        size_t nextIndex = current_.index + 1;
+        closeSegment();
+        if (stopped_) {
+            return false;
+        }
+        current_.index = nextIndex;
+
+        // only keep the last K minutes. The segments of earlier runs have timestamps of another device clock(it
+        // restarts after power cycle), but they are older than this run, so they expire once this run is longer
+        if (options_.retention == RetentionPolicy::Keep && options_.keepDuration > 0) {
+            while (!closed_.empty()) {
+                int64_t age = earlierSegments_ > 0 ? timestamp - runStartTime_ : timestamp - closed_.front().endTime;
+                if (age <= options_.keepDuration * 60.0E9) {
+                    break;
+                }
+                removeOldestSegment();
+            }
+        }
+
+        if (!checkDiskSpace(timestamp)) {
+            return false;
+        }
+        openSegment(timestamp);
+        return true;
+    }
+
+    // check disk space periodically
+    if (timestamp - lastCheckTime_ >= kDiskCheckInterval || totalBytes_ - lastCheckBytes_ >= kDiskCheckBytes) {
+        return checkDiskSpace(timestamp);
+    }
+    return true;
+}
+
+bool SegmentWriter::checkpointByTime(int64_t timestamp) {
+    if (options_.checkpointDuration > 0 && timestamp - checkpointTime_ >= options_.checkpointDuration * 1.0E9) {
+        return checkpoint();
+    }
+    return true;
+}
+
+void SegmentWriter::openSegment(int64_t timestamp) {
+    size_t index = current_.index;
+    current_ = SegmentInfo();
+    current_.index = index;
+    current_.folder = segmentFolderName(index);
+    current_.startTime = timestamp;
+    current_.endTime = timestamp;
+    path_ = root_ / current_.folder;
+    LOG(INFO) << fmt::format("open segment \"{}\"", path_.string());
+
+    // create folders
+    fs::create_directories(path_);
+    for (auto& s : streams_) {
+        fs::create_directories(path_ / s);
+        current_.imageNum[s] = 0;
+    }
+
+    // create IMU and index file
+    const string imuHeader = kImuHeader + "\n";
+    const string indexHeader = kIndexHeader + "\n";
+    imuFd_ = createFile(path_ / "imu.csv", imuHeader);
+    indexFd_ = createFile(path_ / "index.csv", indexHeader);
+    imuFileSize_ = imuHeader.size();
+    indexFileSize_ = indexHeader.size();
+    pendingImages_ = 0;
+    checkpointTime_ = timestamp;
+
+    opened_ = true;
+}
+
+void SegmentWriter::closeSegment() {
+    // flush all data and close files. If failed, the segment is left unclosed with the last checkpoint for recovery
+    bool flushed = checkpoint();
+    ::close(imuFd_);
+    ::close(indexFd_);
+    imuFd_ = -1;
+    indexFd_ = -1;
+    opened_ = false;
+    if (!flushed) {
+        LOG(ERROR) << fmt::format("segment \"{}\" isn't closed, recover it later", path_.string());
+        return;
+    }
+
+    // write segment information, the segment is complete only if this file exists
+    writeSegmentInfo(path_, current_);
+    fs::remove(path_ / "checkpoint.yaml");
+    LOG(INFO) << fmt::format("close segment \"{}\", duration = {:.3f} s, size = {:.3f} MB", path_.string(),
+                             (current_.endTime - current_.startTime) * 1.0E-9, current_.bytes / 1024. / 1024.);
+
+    closed_.emplace_back(current_);
+    writeSegmentList(root_, closed_);
+}
+
+bool SegmentWriter::checkDiskSpace(int64_t timestamp) {
+    lastCheckTime_ = timestamp;
+    lastCheckBytes_ = totalBytes_;
+    if (!getDiskSpace(root_.string(), &diskSpace_)) {
+        LOG(ERROR) << fmt::format("cannot get disk space of \"{}\"", root_.string());
+        return true;
+    }
+
+    while (diskSpace_.available < options_.minFreeSpace * kGB) {
+        if (options_.retention == RetentionPolicy::Keep && removeOldestSegment()) {
+            getDiskSpace(root_.string(), &diskSpace_);
+            continue;
+        }
+
+        LOG(WARNING) << fmt::format("disk is full, free space = {:.3f} GB, stop recording", diskSpace_.available / kGB);
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SegmentWriter::removeOldestSegment() {
+    if (closed_.empty()) {
+        return false;
+    }
+    fs::path segmentPath = root_ / closed_.front().folder;
+    LOG(INFO) << fmt::format("remove segment \"{}\"", segmentPath.string());
+    boost::system::error_code ec;
+    fs::remove_all(segmentPath, ec);
+    if (ec) {
+        LOG(ERROR) << fmt::format("cannot remove segment \"{}\": {}", segmentPath.string(), ec.message());
+    }
+    closed_.pop_front();
+    earlierSegments_ = earlierSegments_ > 0 ? earlierSegments_ - 1 : 0;
+    writeSegmentList(root_, closed_);
+    return true;
+}
+
+}  // namespace mev
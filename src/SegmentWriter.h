@@ -0,0 +1,211 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "DiskSpace.h"
+#include "Types.h"
+
+namespace mev {
+
+// retention policy when the disk is full
+enum class RetentionPolicy {
+    Stop,  // close the current segment and stop recording
+    Keep,  // remove the oldest closed segments, and only keep the last K minutes if set
+};
+
+// segment options
+struct SegmentOptions {
+    double maxDuration{0};                             // max duration of one segment(s), 0 for unlimited
+    double maxSize{0};                                 // max size of one segment(GB), 0 for unlimited
+    double minFreeSpace{1.0};                          // min free disk space(GB) to continue recording
+    RetentionPolicy retention{RetentionPolicy::Stop};  // retention policy
+    double keepDuration{0};                            // only keep the last K minutes for Keep policy, 0 for unlimited
+    std::size_t checkpointInterval{30};                // write checkpoint every N images, 0 to disable
+    double checkpointDuration{1.0};                    // write checkpoint at least every N seconds, 0 to disable
+};
+
+// segment information
+struct SegmentInfo {
+    std::size_t index{0};                           // segment index
+    std::string folder;                             // segment folder name
+    std::int64_t startTime{0};                      // start timestamp, ns
+    std::int64_t endTime{0};                        // end timestamp, ns
+    std::uint64_t bytes{0};                         // written bytes
+    std::uint64_t imuNum{0};                        // IMU record number
+    std::map<std::string, std::uint64_t> imageNum;  // image number for each stream
+};
+
+// header of IMU file
+const std::string kImuHeader =
+    "# Timestamp(ns), HostTimestamp(ns), AccX(m/s^2), AccY(m/s^2), AccZ(m/s^2), GyroX(rad/s), GyroY(rad/s), "
+    "GyroZ(rad/s)";
+// header of image index file
+const std::string kIndexHeader = "# Stream, FrameID, Timestamp(ns), HostTimestamp(ns), File";
+
+// get the segment folder name from index
+std::string segmentFolderName(std::size_t index);
+
+// format IMU record to one line in IMU file, with line break
+std::string formatImuRecord(const ImuRecord& record);
+
+/**
+ * @brief Write segment information to "segment.yaml" in segment folder, which means the segment is closed
+ *
+ * @param folder    Segment folder
+ * @param info      Segment information
+ * @return True for success
+ */
+bool writeSegmentInfo(const boost::filesystem::path& folder, const SegmentInfo& info);
+
+/**
+ * @brief Read segment information from "segment.yaml" in segment folder
+ *
+ * @param folder    Segment folder
+ * @param info      Output segment information
+ * @return False if the file is not exist or broken, which means the segment is not closed
+ */
+bool readSegmentInfo(const boost::filesystem::path& folder, SegmentInfo* info);
+
+/**
+ * @brief Find all closed segments in root folder, sorted by index
+ *
+ * @param root  Root folder
+ * @return Closed segments
+ */
+std::vector<SegmentInfo> findClosedSegments(const boost::filesystem::path& root);
+
+/**
+ * @brief Write the closed segment list "segments.csv" to root folder
+ *
+ * @param root      Root folder
+ * @param segments  Closed segments
+ * @return True for success
+ */
+bool writeSegmentList(const boost::filesystem::path& root, const std::deque<SegmentInfo>& segments);
+
+/**
+ * @brief Segmented data writer. The recording is split to segments in root folder, and rotate to a new segment every N
+ * seconds or N GB. Each segment contains the images, IMU and index, so every closed segment could be replayed on its
+ * own
+ *
+ *  root/
+ *      segments.csv                    closed segment list
+ *      segment_000000/
+ *          left/<timestamp>.jpg        images, the file name is the timestamp in ns
+ *          right/<timestamp>.jpg
+ *          imu.csv                     IMU data, with device and host timestamp
+ *          index.csv                   image index, stream, frame ID, device and host timestamp, and file name
+ *          checkpoint.yaml             the last checkpoint, the data before it has been synced to disk
+ *          segment.yaml                segment information, only written when the segment is closed
+ *      segment_000001/
+ *      ...
+ *
+ * The index and IMU are buffered in memory, and written to disk with the images synced every N images or N seconds of
+ * data(checkpoint), so at most one checkpoint interval of data will be lost if the process is killed, even if the
+ * images stall and only IMU arrives. The unclosed segment could be recovered by recoverSegment().
+ */
+class SegmentWriter {
+  public:
+    /**
+     * @brief Constructor. The closed segments already in root folder will be kept, and managed by retention policy
+     *
+     * @param root      Root folder, should be exist
+     * @param options   Segment options
+     * @param streams   Image stream names, the folder with the same name will be created in each segment
+     */
+    SegmentWriter(const boost::filesystem::path& root, const SegmentOptions& options,
+                  const std::vector<std::string>& streams);
+
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+  public:
+    /**
+     * @brief Write image to current segment
+     *
+     * @param record    Image record
+     * @return False if the recording is stopped
+     */
+    bool write(const ImageRecord& record);
+
+    /**
+     * @brief Write IMU to current segment
+     *
+     * @param record    IMU record
+     * @return False if the recording is stopped
+     */
+    bool write(const ImuRecord& record);
+
+    // write checkpoint, flush the buffered index and IMU, and sync all data to disk. Return false if the data couldn't
+    // be written or synced, then the recording is stopped
+    bool checkpoint();
+
+    // close current segment and stop recording
+    void close();
+
+    // whether the recording is stopped, by close(), the disk is full with Stop policy or failed to write
+    inline bool isStopped() const { return stopped_; }
+
+    // current segment index
+    inline std::size_t segmentIndex() const { return current_.index; }
+
+    // total written bytes of all segments
+    inline std::uint64_t totalBytes() const { return totalBytes_; }
+
+    // last checked disk space
+    inline const DiskSpace& diskSpace() const { return diskSpace_; }
+
+  private:
+    // prepare the segment to write data with timestamp, rotate and check disk space if needed. Return false if stopped
+    bool prepare(std::int64_t timestamp, std::size_t bytes);
+
+    // write checkpoint if the data since last checkpoint is longer than checkpoint duration, return false if failed
+    bool checkpointByTime(std::int64_t timestamp);
+
+    // open a new segment
+    void openSegment(std::int64_t timestamp);
+
+    // close current segment and write its information
+    void closeSegment();
+
+    // check the free disk space and apply retention policy, return false if recording should be stopped
+    bool checkDiskSpace(std::int64_t timestamp);
+
+    // remove the oldest closed segment, return false if there isn't any closed segment
+    bool removeOldestSegment();
+
+  private:
+    boost::filesystem::path root_;      // root folder
+    SegmentOptions options_;            // options
+    std::vector<std::string> streams_;  // image stream names
+    bool stopped_{false};               // whether the recording is stopped
+
+    // current segment
+    bool opened_{false};              // whether current segment is opened
+    SegmentInfo current_;             // current segment info
+    boost::filesystem::path path_;    // current segment path
+    int imuFd_{-1};                   // IMU file descriptor
+    int indexFd_{-1};                 // index file descriptor
+    std::string imuBuffer_;           // IMU buffer since last checkpoint
+    std::string indexBuffer_;         // index buffer since last checkpoint
+    std::uint64_t imuFileSize_{0};    // synced IMU file size
+    std::uint64_t indexFileSize_{0};  // synced index file size
+    std::size_t pendingImages_{0};    // image number since last checkpoint
+    std::int64_t checkpointTime_{0};  // data timestamp of last checkpoint, ns
+    std::deque<SegmentInfo> closed_;  // closed segments
+    std::size_t earlierSegments_{0};  // closed segment number of earlier runs, at the front of closed segments
+    std::int64_t runStartTime_{0};    // timestamp of the first segment in this run, ns
+
+    // disk space
+    DiskSpace diskSpace_;              // last checked disk space
+    std::int64_t lastCheckTime_{0};    // timestamp of last disk check, ns
+    std::uint64_t lastCheckBytes_{0};  // total written bytes of last disk check
+    std::uint64_t totalBytes_{0};      // total written bytes
+};
+
+}  // namespace mev
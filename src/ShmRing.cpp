@@ -0,0 +1,254 @@
+#include "ShmRing.h"
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// magic number of shared memory, "MEVS"
+constexpr uint32_t kShmMagic = 0x5356454d;
+// version of shared memory layout
+constexpr uint32_t kShmVersion = 1;
+// alignment of slot
+constexpr size_t kSlotAlign = 64;
+
+// header of shared memory
+struct ShmHeader {
+    uint32_t magic;              // magic number
+    uint32_t version;            // layout version
+    uint64_t slotNum;            // slot number
+    uint64_t slotStride;         // bytes of one slot, including slot header
+    atomic<uint32_t> notify;     // futex word, increased after each publish
+    atomic<uint64_t> published;  // published frame number
+};
+
+// header of slot, followed by image data
+struct alignas(kSlotAlign) SlotHeader {
+    atomic<uint64_t> sequence;  // sequence lock, odd when writing, 2 * (index + 1) when the frame of index is written
+    char stream[16];            // stream name
+    uint32_t frameId;           // frame ID
+    int64_t timestamp;          // device timestamp, ns
+    int64_t hostTimestamp;      // host timestamp, ns
+    int32_t rows;               // image rows
+    int32_t cols;               // image cols
+    int32_t type;               // image type
+    uint64_t step;              // image step
+};
+
+// the header size, aligned to slot
+constexpr size_t kHeaderSize = (sizeof(ShmHeader) + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+
+// shared memory name should start with '/'
+string shmName(const string& name) { return name.empty() || name[0] != '/' ? "/" + name : name; }
+
+// get slot of index
+inline SlotHeader* slotOf(void* memory, uint64_t index) {
+    auto* header = static_cast<ShmHeader*>(memory);
+    return reinterpret_cast<SlotHeader*>(static_cast<uint8_t*>(memory) + kHeaderSize +
+                                         (index % header->slotNum) * header->slotStride);
+}
+
+// futex on shared memory, the futex should not be private since it's shared between processes
+inline long futex(atomic<uint32_t>* addr, int op, uint32_t value, const timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, value, timeout, nullptr, 0);
+}
+
+}  // namespace
+
+bool ShmFrame::isValid() const {
+    return slotSequence != nullptr && slotSequence->load(memory_order_acquire) == sequence;
+}
+
+ShmPublisher::ShmPublisher(const string& name, size_t slotNum, size_t slotSize) : name_(shmName(name)) {
+    CHECK_GT(slotNum, 1) << "slot number should be greater than 1";
+    size_t slotStride = (sizeof(SlotHeader) + slotSize + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+    size_ = kHeaderSize + slotNum * slotStride;
+
+    // create shared memory, remove the old one first, so the subscribers of old one won't be affected
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    PCHECK(fd >= 0) << fmt::format("cannot create shared memory \"{}\"", name_);
+    PCHECK(ftruncate(fd, static_cast<off_t>(size_)) == 0)
+        << fmt::format("cannot resize shared memory \"{}\" to {} bytes", name_, size_);
+    memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    PCHECK(memory_ != MAP_FAILED) << fmt::format("cannot map shared memory \"{}\"", name_);
+
+    // init header, the magic is written at last, so the subscriber never sees a partial header
+    auto* header = new (memory_) ShmHeader();
+    header->version = kShmVersion;
+    header->slotNum = slotNum;
+    header->slotStride = slotStride;
+    for (size_t i = 0; i < slotNum; ++i) {
+        new (slotOf(memory_, i)) SlotHeader();
+    }
+    atomic_thread_fence(memory_order_release);
+    header->magic = kShmMagic;
+    LOG(INFO) << fmt::format("create shared memory \"{}\", slot number = {}, slot size = {} bytes", name_, slotNum,
+                             slotSize);
+}
+
+ShmPublisher::~ShmPublisher() {
+    munmap(memory_, size_);
+    shm_unlink(name_.c_str());
+}
+
+bool ShmPublisher::publish(const string& stream, uint32_t frameId, int64_t timestamp, int64_t hostTimestamp,
+                           const Mat& image) {
+    auto* header = static_cast<ShmHeader*>(memory_);
+    size_t dataSize = image.step[0] * image.rows;
+    if (dataSize > header->slotStride - sizeof(SlotHeader)) {
+        LOG_EVERY_N(ERROR, 100) << fmt::format("image size {} bytes is larger than slot size of \"{}\"", dataSize,
+                                               name_);
+        return false;
+    }
+
+    // write slot with sequence lock
+    lock_guard<mutex> lock(mutex_);
+    uint64_t index = header->published.load(memory_order_relaxed);
+    auto* slot = slotOf(memory_, index);
+    slot->sequence.store(2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    strncpy(slot->stream, stream.c_str(), sizeof(slot->stream) - 1);
+    slot->stream[sizeof(slot->stream) - 1] = '\0';
+    slot->frameId = frameId;
+    slot->timestamp = timestamp;
+    slot->hostTimestamp = hostTimestamp;
+    slot->rows = image.rows;
+    slot->cols = image.cols;
+    slot->type = image.type();
+    slot->step = image.step[0];
+    uint8_t* data = reinterpret_cast<uint8_t*>(slot + 1);
+    if (image.isContinuous()) {
+        memcpy(data, image.data, dataSize);
+    } else {
+        for (int r = 0; r < image.rows; ++r) {
+            memcpy(data + r * image.step[0], image.ptr(r), image.cols * image.elemSize());
+        }
+    }
+    slot->sequence.store(2 * (index + 1), memory_order_release);
+
+    // notify subscribers
+    header->published.store(index + 1, memory_order_release);
+    header->notify.fetch_add(1, memory_order_release);
+    futex(&header->notify, FUTEX_WAKE, INT_MAX, nullptr);
+    return true;
+}
+
+uint64_t ShmPublisher::published() const {
+    return static_cast<ShmHeader*>(memory_)->published.load(memory_order_acquire);
+}
+
+ShmSubscriber::ShmSubscriber(const string& name) {
+    string fullName = shmName(name);
+    int fd = shm_open(fullName.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        PLOG(ERROR) << fmt::format("cannot open shared memory \"{}\"", fullName);
+        return;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kHeaderSize) {
+        LOG(ERROR) << fmt::format("invalid shared memory \"{}\"", fullName);
+        ::close(fd);
+        return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* memory = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        PLOG(ERROR) << fmt::format("cannot map shared memory \"{}\"", fullName);
+        return;
+    }
+    auto* header = static_cast<ShmHeader*>(memory);
+    if (header->magic != kShmMagic || header->version != kShmVersion) {
+        LOG(ERROR) << fmt::format("invalid shared memory \"{}\", magic = {:#x}, version = {}", fullName,
+                                  header->magic, header->version);
+        munmap(memory, size_);
+        return;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    memory_ = memory;
+    // start from the latest frame
+    next_ = header->published.load(memory_order_acquire);
+}
+
+ShmSubscriber::~ShmSubscriber() {
+    if (memory_ != nullptr) {
+        munmap(memory_, size_);
+    }
+}
+
+bool ShmSubscriber::next(ShmFrame* frame, int timeout) {
+    if (memory_ == nullptr) {
+        return false;
+    }
+    auto* header = static_cast<ShmHeader*>(memory_);
+    timespec deadline{};
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    int64_t deadlineNs = deadline.tv_sec * 1000000000LL + deadline.tv_nsec + timeout * 1000000LL;
+    while (true) {
+        uint32_t notify = header->notify.load(memory_order_acquire);
+        uint64_t published = header->published.load(memory_order_acquire);
+        if (next_ < published) {
+            // the slot after the oldest one may be being written, skip the frames could be overwritten
+            if (published - next_ >= header->slotNum) {
+                uint64_t oldest = published - header->slotNum + 1;
+                skipped_ += oldest - next_;
+                next_ = oldest;
+            }
+            uint64_t index = next_++;
+            auto* slot = slotOf(memory_, index);
+            uint64_t sequence = slot->sequence.load(memory_order_acquire);
+            if (sequence != 2 * (index + 1)) {
+                ++skipped_;
+                continue;
+            }
+            frame->index = index;
+            frame->stream = slot->stream;
+            frame->frameId = slot->frameId;
+            frame->timestamp = slot->timestamp;
+            frame->hostTimestamp = slot->hostTimestamp;
+            frame->image = Mat(slot->rows, slot->cols, slot->type, reinterpret_cast<uint8_t*>(slot + 1),
+                               static_cast<size_t>(slot->step));
+            frame->slotSequence = &slot->sequence;
+            frame->sequence = sequence;
+            // the header may be overwritten during reading
+            atomic_thread_fence(memory_order_acquire);
+            if (!frame->isValid()) {
+                ++skipped_;
+                continue;
+            }
+            return true;
+        }
+
+        // wait for new frame
+        timespec wait{};
+        if (timeout >= 0) {
+            timespec now{};
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t remain = deadlineNs - (now.tv_sec * 1000000000LL + now.tv_nsec);
+            if (remain <= 0) {
+                return false;
+            }
+            wait.tv_sec = remain / 1000000000LL;
+            wait.tv_nsec = remain % 1000000000LL;
+        }
+        futex(&header->notify, FUTEX_WAIT, notify, timeout >= 0 ? &wait : nullptr);
+    }
+}
+
+}  // namespace mev
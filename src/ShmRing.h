@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace mev {
+
+// default max image size of one slot, 1280x720 BGR
+constexpr std::size_t kShmSlotSize = 1280 * 720 * 3;
+
+// frame in shared memory ring, the image refers to the shared memory without copy
+struct ShmFrame {
+    std::uint64_t index{0};         // publish index
+    std::string stream;             // stream name
+    std::uint32_t frameId{0};       // frame ID
+    std::int64_t timestamp{0};      // device timestamp, ns
+    std::int64_t hostTimestamp{0};  // host timestamp, ns
+    cv::Mat image;                  // image in shared memory, read only
+
+    /**
+     * @brief Whether the frame is still valid, i.e. the slot hasn't been overwritten by publisher. Should be checked
+     * after the image is used, the result is undefined if it's false
+     */
+    bool isValid() const;
+
+    const std::atomic<std::uint64_t>* slotSequence{nullptr};  // sequence lock of slot
+    std::uint64_t sequence{0};                                // sequence of slot when the frame is read
+};
+
+/**
+ * @brief Frame publisher by POSIX shared memory ring. The frames are copied to a ring of preallocated slots in shared
+ * memory "/dev/shm/<name>", and the subscribers are notified by futex on the shared memory, so any number of other
+ * processes could read the frames without serialization or extra copy.
+ *
+ *  header | slot 0 | slot 1 | ... | slot N-1
+ *
+ * Each slot is protected by a sequence lock, the subscriber could check whether the slot is overwritten during reading.
+ * The publisher never waits for subscribers, a slow subscriber will skip frames. publish() is thread safe, so the
+ * frames of several capture threads could be published to the same ring.
+ */
+class ShmPublisher {
+  public:
+    /**
+     * @brief Constructor, create the shared memory, the existing one with the same name will be replaced
+     *
+     * @param name      Shared memory name, such as "mev_frames"
+     * @param slotNum   Slot number of ring
+     * @param slotSize  Max image size of one slot, bytes
+     */
+    explicit ShmPublisher(const std::string& name, std::size_t slotNum = 16, std::size_t slotSize = kShmSlotSize);
+
+    // destructor, unmap and remove the shared memory, the subscribers could still read the mapped memory
+    ~ShmPublisher();
+
+    ShmPublisher(const ShmPublisher&) = delete;
+    ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+  public:
+    /**
+     * @brief Publish frame, copy the image to next slot and notify subscribers
+     *
+     * @param stream        Stream name, at most 15 characters
+     * @param frameId       Frame ID
+     * @param timestamp     Device timestamp, ns
+     * @param hostTimestamp Host timestamp, ns
+     * @param image         Image
+     * @return False if the image is larger than slot size
+     */
+    bool publish(const std::string& stream, std::uint32_t frameId, std::int64_t timestamp, std::int64_t hostTimestamp,
+                 const cv::Mat& image);
+
+    // published frame number
+    std::uint64_t published() const;
+
+  private:
+    std::string name_;       // shared memory name
+    void* memory_{nullptr};  // mapped memory
+    std::size_t size_{0};    // mapped size
+    std::mutex mutex_;       // mutex of publish
+};
+
+/**
+ * @brief Frame subscriber of shared memory ring created by ShmPublisher, map the frames without copy
+ */
+class ShmSubscriber {
+  public:
+    /**
+     * @brief Constructor, open and map the shared memory
+     *
+     * @param name  Shared memory name
+     */
+    explicit ShmSubscriber(const std::string& name);
+
+    ~ShmSubscriber();
+
+    ShmSubscriber(const ShmSubscriber&) = delete;
+    ShmSubscriber& operator=(const ShmSubscriber&) = delete;
+
+  public:
+    // whether the shared memory is opened
+    inline bool isOpened() const { return memory_ != nullptr; }
+
+    /**
+     * @brief Get the next frame, wait if there isn't any new frame. If the subscriber is too slow, the overwritten
+     * frames are skipped
+     *
+     * @param frame     Output frame
+     * @param timeout   Timeout, ms, negative to wait forever
+     * @return False if timeout or not opened
+     */
+    bool next(ShmFrame* frame, int timeout = -1);
+
+    // skipped frame number since opened
+    inline std::uint64_t skipped() const { return skipped_; }
+
+  private:
+    void* memory_{nullptr};     // mapped memory
+    std::size_t size_{0};       // mapped size
+    std::uint64_t next_{0};     // index of next frame
+    std::uint64_t skipped_{0};  // skipped frame number
+};
+
+}  // namespace mev
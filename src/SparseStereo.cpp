@@ -0,0 +1,248 @@
+#include "SparseStereo.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <opencv2/imgproc.hpp>
+#include "ClockSync.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// patch width, one SIMD register of 8 bits pixels
+constexpr int kPatchWidth = 16;
+
+// sums of patch pair for ZNCC
+struct PatchSums {
+    uint32_t sumR{0};   // sum of right pixels
+    uint32_t sumRR{0};  // sum of squared right pixels
+    uint32_t sumLR{0};  // sum of products of left and right pixels
+};
+
+#if defined(__SSE2__)
+// horizontal sum of 4 int32
+inline uint32_t sum32(__m128i v) {
+    v = _mm_add_epi32(v, _mm_srli_si128(v, 8));
+    v = _mm_add_epi32(v, _mm_srli_si128(v, 4));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+}
+
+// horizontal sum of 2 int64 of _mm_sad_epu8
+inline uint32_t sum64(__m128i v) {
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v) + _mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+}
+#endif
+
+// SAD of 16 x height patches
+inline uint32_t patchSad(const uint8_t* l, size_t lStep, const uint8_t* r, size_t rStep, int height) {
+#if defined(__SSE2__)
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < height; ++i, l += lStep, r += rStep) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(a, b));
+    }
+    return sum64(sum);
+#elif defined(__aarch64__)
+    uint16x8_t sum = vdupq_n_u16(0);
+    for (int i = 0; i < height; ++i, l += lStep, r += rStep) {
+        uint8x16_t a = vld1q_u8(l);
+        uint8x16_t b = vld1q_u8(r);
+        sum = vabal_u8(sum, vget_low_u8(a), vget_low_u8(b));
+        sum = vabal_u8(sum, vget_high_u8(a), vget_high_u8(b));
+    }
+    uint64x2_t s = vpaddlq_u32(vpaddlq_u16(sum));
+    return static_cast<uint32_t>(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+#else
+    uint32_t sum{0};
+    for (int i = 0; i < height; ++i, l += lStep, r += rStep) {
+        for (int j = 0; j < kPatchWidth; ++j) {
+            sum += static_cast<uint32_t>(abs(l[j] - r[j]));
+        }
+    }
+    return sum;
+#endif
+}
+
+// sums of 16 x height patches for ZNCC
+inline PatchSums patchSums(const uint8_t* l, size_t lStep, const uint8_t* r, size_t rStep, int height) {
+    PatchSums sums;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sumR = zero, sumRR = zero, sumLR = zero;
+    for (int i = 0; i < height; ++i, l += lStep, r += rStep) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r));
+        sumR = _mm_add_epi64(sumR, _mm_sad_epu8(b, zero));
+        __m128i aLo = _mm_unpacklo_epi8(a, zero), aHi = _mm_unpackhi_epi8(a, zero);
+        __m128i bLo = _mm_unpacklo_epi8(b, zero), bHi = _mm_unpackhi_epi8(b, zero);
+        sumRR = _mm_add_epi32(sumRR, _mm_add_epi32(_mm_madd_epi16(bLo, bLo), _mm_madd_epi16(bHi, bHi)));
+        sumLR = _mm_add_epi32(sumLR, _mm_add_epi32(_mm_madd_epi16(aLo, bLo), _mm_madd_epi16(aHi, bHi)));
+    }
+    sums.sumR = sum64(sumR);
+    sums.sumRR = sum32(sumRR);
+    sums.sumLR = sum32(sumLR);
+#elif defined(__aarch64__)
+    uint32x4_t sumR = vdupq_n_u32(0), sumRR = vdupq_n_u32(0), sumLR = vdupq_n_u32(0);
+    for (int i = 0; i < height; ++i, l += lStep, r += rStep) {
+        uint8x16_t a = vld1q_u8(l);
+        uint8x16_t b = vld1q_u8(r);
+        sumR = vpadalq_u16(sumR, vpaddlq_u8(b));
+        sumRR = vpadalq_u16(sumRR, vmull_u8(vget_low_u8(b), vget_low_u8(b)));
+        sumRR = vpadalq_u16(sumRR, vmull_u8(vget_high_u8(b), vget_high_u8(b)));
+        sumLR = vpadalq_u16(sumLR, vmull_u8(vget_low_u8(a), vget_low_u8(b)));
+        sumLR = vpadalq_u16(sumLR, vmull_u8(vget_high_u8(a), vget_high_u8(b)));
+    }
+    sums.sumR = vaddvq_u32(sumR);
+    sums.sumRR = vaddvq_u32(sumRR);
+    sums.sumLR = vaddvq_u32(sumLR);
+#else
+    for (int i = 0; i < height; ++i, l += lStep, r += rStep) {
+        for (int j = 0; j < kPatchWidth; ++j) {
+            sums.sumR += r[j];
+            sums.sumRR += r[j] * r[j];
+            sums.sumLR += l[j] * r[j];
+        }
+    }
+#endif
+    return sums;
+}
+
+// convert image to gray, the gray image is used directly
+void toGray(const Mat& image, Mat& gray) {
+    if (image.channels() == 3) {
+        cvtColor(image, gray, COLOR_BGR2GRAY);
+    } else {
+        gray = image;
+    }
+}
+
+}  // namespace
+
+SparseStereoMatcher::SparseStereoMatcher(const StereoCamera& camera, const SparseStereoOptions& options)
+    : camera_(camera), options_(options) {
+    CHECK_GT(camera_.fx, 0) << "invalid focal length";
+    CHECK_GT(camera_.baseline, 0) << "invalid baseline";
+    CHECK(options_.minDisparity > 0 && options_.minDisparity < options_.maxDisparity) << "invalid disparity range";
+    CHECK(options_.patchHeight > 0 && options_.patchHeight % 2 == 1) << "patch height should be odd";
+}
+
+const vector<StereoPoint>& SparseStereoMatcher::match(const Mat& left, const Mat& right,
+                                                      const vector<Feature>& features) {
+    int64_t startTime = hostNow();
+    CHECK_EQ(left.size(), right.size()) << "left and right image should have the same size";
+    toGray(left, leftGray_);
+    toGray(right, rightGray_);
+    CHECK_EQ(leftGray_.type(), CV_8UC1) << "the image should be 8 bits gray or BGR";
+
+    points_.clear();
+    for (auto& f : features) {
+        StereoPoint point;
+        if (!matchPatch(cvRound(f.point.x), cvRound(f.point.y), &point)) {
+            continue;
+        }
+        // triangulate the rectified pixel with disparity
+        double z = camera_.fx * camera_.baseline / point.disparity;
+        if (z < options_.minDepth || z > options_.maxDepth) {
+            continue;
+        }
+        point.id = f.id;
+        point.left = f.point;
+        point.position.x = static_cast<float>((f.point.x - camera_.cx) * z / camera_.fx);
+        point.position.y = static_cast<float>((f.point.y - camera_.cy) * z / camera_.fy);
+        point.position.z = static_cast<float>(z);
+        points_.emplace_back(point);
+    }
+
+    ++statistics_.frames;
+    statistics_.features += features.size();
+    statistics_.matched += points_.size();
+    statistics_.matchTime += hostNow() - startTime;
+    return points_;
+}
+
+bool SparseStereoMatcher::matchPatch(int x, int y, StereoPoint* point) {
+    const int halfWidth = kPatchWidth / 2;
+    const int halfHeight = options_.patchHeight / 2;
+    if (x - halfWidth < 0 || x + halfWidth > leftGray_.cols || y - halfHeight < 0 ||
+        y + halfHeight >= leftGray_.rows) {
+        return false;
+    }
+    // the right patch should be inside image
+    const int minDisparity = options_.minDisparity;
+    const int maxDisparity = min(options_.maxDisparity, x - halfWidth);
+    if (maxDisparity - minDisparity < 2) {
+        return false;
+    }
+
+    // costs of all disparities, the smaller the better
+    const int n = kPatchWidth * options_.patchHeight;
+    const size_t lStep = leftGray_.step;
+    const size_t rStep = rightGray_.step;
+    const uint8_t* l = leftGray_.ptr<uint8_t>(y - halfHeight) + x - halfWidth;
+    const uint8_t* r = rightGray_.ptr<uint8_t>(y - halfHeight) + x - halfWidth;
+    costs_.resize(static_cast<size_t>(maxDisparity + 1));
+    if (options_.cost == MatchCost::SAD) {
+        for (int d = minDisparity; d <= maxDisparity; ++d) {
+            costs_[d] = static_cast<float>(patchSad(l, lStep, r - d, rStep, options_.patchHeight)) / n;
+        }
+    } else {
+        // the left sums are the same for all disparities
+        PatchSums leftSums = patchSums(l, lStep, l, lStep, options_.patchHeight);
+        double sumL = leftSums.sumR;
+        double varL = static_cast<double>(n) * leftSums.sumRR - sumL * sumL;
+        if (varL <= 0) {
+            return false;
+        }
+        for (int d = minDisparity; d <= maxDisparity; ++d) {
+            PatchSums sums = patchSums(l, lStep, r - d, rStep, options_.patchHeight);
+            double sumR = sums.sumR;
+            double varR = static_cast<double>(n) * sums.sumRR - sumR * sumR;
+            double zncc = varR > 0 ? (static_cast<double>(n) * sums.sumLR - sumL * sumR) / sqrt(varL * varR) : 0;
+            costs_[d] = static_cast<float>(1 - zncc);
+        }
+    }
+
+    // the best disparity, and the second best out of its neighbors
+    int best = minDisparity;
+    for (int d = minDisparity + 1; d <= maxDisparity; ++d) {
+        if (costs_[d] < costs_[best]) {
+            best = d;
+        }
+    }
+    float second = numeric_limits<float>::max();
+    for (int d = minDisparity; d <= maxDisparity; ++d) {
+        if (abs(d - best) > 1) {
+            second = min(second, costs_[d]);
+        }
+    }
+    float cost = costs_[best];
+    point->score = options_.cost == MatchCost::SAD ? cost : 1 - cost;
+    if ((options_.cost == MatchCost::SAD && cost > options_.maxSad) ||
+        (options_.cost == MatchCost::ZNCC && point->score < options_.minZncc) || cost > options_.uniqueness * second) {
+        return false;
+    }
+
+    // sub-pixel refinement by parabola fitting, the disparity on the boundary of range isn't refined
+    double offset{0};
+    if (best > minDisparity && best < maxDisparity) {
+        double c0 = costs_[best - 1], c1 = costs_[best], c2 = costs_[best + 1];
+        double denom = c0 - 2 * c1 + c2;
+        if (denom > 0) {
+            offset = max(-0.5, min(0.5, (c0 - c2) / (2 * denom)));
+        }
+    }
+    point->disparity = static_cast<float>(best + offset);
+    return true;
+}
+
+}  // namespace mev
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+#include "FeatureTracker.h"
+
+namespace mev {
+
+// rectified stereo camera, the pinhole of left camera and the baseline
+struct StereoCamera {
+    double fx{0};        // focal length x, pixel
+    double fy{0};        // focal length y, pixel
+    double cx{0};        // principal point x, pixel
+    double cy{0};        // principal point y, pixel
+    double baseline{0};  // distance between left and right camera, m
+};
+
+// cost of patch matching
+enum class MatchCost {
+    SAD,   // sum of absolute difference, fast but sensitive to brightness difference
+    ZNCC,  // zero-mean normalized cross correlation, robust to brightness and contrast difference
+};
+
+// sparse stereo matcher options
+struct SparseStereoOptions {
+    MatchCost cost{MatchCost::ZNCC};  // matching cost
+    int minDisparity{1};              // min disparity, pixel
+    int maxDisparity{128};            // max disparity, pixel
+    int patchHeight{9};               // patch height, the patch width is fixed to 16 for SIMD
+    double maxSad{12.0};              // max average absolute difference per pixel for SAD
+    double minZncc{0.8};              // min ZNCC score
+    double uniqueness{0.9};           // the best cost should be better than the second best(out of +-1 pixel) by it
+    double minDepth{0.1};             // min depth, m
+    double maxDepth{20.0};            // max depth, m
+};
+
+// stereo point of left feature
+struct StereoPoint {
+    std::uint64_t id{0};   // feature ID
+    cv::Point2f left;      // position in left image
+    float disparity{0};    // disparity with sub-pixel refinement, pixel
+    float score{0};        // average absolute difference per pixel for SAD, or ZNCC score
+    cv::Point3f position;  // position in left camera frame, m
+};
+
+// sparse stereo statistics
+struct SparseStereoStatistics {
+    std::uint64_t frames{0};    // processed frame number
+    std::uint64_t features{0};  // total feature number to match
+    std::uint64_t matched{0};   // total matched feature number
+    std::int64_t matchTime{0};  // time to match and triangulate, ns
+};
+
+/**
+ * @brief Sparse stereo matcher. The left features are matched along the same row of rectified right image, the patch
+ * costs of all disparities are computed by SIMD(SSE2 or NEON, scalar fallback), the best disparity is refined to
+ * sub-pixel by parabola fitting, then triangulated to 3D landmarks. It's much cheaper than dense matching since only
+ * the features are matched. Not thread safe
+ */
+class SparseStereoMatcher {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param camera    Rectified stereo camera
+     * @param options   Matcher options
+     */
+    SparseStereoMatcher(const StereoCamera& camera, const SparseStereoOptions& options = SparseStereoOptions());
+
+    /**
+     * @brief Match left features in right image and triangulate them
+     *
+     * @param left      Rectified left image, gray or BGR
+     * @param right     Rectified right image, gray or BGR
+     * @param features  Features in left image
+     * @return Matched stereo points, the unmatched features are not included
+     */
+    const std::vector<StereoPoint>& match(const cv::Mat& left, const cv::Mat& right,
+                                          const std::vector<Feature>& features);
+
+    // stereo points of last frame
+    inline const std::vector<StereoPoint>& points() const { return points_; }
+
+    // statistics
+    inline const SparseStereoStatistics& statistics() const { return statistics_; }
+
+  private:
+    /**
+     * @brief Match one patch of left image along the row of right image
+     *
+     * @param x     Patch center x in left image
+     * @param y     Patch center y in left image
+     * @param point Output disparity and score
+     * @return True if matched
+     */
+    bool matchPatch(int x, int y, StereoPoint* point);
+
+  private:
+    StereoCamera camera_;
+    SparseStereoOptions options_;
+    SparseStereoStatistics statistics_;
+    std::vector<StereoPoint> points_;
+    cv::Mat leftGray_;          // gray left image
+    cv::Mat rightGray_;         // gray right image
+    std::vector<float> costs_;  // cost of each disparity, the smaller the better
+};
+
+}  // namespace mev
@@ -0,0 +1,113 @@
+#include "StereoSynchronizer.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace mev {
+
+StereoSynchronizer::StereoSynchronizer(const SyncOptions& options, const ImuBuffer* imuBuffer)
+    : options_(options), imuBuffer_(imuBuffer) {}
+
+void StereoSynchronizer::push(SyncStream stream, StreamImage image) {
+    lock_guard<mutex> lock(mutex_);
+    size_t s = static_cast<size_t>(stream);
+    ++statistics_.received[s];
+    queues_[s].emplace_back(std::move(image));
+    // drop the oldest one if the queue is full
+    if (queues_[s].size() > options_.queueSize) {
+        queues_[s].pop_front();
+        ++statistics_.unmatched[s];
+    }
+    match();
+}
+
+bool StereoSynchronizer::pop(FrameBundle* bundle) {
+    lock_guard<mutex> lock(mutex_);
+    if (ready_.empty()) {
+        return false;
+    }
+
+    // wait for the IMU after left image, unless too many bundles are waiting(IMU is disabled or lost)
+    FrameBundle& front = ready_.front();
+    if (imuBuffer_ != nullptr) {
+        if (imuBuffer_->latestTime() < front.left.timestamp && ready_.size() <= options_.queueSize) {
+            return false;
+        }
+        front.imu = imuBuffer_->slice(lastBundleTime_, front.left.timestamp);
+    }
+    lastBundleTime_ = front.left.timestamp;
+    *bundle = std::move(front);
+    ready_.pop_front();
+    ++statistics_.bundles;
+    return true;
+}
+
+SyncStatistics StereoSynchronizer::statistics() const {
+    lock_guard<mutex> lock(mutex_);
+    return statistics_;
+}
+
+bool StereoSynchronizer::isMatched(const StreamImage& a, const StreamImage& b) const {
+    if (options_.useFrameId && a.frameId != b.frameId) {
+        return false;
+    }
+    return abs(a.timestamp - b.timestamp) <= options_.tolerance;
+}
+
+void StereoSynchronizer::match() {
+    const array<bool, 3> required = {true, options_.withRight, options_.withDepth};
+    auto& lefts = queues_[static_cast<size_t>(SyncStream::Left)];
+    while (!lefts.empty()) {
+        const StreamImage& left = lefts.front();
+        bool waiting{false}, leftUnmatched{false};
+        array<deque<StreamImage>::iterator, 3> matched;
+        for (size_t s = 1; s < 3 && !leftUnmatched; ++s) {
+            if (!required[s]) {
+                continue;
+            }
+            auto& queue = queues_[s];
+            // the frames too old to match the left frame will never be matched
+            while (!queue.empty() && queue.front().timestamp < left.timestamp - options_.tolerance) {
+                queue.pop_front();
+                ++statistics_.unmatched[s];
+            }
+            matched[s] = find_if(queue.begin(), queue.end(), [&](const StreamImage& v) { return isMatched(left, v); });
+            if (matched[s] != queue.end()) {
+                continue;
+            }
+            // if there is newer frame in this stream, the left frame will never be matched, otherwise wait for it
+            if (!queue.empty() && queue.back().timestamp > left.timestamp + options_.tolerance) {
+                leftUnmatched = true;
+            } else {
+                waiting = true;
+            }
+        }
+
+        if (leftUnmatched) {
+            lefts.pop_front();
+            ++statistics_.unmatched[static_cast<size_t>(SyncStream::Left)];
+            continue;
+        }
+        if (waiting) {
+            return;
+        }
+
+        // emit bundle, and remove the matched frames and the frames before them
+        FrameBundle bundle;
+        bundle.left = std::move(lefts.front());
+        lefts.pop_front();
+        for (size_t s = 1; s < 3; ++s) {
+            if (!required[s]) {
+                continue;
+            }
+            auto& queue = queues_[s];
+            size_t skipped = static_cast<size_t>(matched[s] - queue.begin());
+            (s == static_cast<size_t>(SyncStream::Right) ? bundle.right : bundle.depth) = std::move(*matched[s]);
+            queue.erase(queue.begin(), matched[s] + 1);
+            statistics_.unmatched[s] += skipped;
+        }
+        ready_.emplace_back(std::move(bundle));
+    }
+}
+
+}  // namespace mev
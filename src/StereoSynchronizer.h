@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include "FrameBundle.h"
+#include "ImuBuffer.h"
+
+namespace mev {
+
+// stream type in synchronizer
+enum class SyncStream {
+    Left = 0,
+    Right = 1,
+    Depth = 2,
+};
+
+// synchronizer options
+struct SyncOptions {
+    std::int64_t tolerance{5000000};  // max timestamp difference to match, ns
+    std::size_t queueSize{5};         // max size of each stream queue
+    bool useFrameId{true};            // whether the frame ID should also be the same to match
+    bool withRight{true};             // whether the right stream is required
+    bool withDepth{true};             // whether the depth stream is required
+};
+
+// synchronizer statistics
+struct SyncStatistics {
+    std::size_t bundles{0};                   // emitted bundle number
+    std::array<std::size_t, 3> received{};    // received frame number of each stream
+    std::array<std::size_t, 3> unmatched{};   // unmatched(dropped) frame number of each stream
+};
+
+/**
+ * @brief Stereo pair synchronizer, match the left, right and depth frames by frame ID and timestamp within tolerance,
+ * and emit atomic frame bundles. Each stream has a bounded queue, the frame which could never be matched(there is newer
+ * frame in other stream) or exceeds the queue size is dropped and counted as unmatched.
+ *
+ * If the IMU buffer is set, the bundle is emitted until the IMU after its left timestamp is received, and the IMU
+ * records since last bundle are attached.
+ */
+class StereoSynchronizer {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param options       Synchronizer options
+     * @param imuBuffer     IMU buffer to attach IMU to bundle, nullptr for no IMU
+     */
+    explicit StereoSynchronizer(const SyncOptions& options, const ImuBuffer* imuBuffer = nullptr);
+
+  public:
+    /**
+     * @brief Push frame of stream, the frames of each stream should be in time order
+     *
+     * @param stream    Stream type
+     * @param image     Stream image
+     */
+    void push(SyncStream stream, StreamImage image);
+
+    /**
+     * @brief Pop the oldest matched bundle
+     *
+     * @param bundle    Output bundle
+     * @return False if there isn't any matched bundle
+     */
+    bool pop(FrameBundle* bundle);
+
+    // get statistics
+    SyncStatistics statistics() const;
+
+  private:
+    // whether two frames are matched
+    bool isMatched(const StreamImage& a, const StreamImage& b) const;
+
+    // try to match the queued frames to bundles
+    void match();
+
+  private:
+    SyncOptions options_;
+    const ImuBuffer* imuBuffer_;
+    std::array<std::deque<StreamImage>, 3> queues_;                // frame queue of each stream
+    std::deque<FrameBundle> ready_;                                 // matched bundles
+    std::int64_t lastBundleTime_{std::numeric_limits<std::int64_t>::min()};  // left timestamp of last emitted bundle
+    SyncStatistics statistics_;
+    mutable std::mutex mutex_;
+};
+
+}  // namespace mev
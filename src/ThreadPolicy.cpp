@@ -0,0 +1,171 @@
+#include "ThreadPolicy.h"
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <glog/logging.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <boost/algorithm/string.hpp>
+
+using namespace std;
+
+namespace mev {
+
+bool setThreadAffinity(const vector<int>& cpus) {
+    if (cpus.empty()) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        LOG(WARNING) << fmt::format("cannot set CPU affinity to {}: {}", cpus, strerror(ret));
+        return false;
+    }
+    return true;
+}
+
+bool parseCpuList(const string& text, vector<int>* cpus) {
+    cpus->clear();
+    vector<string> items;
+    boost::split(items, text, boost::is_any_of(","), boost::token_compress_on);
+    try {
+        for (auto& item : items) {
+            boost::trim(item);
+            if (item.empty()) {
+                continue;
+            }
+            auto pos = item.find('-');
+            int first = stoi(item.substr(0, pos));
+            int last = pos == string::npos ? first : stoi(item.substr(pos + 1));
+            if (first < 0 || last < first || last >= CPU_SETSIZE) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus->emplace_back(cpu);
+            }
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    // sorted and unique, the same as the affinity read back
+    sort(cpus->begin(), cpus->end());
+    cpus->erase(unique(cpus->begin(), cpus->end()), cpus->end());
+    return true;
+}
+
+bool parseThreadPolicy(const string& text, ThreadPolicy* policy) {
+    *policy = ThreadPolicy();
+    vector<string> items;
+    boost::split(items, text, boost::is_any_of(";"), boost::token_compress_on);
+    try {
+        for (auto& item : items) {
+            boost::trim(item);
+            if (item.empty()) {
+                continue;
+            }
+            auto pos = item.find('=');
+            if (pos == string::npos) {
+                return false;
+            }
+            string key = boost::trim_copy(item.substr(0, pos));
+            string value = boost::trim_copy(item.substr(pos + 1));
+            if (key == "cpus") {
+                if (!parseCpuList(value, &policy->cpus)) {
+                    return false;
+                }
+            } else if (key == "fifo") {
+                policy->fifoPriority = stoi(value);
+                if (policy->fifoPriority < 1 || policy->fifoPriority > 99) {
+                    return false;
+                }
+            } else if (key == "nice") {
+                policy->nice = stoi(value);
+                if (policy->nice < -20 || policy->nice > 19) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+    } catch (const exception&) {
+        return false;
+    }
+    // nice is only used by normal scheduling
+    return policy->fifoPriority == 0 || policy->nice == 0;
+}
+
+string formatThreadPolicy(const ThreadPolicy& policy) {
+    vector<string> items;
+    if (!policy.cpus.empty()) {
+        items.emplace_back(fmt::format("cpus={}", fmt::join(policy.cpus, ",")));
+    }
+    if (policy.fifoPriority != 0) {
+        items.emplace_back(fmt::format("fifo={}", policy.fifoPriority));
+    }
+    if (policy.nice != 0) {
+        items.emplace_back(fmt::format("nice={}", policy.nice));
+    }
+    return boost::join(items, ";");
+}
+
+bool applyThreadPolicy(const ThreadPolicy& policy, const string& name) {
+    if (policy.empty()) {
+        return true;
+    }
+
+    // apply, the errors are reported with the actual state below
+    setThreadAffinity(policy.cpus);
+    auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (policy.fifoPriority > 0) {
+        sched_param param{};
+        param.sched_priority = policy.fifoPriority;
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        LOG_IF(WARNING, ret != 0) << fmt::format("cannot set SCHED_FIFO priority {} for thread \"{}\": {}",
+                                                 policy.fifoPriority, name, strerror(ret));
+    } else if (policy.nice != 0 && setpriority(PRIO_PROCESS, tid, policy.nice) != 0) {
+        PLOG(WARNING) << fmt::format("cannot set nice {} for thread \"{}\"", policy.nice, name);
+    }
+
+    // read back the actual state
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    vector<int> cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.emplace_back(cpu);
+            }
+        }
+    }
+    int scheduler{0};
+    sched_param param{};
+    pthread_getschedparam(pthread_self(), &scheduler, &param);
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, tid);
+
+    bool fifoApplied = scheduler == SCHED_FIFO && param.sched_priority == policy.fifoPriority;
+    bool applied = (policy.cpus.empty() || cpus == policy.cpus) && (policy.fifoPriority == 0 || fifoApplied) &&
+                   (policy.nice == 0 || nice == policy.nice);
+    string schedulerName = scheduler == SCHED_FIFO ? "SCHED_FIFO" : scheduler == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER";
+    string state = fmt::format("thread \"{}\": requested \"{}\", actual CPUs = [{}], scheduler = {}, priority = {}, "
+                               "nice = {}",
+                               name, formatThreadPolicy(policy), fmt::join(cpus, ","), schedulerName,
+                               param.sched_priority, nice);
+    if (applied) {
+        LOG(INFO) << state;
+    } else {
+        LOG(WARNING) << state << ", NOT applied";
+    }
+    return applied;
+}
+
+}  // namespace mev
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace mev {
+
+// scheduling policy of thread
+struct ThreadPolicy {
+    std::vector<int> cpus;  // CPU affinity, empty for not set
+    int fifoPriority{0};    // SCHED_FIFO priority(1~99), 0 for normal scheduling
+    int nice{0};            // nice value(-20~19) for normal scheduling, 0 for not set
+
+    // whether nothing is set
+    inline bool empty() const { return cpus.empty() && fifoPriority == 0 && nice == 0; }
+};
+
+/**
+ * @brief Set the CPU affinity of current thread
+ *
+ * @param cpus  CPU indexes the thread could run on, empty to do nothing
+ * @return True for success
+ */
+bool setThreadAffinity(const std::vector<int>& cpus);
+
+// parse CPU list, such as "0,2-3", the CPUs are sorted and unique, return false if invalid
+bool parseCpuList(const std::string& text, std::vector<int>* cpus);
+
+/**
+ * @brief Parse thread policy, the items are separated by ';', such as "cpus=2-3;fifo=80" or "cpus=0,1;nice=5"
+ *
+ * @param text      Policy text, empty for default policy
+ * @param policy    Output policy
+ * @return False if invalid
+ */
+bool parseThreadPolicy(const std::string& text, ThreadPolicy* policy);
+
+// format thread policy to text, which could be parsed by parseThreadPolicy()
+std::string formatThreadPolicy(const ThreadPolicy& policy);
+
+/**
+ * @brief Apply the policy to current thread, then read back the affinity, scheduler and nice value of the thread and
+ * report them, warn if any setting isn't applied. SCHED_FIFO needs CAP_SYS_NICE or RLIMIT_RTPRIO, and negative nice
+ * needs CAP_SYS_NICE or RLIMIT_NICE
+ *
+ * @param policy    Thread policy, nothing is done if it's empty
+ * @param name      Thread name in report
+ * @return True if all settings are applied
+ */
+bool applyThreadPolicy(const ThreadPolicy& policy, const std::string& name);
+
+}  // namespace mev
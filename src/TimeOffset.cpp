@@ -0,0 +1,276 @@
+#include "TimeOffset.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "ClockSync.h"
+#include "ImuIntegration.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+// skew symmetric matrix of vector, [v]x * u = v x u
+inline Matx33d skew(const Vec3d& v) { return Matx33d(0, -v[2], v[1], v[2], 0, -v[0], -v[1], v[0], 0); }
+
+}  // namespace
+
+TimeOffsetEstimator::TimeOffsetEstimator(const Matx33d& cameraMatrix, const Matx33d& cameraImu,
+                                         const TimeOffsetOptions& options)
+    : cameraMatrix_(cameraMatrix), cameraImu_(cameraImu), options_(options) {
+    CHECK(cameraMatrix_(0, 0) > 0 && cameraMatrix_(1, 1) > 0) << "invalid camera matrix";
+    CHECK_GT(options_.window, 0) << "window should be greater than 0";
+    CHECK(options_.step > 0 && options_.step <= options_.maxOffset) << "step should be in (0, maxOffset]";
+}
+
+void TimeOffsetEstimator::addImu(const ImuSpan& imu) {
+    for (auto& record : imu) {
+        // the accelerator only records are skipped
+        if ((record.gyro[0] == 0 && record.gyro[1] == 0 && record.gyro[2] == 0) ||
+            (!gyro_.empty() && record.timestamp <= gyro_.back().timestamp)) {
+            continue;
+        }
+        GyroSample sample;
+        sample.timestamp = record.timestamp;
+        sample.velocity = cameraImu_ * Vec3d(record.gyro[0], record.gyro[1], record.gyro[2]);
+        if (!gyro_.empty()) {
+            // trapezoidal integration, the angular velocity is linear between records
+            auto& last = gyro_.back();
+            double dt = (record.timestamp - last.timestamp) * 1.0E-9;
+            sample.angle = last.angle + (last.velocity + sample.velocity) * (0.5 * dt);
+        }
+        gyro_.emplace_back(sample);
+    }
+    // keep the gyroscope which may be used by the shifted intervals of window
+    if (gyro_.size() > 2) {
+        int64_t keepTime = gyro_.back().timestamp - options_.window - 2 * options_.maxOffset;
+        auto it = lower_bound(gyro_.begin() + 1, gyro_.end() - 1, keepTime,
+                              [](const GyroSample& s, int64_t t) { return s.timestamp < t; });
+        gyro_.erase(gyro_.begin(), it - 1);
+    }
+}
+
+bool TimeOffsetEstimator::addFrame(int64_t timestamp, const vector<Feature>& features) {
+    ++statistics_.frames;
+    int64_t startTime = hostNow();
+    if (lastTimestamp_ > 0 && timestamp > lastTimestamp_) {
+        Matx33d rotation;
+        if (visualRotation(features, &rotation)) {
+            VisualSample sample;
+            sample.start = lastTimestamp_;
+            sample.end = timestamp;
+            sample.velocity = logRotation(rotation) / ((timestamp - lastTimestamp_) * 1.0E-9);
+            visual_.emplace_back(sample);
+            ++statistics_.rotations;
+        }
+    }
+    previous_.clear();
+    for (auto& f : features) {
+        previous_[f.id] = f.point;
+    }
+    lastTimestamp_ = timestamp;
+    while (!visual_.empty() && visual_.front().start < timestamp - options_.window) {
+        visual_.pop_front();
+    }
+    statistics_.rotationTime += hostNow() - startTime;
+
+    startTime = hostNow();
+    bool updated = search();
+    statistics_.estimateTime += hostNow() - startTime;
+    if (!updated) {
+        return false;
+    }
+    ++statistics_.estimates;
+    statistics_.valid += estimate_.valid;
+    return true;
+}
+
+bool TimeOffsetEstimator::visualRotation(const vector<Feature>& features, Matx33d* rotation) {
+    // bearings of the features tracked from previous frame
+    const Matx33d inverseK = cameraMatrix_.inv();
+    vector<Vec3d> previous, current;
+    for (auto& f : features) {
+        auto it = previous_.find(f.id);
+        if (f.age == 0 || it == previous_.end()) {
+            continue;
+        }
+        Vec3d p = inverseK * Vec3d(it->second.x, it->second.y, 1), c = inverseK * Vec3d(f.point.x, f.point.y, 1);
+        previous.emplace_back(p / norm(p));
+        current.emplace_back(c / norm(c));
+    }
+    const size_t n = previous.size();
+    if (n < static_cast<size_t>(options_.minFeatures)) {
+        return false;
+    }
+    // rotation R from current to previous, previous = R * current, it's updated by R = exp(delta) * R and the
+    // residual is previous - R * current. The outliers(moving objects, wrong tracks or near points with parallax) are
+    // rejected by the residual after each round
+    const double threshold = options_.outlierPixels / cameraMatrix_(0, 0);
+    vector<uint8_t> inliers(n, 1);
+    Matx33d R = Matx33d::eye();
+    for (int round = 0; round < 3; ++round) {
+        for (int iteration = 0; iteration < 5; ++iteration) {
+            Matx33d H = Matx33d::zeros();
+            Vec3d b(0, 0, 0);
+            for (size_t i = 0; i < n; ++i) {
+                if (!inliers[i]) {
+                    continue;
+                }
+                Vec3d q = R * current[i];
+                Matx33d J = skew(q);
+                H += J.t() * J;
+                b += J.t() * (previous[i] - q);
+            }
+            Vec3d delta = H.solve(-b, DECOMP_CHOLESKY);
+            R = expRotation(delta) * R;
+            if (norm(delta) < 1.0E-9) {
+                break;
+            }
+        }
+        size_t inlierNum{0};
+        for (size_t i = 0; i < n; ++i) {
+            inliers[i] = norm(previous[i] - R * current[i]) < threshold;
+            inlierNum += inliers[i];
+        }
+        if (inlierNum < static_cast<size_t>(options_.minFeatures)) {
+            return false;
+        }
+    }
+    *rotation = R;
+    return true;
+}
+
+Vec3d TimeOffsetEstimator::cumulativeAngle(double t, size_t* index) const {
+    // find the records a <= t < b from the hint, the angular velocity is linear between them
+    while (*index + 2 < gyro_.size() && static_cast<double>(gyro_[*index + 1].timestamp) <= t) {
+        ++*index;
+    }
+    const GyroSample& a = gyro_[*index];
+    const GyroSample& b = gyro_[*index + 1];
+    double dt = t - static_cast<double>(a.timestamp);
+    Vec3d w = a.velocity + (b.velocity - a.velocity) * (dt / static_cast<double>(b.timestamp - a.timestamp));
+    return a.angle + (a.velocity + w) * (0.5E-9 * dt);
+}
+
+bool TimeOffsetEstimator::search() {
+    if (gyro_.size() < 2) {
+        return false;
+    }
+    // only the frame intervals covered by gyroscope at all shifted offsets are used
+    const int64_t coverBegin = gyro_.front().timestamp + options_.maxOffset;
+    const int64_t coverEnd = gyro_.back().timestamp - options_.maxOffset;
+    vector<const VisualSample*> samples;
+    for (auto& s : visual_) {
+        if (s.start >= coverBegin && s.end <= coverEnd) {
+            samples.emplace_back(&s);
+        }
+    }
+    const size_t n = samples.size();
+    if (n < options_.minSamples) {
+        return false;
+    }
+
+    // the mean of window is removed from visual and gyroscope angular velocities, so the bias doesn't matter
+    vector<Vec3d> visual(n);
+    Vec3d mean(0, 0, 0);
+    for (size_t i = 0; i < n; ++i) {
+        visual[i] = samples[i]->velocity;
+        mean += visual[i];
+    }
+    mean /= static_cast<double>(n);
+    double visualNorm{0};
+    for (auto& v : visual) {
+        v -= mean;
+        visualNorm += v.dot(v);
+    }
+    // centered average gyroscope angular velocities of the shifted intervals, return the squared norm. The interval
+    // starts and ends are increasing, so the records are found by walking forward
+    vector<Vec3d> gyro(n);
+    auto shift = [&](double offset, vector<Vec3d>& g) {
+        Vec3d m(0, 0, 0);
+        size_t startIndex{0}, endIndex{0};
+        for (size_t i = 0; i < n; ++i) {
+            double t0 = static_cast<double>(samples[i]->start) + offset;
+            double t1 = static_cast<double>(samples[i]->end) + offset;
+            g[i] = (cumulativeAngle(t1, &endIndex) - cumulativeAngle(t0, &startIndex)) / ((t1 - t0) * 1.0E-9);
+            m += g[i];
+        }
+        m /= static_cast<double>(n);
+        double squaredNorm{0};
+        for (auto& w : g) {
+            w -= m;
+            squaredNorm += w.dot(w);
+        }
+        return squaredNorm;
+    };
+    auto correlate = [&](double offset) {
+        double gyroNorm = shift(offset, gyro);
+        double cross{0};
+        for (size_t i = 0; i < n; ++i) {
+            cross += visual[i].dot(gyro[i]);
+        }
+        return visualNorm > 0 && gyroNorm > 0 ? cross / sqrt(visualNorm * gyroNorm) : 0.0;
+    };
+
+    // search the peak of correlation, then refine it by parabola
+    const int steps = static_cast<int>(options_.maxOffset / options_.step);
+    const double step = static_cast<double>(options_.step);
+    vector<double> correlations(2 * steps + 1);
+    for (int k = -steps; k <= steps; ++k) {
+        correlations[k + steps] = correlate(k * step);
+    }
+    const int peak = static_cast<int>(max_element(correlations.begin(), correlations.end()) - correlations.begin());
+    double offset = (peak - steps) * step;
+    if (peak > 0 && peak < 2 * steps) {
+        double c0 = correlations[peak - 1], c1 = correlations[peak], c2 = correlations[peak + 1];
+        double denominator = c0 - 2 * c1 + c2;
+        if (denominator < 0) {
+            offset += min(max(0.5 * (c0 - c2) / denominator, -0.5), 0.5) * step;
+        }
+    }
+
+    // refine by Gauss-Newton of least squares, the residual is visual - gyro(offset) and its derivative to offset is
+    // the numerical derivative of gyroscope, then the standard deviation is from the residual and the information
+    const double h = 0.5 * step;
+    vector<Vec3d> after(n), before(n);
+    double residual{0}, information{0};
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        shift(offset, gyro);
+        shift(offset + h, after);
+        shift(offset - h, before);
+        double gradient{0};
+        residual = information = 0;
+        for (size_t i = 0; i < n; ++i) {
+            Vec3d e = visual[i] - gyro[i];
+            Vec3d d = (after[i] - before[i]) / (2 * h);
+            residual += e.dot(e);
+            information += d.dot(d);
+            gradient += d.dot(e);
+        }
+        // keep it within one step of the peak, as the residual could be dominated by noise
+        double delta = information > 0 ? gradient / information : 0.0;
+        double refined = min(max(offset + delta, (peak - steps - 1) * step), (peak - steps + 1) * step);
+        if (abs(refined - offset) < 1.0) {
+            break;
+        }
+        offset = refined;
+    }
+    const double correlation = correlate(offset);
+    const double excitation = sqrt(shift(offset, gyro) / static_cast<double>(n));
+    const double variance = residual / static_cast<double>(3 * n - 1);
+
+    estimate_.timestamp = lastTimestamp_;
+    estimate_.offset = offset;
+    estimate_.stddev = information > 0 ? sqrt(variance / information) : numeric_limits<double>::infinity();
+    estimate_.correlation = correlation;
+    estimate_.excitation = excitation;
+    estimate_.samples = n;
+    estimate_.valid = peak > 0 && peak < 2 * steps && excitation >= options_.minExcitation &&
+                      correlation >= options_.minCorrelation;
+    return true;
+}
+
+}  // namespace mev
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <opencv2/core.hpp>
+#include <unordered_map>
+#include <vector>
+#include "FeatureTracker.h"
+#include "ImuBuffer.h"
+
+namespace mev {
+
+// camera-IMU time offset estimator options
+struct TimeOffsetOptions {
+    std::int64_t window{5000000000};   // sliding window of frames, ns
+    std::int64_t maxOffset{50000000};  // search range of offset, [-maxOffset, maxOffset], ns
+    std::int64_t step{1000000};        // search step of offset before sub-step refinement, ns
+    std::size_t minSamples{30};        // min frame interval number in window to estimate
+    int minFeatures{20};               // min feature number tracked from previous frame to get visual rotation
+    double outlierPixels{2.0};         // features with larger rotation residual are rejected, pixel
+    double minExcitation{0.2};         // min angular velocity std in window to be valid, rad/s
+    double minCorrelation{0.8};        // min correlation of visual and gyroscope angular velocity to be valid
+};
+
+// time offset estimate of sliding window
+struct TimeOffsetEstimate {
+    bool valid{false};          // whether the excitation and correlation are enough and the peak is in range
+    std::int64_t timestamp{0};  // device timestamp of latest frame, ns
+    double offset{0};           // t_imu - t_camera of the same instant, ns
+    double stddev{0};           // standard deviation of offset, ns
+    double correlation{0};      // correlation of visual and gyroscope angular velocity at offset
+    double excitation{0};       // angular velocity std of gyroscope in window, rad/s
+    std::size_t samples{0};     // frame interval number used
+};
+
+// estimator statistics, the time is wall time
+struct TimeOffsetStatistics {
+    std::uint64_t frames{0};       // frame number
+    std::uint64_t rotations{0};    // frame number with visual rotation
+    std::uint64_t estimates{0};    // estimate number
+    std::uint64_t valid{0};        // valid estimate number
+    std::int64_t rotationTime{0};  // time to estimate visual rotation, ns
+    std::int64_t estimateTime{0};  // time to search offset, ns
+};
+
+/**
+ * @brief Online camera-IMU time offset estimator. The rotation between consecutive frames is estimated from the
+ * tracked features(pure rotation model, robust Gauss-Newton on bearings), and divided by the frame interval as the
+ * visual angular velocity. The gyroscope is integrated to a cumulative rotation vector in camera frame, so its average
+ * angular velocity over any shifted frame interval is a difference.
+ *
+ * Each frame, the offset is searched in the sliding window by the normalized cross-correlation of the visual and
+ * shifted gyroscope angular velocities(the mean of window is removed, so the gyroscope bias doesn't matter), refined by
+ * parabola around the peak and Gauss-Newton of their squared difference, and its standard deviation is from the
+ * residual and the sensitivity to offset. The estimate is valid only if the motion excites the rotation and the
+ * correlation is high
+ */
+class TimeOffsetEstimator {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param cameraMatrix  Camera matrix of the tracked image
+     * @param cameraImu     Rotation from IMU frame to camera frame, p_camera = cameraImu * p_imu
+     * @param options       Estimator options
+     */
+    TimeOffsetEstimator(const cv::Matx33d& cameraMatrix, const cv::Matx33d& cameraImu,
+                        const TimeOffsetOptions& options = TimeOffsetOptions());
+
+    /**
+     * @brief Add IMU records, the accelerator only records are skipped
+     *
+     * @param imu   IMU records after the added ones, in time order
+     */
+    void addImu(const ImuSpan& imu);
+
+    /**
+     * @brief Add the tracked features of a frame and update the estimate
+     *
+     * @param timestamp Device timestamp of frame, ns
+     * @param features  Tracked features of frame
+     * @return True if the estimate is updated
+     */
+    bool addFrame(std::int64_t timestamp, const std::vector<Feature>& features);
+
+    // latest estimate
+    inline const TimeOffsetEstimate& estimate() const { return estimate_; }
+
+    // statistics
+    inline const TimeOffsetStatistics& statistics() const { return statistics_; }
+
+  private:
+    // gyroscope record with the cumulative rotation vector since the first one, in camera frame
+    struct GyroSample {
+        std::int64_t timestamp{0};
+        cv::Vec3d velocity;  // angular velocity, rad/s
+        cv::Vec3d angle;     // cumulative rotation vector, rad
+    };
+
+    // visual angular velocity between two frames
+    struct VisualSample {
+        std::int64_t start{0};  // timestamp of previous frame, ns
+        std::int64_t end{0};    // timestamp of current frame, ns
+        cv::Vec3d velocity;     // angular velocity in camera frame, rad/s
+    };
+
+    // estimate the rotation from current frame to previous frame, return false if there are too few features
+    bool visualRotation(const std::vector<Feature>& features, cv::Matx33d* rotation);
+
+    // cumulative rotation vector at time t(ns), index is the hint of the record before t and it's updated, so the
+    // lookups with increasing time walk forward
+    cv::Vec3d cumulativeAngle(double t, std::size_t* index) const;
+
+    // search the offset in window, return false if there are too few samples
+    bool search();
+
+  private:
+    cv::Matx33d cameraMatrix_;
+    cv::Matx33d cameraImu_;
+    TimeOffsetOptions options_;
+    std::vector<GyroSample> gyro_;  // contiguous for fast lookup, the old ones are erased in batch
+    std::deque<VisualSample> visual_;
+    std::int64_t lastTimestamp_{0};                            // device timestamp of previous frame, ns
+    std::unordered_map<std::uint64_t, cv::Point2f> previous_;  // features of previous frame
+    TimeOffsetEstimate estimate_;
+    TimeOffsetStatistics statistics_;
+};
+
+}  // namespace mev
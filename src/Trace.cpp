@@ -0,0 +1,116 @@
+#include "Trace.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace mev {
+
+namespace {
+
+// complete event
+struct TraceEvent {
+    const char* name{nullptr};  // event name
+    int64_t start{0};           // start time, ns
+    int64_t end{0};             // end time, ns
+};
+
+// event buffer of one thread, only written by its own thread
+struct ThreadBuffer {
+    int tid{0};                 // thread index in trace
+    string name;                // thread name
+    vector<TraceEvent> events;  // ring buffer
+    atomic<uint64_t> count{0};  // total added event number
+};
+
+// all thread buffers, kept after the thread exits so its events could be written
+mutex gBuffersMutex;
+vector<shared_ptr<ThreadBuffer>> gBuffers;
+
+// get the buffer of current thread, register it in the first call
+ThreadBuffer& threadBuffer() {
+    thread_local shared_ptr<ThreadBuffer> buffer = [] {
+        auto b = make_shared<ThreadBuffer>();
+        b->events.resize(kTraceBufferSize);
+        lock_guard<mutex> lock(gBuffersMutex);
+        b->tid = static_cast<int>(gBuffers.size()) + 1;
+        b->name = fmt::format("thread {}", b->tid);
+        gBuffers.emplace_back(b);
+        return b;
+    }();
+    return *buffer;
+}
+
+}  // namespace
+
+namespace detail {
+
+atomic<bool> gTraceEnabled{false};
+
+void addTraceEvent(const char* name, int64_t start, int64_t end) {
+    auto& buffer = threadBuffer();
+    uint64_t n = buffer.count.load(memory_order_relaxed);
+    buffer.events[n % kTraceBufferSize] = {name, start, end};
+    buffer.count.store(n + 1, memory_order_release);
+}
+
+int64_t traceNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace detail
+
+void enableTrace(bool enable) { detail::gTraceEnabled = enable; }
+
+void setTraceThreadName(const string& name) {
+    // the OS thread name is limited to 15 characters, and the main thread is not renamed since it's the process name
+    if (syscall(SYS_gettid) != getpid()) {
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    }
+    auto& buffer = threadBuffer();
+    lock_guard<mutex> lock(gBuffersMutex);
+    buffer.name = name;
+}
+
+bool writeTrace(const fs::path& file) {
+    FILE* fp = fopen(file.string().c_str(), "w");
+    if (fp == nullptr) {
+        LOG(ERROR) << fmt::format("cannot open trace file \"{}\"", file.string());
+        return false;
+    }
+
+    lock_guard<mutex> lock(gBuffersMutex);
+    size_t eventNum{0};
+    fmt::print(fp, "{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fmt::print(fp, "{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{{\"name\":\"mev\"}}}}");
+    for (auto& buffer : gBuffers) {
+        fmt::print(fp, ",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+                       "\"args\":{{\"name\":\"{}\"}}}}",
+                   buffer->tid, buffer->name);
+        uint64_t count = buffer->count.load(memory_order_acquire);
+        uint64_t begin = count > kTraceBufferSize ? count - kTraceBufferSize : 0;
+        for (uint64_t i = begin; i < count; ++i) {
+            auto& e = buffer->events[i % kTraceBufferSize];
+            // the time unit of Chrome trace is us
+            fmt::print(fp, ",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                       e.name, buffer->tid, e.start * 1.0E-3, (e.end - e.start) * 1.0E-3);
+        }
+        eventNum += count - begin;
+    }
+    fmt::print(fp, "\n]}}\n");
+    bool ok = fclose(fp) == 0;
+    LOG(INFO) << fmt::format("write {} trace events of {} threads to \"{}\"", eventNum, gBuffers.size(),
+                             file.string());
+    return ok;
+}
+
+}  // namespace mev
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <string>
+
+namespace mev {
+
+// max event number of each thread buffer, the oldest events will be overwritten when it's full
+constexpr std::size_t kTraceBufferSize = 1 << 16;
+
+namespace detail {
+// whether trace is enabled
+extern std::atomic<bool> gTraceEnabled;
+
+// add complete event to the buffer of current thread
+void addTraceEvent(const char* name, std::int64_t start, std::int64_t end);
+
+// steady clock time, ns
+std::int64_t traceNow();
+}  // namespace detail
+
+// enable or disable trace, it's disabled by default
+void enableTrace(bool enable);
+
+// whether trace is enabled
+inline bool isTraceEnabled() { return detail::gTraceEnabled.load(std::memory_order_relaxed); }
+
+// set the name of current thread in trace, such as "capture" or "encode", it's also the OS thread name(shown in top)
+// except the main thread
+void setTraceThreadName(const std::string& name);
+
+/**
+ * @brief Write all trace events to file in Chrome trace format(JSON), which could be opened in Perfetto or
+ * chrome://tracing. Should be called after the traced threads are stopped
+ *
+ * @param file  Output file
+ * @return True for success
+ */
+bool writeTrace(const boost::filesystem::path& file);
+
+/**
+ * @brief Scoped trace marker, record the time from construction to destruction as a complete event. The events are
+ * saved to a per-thread ring buffer without lock, and nothing is done if the trace is disabled
+ *
+ * @code
+ *  {
+ *      TraceScope trace("encode");
+ *      imencode(...);
+ *  }
+ * @endcode
+ */
+class TraceScope {
+  public:
+    // name should be a string literal, only the pointer is saved
+    explicit TraceScope(const char* name) : name_(name), start_(isTraceEnabled() ? detail::traceNow() : 0) {}
+
+    ~TraceScope() {
+        if (start_ != 0) {
+            detail::addTraceEvent(name_, start_, detail::traceNow());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* name_;    // event name
+    std::int64_t start_;  // start time, 0 if trace is disabled
+};
+
+}  // namespace mev
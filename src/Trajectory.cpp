@@ -0,0 +1,129 @@
+#include "Trajectory.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "ImuIntegration.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+Matx33d quaternionRotation(double w, double x, double y, double z) {
+    double n = sqrt(w * w + x * x + y * y + z * z);
+    w /= n, x /= n, y /= n, z /= n;
+    return Matx33d(1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y),  // row 0
+                   2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x),  // row 1
+                   2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y));
+}
+
+Vec4d rotationQuaternion(const Matx33d& R) {
+    // compute the largest component first for numerical stability
+    double trace = R(0, 0) + R(1, 1) + R(2, 2);
+    Vec4d q;
+    if (trace > 0) {
+        double s = 2 * sqrt(1 + trace);
+        q = Vec4d(s / 4, (R(2, 1) - R(1, 2)) / s, (R(0, 2) - R(2, 0)) / s, (R(1, 0) - R(0, 1)) / s);
+    } else if (R(0, 0) > R(1, 1) && R(0, 0) > R(2, 2)) {
+        double s = 2 * sqrt(1 + R(0, 0) - R(1, 1) - R(2, 2));
+        q = Vec4d((R(2, 1) - R(1, 2)) / s, s / 4, (R(0, 1) + R(1, 0)) / s, (R(0, 2) + R(2, 0)) / s);
+    } else if (R(1, 1) > R(2, 2)) {
+        double s = 2 * sqrt(1 + R(1, 1) - R(0, 0) - R(2, 2));
+        q = Vec4d((R(0, 2) - R(2, 0)) / s, (R(0, 1) + R(1, 0)) / s, s / 4, (R(1, 2) + R(2, 1)) / s);
+    } else {
+        double s = 2 * sqrt(1 + R(2, 2) - R(0, 0) - R(1, 1));
+        q = Vec4d((R(1, 0) - R(0, 1)) / s, (R(0, 2) + R(2, 0)) / s, (R(1, 2) + R(2, 1)) / s, s / 4);
+    }
+    q *= (q[0] < 0 ? -1.0 : 1.0) / norm(q);
+    return q;
+}
+
+string formatPose(const StampedPose& pose) {
+    Vec4d q = rotationQuaternion(pose.rotation);
+    return fmt::format("{} {:.6f} {:.6f} {:.6f} {:.9f} {:.9f} {:.9f} {:.9f}", pose.timestamp, pose.translation[0],
+                       pose.translation[1], pose.translation[2], q[1], q[2], q[3], q[0]);
+}
+
+bool loadTrajectory(const string& file, vector<StampedPose>* trajectory) {
+    trajectory->clear();
+    ifstream in(file);
+    if (!in.is_open()) {
+        LOG(ERROR) << fmt::format("cannot open trajectory \"{}\"", file);
+        return false;
+    }
+    string line;
+    for (int lineNum = 1; getline(in, line); ++lineNum) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream ss(line);
+        StampedPose pose;
+        double q[4];
+        if (!(ss >> pose.timestamp >> pose.translation[0] >> pose.translation[1] >> pose.translation[2] >> q[0] >>
+              q[1] >> q[2] >> q[3])) {
+            LOG(ERROR) << fmt::format("invalid pose at line {} of \"{}\": {}", lineNum, file, line);
+            return false;
+        }
+        pose.rotation = quaternionRotation(q[3], q[0], q[1], q[2]);
+        trajectory->emplace_back(pose);
+    }
+    stable_sort(trajectory->begin(), trajectory->end(),
+                [](const StampedPose& a, const StampedPose& b) { return a.timestamp < b.timestamp; });
+    return true;
+}
+
+bool poseFromMat(const Mat& mat, int64_t timestamp, StampedPose* pose) {
+    if (mat.type() != CV_64FC1 || mat.total() != 7) {
+        return false;
+    }
+    const double* v = mat.ptr<double>();
+    pose->timestamp = timestamp;
+    pose->translation = Vec3d(v[0], v[1], v[2]);
+    pose->rotation = quaternionRotation(v[6], v[3], v[4], v[5]);
+    return true;
+}
+
+Mat poseToMat(const StampedPose& pose) {
+    Vec4d q = rotationQuaternion(pose.rotation);
+    Mat mat(1, 7, CV_64FC1);
+    double* v = mat.ptr<double>();
+    v[0] = pose.translation[0];
+    v[1] = pose.translation[1];
+    v[2] = pose.translation[2];
+    v[3] = q[1];
+    v[4] = q[2];
+    v[5] = q[3];
+    v[6] = q[0];
+    return mat;
+}
+
+bool interpolatePose(const vector<StampedPose>& trajectory, int64_t timestamp, int64_t maxGap, StampedPose* pose) {
+    // the first pose not before timestamp
+    auto it = lower_bound(trajectory.begin(), trajectory.end(), timestamp,
+                          [](const StampedPose& p, int64_t t) { return p.timestamp < t; });
+    if (it == trajectory.end()) {
+        return false;
+    }
+    if (it->timestamp == timestamp) {
+        *pose = *it;
+        return true;
+    }
+    if (it == trajectory.begin()) {
+        return false;
+    }
+    const StampedPose& p0 = *(it - 1);
+    const StampedPose& p1 = *it;
+    if (p1.timestamp - p0.timestamp > maxGap) {
+        return false;
+    }
+    double s = static_cast<double>(timestamp - p0.timestamp) / (p1.timestamp - p0.timestamp);
+    pose->timestamp = timestamp;
+    pose->translation = p0.translation + (p1.translation - p0.translation) * s;
+    pose->rotation = p0.rotation * expRotation(logRotation(p0.rotation.t() * p1.rotation) * s);
+    return true;
+}
+
+}  // namespace mev
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+namespace mev {
+
+// pose of camera at timestamp, p_world = rotation * p_camera + translation
+struct StampedPose {
+    std::int64_t timestamp{0};                 // timestamp, ns
+    cv::Matx33d rotation{cv::Matx33d::eye()};  // rotation from camera to world
+    cv::Vec3d translation{0, 0, 0};            // camera position in world, m
+};
+
+// rotation matrix of unit quaternion (w, x, y, z)
+cv::Matx33d quaternionRotation(double w, double x, double y, double z);
+
+// unit quaternion (w, x, y, z) of rotation matrix, w >= 0
+cv::Vec4d rotationQuaternion(const cv::Matx33d& R);
+
+// format pose to one line of trajectory "timestamp tx ty tz qx qy qz qw", without line break
+std::string formatPose(const StampedPose& pose);
+
+/**
+ * @brief Load camera trajectory, one pose per line as "timestamp tx ty tz qx qy qz qw", which is the TUM format except
+ * that the timestamp is in ns. The lines start with '#' are comments, the poses are sorted by timestamp
+ *
+ * @param file          Trajectory file
+ * @param trajectory    Output poses
+ * @return False if the file cannot be read or any line is invalid
+ */
+bool loadTrajectory(const std::string& file, std::vector<StampedPose>* trajectory);
+
+/**
+ * @brief Get pose from the 1x7 CV_64FC1 Mat [tx, ty, tz, qx, qy, qz, qw], which is the pose stream published to shared
+ * memory by the odometry
+ *
+ * @param mat       Pose Mat
+ * @param timestamp Timestamp of pose, ns
+ * @param pose      Output pose
+ * @return False if the Mat isn't a pose
+ */
+bool poseFromMat(const cv::Mat& mat, std::int64_t timestamp, StampedPose* pose);
+
+// convert pose to the 1x7 CV_64FC1 Mat [tx, ty, tz, qx, qy, qz, qw], the inverse of poseFromMat()
+cv::Mat poseToMat(const StampedPose& pose);
+
+/**
+ * @brief Interpolate the pose at timestamp, the translation is linear and the rotation is interpolated on the geodesic
+ *
+ * @param trajectory    Poses sorted by timestamp
+ * @param timestamp     Timestamp, ns
+ * @param maxGap        Max time gap between the two poses around the timestamp, ns
+ * @param pose          Output pose
+ * @return False if the timestamp is out of trajectory or the gap is larger than maxGap
+ */
+bool interpolatePose(const std::vector<StampedPose>& trajectory, std::int64_t timestamp, std::int64_t maxGap,
+                     StampedPose* pose);
+
+}  // namespace mev
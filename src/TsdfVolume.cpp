@@ -0,0 +1,323 @@
+#include "TsdfVolume.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "ClockSync.h"
+
+using namespace std;
+using namespace cv;
+
+namespace mev {
+
+namespace {
+
+constexpr int kBlockVoxels = kTsdfBlockSize * kTsdfBlockSize * kTsdfBlockSize;
+
+// the block coordinate is packed to 21 bits of each axis
+constexpr int kKeyBits = 21;
+constexpr int64_t kKeyOffset = int64_t{1} << (kKeyBits - 1);
+constexpr uint64_t kKeyMask = (uint64_t{1} << kKeyBits) - 1;
+
+constexpr float kTsdfScale = 32767.f;
+
+// entry number of the cache to remove duplicated block keys in allocation, in bits
+constexpr int kKeyCacheBits = 12;
+
+inline uint64_t packKey(int x, int y, int z) {
+    return (static_cast<uint64_t>(x + kKeyOffset) & kKeyMask) << (2 * kKeyBits) |
+           (static_cast<uint64_t>(y + kKeyOffset) & kKeyMask) << kKeyBits |
+           (static_cast<uint64_t>(z + kKeyOffset) & kKeyMask);
+}
+
+inline Vec3i unpackKey(uint64_t key) {
+    return Vec3i(static_cast<int>(static_cast<int64_t>((key >> (2 * kKeyBits)) & kKeyMask) - kKeyOffset),
+                 static_cast<int>(static_cast<int64_t>((key >> kKeyBits) & kKeyMask) - kKeyOffset),
+                 static_cast<int>(static_cast<int64_t>(key & kKeyMask) - kKeyOffset));
+}
+
+// floor division of voxel coordinate by block size
+inline int blockOf(int v) { return v >= 0 ? v / kTsdfBlockSize : (v + 1) / kTsdfBlockSize - 1; }
+
+}  // namespace
+
+TsdfVolume::TsdfVolume(const DepthCamera& camera, const TsdfOptions& options) : camera_(camera), options_(options) {
+    CHECK(camera_.fx > 0 && camera_.fy > 0) << "invalid depth camera";
+    CHECK_GT(options_.voxelSize, 0) << "voxel size should be greater than 0";
+    CHECK_GE(options_.truncation, options_.voxelSize) << "truncation should be at least 1 voxel";
+    CHECK_GT(options_.allocationStep, 0) << "allocation step should be greater than 0";
+    CHECK(options_.maxWeight > 0 && options_.maxWeight < 65536) << "max weight should be in [1, 65535]";
+    capacity_ = static_cast<size_t>(options_.memoryBudget * 1024 * 1024 / sizeof(TsdfBlock));
+    CHECK_GT(capacity_, 0) << "memory budget is too small";
+    stripes_ = options_.threads > 0 ? options_.threads : max(getNumThreads(), 1);
+    // the pages of pool are committed when the blocks are allocated
+    blocks_.reserve(capacity_);
+    blockKeys_.reserve(capacity_);
+    lastVisible_.reserve(capacity_);
+    blockIndex_.reserve(min<size_t>(capacity_, 1 << 20));
+    stripeKeys_.resize(stripes_);
+}
+
+void TsdfVolume::integrate(const Mat& depth, const StampedPose& pose) {
+    CHECK_EQ(depth.type(), CV_16UC1) << "depth should be 16 bits image";
+    ++statistics_.frames;
+    const Matx33f rotation = pose.rotation;
+    const Vec3f translation = pose.translation;
+
+    int64_t startTime = hostNow();
+    allocate(depth, rotation, translation);
+    int64_t allocateTime = hostNow();
+    statistics_.allocateTime += allocateTime - startTime;
+    statistics_.visibleBlocks += visible_.size();
+
+    integrateBlocks(depth, rotation, translation);
+    statistics_.integrateTime += hostNow() - allocateTime;
+}
+
+void TsdfVolume::allocate(const Mat& depth, const Matx33f& rotation, const Vec3f& translation) {
+    // collect the touched block keys of each stripe in parallel, the ray is sampled every half block within truncation
+    const float blockSize = static_cast<float>(options_.voxelSize * kTsdfBlockSize);
+    const float inverseBlock = 1 / blockSize;
+    const float truncation = static_cast<float>(options_.truncation);
+    const float minDepth = static_cast<float>(options_.minDepth), maxDepth = static_cast<float>(options_.maxDepth);
+    const int step = options_.allocationStep;
+    parallel_for_(
+        Range(0, stripes_),
+        [&](const Range& range) {
+            for (int s = range.start; s < range.end; ++s) {
+                auto& keys = stripeKeys_[s];
+                keys.clear();
+                vector<uint64_t> cache(size_t{1} << kKeyCacheBits, ~uint64_t{0});
+                int rowBegin = depth.rows * s / stripes_, rowEnd = depth.rows * (s + 1) / stripes_;
+                for (int v = rowBegin + (step - rowBegin % step) % step; v < rowEnd; v += step) {
+                    const uint16_t* row = depth.ptr<uint16_t>(v);
+                    for (int u = 0; u < depth.cols; u += step) {
+                        float d = static_cast<float>(row[u] * camera_.depthScale);
+                        if (row[u] == 0 || d < minDepth || d > maxDepth) {
+                            continue;
+                        }
+                        Vec3f ray = rotation * Vec3f(static_cast<float>((u - camera_.cx) / camera_.fx),
+                                                     static_cast<float>((v - camera_.cy) / camera_.fy), 1.f);
+                        float rayStep = 0.5f * blockSize / static_cast<float>(norm(ray));
+                        int n = static_cast<int>(ceil(2 * truncation / rayStep)) + 1;
+                        Vec3f p = (translation + ray * (d - truncation)) * inverseBlock;
+                        Vec3f dp = ray * (rayStep * inverseBlock);
+                        for (int i = 0; i < n; ++i, p += dp) {
+                            uint64_t key = packKey(static_cast<int>(floor(p[0])), static_cast<int>(floor(p[1])),
+                                                   static_cast<int>(floor(p[2])));
+                            // the neighbor pixels touch the same blocks, most duplicates are removed by the cache
+                            uint64_t& cached = cache[KeyHash()(key) >> (64 - kKeyCacheBits)];
+                            if (cached != key) {
+                                keys.emplace_back(key);
+                                cached = key;
+                            }
+                        }
+                    }
+                }
+                sort(keys.begin(), keys.end());
+                keys.erase(unique(keys.begin(), keys.end()), keys.end());
+            }
+        },
+        stripes_);
+
+    // allocate the blocks in serial, the hash map isn't thread safe
+    const uint64_t frame = statistics_.frames;
+    visible_.clear();
+    for (auto& keys : stripeKeys_) {
+        for (uint64_t key : keys) {
+            int index = findOrAllocate(key);
+            if (index < 0) {
+                ++statistics_.droppedBlocks;
+            } else if (lastVisible_[index] != frame) {
+                lastVisible_[index] = frame;
+                visible_.emplace_back(index);
+            }
+        }
+    }
+}
+
+int TsdfVolume::findOrAllocate(uint64_t key) {
+    auto it = blockIndex_.find(key);
+    if (it != blockIndex_.end()) {
+        return it->second;
+    }
+    if (freeBlocks_.empty() && blocks_.size() >= capacity_ && !evict()) {
+        return -1;
+    }
+    int index;
+    if (!freeBlocks_.empty()) {
+        index = freeBlocks_.back();
+        freeBlocks_.pop_back();
+        blocks_[index] = TsdfBlock();
+        blockKeys_[index] = key;
+        lastVisible_[index] = 0;
+    } else {
+        index = static_cast<int>(blocks_.size());
+        blocks_.emplace_back();
+        blockKeys_.emplace_back(key);
+        lastVisible_.emplace_back(0);
+    }
+    blockIndex_.emplace(key, index);
+    ++statistics_.allocatedBlocks;
+    return index;
+}
+
+bool TsdfVolume::evict() {
+    // all blocks were visible at the last try in current frame, so the remaining keys are dropped without rescanning
+    if (evictFailedFrame_ == statistics_.frames) {
+        return false;
+    }
+    int64_t startTime = hostNow();
+    // the blocks not visible in current frame, the visible ones are being integrated
+    vector<int> candidates;
+    candidates.reserve(blocks_.size());
+    for (auto& item : blockIndex_) {
+        if (lastVisible_[item.second] != statistics_.frames) {
+            candidates.emplace_back(item.second);
+        }
+    }
+    size_t evictNum = min(candidates.size(), max<size_t>(1, static_cast<size_t>(capacity_ * options_.evictRatio)));
+    nth_element(candidates.begin(), candidates.begin() + evictNum, candidates.end(),
+                [&](int a, int b) { return lastVisible_[a] < lastVisible_[b]; });
+    for (size_t i = 0; i < evictNum; ++i) {
+        blockIndex_.erase(blockKeys_[candidates[i]]);
+        freeBlocks_.emplace_back(candidates[i]);
+    }
+    statistics_.evictedBlocks += evictNum;
+    statistics_.evictTime += hostNow() - startTime;
+    if (evictNum == 0) {
+        evictFailedFrame_ = statistics_.frames;
+        return false;
+    }
+    return true;
+}
+
+void TsdfVolume::integrateBlocks(const Mat& depth, const Matx33f& rotation, const Vec3f& translation) {
+    // world to image, the voxel center is projected by K * (R^T * p_world - R^T * t), it's linear in voxel index, so
+    // the homogeneous pixel is incremented by the steps of x, y and z voxels
+    const float voxelSize = static_cast<float>(options_.voxelSize);
+    const Matx33f K(static_cast<float>(camera_.fx), 0, static_cast<float>(camera_.cx) + 0.5f,  // row 0
+                    0, static_cast<float>(camera_.fy), static_cast<float>(camera_.cy) + 0.5f,  // row 1
+                    0, 0, 1);
+    const Matx33f projection = K * rotation.t();
+    const Vec3f offset = -(projection * translation);
+    const Vec3f dx = projection * Vec3f(voxelSize, 0, 0), dy = projection * Vec3f(0, voxelSize, 0),
+                dz = projection * Vec3f(0, 0, voxelSize);
+    const float depthScale = static_cast<float>(camera_.depthScale);
+    const float minDepth = static_cast<float>(options_.minDepth), maxDepth = static_cast<float>(options_.maxDepth);
+    const float truncation = static_cast<float>(options_.truncation), inverseTruncation = 1 / truncation;
+    const int maxWeight = options_.maxWeight;
+    const float cols = static_cast<float>(depth.cols), rows = static_cast<float>(depth.rows);
+    const uchar* depthData = depth.data;
+    const size_t depthStep = depth.step;
+    const int blockNum = static_cast<int>(visible_.size());
+    parallel_for_(
+        Range(0, blockNum),
+        [&](const Range& range) {
+            for (int b = range.start; b < range.end; ++b) {
+                int index = visible_[b];
+                TsdfVoxel* voxel = blocks_[index].voxels.data();
+                Vec3i coord = unpackKey(blockKeys_[index]) * kTsdfBlockSize;
+                Vec3f origin =
+                    projection * (Vec3f(coord[0] + 0.5f, coord[1] + 0.5f, coord[2] + 0.5f) * voxelSize) + offset;
+                for (int z = 0; z < kTsdfBlockSize; ++z) {
+                    for (int y = 0; y < kTsdfBlockSize; ++y) {
+                        Vec3f row = origin + dy * static_cast<float>(y) + dz * static_cast<float>(z);
+                        float pu = row[0], pv = row[1], pz = row[2];
+                        for (int x = 0; x < kTsdfBlockSize; ++x, pu += dx[0], pv += dx[1], pz += dx[2], ++voxel) {
+                            if (pz <= 0) {
+                                continue;
+                            }
+                            float inverseZ = 1 / pz;
+                            float fu = pu * inverseZ, fv = pv * inverseZ;
+                            if (fu < 0 || fu >= cols || fv < 0 || fv >= rows) {
+                                continue;
+                            }
+                            int u = static_cast<int>(fu), v = static_cast<int>(fv);
+                            float d = reinterpret_cast<const uint16_t*>(depthData + v * depthStep)[u] * depthScale;
+                            if (d < minDepth || d > maxDepth) {
+                                continue;
+                            }
+                            float sdf = d - pz;
+                            if (sdf < -truncation) {
+                                continue;
+                            }
+                            // weighted average of the truncated signed distance
+                            float tsdf = min(1.f, sdf * inverseTruncation) * kTsdfScale;
+                            int weight = voxel->weight;
+                            float average = (voxel->tsdf * weight + tsdf) / (weight + 1);
+                            voxel->tsdf = static_cast<int16_t>(average + (average < 0 ? -0.5f : 0.5f));
+                            voxel->weight = static_cast<uint16_t>(min(weight + 1, maxWeight));
+                        }
+                    }
+                }
+            }
+        },
+        stripes_);
+}
+
+const TsdfVoxel* TsdfVolume::voxel(const Vec3i& v) const {
+    int bx = blockOf(v[0]), by = blockOf(v[1]), bz = blockOf(v[2]);
+    auto it = blockIndex_.find(packKey(bx, by, bz));
+    if (it == blockIndex_.end()) {
+        return nullptr;
+    }
+    int x = v[0] - bx * kTsdfBlockSize, y = v[1] - by * kTsdfBlockSize, z = v[2] - bz * kTsdfBlockSize;
+    return &blocks_[it->second].voxels[(z * kTsdfBlockSize + y) * kTsdfBlockSize + x];
+}
+
+void TsdfVolume::extractSurface(vector<Vec3f>* points, int minWeight) const {
+    points->clear();
+    const float voxelSize = static_cast<float>(options_.voxelSize);
+    const Vec3i axes[3] = {Vec3i(1, 0, 0), Vec3i(0, 1, 0), Vec3i(0, 0, 1)};
+    for (auto& item : blockIndex_) {
+        const TsdfVoxel* voxels = blocks_[item.second].voxels.data();
+        Vec3i coord = unpackKey(item.first) * kTsdfBlockSize;
+        for (int i = 0; i < kBlockVoxels; ++i) {
+            const TsdfVoxel& a = voxels[i];
+            if (a.weight < minWeight) {
+                continue;
+            }
+            Vec3i v = coord + Vec3i(i % kTsdfBlockSize, i / kTsdfBlockSize % kTsdfBlockSize,
+                                    i / (kTsdfBlockSize * kTsdfBlockSize));
+            for (auto& axis : axes) {
+                // the zero crossing from front to back of surface, linear interpolated between voxel centers
+                const TsdfVoxel* b = voxel(v + axis);
+                if (!b || b->weight < minWeight || (a.tsdf > 0) == (b->tsdf > 0)) {
+                    continue;
+                }
+                float s = static_cast<float>(a.tsdf) / (a.tsdf - b->tsdf);
+                points->emplace_back(Vec3f(v[0] + 0.5f + s * axis[0], v[1] + 0.5f + s * axis[1],
+                                           v[2] + 0.5f + s * axis[2]) * voxelSize);
+            }
+        }
+    }
+}
+
+bool TsdfVolume::savePly(const string& file, int minWeight) const {
+    vector<Vec3f> points;
+    extractSurface(&points, minWeight);
+    ofstream out(file, ios::binary);
+    if (!out.is_open()) {
+        LOG(ERROR) << fmt::format("cannot open \"{}\" to save PLY", file);
+        return false;
+    }
+    out << fmt::format("ply\nformat binary_little_endian 1.0\nelement vertex {}\nproperty float x\nproperty float y\n"
+                       "property float z\nend_header\n",
+                       points.size());
+    out.write(reinterpret_cast<const char*>(points.data()), static_cast<streamsize>(points.size() * sizeof(Vec3f)));
+    LOG(INFO) << fmt::format("save {} surface points of {} blocks to \"{}\"", points.size(), blockNum(), file);
+    return out.good();
+}
+
+void TsdfVolume::reset() {
+    blockIndex_.clear();
+    blocks_.clear();
+    blockKeys_.clear();
+    lastVisible_.clear();
+    freeBlocks_.clear();
+    visible_.clear();
+}
+
+}  // namespace mev
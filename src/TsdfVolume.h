@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FrameBundle.h"
+#include "Trajectory.h"
+
+namespace mev {
+
+// TSDF volume options, the lengths are in m
+struct TsdfOptions {
+    double voxelSize{0.01};    // voxel size
+    double truncation{0.04};   // truncation distance of signed distance, usually 3~5 voxels
+    double minDepth{0.2};      // min depth to integrate
+    double maxDepth{4.0};      // max depth to integrate
+    int maxWeight{64};         // max weight of voxel, the smaller one adapts to scene changes faster
+    int allocationStep{2};     // pixel step to allocate blocks, the integration uses all pixels
+    double memoryBudget{512};  // max memory of voxel blocks, MB
+    double evictRatio{0.1};    // ratio of blocks to evict when the memory budget is used up
+    int threads{0};            // thread number of allocation and integration, 0 for OpenCV thread number
+};
+
+// voxel of TSDF, the signed distance is normalized by truncation and scaled to int16
+struct TsdfVoxel {
+    std::int16_t tsdf{0};     // signed distance, positive is in front of surface, [-32767, 32767]
+    std::uint16_t weight{0};  // observation weight, 0 if unobserved
+};
+
+// side length of voxel block, in voxels
+constexpr int kTsdfBlockSize = 8;
+
+// voxel block, the voxels are in x, y and z order
+struct TsdfBlock {
+    std::array<TsdfVoxel, kTsdfBlockSize * kTsdfBlockSize * kTsdfBlockSize> voxels;
+};
+
+// TSDF volume statistics
+struct TsdfStatistics {
+    std::uint64_t frames{0};           // integrated frame number
+    std::uint64_t visibleBlocks{0};    // total visible block number of all frames
+    std::uint64_t allocatedBlocks{0};  // total allocated block number
+    std::uint64_t evictedBlocks{0};    // total evicted block number
+    std::uint64_t droppedBlocks{0};    // block number not allocated as all blocks are visible in the frame
+    std::int64_t allocateTime{0};      // time to allocate blocks, ns
+    std::int64_t integrateTime{0};     // time to integrate depth, ns
+    std::int64_t evictTime{0};         // time to evict blocks, ns
+};
+
+/**
+ * @brief Incremental TSDF volume by voxel hashing. The space is divided into 8x8x8 voxel blocks, and only the blocks
+ * near the observed surfaces are allocated and indexed by a hash map of block coordinate. Each frame is integrated in
+ * 2 steps which run in parallel stripes:
+ *  1. allocation, the depth pixels are cast along the ray within truncation, and the touched blocks are collected and
+ *     allocated. These blocks are the visible blocks of the frame
+ *  2. integration, the voxels of visible blocks are projected to depth and updated by the weighted average of the
+ *     truncated signed distance
+ *
+ * The blocks are allocated from a pool bounded by the memory budget, if it's used up, the least recently visible
+ * blocks are evicted, so the volume keeps the latest map around the camera in bounded memory. Not thread safe
+ */
+class TsdfVolume {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param camera    Depth camera
+     * @param options   Volume options
+     */
+    explicit TsdfVolume(const DepthCamera& camera, const TsdfOptions& options = TsdfOptions());
+
+    /**
+     * @brief Integrate depth frame
+     *
+     * @param depth Depth image, CV_16UC1
+     * @param pose  Camera pose of depth
+     */
+    void integrate(const cv::Mat& depth, const StampedPose& pose);
+
+    /**
+     * @brief Extract the surface points, which are the zero crossings of TSDF between neighbor voxels
+     *
+     * @param points    Output points in world frame
+     * @param minWeight Min weight of voxels to extract
+     */
+    void extractSurface(std::vector<cv::Vec3f>* points, int minWeight = 3) const;
+
+    /**
+     * @brief Save the surface points to binary PLY file
+     *
+     * @param file      PLY file
+     * @param minWeight Min weight of voxels to extract
+     * @return True for success
+     */
+    bool savePly(const std::string& file, int minWeight = 3) const;
+
+    // remove all blocks
+    void reset();
+
+    // allocated block number
+    inline std::size_t blockNum() const { return blockIndex_.size(); }
+
+    // max block number of memory budget
+    inline std::size_t capacity() const { return capacity_; }
+
+    inline const TsdfOptions& options() const { return options_; }
+
+    inline const TsdfStatistics& statistics() const { return statistics_; }
+
+  private:
+    // allocate the blocks touched by depth, and collect the visible blocks
+    void allocate(const cv::Mat& depth, const cv::Matx33f& rotation, const cv::Vec3f& translation);
+
+    // integrate depth to visible blocks
+    void integrateBlocks(const cv::Mat& depth, const cv::Matx33f& rotation, const cv::Vec3f& translation);
+
+    // evict the least recently visible blocks, return false if all blocks are visible in current frame, then it isn't
+    // tried again in this frame
+    bool evict();
+
+    // get the block index, allocate it if not exist, -1 if the memory budget is used up
+    int findOrAllocate(std::uint64_t key);
+
+    // voxel at global voxel coordinate, nullptr if the block isn't allocated
+    const TsdfVoxel* voxel(const cv::Vec3i& v) const;
+
+    // hash of packed block coordinate
+    struct KeyHash {
+        inline std::size_t operator()(std::uint64_t key) const {
+            return static_cast<std::size_t>((key ^ (key >> 29)) * 0xBF58476D1CE4E5B9ULL);
+        }
+    };
+
+  private:
+    DepthCamera camera_;
+    TsdfOptions options_;
+    TsdfStatistics statistics_;
+    int stripes_{1};                                              // stripe number of parallel loops
+    std::size_t capacity_{0};                                     // max block number
+    std::unordered_map<std::uint64_t, int, KeyHash> blockIndex_;  // block key to block index
+    std::vector<TsdfBlock> blocks_;                               // block pool
+    std::vector<std::uint64_t> blockKeys_;                        // key of each block in pool
+    std::vector<std::uint64_t> lastVisible_;                      // last visible frame of each block in pool
+    std::vector<int> freeBlocks_;                                 // free block indexes in pool
+    std::uint64_t evictFailedFrame_{0};                           // last frame whose eviction found no block
+    std::vector<int> visible_;                                    // visible block indexes of current frame
+    std::vector<std::vector<std::uint64_t>> stripeKeys_;          // touched block keys of each stripe
+};
+
+}  // namespace mev
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mev {
+
+// the unit of device timestamp is 0.01 ms
+constexpr std::int64_t kDeviceTickNs = 10000;
+
+// convert device timestamp to nanoseconds
+inline std::int64_t deviceToNs(std::uint64_t ticks) { return static_cast<std::int64_t>(ticks) * kDeviceTickNs; }
+
+// encoded image to save
+struct ImageRecord {
+    std::string stream;              // stream name, "left" or "right"
+    std::uint32_t frameId{0};        // frame ID
+    std::int64_t timestamp{0};       // device timestamp, ns
+    std::int64_t hostTimestamp{0};   // host timestamp, ns
+    std::string ext;                 // file extension, such as "jpg"
+    std::vector<std::uint8_t> data;  // encoded image data
+};
+
+// IMU record to save, accelerator and gyroscope in one record, the unused one will be zero
+struct ImuRecord {
+    std::int64_t timestamp{0};      // device timestamp, ns
+    std::int64_t hostTimestamp{0};  // host timestamp, ns
+    double acc[3]{0, 0, 0};         // accelerator, m/s^2
+    double gyro[3]{0, 0, 0};        // gyroscope, rad/s
+};
+
+}  // namespace mev